@@ -0,0 +1,389 @@
+// Microbenchmarks for the per-report hot path.
+//
+// Every benchmark reports wall time, heap allocations and servo register
+// writes per operation. Servos are replaced with a counting fake so no bus or
+// hardware is needed; sockets are local socketpairs and eventfds.
+
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+
+#include "src/bluetooth_channel.h"
+#include "src/controller_packet_to_pan_tilt_action_mapper.h"
+#include "src/controller_report.h"
+#include "src/event_handler.h"
+#include "src/event_loop.h"
+#include "src/joystick_input_to_servo_action_mapper.h"
+#include "src/servo_bus_budget.h"
+
+namespace
+{
+
+std::atomic<uint64_t> g_allocation_count{0};
+uint64_t g_servo_write_count = 0;
+
+}  // namespace
+
+void* operator new(size_t size)
+{
+  g_allocation_count.fetch_add(1, std::memory_order_relaxed);
+  void *memory = malloc(size ? size : 1);
+  if (!memory)
+  {
+    throw std::bad_alloc{};
+  }
+  return memory;
+}
+
+void* operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void operator delete(void *memory) noexcept
+{
+  free(memory);
+}
+
+void operator delete[](void *memory) noexcept
+{
+  free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept
+{
+  free(memory);
+}
+
+void operator delete[](void *memory, size_t) noexcept
+{
+  free(memory);
+}
+
+namespace
+{
+
+constexpr size_t DEFAULT_ITERATIONS = 1000000;
+constexpr size_t SOCKET_ITERATIONS = 200000;
+// Frames queued on the socketpair per untimed refill.
+constexpr size_t SOCKET_BATCH_SIZE = 64;
+constexpr size_t PACKET_SWEEP_SIZE = 256;
+// Size of the monitor header ReceiveHciMonitorFrame() strips.
+constexpr size_t HCI_MONITOR_HEADER_SIZE = 6;
+
+// Stand-in for dynamixel::AxA12 that only counts register writes.
+class CountingServo
+{
+public:
+  bool SetGoalPosition(uint16_t) { return Count(); }
+  bool SetMovingSpeed(uint16_t) { return Count(); }
+  bool SetTorqueEnabled(bool) { return Count(); }
+  bool SetTorqueLimit(uint16_t) { return Count(); }
+  bool SetClockWiseAngleLimit(uint16_t) { return Count(); }
+  bool SetCounterClockWiseAngleLimit(uint16_t) { return Count(); }
+
+private:
+  static bool Count()
+  {
+    ++g_servo_write_count;
+    return true;
+  }
+};
+
+// Accumulates timed sections; PauseTiming()/ResumeTiming() exclude setup work
+// such as refilling a socket.
+class BenchmarkState
+{
+public:
+  explicit BenchmarkState(size_t iterations)
+    : iterations_{iterations},
+      elapsed_{0},
+      allocations_{0},
+      servo_writes_{0} {}
+
+  size_t GetIterations() const { return iterations_; }
+
+  void ResumeTiming()
+  {
+    start_allocations_ = g_allocation_count.load(std::memory_order_relaxed);
+    start_servo_writes_ = g_servo_write_count;
+    start_ = std::chrono::steady_clock::now();
+  }
+
+  void PauseTiming()
+  {
+    elapsed_ += std::chrono::steady_clock::now() - start_;
+    allocations_ += g_allocation_count.load(std::memory_order_relaxed) - start_allocations_;
+    servo_writes_ += g_servo_write_count - start_servo_writes_;
+  }
+
+  void Report(const char *name) const
+  {
+    double iterations = static_cast<double>(iterations_);
+    printf(
+        "%-66s %10zu %10.1f %10.3f %16.6f\n",
+        name,
+        iterations_,
+        std::chrono::duration<double, std::nano>(elapsed_).count() / iterations,
+        allocations_ / iterations,
+        servo_writes_ / iterations);
+  }
+
+private:
+  size_t iterations_;
+  std::chrono::steady_clock::duration elapsed_;
+  uint64_t allocations_;
+  uint64_t servo_writes_;
+  std::chrono::steady_clock::time_point start_;
+  uint64_t start_allocations_;
+  uint64_t start_servo_writes_;
+};
+
+template <typename T>
+void DoNotOptimize(const T &value)
+{
+  asm volatile("" : : "g"(&value) : "memory");
+}
+
+// Stick positions sweeping both axes through full deflection, so the mappers
+// see direction and speed changes as well as steady holds.
+std::vector<std::vector<uint8_t>> MakePacketSweep()
+{
+  std::vector<std::vector<uint8_t>> packets;
+  for (size_t i = 0; i < PACKET_SWEEP_SIZE; ++i)
+  {
+    double phase = 2.0 * M_PI * i / PACKET_SWEEP_SIZE;
+    uint16_t x = static_cast<uint16_t>(0x8000 + 0x7FFF * std::sin(phase));
+    uint16_t y = static_cast<uint16_t>(0x8000 + 0x7FFF * std::cos(phase));
+
+    std::vector<uint8_t> packet(xbox::CONTROLLER_REPORT_SIZE, 0);
+    packet[10] = x & 0xFF;
+    packet[11] = x >> 8;
+    packet[12] = y & 0xFF;
+    packet[13] = y >> 8;
+    packet[14] = packet[16] = 0x00;
+    packet[15] = packet[17] = 0x80;
+    packets.push_back(std::move(packet));
+  }
+  return packets;
+}
+
+void BenchmarkNormalizeJoystickInputScalar()
+{
+  BenchmarkState state{DEFAULT_ITERATIONS};
+
+  state.ResumeTiming();
+  for (size_t i = 0; i < state.GetIterations(); ++i)
+  {
+    double value = xbox::NormalizeJoystickInputScalar(static_cast<uint16_t>(i * 257));
+    DoNotOptimize(value);
+  }
+  state.PauseTiming();
+
+  state.Report("NormalizeJoystickInputScalar");
+}
+
+// Drives the bus budget's transaction time estimate towards 1 ns so the
+// mapper's rate limiter practically never refuses, exposing the write path.
+void SaturateBusBudget(xbox::ServoBusBudget *bus_budget)
+{
+  for (size_t i = 0; i < 1000; ++i)
+  {
+    bus_budget->RecordTransaction(std::chrono::nanoseconds{1});
+  }
+}
+
+void BenchmarkProcessInput(
+    const char *name,
+    const std::vector<double> &inputs,
+    bool unthrottled)
+{
+  CountingServo servo;
+  xbox::ServoBusBudget bus_budget;
+  if (unthrottled)
+  {
+    SaturateBusBudget(&bus_budget);
+  }
+
+  xbox::BasicJoystickInputToServoActionMapper<CountingServo> mapper;
+  if (!xbox::BasicJoystickInputToServoActionMapper<CountingServo>::Create(
+          &servo,
+          &bus_budget,
+          &mapper))
+  {
+    fprintf(stderr, "Failed to create joystick mapper\n");
+    exit(EXIT_FAILURE);
+  }
+
+  BenchmarkState state{DEFAULT_ITERATIONS};
+
+  state.ResumeTiming();
+  for (size_t i = 0; i < state.GetIterations(); ++i)
+  {
+    bool result = mapper.ProcessInput(inputs[i % inputs.size()]);
+    DoNotOptimize(result);
+  }
+  state.PauseTiming();
+
+  state.Report(name);
+}
+
+void BenchmarkProcessPacket()
+{
+  CountingServo tilt;
+  CountingServo pan;
+  xbox::ServoBusBudget bus_budget;
+  xbox::BasicControllerPacketToPanTiltActionMapper<CountingServo> mapper;
+  if (!xbox::BasicControllerPacketToPanTiltActionMapper<CountingServo>::Create(
+          &tilt,
+          &pan,
+          &bus_budget,
+          &mapper))
+  {
+    fprintf(stderr, "Failed to create pan/tilt mapper\n");
+    exit(EXIT_FAILURE);
+  }
+
+  std::vector<std::vector<uint8_t>> packets = MakePacketSweep();
+  BenchmarkState state{DEFAULT_ITERATIONS};
+
+  state.ResumeTiming();
+  for (size_t i = 0; i < state.GetIterations(); ++i)
+  {
+    const std::vector<uint8_t> &packet = packets[i % packets.size()];
+    mapper.ProcessPacket(packet.data(), packet.size());
+  }
+  state.PauseTiming();
+
+  state.Report("ControllerPacketToPanTiltActionMapper::ProcessPacket");
+}
+
+void BenchmarkBluetoothChannelHandlePacket()
+{
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) < 0)
+  {
+    perror("socketpair");
+    exit(EXIT_FAILURE);
+  }
+
+  size_t received_bytes = 0;
+  xbox::BluetoothChannel channel{
+      fds[0],
+      [&received_bytes] (const uint8_t *, size_t size) { received_bytes += size; }};
+
+  std::vector<std::vector<uint8_t>> packets = MakePacketSweep();
+  uint8_t frame[HCI_MONITOR_HEADER_SIZE + xbox::CONTROLLER_REPORT_SIZE] = {};
+
+  BenchmarkState state{SOCKET_ITERATIONS};
+  for (size_t i = 0; i < state.GetIterations(); i += SOCKET_BATCH_SIZE)
+  {
+    for (size_t j = 0; j < SOCKET_BATCH_SIZE; ++j)
+    {
+      const std::vector<uint8_t> &packet = packets[(i + j) % packets.size()];
+      memcpy(frame + HCI_MONITOR_HEADER_SIZE, packet.data(), packet.size());
+      if (send(fds[1], frame, sizeof(frame), 0) < 0)
+      {
+        perror("send");
+        exit(EXIT_FAILURE);
+      }
+    }
+
+    state.ResumeTiming();
+    for (size_t j = 0; j < SOCKET_BATCH_SIZE; ++j)
+    {
+      channel.HandlePacket();
+    }
+    state.PauseTiming();
+  }
+
+  DoNotOptimize(received_bytes);
+  state.Report("BluetoothChannel::HandlePacket");
+  close(fds[1]);
+}
+
+// Stays readable forever, so every RunOnce() dispatches exactly once.
+class LevelTriggeredHandler : public xbox::EventHandler
+{
+public:
+  explicit LevelTriggeredHandler(int fd) : fd_{fd}, dispatch_count_{0} {}
+  int GetFd() const override { return fd_; }
+  void HandlePacket() override { ++dispatch_count_; }
+  size_t GetDispatchCount() const { return dispatch_count_; }
+
+private:
+  int fd_;
+  size_t dispatch_count_;
+};
+
+void BenchmarkEventLoopDispatch()
+{
+  int fd = eventfd(1, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (fd < 0)
+  {
+    perror("eventfd");
+    exit(EXIT_FAILURE);
+  }
+
+  xbox::EventLoop event_loop;
+  LevelTriggeredHandler handler{fd};
+  if (!xbox::EventLoop::Create(&event_loop) || !event_loop.Add(&handler))
+  {
+    fprintf(stderr, "Failed to set up EventLoop\n");
+    exit(EXIT_FAILURE);
+  }
+
+  BenchmarkState state{SOCKET_ITERATIONS};
+
+  state.ResumeTiming();
+  for (size_t i = 0; i < state.GetIterations(); ++i)
+  {
+    event_loop.RunOnce(0);
+  }
+  state.PauseTiming();
+
+  if (handler.GetDispatchCount() != state.GetIterations())
+  {
+    fprintf(stderr, "EventLoop dispatched %zu of %zu events\n",
+            handler.GetDispatchCount(), state.GetIterations());
+  }
+
+  state.Report("EventLoop::RunOnce dispatch");
+  close(fd);
+}
+
+}  // namespace
+
+int main()
+{
+  printf(
+      "%-66s %10s %10s %10s %16s\n",
+      "benchmark",
+      "iterations",
+      "ns/op",
+      "allocs/op",
+      "servo_writes/op");
+
+  BenchmarkNormalizeJoystickInputScalar();
+  std::vector<double> sweep = {0.0, 0.4, 0.9, 0.4, 0.0, -0.4, -0.9, -0.4};
+  BenchmarkProcessInput("JoystickInputToServoActionMapper::ProcessInput/hold", {0.9}, false);
+  BenchmarkProcessInput("JoystickInputToServoActionMapper::ProcessInput/sweep", sweep, false);
+  BenchmarkProcessInput(
+      "JoystickInputToServoActionMapper::ProcessInput/sweep_unthrottled",
+      sweep,
+      true);
+  BenchmarkProcessPacket();
+  BenchmarkBluetoothChannelHandlePacket();
+  BenchmarkEventLoopDispatch();
+  return EXIT_SUCCESS;
+}
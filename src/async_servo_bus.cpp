@@ -0,0 +1,139 @@
+#include "src/async_servo_bus.h"
+
+#include <fcntl.h>
+#include <sys/ioctl.h>
+
+#include <iostream>
+
+namespace
+{
+bool GetBaudRateConstant(uint32_t baud_rate, speed_t *out_speed)
+{
+  switch (baud_rate)
+  {
+    case 9600: *out_speed = B9600; return true;
+    case 19200: *out_speed = B19200; return true;
+    case 57600: *out_speed = B57600; return true;
+    case 115200: *out_speed = B115200; return true;
+    case 500000: *out_speed = B500000; return true;
+    case 1000000: *out_speed = B1000000; return true;
+    default: return false;
+  }
+}
+}  // namespace
+
+namespace xbox
+{
+
+bool ParseServoStatusReturn(const std::string &name, ServoStatusReturn *out_status_return)
+{
+  assert(out_status_return);
+
+  if (name == "all")
+  {
+    *out_status_return = ServoStatusReturn::ALL;
+    return true;
+  }
+
+  if (name == "reads")
+  {
+    *out_status_return = ServoStatusReturn::READS_ONLY;
+    return true;
+  }
+
+  return false;
+}
+
+bool OpenServoUart(const std::string &device_path, uint32_t baud_rate, int *out_fd)
+{
+  assert(out_fd);
+
+  speed_t speed;
+  if (!GetBaudRateConstant(baud_rate, &speed))
+  {
+    std::cerr << "Unsupported servo baud rate: " << baud_rate << std::endl;
+    return false;
+  }
+
+  int fd = open(device_path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+  if (fd < 0)
+  {
+    std::cerr << "Failed to open " << device_path << ". Error: " << strerror(errno) << std::endl;
+    return false;
+  }
+
+  struct termios options;
+  if (tcgetattr(fd, &options) < 0)
+  {
+    std::cerr << "Failed to read UART attributes. Error: " << strerror(errno) << std::endl;
+    close(fd);
+    return false;
+  }
+
+  cfmakeraw(&options);
+  options.c_cflag |= CLOCAL | CREAD;
+  options.c_cflag &= ~(CSTOPB | CRTSCTS);
+  options.c_cc[VMIN] = 0;
+  options.c_cc[VTIME] = 0;
+  cfsetispeed(&options, speed);
+  cfsetospeed(&options, speed);
+
+  if (tcsetattr(fd, TCSANOW, &options) < 0)
+  {
+    std::cerr << "Failed to configure UART. Error: " << strerror(errno) << std::endl;
+    close(fd);
+    return false;
+  }
+
+  tcflush(fd, TCIOFLUSH);
+  *out_fd = fd;
+  return true;
+}
+
+bool IsSupportedServoBaudRate(uint32_t baud_rate)
+{
+  speed_t speed;
+  return GetBaudRateConstant(baud_rate, &speed);
+}
+
+bool SetServoUartBaudRate(int fd, uint32_t baud_rate)
+{
+  speed_t speed;
+  if (!GetBaudRateConstant(baud_rate, &speed))
+  {
+    XBOX_LOG(LogLevel::ERROR, "Unsupported servo baud rate: %u", baud_rate);
+    return false;
+  }
+
+  struct termios options;
+  if (tcgetattr(fd, &options) < 0)
+  {
+    XBOX_LOG(LogLevel::ERROR, "Failed to read UART attributes. Error: %s", strerror(errno));
+    return false;
+  }
+
+  cfsetispeed(&options, speed);
+  cfsetospeed(&options, speed);
+
+  // TCSADRAIN: nothing already written may go out at the new rate.
+  if (tcsetattr(fd, TCSADRAIN, &options) < 0)
+  {
+    XBOX_LOG(LogLevel::ERROR, "Failed to set UART baud rate. Error: %s", strerror(errno));
+    return false;
+  }
+
+  tcflush(fd, TCIFLUSH);
+  return true;
+}
+
+size_t GetUartOutputQueueSize(int fd)
+{
+  int queued = 0;
+  if (ioctl(fd, TIOCOUTQ, &queued) < 0)
+  {
+    return 0;
+  }
+  return static_cast<size_t>(queued);
+}
+
+}  // namespace xbox
@@ -0,0 +1,1053 @@
+#ifndef XBOXCONTROLLER_ASYNCSERVOBUS_H
+#define XBOXCONTROLLER_ASYNCSERVOBUS_H
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <type_traits>
+
+#include "src/dynamixel_protocol.h"
+#include "src/event_handler.h"
+#include "src/event_loop.h"
+#include "src/logger.h"
+#include "src/metrics.h"
+#include "src/periodic_timer.h"
+#include "src/servo_bus_budget.h"
+#include "src/servo_bus_scheduler.h"
+
+namespace xbox
+{
+namespace async_servo_bus_internal
+{
+constexpr size_t TRANSACTION_QUEUE_CAPACITY = 64;
+constexpr size_t UART_READ_CHUNK_SIZE = 64;
+// The AX-12 answers after its return delay (500 us by default). The longest
+// status packet's time on the wire is added, which matters at low baud rates.
+constexpr std::chrono::microseconds STATUS_TIMEOUT{5000};
+// Added to the computed wire time before the direction pin is released, and
+// used to poll again if the UART still holds unsent bytes.
+constexpr std::chrono::microseconds TRANSMIT_MARGIN{20};
+// With unacknowledged writes, one commanded register is read back this often
+// while the bus is idle.
+constexpr std::chrono::milliseconds VERIFY_READ_INTERVAL{20};
+constexpr size_t MAX_COMMANDED_REGISTERS = 32;
+constexpr int INVALID_FD = -1;
+}  // namespace async_servo_bus_internal
+
+// Which instructions the servos answer (AX-12 status return level).
+enum class ServoStatusReturn : uint8_t
+{
+  // Level 1: only reads are answered. Writes go out fire-and-forget and are
+  // checked afterwards by idle-time readback, which resends lost writes.
+  READS_ONLY = 1,
+  // Level 2, the factory default: every instruction is answered.
+  ALL = 2,
+};
+
+bool ParseServoStatusReturn(const std::string &name, ServoStatusReturn *out_status_return);
+
+// Opens |device_path| as a raw, non-blocking 8N1 UART at |baud_rate|.
+bool OpenServoUart(const std::string &device_path, uint32_t baud_rate, int *out_fd);
+
+// Whether |baud_rate| is one the UART can be set to.
+bool IsSupportedServoBaudRate(uint32_t baud_rate);
+
+// Switches an open servo UART to |baud_rate| and drops anything buffered.
+bool SetServoUartBaudRate(int fd, uint32_t baud_rate);
+
+// Bytes written to |fd| that the UART has not shifted out yet.
+size_t GetUartOutputQueueSize(int fd);
+
+// Whom to tell how a write or read turned out. A null |observer| means
+// nobody.
+struct ServoTransactionTarget
+{
+  ServoTransactionObserver *observer;
+  size_t servo_index;
+  ServoRegister reg;
+};
+
+// Non-blocking Dynamixel transport for a half-duplex AX-12 bus.
+//
+// Instructions queue up and go out one transaction at a time from the event
+// loop thread: the packet is written as EPOLLOUT allows, a one-shot timer
+// waits out its time on the wire, then |DirectionPin| is switched to receive
+// and the status packet is parsed incrementally as EPOLLIN delivers it.
+// Writes and reads therefore complete asynchronously; their failures are
+// counted and logged when the status (or its timeout) arrives, and the
+// outcome goes to the transaction's ServoTransactionTarget. Nothing blocks,
+// so a single thread overlaps Bluetooth input with bus I/O without locks.
+//
+// In ServoStatusReturn::READS_ONLY mode a write holds the bus only for its
+// own bytes, about half of a write plus status. The last value written to
+// each register is remembered, and while the queue is empty a periodic
+// timer reads one of them back; a mismatch is rewritten, a match confirms
+// the write to its observer.
+//
+// |DirectionPin| needs Set() (transmit) and Clear() (receive).
+template <typename DirectionPin>
+class BasicAsyncServoBus final : public EventHandler
+{
+public:
+  BasicAsyncServoBus(
+      DirectionPin *direction_pin,
+      uint32_t baud_rate,
+      ServoStatusReturn status_return,
+      ServoBusBudget *bus_budget)
+    : direction_pin_{direction_pin},
+      baud_rate_{baud_rate},
+      status_return_{status_return},
+      bus_budget_{bus_budget},
+      event_loop_{nullptr},
+      uart_fd_{async_servo_bus_internal::INVALID_FD},
+      timer_{this, &BasicAsyncServoBus::HandleTimer},
+      verify_timer_{this, &BasicAsyncServoBus::HandleVerifyTimer},
+      state_{State::IDLE},
+      write_interest_{false},
+      queue_head_{0},
+      queue_count_{0},
+      bytes_written_{0},
+      commanded_count_{0},
+      next_verify_index_{0},
+      blocking_read_{} {}
+
+  ~BasicAsyncServoBus()
+  {
+    using namespace async_servo_bus_internal;
+
+    if (uart_fd_ != INVALID_FD)
+    {
+      close(uart_fd_);
+    }
+    if (timer_.fd != INVALID_FD)
+    {
+      close(timer_.fd);
+    }
+    if (verify_timer_.fd != INVALID_FD)
+    {
+      close(verify_timer_.fd);
+    }
+  }
+
+  // Takes ownership of |uart_fd| and registers with |event_loop|.
+  bool Start(int uart_fd, EventLoop *event_loop)
+  {
+    assert(direction_pin_);
+    assert(event_loop);
+
+    uart_fd_ = uart_fd;
+    event_loop_ = event_loop;
+    direction_pin_->Clear();
+
+    if (!OpenOneShotTimer(&timer_.fd))
+    {
+      return false;
+    }
+
+    if (status_return_ == ServoStatusReturn::READS_ONLY &&
+        !OpenPeriodicTimer(async_servo_bus_internal::VERIFY_READ_INTERVAL, &verify_timer_.fd))
+    {
+      return false;
+    }
+
+    if (!event_loop_->Add(this, EPOLLIN) ||
+        !event_loop_->Add(&timer_) ||
+        (verify_timer_.fd != async_servo_bus_internal::INVALID_FD &&
+            !event_loop_->Add(&verify_timer_)))
+    {
+      std::cerr << "Failed to add servo bus to EventLoop" << std::endl;
+      return false;
+    }
+
+    return true;
+  }
+
+  // Sets servo |id|'s status return level to the bus mode. The level lives
+  // in EEPROM, so it is read first and only written if it differs. Blocks
+  // like ReadBlocking(), and must run before anything else is sent to that
+  // servo: until the write lands, the servo may or may not answer, so its
+  // reply is optional.
+  bool ConfigureStatusReturn(uint8_t id)
+  {
+    // A servo at level 0 answers no reads; it gets the write too.
+    uint16_t level;
+    if (ReadBlocking(id, AxA12Address::STATUS_RETURN_LEVEL, 1, &level) &&
+        level == static_cast<uint16_t>(status_return_))
+    {
+      return true;
+    }
+
+    Transaction *transaction = Push();
+    if (!transaction)
+    {
+      return false;
+    }
+
+    BuildDynamixelWritePacket(
+        id,
+        AxA12Address::STATUS_RETURN_LEVEL,
+        static_cast<uint8_t>(status_return_),
+        1,
+        &transaction->packet);
+    transaction->id = id;
+    transaction->kind = TransactionKind::WRITE;
+    transaction->status_reply = StatusReply::OPTIONAL;
+    StartNextIfIdle();
+    return true;
+  }
+
+  // Queues a register write. Returns false only if the queue is full.
+  // Broadcast writes are never confirmed to |target|.
+  bool Write(
+      uint8_t id,
+      AxA12Address address,
+      uint16_t value,
+      uint8_t width,
+      const ServoTransactionTarget &target = ServoTransactionTarget{})
+  {
+    Transaction *transaction = Push();
+    if (!transaction)
+    {
+      return false;
+    }
+
+    BuildDynamixelWritePacket(id, address, value, width, &transaction->packet);
+    transaction->id = id;
+    transaction->kind = TransactionKind::WRITE;
+    transaction->value = value;
+    transaction->target = target;
+    transaction->status_reply =
+        (id == DYNAMIXEL_BROADCAST_ID || status_return_ == ServoStatusReturn::READS_ONLY)
+            ? StatusReply::NONE
+            : StatusReply::REQUIRED;
+
+    if (status_return_ == ServoStatusReturn::READS_ONLY && id != DYNAMIXEL_BROADCAST_ID)
+    {
+      RememberCommand(id, address, value, width, target);
+    }
+
+    StartNextIfIdle();
+    return true;
+  }
+
+  // Queues a register read whose answer goes to |target|. Returns false only
+  // if the queue is full.
+  bool Read(uint8_t id, AxA12Address address, uint8_t width, const ServoTransactionTarget &target)
+  {
+    Transaction *transaction = Push();
+    if (!transaction)
+    {
+      return false;
+    }
+
+    BuildDynamixelReadPacket(id, address, width, &transaction->packet);
+    transaction->id = id;
+    transaction->kind = TransactionKind::READ;
+    transaction->status_reply = StatusReply::REQUIRED;
+    transaction->width = width;
+    transaction->target = target;
+    StartNextIfIdle();
+    return true;
+  }
+
+  // Reads a register by polling the bus until the answer arrives. Only the
+  // bus's own descriptors are polled, so no other event handler runs in the
+  // meantime. Meant for startup; never call it from an event handler.
+  bool ReadBlocking(uint8_t id, AxA12Address address, uint8_t width, uint16_t *out_value)
+  {
+    assert(out_value);
+    assert(event_loop_);
+    assert(!blocking_read_.pending);
+
+    Transaction *transaction = Push();
+    if (!transaction)
+    {
+      return false;
+    }
+
+    BuildDynamixelReadPacket(id, address, width, &transaction->packet);
+    transaction->id = id;
+    transaction->kind = TransactionKind::BLOCKING_READ;
+    transaction->status_reply = StatusReply::REQUIRED;
+    transaction->width = width;
+    blocking_read_ = BlockingRead{true, false, 0};
+    StartNextIfIdle();
+
+    if (!WaitForBlockingResult())
+    {
+      return false;
+    }
+
+    *out_value = blocking_read_.value;
+    return blocking_read_.succeeded;
+  }
+
+  // Pings servo |id| and waits for its answer, like ReadBlocking(). Servos
+  // answer pings at every status return level.
+  bool PingBlocking(uint8_t id)
+  {
+    assert(event_loop_);
+    assert(!blocking_read_.pending);
+
+    Transaction *transaction = Push();
+    if (!transaction)
+    {
+      return false;
+    }
+
+    BuildDynamixelPingPacket(id, &transaction->packet);
+    transaction->id = id;
+    transaction->kind = TransactionKind::PING;
+    transaction->status_reply = StatusReply::REQUIRED;
+    blocking_read_ = BlockingRead{true, false, 0};
+    StartNextIfIdle();
+
+    return WaitForBlockingResult() && blocking_read_.succeeded;
+  }
+
+  // Polls the bus, like ReadBlocking(), until every queued instruction has
+  // completed.
+  bool FlushBlocking()
+  {
+    assert(event_loop_);
+
+    while (queue_count_ > 0)
+    {
+      if (!PollOnce())
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Moves the UART to |baud_rate|. The servos are not told; see
+  // DiscoverServoBus(). Only valid while nothing is queued.
+  bool SetBaudRate(uint32_t baud_rate)
+  {
+    assert(queue_count_ == 0);
+
+    if (!SetServoUartBaudRate(uart_fd_, baud_rate))
+    {
+      return false;
+    }
+
+    baud_rate_ = baud_rate;
+    parser_.Reset();
+    return true;
+  }
+
+  uint32_t GetBaudRate() const
+  {
+    return baud_rate_;
+  }
+
+  size_t GetPendingCount() const
+  {
+    return queue_count_;
+  }
+
+  int GetFd() const override
+  {
+    return uart_fd_;
+  }
+
+  void HandlePacket() override
+  {
+    HandleReadable();
+  }
+
+  void HandleEvents(uint32_t events) override
+  {
+    if (events & EPOLLOUT)
+    {
+      ContinueTransmit();
+    }
+    if (events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+    {
+      HandleReadable();
+    }
+  }
+
+private:
+  enum class State
+  {
+    IDLE,
+    TRANSMITTING,
+    DRAINING,
+    AWAITING_STATUS,
+  };
+
+  enum class TransactionKind : uint8_t
+  {
+    WRITE,
+    READ,
+    BLOCKING_READ,
+    VERIFY_READ,
+    PING,
+  };
+
+  enum class StatusReply : uint8_t
+  {
+    NONE,
+    REQUIRED,
+    // Waited for, but a timeout is not an error.
+    OPTIONAL,
+  };
+
+  struct Transaction
+  {
+    DynamixelPacket packet;
+    uint8_t id;
+    TransactionKind kind;
+    StatusReply status_reply;
+    // Reads only; a ping answers with no params.
+    uint8_t width;
+    // VERIFY_READ only.
+    AxA12Address address;
+    // WRITE: the value written. VERIFY_READ: what the register should hold.
+    uint16_t value;
+    ServoTransactionTarget target;
+  };
+
+  struct BlockingRead
+  {
+    bool pending;
+    bool succeeded;
+    uint16_t value;
+  };
+
+  struct CommandedRegister
+  {
+    uint8_t id;
+    AxA12Address address;
+    uint8_t width;
+    uint16_t value;
+    ServoTransactionTarget target;
+  };
+
+  class Timer final : public EventHandler
+  {
+  public:
+    Timer(BasicAsyncServoBus *bus, void (BasicAsyncServoBus::*callback)())
+      : fd{async_servo_bus_internal::INVALID_FD},
+        bus_{bus},
+        callback_{callback} {}
+
+    int GetFd() const override
+    {
+      return fd;
+    }
+
+    void HandlePacket() override
+    {
+      if (ReadTimerExpirations(fd) > 0)
+      {
+        (bus_->*callback_)();
+      }
+    }
+
+  public:
+    int fd;
+
+  private:
+    BasicAsyncServoBus *bus_;
+    void (BasicAsyncServoBus::*callback_)();
+  };
+
+private:
+  Transaction* Push()
+  {
+    using namespace async_servo_bus_internal;
+
+    if (queue_count_ == queue_.size())
+    {
+      XBOX_LOG_EVERY(LogLevel::ERROR, 1000, "Servo bus queue full; dropping instruction");
+      return nullptr;
+    }
+
+    size_t index = (queue_head_ + queue_count_) % queue_.size();
+    ++queue_count_;
+    queue_[index].target = ServoTransactionTarget{};
+    return &queue_[index];
+  }
+
+  Transaction& Front()
+  {
+    assert(queue_count_ > 0);
+    return queue_[queue_head_];
+  }
+
+  // Every transaction ends by status or timeout, so this terminates.
+  bool WaitForBlockingResult()
+  {
+    while (blocking_read_.pending)
+    {
+      if (!PollOnce())
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Waits for the UART or the transaction timer and handles what is ready,
+  // the way the event loop would, but without running any other handler:
+  // the blocking calls run during startup, while the loop already holds
+  // handlers that must not fire yet. The verify timer is left to the loop.
+  bool PollOnce()
+  {
+    std::array<struct pollfd, 2> fds{{
+        {uart_fd_, static_cast<short>(write_interest_ ? (POLLIN | POLLOUT) : POLLIN), 0},
+        {timer_.fd, POLLIN, 0},
+    }};
+
+    if (poll(fds.data(), fds.size(), -1) < 0)
+    {
+      if (errno == EINTR)
+      {
+        return true;
+      }
+
+      std::cerr << "Failed to poll servo bus. Error: " << strerror(errno) << std::endl;
+      return false;
+    }
+
+    uint32_t events = 0;
+    if (fds[0].revents & POLLIN)
+    {
+      events |= EPOLLIN;
+    }
+    if (fds[0].revents & POLLOUT)
+    {
+      events |= EPOLLOUT;
+    }
+    if (fds[0].revents & POLLERR)
+    {
+      events |= EPOLLERR;
+    }
+    if (fds[0].revents & POLLHUP)
+    {
+      events |= EPOLLHUP;
+    }
+    if (events != 0)
+    {
+      HandleEvents(events);
+    }
+
+    if (fds[1].revents & POLLIN)
+    {
+      timer_.HandlePacket();
+    }
+    return true;
+  }
+
+  // 8N1: ten bit times per byte.
+  std::chrono::nanoseconds GetWireTime(size_t byte_count) const
+  {
+    return std::chrono::nanoseconds{
+        static_cast<int64_t>(byte_count) * 10 * 1000000000 / baud_rate_};
+  }
+
+  void StartNextIfIdle()
+  {
+    if (state_ != State::IDLE || queue_count_ == 0)
+    {
+      return;
+    }
+
+    direction_pin_->Set();
+    bytes_written_ = 0;
+    transaction_start_ = std::chrono::steady_clock::now();
+    state_ = State::TRANSMITTING;
+    ContinueTransmit();
+  }
+
+  void ContinueTransmit()
+  {
+    using namespace async_servo_bus_internal;
+
+    if (state_ != State::TRANSMITTING)
+    {
+      SetWriteInterest(false);
+      return;
+    }
+
+    const DynamixelPacket &packet = Front().packet;
+    while (bytes_written_ < packet.size)
+    {
+      ssize_t written = write(
+          uart_fd_,
+          packet.bytes.data() + bytes_written_,
+          packet.size - bytes_written_);
+      if (written < 0)
+      {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+          SetWriteInterest(true);
+          return;
+        }
+        if (errno == EINTR)
+        {
+          continue;
+        }
+
+        XBOX_LOG_EVERY(LogLevel::ERROR, 1000, "Servo UART write failed. Error: %s", strerror(errno));
+        direction_pin_->Clear();
+        Complete(false, nullptr);
+        return;
+      }
+
+      bytes_written_ += written;
+    }
+
+    SetWriteInterest(false);
+
+    state_ = State::DRAINING;
+    ArmOneShotTimer(timer_.fd, GetWireTime(packet.size) + TRANSMIT_MARGIN);
+  }
+
+  void HandleTimer()
+  {
+    using namespace async_servo_bus_internal;
+
+    switch (state_)
+    {
+      case State::DRAINING:
+        if (GetUartOutputQueueSize(uart_fd_) > 0)
+        {
+          ArmOneShotTimer(timer_.fd, TRANSMIT_MARGIN);
+          return;
+        }
+
+        direction_pin_->Clear();
+        // Drop our own echo and any noise from the turnaround.
+        tcflush(uart_fd_, TCIFLUSH);
+        parser_.Reset();
+
+        if (Front().status_reply == StatusReply::NONE)
+        {
+          Complete(true, nullptr);
+          return;
+        }
+
+        state_ = State::AWAITING_STATUS;
+        ArmOneShotTimer(timer_.fd, STATUS_TIMEOUT + GetWireTime(DYNAMIXEL_MAX_PACKET_SIZE));
+        break;
+      case State::AWAITING_STATUS:
+        if (Front().status_reply == StatusReply::OPTIONAL)
+        {
+          Complete(true, nullptr);
+          break;
+        }
+
+        // Unanswered pings are how discovery finds empty IDs.
+        if (Front().kind == TransactionKind::PING)
+        {
+          Complete(false, nullptr);
+          break;
+        }
+
+        IncrementCounter(Counter::SERVO_STATUS_TIMEOUTS);
+        XBOX_LOG_EVERY(
+            LogLevel::ERROR,
+            1000,
+            "Servo %u did not answer instruction 0x%x",
+            Front().id,
+            Front().packet.bytes[4]);
+        Complete(false, nullptr);
+        break;
+      case State::IDLE:
+      case State::TRANSMITTING:
+        break;
+    }
+  }
+
+  void HandleReadable()
+  {
+    using namespace async_servo_bus_internal;
+
+    uint8_t buffer[UART_READ_CHUNK_SIZE];
+    while (true)
+    {
+      ssize_t received = read(uart_fd_, buffer, sizeof(buffer));
+      if (received <= 0)
+      {
+        if (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        {
+          XBOX_LOG_EVERY(LogLevel::ERROR, 1000, "Servo UART read failed. Error: %s", strerror(errno));
+        }
+        return;
+      }
+
+      if (state_ != State::AWAITING_STATUS)
+      {
+        continue;
+      }
+
+      for (ssize_t i = 0; i < received && state_ == State::AWAITING_STATUS; ++i)
+      {
+        DynamixelStatusParser::Result result = parser_.Feed(buffer[i]);
+        if (result == DynamixelStatusParser::Result::COMPLETE &&
+            parser_.GetStatus().id == Front().id)
+        {
+          ArmOneShotTimer(timer_.fd, std::chrono::nanoseconds{0});
+          const DynamixelStatus &status = parser_.GetStatus();
+          if (status.error != 0)
+          {
+            XBOX_LOG_EVERY(
+                LogLevel::ERROR,
+                1000,
+                "Servo %u reported error 0x%x",
+                status.id,
+                status.error);
+          }
+          Complete(status.error == 0, &status);
+        }
+      }
+    }
+  }
+
+  void HandleVerifyTimer()
+  {
+    if (queue_count_ > 0 || commanded_count_ == 0)
+    {
+      return;
+    }
+
+    next_verify_index_ = (next_verify_index_ + 1) % commanded_count_;
+    const CommandedRegister &command = commanded_[next_verify_index_];
+
+    Transaction *transaction = Push();
+    assert(transaction);
+    BuildDynamixelReadPacket(command.id, command.address, command.width, &transaction->packet);
+    transaction->id = command.id;
+    transaction->kind = TransactionKind::VERIFY_READ;
+    transaction->status_reply = StatusReply::REQUIRED;
+    transaction->width = command.width;
+    transaction->address = command.address;
+    transaction->value = command.value;
+    transaction->target = command.target;
+    StartNextIfIdle();
+  }
+
+  void RememberCommand(
+      uint8_t id,
+      AxA12Address address,
+      uint16_t value,
+      uint8_t width,
+      const ServoTransactionTarget &target)
+  {
+    for (size_t i = 0; i < commanded_count_; ++i)
+    {
+      if (commanded_[i].id == id && commanded_[i].address == address)
+      {
+        commanded_[i].value = value;
+        commanded_[i].target = target;
+        return;
+      }
+    }
+
+    if (commanded_count_ < commanded_.size())
+    {
+      commanded_[commanded_count_++] = CommandedRegister{id, address, width, value, target};
+    }
+  }
+
+  // Confirms a register whose readback matches the command that was checked,
+  // and rewrites one that disagrees with it, unless a newer command has
+  // replaced it.
+  void VerifyReadback(const Transaction &transaction, uint16_t value)
+  {
+    if (value == transaction.value)
+    {
+      ReportWrite(transaction.target, value, true);
+      return;
+    }
+
+    for (size_t i = 0; i < commanded_count_; ++i)
+    {
+      const CommandedRegister &command = commanded_[i];
+      if (command.id == transaction.id &&
+          command.address == transaction.address &&
+          command.value == transaction.value)
+      {
+        IncrementCounter(Counter::SERVO_WRITES_RESENT);
+        XBOX_LOG_EVERY(
+            LogLevel::WARNING,
+            1000,
+            "Servo %u register 0x%x holds 0x%x instead of 0x%x; resending",
+            transaction.id,
+            static_cast<unsigned int>(transaction.address),
+            value,
+            transaction.value);
+        Write(command.id, command.address, command.value, command.width, command.target);
+        return;
+      }
+    }
+  }
+
+  static void ReportWrite(const ServoTransactionTarget &target, uint16_t value, bool succeeded)
+  {
+    if (target.observer)
+    {
+      target.observer->HandleServoWriteComplete(
+          target.servo_index,
+          target.reg,
+          value,
+          succeeded);
+    }
+  }
+
+  static void ReportRead(const ServoTransactionTarget &target, uint16_t value, bool succeeded)
+  {
+    if (target.observer)
+    {
+      target.observer->HandleServoReadComplete(
+          target.servo_index,
+          target.reg,
+          value,
+          succeeded);
+    }
+  }
+
+  void Complete(bool succeeded, const DynamixelStatus *status)
+  {
+    Transaction transaction = Front();
+
+    // Pings only happen during discovery, whose timeouts say nothing about
+    // the bus during control.
+    if (transaction.kind != TransactionKind::PING)
+    {
+      if (bus_budget_)
+      {
+        bus_budget_->RecordTransaction(std::chrono::steady_clock::now() - transaction_start_);
+      }
+
+      if (!succeeded)
+      {
+        IncrementCounter(Counter::SERVO_WRITE_ERRORS);
+      }
+    }
+
+    queue_head_ = (queue_head_ + 1) % queue_.size();
+    --queue_count_;
+    state_ = State::IDLE;
+
+    if (transaction.kind == TransactionKind::WRITE)
+    {
+      // Unanswered writes that went out are confirmed by VerifyReadback().
+      if (status || !succeeded)
+      {
+        ReportWrite(transaction.target, transaction.value, succeeded);
+      }
+    }
+    else if (transaction.kind == TransactionKind::PING)
+    {
+      // A servo that answers with error flags set is still there.
+      blocking_read_ = BlockingRead{false, status != nullptr, 0};
+    }
+    else
+    {
+      bool complete = succeeded && status && status->param_count == transaction.width;
+      uint16_t value = 0;
+      if (complete)
+      {
+        value = status->params[0];
+        if (transaction.width == 2)
+        {
+          value |= static_cast<uint16_t>(status->params[1]) << 8;
+        }
+      }
+
+      if (transaction.kind == TransactionKind::BLOCKING_READ)
+      {
+        blocking_read_ = BlockingRead{false, complete, value};
+      }
+      else if (transaction.kind == TransactionKind::READ)
+      {
+        ReportRead(transaction.target, value, complete);
+      }
+      else if (complete)
+      {
+        VerifyReadback(transaction, value);
+      }
+    }
+
+    StartNextIfIdle();
+  }
+
+  void SetWriteInterest(bool enabled)
+  {
+    if (write_interest_ == enabled)
+    {
+      return;
+    }
+
+    write_interest_ = enabled;
+    event_loop_->Modify(this, enabled ? (EPOLLIN | EPOLLOUT) : EPOLLIN);
+  }
+
+private:
+  BasicAsyncServoBus(const BasicAsyncServoBus &other) = delete;
+  BasicAsyncServoBus& operator=(const BasicAsyncServoBus &other) = delete;
+
+private:
+  DirectionPin *direction_pin_;
+  uint32_t baud_rate_;
+  ServoStatusReturn status_return_;
+  ServoBusBudget *bus_budget_;
+  EventLoop *event_loop_;
+  int uart_fd_;
+  Timer timer_;
+  Timer verify_timer_;
+  State state_;
+  bool write_interest_;
+  std::array<Transaction, async_servo_bus_internal::TRANSACTION_QUEUE_CAPACITY> queue_;
+  size_t queue_head_;
+  size_t queue_count_;
+  size_t bytes_written_;
+  std::chrono::steady_clock::time_point transaction_start_;
+  DynamixelStatusParser parser_;
+  std::array<CommandedRegister, async_servo_bus_internal::MAX_COMMANDED_REGISTERS> commanded_;
+  size_t commanded_count_;
+  size_t next_verify_index_;
+  BlockingRead blocking_read_;
+};
+
+// Servo facade over a BasicAsyncServoBus, with the setters and getters the
+// scheduler and mappers use. Setters and RequestPresentPosition() queue and
+// return, and their outcome goes to the observer a scheduler attached;
+// getters block (see ReadBlocking()).
+template <typename Bus>
+class AsyncServo
+{
+public:
+  AsyncServo() : bus_{nullptr}, id_{0}, observer_{nullptr}, servo_index_{0} {}
+  AsyncServo(Bus *bus, uint8_t id)
+    : bus_{bus},
+      id_{id},
+      observer_{nullptr},
+      servo_index_{0} {}
+
+  void SetTransactionObserver(ServoTransactionObserver *observer, size_t servo_index)
+  {
+    observer_ = observer;
+    servo_index_ = servo_index;
+  }
+
+  bool SetGoalPosition(uint16_t position)
+  {
+    return Write(AxA12Address::GOAL_POSITION, ServoRegister::GOAL_POSITION, position, 2);
+  }
+
+  bool SetMovingSpeed(uint16_t speed)
+  {
+    return Write(AxA12Address::MOVING_SPEED, ServoRegister::MOVING_SPEED, speed, 2);
+  }
+
+  bool SetTorqueEnabled(bool enabled)
+  {
+    return Write(AxA12Address::TORQUE_ENABLE, ServoRegister::TORQUE_ENABLE, enabled, 1);
+  }
+
+  bool SetTorqueLimit(uint16_t limit)
+  {
+    return Write(AxA12Address::TORQUE_LIMIT, ServoRegister::TORQUE_LIMIT, limit, 2);
+  }
+
+  bool SetClockWiseAngleLimit(uint16_t limit)
+  {
+    return Write(AxA12Address::CW_ANGLE_LIMIT, ServoRegister::CW_ANGLE_LIMIT, limit, 2);
+  }
+
+  bool SetCounterClockWiseAngleLimit(uint16_t limit)
+  {
+    return Write(AxA12Address::CCW_ANGLE_LIMIT, ServoRegister::CCW_ANGLE_LIMIT, limit, 2);
+  }
+
+  bool GetPresentPosition(uint16_t *out_position)
+  {
+    return bus_->ReadBlocking(id_, AxA12Address::PRESENT_POSITION, 2, out_position);
+  }
+
+  bool GetTorqueLimit(uint16_t *out_limit)
+  {
+    return bus_->ReadBlocking(id_, AxA12Address::TORQUE_LIMIT, 2, out_limit);
+  }
+
+  bool GetClockWiseAngleLimit(uint16_t *out_limit)
+  {
+    return bus_->ReadBlocking(id_, AxA12Address::CW_ANGLE_LIMIT, 2, out_limit);
+  }
+
+  bool GetCounterClockWiseAngleLimit(uint16_t *out_limit)
+  {
+    return bus_->ReadBlocking(id_, AxA12Address::CCW_ANGLE_LIMIT, 2, out_limit);
+  }
+
+  bool RequestPresentPosition()
+  {
+    return bus_->Read(
+        id_,
+        AxA12Address::PRESENT_POSITION,
+        2,
+        ServoTransactionTarget{observer_, servo_index_, ServoRegister::PRESENT_POSITION});
+  }
+
+  // Blocks until everything queued on the bus has completed.
+  bool WaitForWrites()
+  {
+    return bus_->FlushBlocking();
+  }
+
+private:
+  bool Write(AxA12Address address, ServoRegister reg, uint16_t value, uint8_t width)
+  {
+    return bus_->Write(id_, address, value, width, ServoTransactionTarget{observer_, servo_index_, reg});
+  }
+
+private:
+  Bus *bus_;
+  uint8_t id_;
+  ServoTransactionObserver *observer_;
+  size_t servo_index_;
+};
+
+template <typename Bus>
+void AttachServoTransactionObserver(
+    AsyncServo<Bus> *servo,
+    ServoTransactionObserver *observer,
+    size_t servo_index)
+{
+  servo->SetTransactionObserver(observer, servo_index);
+}
+
+template <typename Bus>
+bool WaitForServoWrites(AsyncServo<Bus> *servo)
+{
+  return servo->WaitForWrites();
+}
+
+template <typename Bus>
+bool RequestServoPresentPosition(AsyncServo<Bus> *servo)
+{
+  return servo->RequestPresentPosition();
+}
+
+template <typename Bus>
+struct IsAsynchronousServo<AsyncServo<Bus>> : std::true_type {};
+
+}  // namespace xbox
+
+#endif  // XBOXCONTROLLER_ASYNCSERVOBUS_H
@@ -0,0 +1,241 @@
+#ifndef XBOXCONTROLLER_AXISSTATEMACHINE_H
+#define XBOXCONTROLLER_AXISSTATEMACHINE_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace xbox
+{
+
+// What one joystick axis asks its servo to do, after quantization.
+enum class AxisCommand : uint8_t
+{
+  STOP,
+  POSITIVE_SLOW,
+  POSITIVE_FAST,
+  NEGATIVE_SLOW,
+  NEGATIVE_FAST,
+  COUNT,
+};
+
+// What the servo's registers hold, as far as the mapper has commanded them.
+//
+// MOVING_* states have torque on, the moving speed of the bucket and the goal
+// at the travel limit of the direction. STOPPING_* states are the same with
+// torque released: the servo coasts to a halt while speed and goal still hold
+// the last motion, so resuming it only needs torque back. STOPPED is the
+// initial state, in which speed and goal hold nothing useful and there is no
+// motion to stop. After a failed write the mapper falls back to UNKNOWN, from
+// which every command rewrites all the registers it depends on.
+enum class AxisState : uint8_t
+{
+  STOPPED,
+  MOVING_POSITIVE_SLOW,
+  MOVING_POSITIVE_FAST,
+  MOVING_NEGATIVE_SLOW,
+  MOVING_NEGATIVE_FAST,
+  STOPPING_POSITIVE_SLOW,
+  STOPPING_POSITIVE_FAST,
+  STOPPING_NEGATIVE_SLOW,
+  STOPPING_NEGATIVE_FAST,
+  UNKNOWN,
+  COUNT,
+};
+
+constexpr size_t AXIS_COMMAND_COUNT = static_cast<size_t>(AxisCommand::COUNT);
+constexpr size_t AXIS_STATE_COUNT = static_cast<size_t>(AxisState::COUNT);
+
+// Register writes a transition issues, in the order they go out.
+enum AxisWrite : uint8_t
+{
+  AXIS_WRITE_MOVING_SPEED = 1 << 0,
+  AXIS_WRITE_GOAL_POSITION = 1 << 1,
+  AXIS_WRITE_TORQUE_ENABLE = 1 << 2,
+  AXIS_WRITE_TORQUE_DISABLE = 1 << 3,
+};
+
+struct AxisTransition
+{
+  AxisState next_state;
+  uint8_t writes;
+};
+
+constexpr size_t CountAxisWrites(uint8_t writes)
+{
+  return ((writes & AXIS_WRITE_MOVING_SPEED) != 0) +
+      ((writes & AXIS_WRITE_GOAL_POSITION) != 0) +
+      ((writes & AXIS_WRITE_TORQUE_ENABLE) != 0) +
+      ((writes & AXIS_WRITE_TORQUE_DISABLE) != 0);
+}
+
+namespace axis_state_machine_internal
+{
+enum class Torque : uint8_t
+{
+  OFF,
+  ON,
+  UNKNOWN,
+};
+
+// Register contents behind a state. Speed and direction are 0 when unknown.
+struct AxisRegisters
+{
+  Torque torque;
+  // 1 slow, 2 fast.
+  uint8_t speed;
+  // 1 positive, 2 negative.
+  uint8_t direction;
+};
+
+constexpr AxisRegisters GetStateRegisters(AxisState state)
+{
+  switch (state)
+  {
+    case AxisState::MOVING_POSITIVE_SLOW: return AxisRegisters{Torque::ON, 1, 1};
+    case AxisState::MOVING_POSITIVE_FAST: return AxisRegisters{Torque::ON, 2, 1};
+    case AxisState::MOVING_NEGATIVE_SLOW: return AxisRegisters{Torque::ON, 1, 2};
+    case AxisState::MOVING_NEGATIVE_FAST: return AxisRegisters{Torque::ON, 2, 2};
+    case AxisState::STOPPING_POSITIVE_SLOW: return AxisRegisters{Torque::OFF, 1, 1};
+    case AxisState::STOPPING_POSITIVE_FAST: return AxisRegisters{Torque::OFF, 2, 1};
+    case AxisState::STOPPING_NEGATIVE_SLOW: return AxisRegisters{Torque::OFF, 1, 2};
+    case AxisState::STOPPING_NEGATIVE_FAST: return AxisRegisters{Torque::OFF, 2, 2};
+    case AxisState::UNKNOWN: return AxisRegisters{Torque::UNKNOWN, 0, 0};
+    case AxisState::STOPPED:
+    case AxisState::COUNT:
+      break;
+  }
+  return AxisRegisters{Torque::OFF, 0, 0};
+}
+
+constexpr AxisState GetMovingState(AxisCommand command)
+{
+  switch (command)
+  {
+    case AxisCommand::POSITIVE_SLOW: return AxisState::MOVING_POSITIVE_SLOW;
+    case AxisCommand::POSITIVE_FAST: return AxisState::MOVING_POSITIVE_FAST;
+    case AxisCommand::NEGATIVE_SLOW: return AxisState::MOVING_NEGATIVE_SLOW;
+    case AxisCommand::NEGATIVE_FAST: return AxisState::MOVING_NEGATIVE_FAST;
+    case AxisCommand::STOP:
+    case AxisCommand::COUNT:
+      break;
+  }
+  return AxisState::STOPPED;
+}
+
+constexpr AxisState GetStoppingState(AxisState state)
+{
+  switch (state)
+  {
+    case AxisState::MOVING_POSITIVE_SLOW: return AxisState::STOPPING_POSITIVE_SLOW;
+    case AxisState::MOVING_POSITIVE_FAST: return AxisState::STOPPING_POSITIVE_FAST;
+    case AxisState::MOVING_NEGATIVE_SLOW: return AxisState::STOPPING_NEGATIVE_SLOW;
+    case AxisState::MOVING_NEGATIVE_FAST: return AxisState::STOPPING_NEGATIVE_FAST;
+    case AxisState::UNKNOWN: return AxisState::STOPPED;
+    default:
+      return state;
+  }
+}
+
+// Writes only the registers whose contents differ between the two states.
+constexpr AxisTransition MakeAxisTransition(AxisState state, AxisCommand command)
+{
+  AxisRegisters current = GetStateRegisters(state);
+
+  if (command == AxisCommand::STOP)
+  {
+    return AxisTransition{
+        GetStoppingState(state),
+        static_cast<uint8_t>(current.torque == Torque::OFF ? 0 : AXIS_WRITE_TORQUE_DISABLE)};
+  }
+
+  AxisState next_state = GetMovingState(command);
+  AxisRegisters next = GetStateRegisters(next_state);
+  uint8_t writes = 0;
+  if (current.speed != next.speed)
+  {
+    writes |= AXIS_WRITE_MOVING_SPEED;
+  }
+  if (current.direction != next.direction)
+  {
+    writes |= AXIS_WRITE_GOAL_POSITION;
+  }
+  if (current.torque != Torque::ON)
+  {
+    writes |= AXIS_WRITE_TORQUE_ENABLE;
+  }
+  return AxisTransition{next_state, writes};
+}
+
+struct AxisTransitionTable
+{
+  AxisTransition entries[AXIS_STATE_COUNT][AXIS_COMMAND_COUNT];
+};
+
+constexpr AxisTransitionTable MakeAxisTransitionTable()
+{
+  AxisTransitionTable table{};
+  for (size_t state = 0; state < AXIS_STATE_COUNT; ++state)
+  {
+    for (size_t command = 0; command < AXIS_COMMAND_COUNT; ++command)
+    {
+      table.entries[state][command] = MakeAxisTransition(
+          static_cast<AxisState>(state),
+          static_cast<AxisCommand>(command));
+    }
+  }
+  return table;
+}
+
+constexpr AxisTransitionTable AXIS_TRANSITIONS = MakeAxisTransitionTable();
+
+// Checked for every state and command at compile time: repeating a command
+// writes nothing, and no transition writes more than three registers.
+constexpr bool IsAxisTransitionTableMinimal()
+{
+  for (size_t state = 0; state < AXIS_STATE_COUNT; ++state)
+  {
+    for (size_t command = 0; command < AXIS_COMMAND_COUNT; ++command)
+    {
+      const AxisTransition &transition = AXIS_TRANSITIONS.entries[state][command];
+      const AxisTransition &repeat =
+          AXIS_TRANSITIONS.entries[static_cast<size_t>(transition.next_state)][command];
+      if (repeat.writes != 0 ||
+          repeat.next_state != transition.next_state ||
+          CountAxisWrites(transition.writes) > 3)
+      {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static_assert(IsAxisTransitionTableMinimal(), "Axis transition table is not minimal");
+static_assert(
+    AXIS_TRANSITIONS.entries[static_cast<size_t>(AxisState::STOPPING_POSITIVE_FAST)]
+                            [static_cast<size_t>(AxisCommand::POSITIVE_FAST)].writes ==
+        AXIS_WRITE_TORQUE_ENABLE,
+    "Resuming a stopped motion should only re-enable torque");
+static_assert(
+    AXIS_TRANSITIONS.entries[static_cast<size_t>(AxisState::MOVING_POSITIVE_SLOW)]
+                            [static_cast<size_t>(AxisCommand::NEGATIVE_SLOW)].writes ==
+        AXIS_WRITE_GOAL_POSITION,
+    "Reversing at the same speed should only move the goal");
+}  // namespace axis_state_machine_internal
+
+// Whether |state| has the servo driven towards a travel limit.
+constexpr bool IsAxisMoving(AxisState state)
+{
+  return axis_state_machine_internal::GetStateRegisters(state).torque ==
+      axis_state_machine_internal::Torque::ON;
+}
+
+inline AxisTransition GetAxisTransition(AxisState state, AxisCommand command)
+{
+  return axis_state_machine_internal::AXIS_TRANSITIONS
+      .entries[static_cast<size_t>(state)][static_cast<size_t>(command)];
+}
+
+}  // namespace xbox
+
+#endif  // XBOXCONTROLLER_AXISSTATEMACHINE_H
@@ -2,6 +2,7 @@
 
 #include <stdio.h>
 #include <stdbool.h>
+#include <endian.h>
 #include <errno.h>
 #include <unistd.h>
 #include <stdlib.h>
@@ -21,9 +22,10 @@
 #include <bluetooth/bluetooth.h>
 #include <hci.h>
 
+#include "src/logger.h"
+
 namespace
 {
-constexpr int INVALID_FD = -1;
 
 struct mgmt_hdr
 {
@@ -37,11 +39,9 @@ struct mgmt_hdr
 namespace xbox
 {
 
-bool BluetoothChannel::Create(
-    PacketCallback &&callback,
-    BluetoothChannel* out_channel)
+bool OpenHciMonitorSocket(int *out_fd)
 {
-  assert(out_channel);
+  assert(out_fd);
 
   int fd = socket(AF_BLUETOOTH, SOCK_RAW | SOCK_CLOEXEC, BTPROTO_HCI);
   if (fd < 0)
@@ -63,57 +63,24 @@ bool BluetoothChannel::Create(
     return false;
   }
 
-  *out_channel = BluetoothChannel{
-      fd,
-      std::move(callback)};
+  *out_fd = fd;
   return true;
 }
 
-BluetoothChannel::BluetoothChannel() : initialized_{false} {}
-
-BluetoothChannel::BluetoothChannel(
-    int fd,
-    PacketCallback &&callback)
-  : initialized_{true},
-    fd_{fd},
-    callback_{std::move(callback)} {}
-
-BluetoothChannel::BluetoothChannel(BluetoothChannel&& other)
-{
-  StealResources(&other);
-}
-
-BluetoothChannel& BluetoothChannel::operator=(BluetoothChannel&& other)
-{
-  if (&other != this)
-  {
-    Close();
-    StealResources(&other);
-  }
-
-  return *this;
-}
-
-int BluetoothChannel::GetFd() const
-{
-  assert(initialized_);
-  return fd_;
-}
-
-void BluetoothChannel::HandlePacket()
+int ReceiveHciMonitorFrame(int fd, uint8_t *data, size_t data_size, uint16_t *out_adapter_index)
 {
-  assert(initialized_);
+  assert(data);
+  assert(out_adapter_index);
 
   struct mgmt_hdr header;
   struct msghdr msg;
   struct iovec iov[2];
-  uint8_t data[1490];
   uint8_t control[64];
 
   iov[0].iov_base = &header;
   iov[0].iov_len = sizeof(header);
   iov[1].iov_base = data;
-  iov[1].iov_len = sizeof(data);
+  iov[1].iov_len = data_size;
 
   memset(&msg, 0, sizeof(msg));
   msg.msg_iov = iov;
@@ -121,38 +88,21 @@ void BluetoothChannel::HandlePacket()
   msg.msg_control = control;
   msg.msg_controllen = sizeof(control);
 
-  int result = recvmsg(fd_, &msg, MSG_DONTWAIT);
+  int result = recvmsg(fd, &msg, MSG_DONTWAIT);
   if (result < 0)
   {
-    std::cerr << "Failed to read msg: " << strerror(errno) << std::endl;
-    return;
+    XBOX_LOG(LogLevel::ERROR, "Failed to read msg: %s", strerror(errno));
+    return -1;
   }
 
-  int data_len = result - sizeof(header);
-  callback_(data, data_len);
-}
-
-void BluetoothChannel::Close()
-{
-  if (!initialized_)
+  if (result < static_cast<int>(sizeof(header)))
   {
-    return;
+    XBOX_LOG(LogLevel::ERROR, "Short monitor frame: %d bytes", result);
+    return -1;
   }
 
-  close(fd_);
-  fd_ = INVALID_FD;
-  initialized_ = false;
-}
-
-void BluetoothChannel::StealResources(BluetoothChannel* other)
-{
-  assert(other);
-
-  initialized_ = other->initialized_;
-  other->initialized_ = false;
-  fd_ = other->fd_;
-  other->fd_ = INVALID_FD;
-  callback_ = std::move(other->callback_);
+  *out_adapter_index = le16toh(header.index);
+  return result - static_cast<int>(sizeof(header));
 }
 
 }  // namespace xbox
@@ -1,46 +1,221 @@
 #ifndef XBOXCONTROLLER_BLUETOOTHCHANNEL_H
 #define XBOXCONTROLLER_BLUETOOTHCHANNEL_H
 
+#include <unistd.h>
+
+#include <cassert>
 #include <cstdint>
 #include <functional>
+#include <utility>
 
 #include "src/event_handler.h"
+#include "src/metrics.h"
+#include "src/tracepoints.h"
 
 namespace xbox
 {
 
-class BluetoothChannel : public EventHandler
+// Maximum payload of a single HCI monitor frame, excluding the monitor header.
+constexpr size_t HCI_MONITOR_FRAME_SIZE = 1490;
+
+// Bit n set accepts frames from adapter hci<n>. Adapters past hci63 are only
+// accepted by ALL_HCI_ADAPTERS.
+using HciAdapterMask = uint64_t;
+constexpr HciAdapterMask ALL_HCI_ADAPTERS = ~HciAdapterMask{0};
+
+inline bool IsHciAdapterAccepted(HciAdapterMask mask, uint16_t adapter_index)
+{
+  if (mask == ALL_HCI_ADAPTERS)
+  {
+    return true;
+  }
+  return adapter_index < 64 && (mask & (HciAdapterMask{1} << adapter_index)) != 0;
+}
+
+// The monitor channel can only be bound to every adapter at once
+// (HCI_DEV_NONE); frames are told apart by the adapter index in their header.
+bool OpenHciMonitorSocket(int *out_fd);
+
+// Reads one frame from the monitor socket into |data|. Returns the payload
+// length, or a negative value if nothing could be read. |out_adapter_index|
+// receives the index of the adapter the frame passed through.
+int ReceiveHciMonitorFrame(int fd, uint8_t *data, size_t data_size, uint16_t *out_adapter_index);
+
+// Event loop handler for the HCI monitor channel.
+//
+// |Callback| is invoked with the payload of every frame from an adapter in
+// the channel's HciAdapterMask; other frames are counted and dropped.
+// BluetoothChannel type-erases it behind std::function; the input pipeline
+// instantiates the channel with a concrete stage chain instead so the whole
+// per-frame path is visible to the compiler.
+template <typename Callback>
+class BasicBluetoothChannel final : public EventHandler
 {
 public:
-  using PacketCallback = std::function<void(const uint8_t *buffer, size_t length)>;
+  using PacketCallback = Callback;
 
 public:
-  static bool Create(PacketCallback &&callback, BluetoothChannel* out_channel);
+  static bool Create(
+      PacketCallback &&callback,
+      HciAdapterMask adapter_mask,
+      BasicBluetoothChannel* out_channel);
 
 public:
-  BluetoothChannel();
-  BluetoothChannel(
+  BasicBluetoothChannel();
+  BasicBluetoothChannel(
       int fd,
-      PacketCallback &&callback);
-  BluetoothChannel(BluetoothChannel&& other);
-  BluetoothChannel& operator=(BluetoothChannel&& other);
+      PacketCallback &&callback,
+      HciAdapterMask adapter_mask=ALL_HCI_ADAPTERS);
+  BasicBluetoothChannel(BasicBluetoothChannel&& other);
+  BasicBluetoothChannel& operator=(BasicBluetoothChannel&& other);
   int GetFd() const override;
   void HandlePacket() override;
+  PacketCallback& GetCallback();
 
 private:
   void Close();
-  void StealResources(BluetoothChannel* other);
+  void StealResources(BasicBluetoothChannel* other);
 
 private:
-  BluetoothChannel(const BluetoothChannel& other) = delete;
-  BluetoothChannel& operator=(const BluetoothChannel& other) = delete;
+  BasicBluetoothChannel(const BasicBluetoothChannel& other) = delete;
+  BasicBluetoothChannel& operator=(const BasicBluetoothChannel& other) = delete;
 
 private:
   bool initialized_;
   int fd_;
   PacketCallback callback_;
+  HciAdapterMask adapter_mask_;
 };
 
+using BluetoothChannel =
+    BasicBluetoothChannel<std::function<void(const uint8_t *buffer, size_t length)>>;
+
+template <typename Callback>
+bool BasicBluetoothChannel<Callback>::Create(
+    PacketCallback &&callback,
+    HciAdapterMask adapter_mask,
+    BasicBluetoothChannel* out_channel)
+{
+  assert(out_channel);
+
+  int fd;
+  if (!OpenHciMonitorSocket(&fd))
+  {
+    return false;
+  }
+
+  *out_channel = BasicBluetoothChannel{
+      fd,
+      std::move(callback),
+      adapter_mask};
+  return true;
+}
+
+template <typename Callback>
+BasicBluetoothChannel<Callback>::BasicBluetoothChannel()
+  : initialized_{false},
+    fd_{-1},
+    callback_{},
+    adapter_mask_{ALL_HCI_ADAPTERS} {}
+
+template <typename Callback>
+BasicBluetoothChannel<Callback>::BasicBluetoothChannel(
+    int fd,
+    PacketCallback &&callback,
+    HciAdapterMask adapter_mask)
+  : initialized_{true},
+    fd_{fd},
+    callback_{std::move(callback)},
+    adapter_mask_{adapter_mask} {}
+
+template <typename Callback>
+BasicBluetoothChannel<Callback>::BasicBluetoothChannel(BasicBluetoothChannel&& other)
+  : initialized_{false},
+    fd_{-1},
+    callback_{},
+    adapter_mask_{ALL_HCI_ADAPTERS}
+{
+  StealResources(&other);
+}
+
+template <typename Callback>
+BasicBluetoothChannel<Callback>& BasicBluetoothChannel<Callback>::operator=(
+    BasicBluetoothChannel&& other)
+{
+  if (&other != this)
+  {
+    Close();
+    StealResources(&other);
+  }
+
+  return *this;
+}
+
+template <typename Callback>
+int BasicBluetoothChannel<Callback>::GetFd() const
+{
+  assert(initialized_);
+  return fd_;
+}
+
+template <typename Callback>
+void BasicBluetoothChannel<Callback>::HandlePacket()
+{
+  assert(initialized_);
+
+  uint8_t data[HCI_MONITOR_FRAME_SIZE];
+  uint16_t adapter_index;
+  int data_len = ReceiveHciMonitorFrame(fd_, data, sizeof(data), &adapter_index);
+  if (data_len < 0)
+  {
+    IncrementCounter(Counter::FRAMES_DROPPED);
+    XBOX_TRACE1(frame_dropped, fd_);
+    return;
+  }
+
+  if (!IsHciAdapterAccepted(adapter_mask_, adapter_index))
+  {
+    IncrementCounter(Counter::FRAMES_FILTERED);
+    return;
+  }
+
+  IncrementCounter(Counter::FRAMES_RECEIVED);
+  XBOX_TRACE2(frame_received, fd_, data_len);
+  callback_(data, static_cast<size_t>(data_len));
+}
+
+template <typename Callback>
+Callback& BasicBluetoothChannel<Callback>::GetCallback()
+{
+  return callback_;
+}
+
+template <typename Callback>
+void BasicBluetoothChannel<Callback>::Close()
+{
+  if (!initialized_)
+  {
+    return;
+  }
+
+  close(fd_);
+  fd_ = -1;
+  initialized_ = false;
+}
+
+template <typename Callback>
+void BasicBluetoothChannel<Callback>::StealResources(BasicBluetoothChannel* other)
+{
+  assert(other);
+
+  initialized_ = other->initialized_;
+  other->initialized_ = false;
+  fd_ = other->fd_;
+  other->fd_ = -1;
+  callback_ = std::move(other->callback_);
+  adapter_mask_ = other->adapter_mask_;
+}
+
 }  // namespace xbox
 
 #endif  // XBOXCONTROLLER_BLUETOOTHCHANNEL_H
@@ -0,0 +1,118 @@
+#include "src/button_event_dispatcher.h"
+
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+using xbox::ControllerButton;
+
+struct ButtonName
+{
+  const char *name;
+  ControllerButton button;
+};
+
+const std::array<ButtonName, xbox::CONTROLLER_BUTTON_COUNT> BUTTON_NAMES =
+{{
+  {"A", ControllerButton::A},
+  {"B", ControllerButton::B},
+  {"X", ControllerButton::X},
+  {"Y", ControllerButton::Y},
+  {"LB", ControllerButton::LB},
+  {"RB", ControllerButton::RB},
+  {"L3", ControllerButton::L3},
+  {"R3", ControllerButton::R3},
+  {"DPAD_UP", ControllerButton::DPAD_UP},
+  {"DPAD_RIGHT", ControllerButton::DPAD_RIGHT},
+  {"DPAD_DOWN", ControllerButton::DPAD_DOWN},
+  {"DPAD_LEFT", ControllerButton::DPAD_LEFT},
+}};
+
+bool ParseButtonName(const std::string &name, ControllerButton *out_button)
+{
+  for (const ButtonName &entry : BUTTON_NAMES)
+  {
+    if (name == entry.name)
+    {
+      *out_button = entry.button;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ParseLine(const std::string &text, uint32_t *out_line)
+{
+  if (text.empty())
+  {
+    return false;
+  }
+
+  char *end;
+  unsigned long line = strtoul(text.c_str(), &end, 10);
+  if (*end != '\0' || line > UINT32_MAX)
+  {
+    return false;
+  }
+
+  *out_line = static_cast<uint32_t>(line);
+  return true;
+}
+}  // namespace
+
+namespace xbox
+{
+
+bool ParseButtonOutputBindings(
+    const std::string &spec,
+    std::vector<ButtonOutputBinding> *out_bindings)
+{
+  assert(out_bindings);
+
+  std::vector<ButtonOutputBinding> bindings;
+  size_t start = 0;
+  while (!spec.empty() && start <= spec.size())
+  {
+    size_t end = spec.find(',', start);
+    if (end == std::string::npos)
+    {
+      end = spec.size();
+    }
+
+    std::string entry = spec.substr(start, end - start);
+    start = end + 1;
+
+    size_t line_start = entry.find(':');
+    size_t mode_start = (line_start == std::string::npos)
+        ? std::string::npos
+        : entry.find(':', line_start + 1);
+
+    ButtonOutputBinding binding;
+    binding.mode = ButtonOutputMode::FOLLOW;
+    if (line_start == std::string::npos ||
+        !ParseButtonName(entry.substr(0, line_start), &binding.button) ||
+        !ParseLine(entry.substr(line_start + 1, mode_start - line_start - 1), &binding.line))
+    {
+      std::cerr << "Malformed button output entry: \"" << entry << "\"" << std::endl;
+      return false;
+    }
+
+    if (mode_start != std::string::npos)
+    {
+      if (entry.substr(mode_start + 1) != "toggle")
+      {
+        std::cerr << "Unknown button output mode in: \"" << entry << "\"" << std::endl;
+        return false;
+      }
+      binding.mode = ButtonOutputMode::TOGGLE;
+    }
+
+    bindings.push_back(binding);
+  }
+
+  *out_bindings = std::move(bindings);
+  return true;
+}
+
+}  // namespace xbox
@@ -0,0 +1,220 @@
+#ifndef XBOXCONTROLLER_BUTTONEVENTDISPATCHER_H
+#define XBOXCONTROLLER_BUTTONEVENTDISPATCHER_H
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "src/controller_report.h"
+#include "src/gpio_line.h"
+
+namespace xbox
+{
+
+// Collects the GPIO writes issued while handling one report so that each pin
+// is written at most once, with its final level, after all handlers ran.
+template <typename Pin>
+class GpioWriteBatch
+{
+public:
+  GpioWriteBatch() : size_{0} {}
+
+  void Write(Pin *pin, bool high)
+  {
+    assert(pin);
+
+    for (size_t i = 0; i < size_; ++i)
+    {
+      if (writes_[i].pin == pin)
+      {
+        writes_[i].high = high;
+        return;
+      }
+    }
+
+    assert(size_ < writes_.size());
+    writes_[size_++] = PendingWrite{pin, high};
+  }
+
+  void Flush()
+  {
+    for (size_t i = 0; i < size_; ++i)
+    {
+      if (writes_[i].high)
+      {
+        writes_[i].pin->Set();
+      }
+      else
+      {
+        writes_[i].pin->Clear();
+      }
+    }
+    size_ = 0;
+  }
+
+private:
+  struct PendingWrite
+  {
+    Pin *pin;
+    bool high;
+  };
+
+private:
+  // At most one binding per button, so at most one pin write per button.
+  std::array<PendingWrite, CONTROLLER_BUTTON_COUNT> writes_;
+  size_t size_;
+};
+
+enum class ButtonOutputMode : uint8_t
+{
+  // Pin is high while the button is held.
+  FOLLOW,
+  // Pin flips on every press.
+  TOGGLE,
+};
+
+// One button driving one line of a GPIO chip.
+struct ButtonOutputBinding
+{
+  ControllerButton button;
+  uint32_t line;
+  ButtonOutputMode mode;
+};
+
+// Parses comma-separated "BUTTON:LINE" or "BUTTON:LINE:toggle" entries, e.g.
+// "A:17,DPAD_UP:27:toggle". Buttons are named as in ControllerButton. An empty
+// |spec| binds nothing.
+bool ParseButtonOutputBindings(
+    const std::string &spec,
+    std::vector<ButtonOutputBinding> *out_bindings);
+
+// Fires per-button handlers on press/release edges.
+//
+// Each report is reduced to a 16-bit button mask and XORed against the
+// previous one; only bits that changed and have a binding are visited, using
+// count-trailing-zeros to jump between them. A report with no button change
+// costs one XOR and a branch.
+template <typename Pin>
+class BasicButtonEventDispatcher
+{
+public:
+  using Handler = void (*)(void *context, bool pressed, GpioWriteBatch<Pin> *batch);
+
+public:
+  BasicButtonEventDispatcher() : previous_buttons_{0}, bound_buttons_{0}, bindings_{} {}
+
+  void Bind(ControllerButton button, Handler handler, void *context)
+  {
+    assert(handler);
+
+    Binding &binding = bindings_[static_cast<size_t>(button)];
+    binding = Binding{};
+    binding.handler = handler;
+    binding.context = context;
+    bound_buttons_ |= ToButtonMask(button);
+  }
+
+  void BindOutputPin(ControllerButton button, Pin *pin, ButtonOutputMode mode)
+  {
+    assert(pin);
+
+    Binding &binding = bindings_[static_cast<size_t>(button)];
+    binding = Binding{};
+    binding.handler = (mode == ButtonOutputMode::FOLLOW)
+        ? &BasicButtonEventDispatcher::FollowPin
+        : &BasicButtonEventDispatcher::TogglePin;
+    binding.context = &binding;
+    binding.pin = pin;
+    bound_buttons_ |= ToButtonMask(button);
+  }
+
+  void ProcessButtons(uint16_t buttons)
+  {
+    uint16_t changed = (buttons ^ previous_buttons_) & bound_buttons_;
+    previous_buttons_ = buttons;
+
+    if (changed == 0)
+    {
+      return;
+    }
+
+    GpioWriteBatch<Pin> batch;
+    do
+    {
+      unsigned int index = __builtin_ctz(changed);
+      changed &= changed - 1;
+
+      const Binding &binding = bindings_[index];
+      binding.handler(binding.context, (buttons >> index) & 1, &batch);
+    } while (changed != 0);
+
+    batch.Flush();
+  }
+
+private:
+  struct Binding
+  {
+    Handler handler;
+    void *context;
+    Pin *pin;
+    bool pin_high;
+  };
+
+  static void FollowPin(void *context, bool pressed, GpioWriteBatch<Pin> *batch)
+  {
+    Binding *binding = static_cast<Binding *>(context);
+    binding->pin_high = pressed;
+    batch->Write(binding->pin, pressed);
+  }
+
+  static void TogglePin(void *context, bool pressed, GpioWriteBatch<Pin> *batch)
+  {
+    if (!pressed)
+    {
+      return;
+    }
+
+    Binding *binding = static_cast<Binding *>(context);
+    binding->pin_high = !binding->pin_high;
+    batch->Write(binding->pin, binding->pin_high);
+  }
+
+private:
+  BasicButtonEventDispatcher(const BasicButtonEventDispatcher &other) = delete;
+  BasicButtonEventDispatcher& operator=(const BasicButtonEventDispatcher &other) = delete;
+
+private:
+  uint16_t previous_buttons_;
+  uint16_t bound_buttons_;
+  std::array<Binding, CONTROLLER_BUTTON_COUNT> bindings_;
+};
+
+using ButtonEventDispatcher = BasicButtonEventDispatcher<GpioLineOutput>;
+
+// Input pipeline stage feeding each report's buttons to a dispatcher before
+// passing the report on.
+template <typename Dispatcher>
+class ButtonDispatchStage
+{
+public:
+  ButtonDispatchStage() : dispatcher_{nullptr} {}
+  explicit ButtonDispatchStage(Dispatcher *dispatcher) : dispatcher_{dispatcher} {}
+
+  template <typename Next>
+  void operator()(Next& next, const ControllerReport &report) const
+  {
+    assert(dispatcher_);
+
+    dispatcher_->ProcessButtons(GetButtonMask(report));
+    next(report);
+  }
+
+private:
+  Dispatcher *dispatcher_;
+};
+
+}  // namespace xbox
+
+#endif  // XBOXCONTROLLER_BUTTONEVENTDISPATCHER_H
@@ -0,0 +1,341 @@
+#include "src/capture_decoder.h"
+
+#include <cassert>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define XBOX_CAPTURE_DECODER_X86 1
+#include <immintrin.h>
+#endif
+
+#include "src/controller_report.h"
+
+namespace
+{
+using xbox::ControllerCaptureRecord;
+using xbox::ControllerReportColumns;
+
+// Offset of left_stick_x within the report; the eight 16-bit fields the SIMD
+// kernels load start here.
+constexpr size_t REPORT_FIELDS_OFFSET = 10;
+constexpr uint16_t TRIGGER_MASK = 0x03FF;
+
+static_assert(
+    REPORT_FIELDS_OFFSET + 16 <= sizeof(ControllerCaptureRecord::payload)
+        + sizeof(ControllerCaptureRecord::padding),
+    "SIMD loads must stay inside the record");
+
+// Raw pointers to row |first_row| of every column.
+struct ColumnCursor
+{
+  explicit ColumnCursor(ControllerReportColumns *columns, size_t first_row)
+    : timestamp_ns{columns->timestamp_ns.data() + first_row},
+      left_stick_x{columns->left_stick_x.data() + first_row},
+      left_stick_y{columns->left_stick_y.data() + first_row},
+      right_stick_x{columns->right_stick_x.data() + first_row},
+      right_stick_y{columns->right_stick_y.data() + first_row},
+      left_trigger{columns->left_trigger.data() + first_row},
+      right_trigger{columns->right_trigger.data() + first_row},
+      dpad{columns->dpad.data() + first_row},
+      buttons{columns->buttons.data() + first_row} {}
+
+  int64_t *timestamp_ns;
+  uint16_t *left_stick_x;
+  uint16_t *left_stick_y;
+  uint16_t *right_stick_x;
+  uint16_t *right_stick_y;
+  uint16_t *left_trigger;
+  uint16_t *right_trigger;
+  uint8_t *dpad;
+  uint8_t *buttons;
+};
+
+void DecodeScalar(
+    const ControllerCaptureRecord *records,
+    size_t begin,
+    size_t end,
+    const ColumnCursor &out)
+{
+  for (size_t i = begin; i < end; ++i)
+  {
+    xbox::ControllerReport report;
+    xbox::DecodeControllerReport(records[i].payload, sizeof(records[i].payload), &report);
+
+    out.timestamp_ns[i] = records[i].timestamp_ns;
+    out.left_stick_x[i] = report.left_stick_x;
+    out.left_stick_y[i] = report.left_stick_y;
+    out.right_stick_x[i] = report.right_stick_x;
+    out.right_stick_y[i] = report.right_stick_y;
+    out.left_trigger[i] = report.left_trigger;
+    out.right_trigger[i] = report.right_trigger;
+    out.dpad[i] = report.dpad;
+    out.buttons[i] = report.buttons;
+  }
+}
+
+void CopyTimestamps(
+    const ControllerCaptureRecord *records,
+    size_t begin,
+    size_t end,
+    int64_t *out)
+{
+  for (size_t i = begin; i < end; ++i)
+  {
+    out[i] = records[i].timestamp_ns;
+  }
+}
+
+#ifdef XBOX_CAPTURE_DECODER_X86
+
+inline __m128i LoadReportFields128(const ControllerCaptureRecord *record)
+{
+  return _mm_loadu_si128(
+      reinterpret_cast<const __m128i *>(record->payload + REPORT_FIELDS_OFFSET));
+}
+
+// Returns the number of records decoded; the caller finishes the tail.
+__attribute__((target("sse2")))
+size_t DecodeSse2(
+    const ControllerCaptureRecord *records,
+    size_t record_count,
+    const ColumnCursor &out)
+{
+  constexpr size_t BLOCK = 8;
+  const __m128i trigger_mask = _mm_set1_epi16(TRIGGER_MASK);
+  const __m128i low_byte_mask = _mm_set1_epi16(0x00FF);
+  const __m128i zero = _mm_setzero_si128();
+
+  size_t i = 0;
+  for (; i + BLOCK <= record_count; i += BLOCK)
+  {
+    const ControllerCaptureRecord *block = records + i;
+
+    // Row k holds record k as [lx ly rx ry lt rt dpad|buttons spare].
+    __m128i t0 = _mm_unpacklo_epi16(LoadReportFields128(block + 0), LoadReportFields128(block + 1));
+    __m128i t1 = _mm_unpackhi_epi16(LoadReportFields128(block + 0), LoadReportFields128(block + 1));
+    __m128i t2 = _mm_unpacklo_epi16(LoadReportFields128(block + 2), LoadReportFields128(block + 3));
+    __m128i t3 = _mm_unpackhi_epi16(LoadReportFields128(block + 2), LoadReportFields128(block + 3));
+    __m128i t4 = _mm_unpacklo_epi16(LoadReportFields128(block + 4), LoadReportFields128(block + 5));
+    __m128i t5 = _mm_unpackhi_epi16(LoadReportFields128(block + 4), LoadReportFields128(block + 5));
+    __m128i t6 = _mm_unpacklo_epi16(LoadReportFields128(block + 6), LoadReportFields128(block + 7));
+    __m128i t7 = _mm_unpackhi_epi16(LoadReportFields128(block + 6), LoadReportFields128(block + 7));
+
+    __m128i u0 = _mm_unpacklo_epi32(t0, t2);
+    __m128i u1 = _mm_unpackhi_epi32(t0, t2);
+    __m128i u2 = _mm_unpacklo_epi32(t1, t3);
+    __m128i u3 = _mm_unpackhi_epi32(t1, t3);
+    __m128i u4 = _mm_unpacklo_epi32(t4, t6);
+    __m128i u5 = _mm_unpackhi_epi32(t4, t6);
+    __m128i u6 = _mm_unpacklo_epi32(t5, t7);
+    __m128i u7 = _mm_unpackhi_epi32(t5, t7);
+
+    __m128i dpad_buttons = _mm_unpacklo_epi64(u3, u7);
+
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out.left_stick_x + i), _mm_unpacklo_epi64(u0, u4));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out.left_stick_y + i), _mm_unpackhi_epi64(u0, u4));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out.right_stick_x + i), _mm_unpacklo_epi64(u1, u5));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out.right_stick_y + i), _mm_unpackhi_epi64(u1, u5));
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i *>(out.left_trigger + i),
+        _mm_and_si128(_mm_unpacklo_epi64(u2, u6), trigger_mask));
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i *>(out.right_trigger + i),
+        _mm_and_si128(_mm_unpackhi_epi64(u2, u6), trigger_mask));
+    _mm_storel_epi64(
+        reinterpret_cast<__m128i *>(out.dpad + i),
+        _mm_packus_epi16(_mm_and_si128(dpad_buttons, low_byte_mask), zero));
+    _mm_storel_epi64(
+        reinterpret_cast<__m128i *>(out.buttons + i),
+        _mm_packus_epi16(_mm_srli_epi16(dpad_buttons, 8), zero));
+  }
+
+  CopyTimestamps(records, 0, i, out.timestamp_ns);
+  return i;
+}
+
+__attribute__((target("avx2")))
+inline __m256i LoadReportFields256(const ControllerCaptureRecord *low, const ControllerCaptureRecord *high)
+{
+  return _mm256_inserti128_si256(
+      _mm256_castsi128_si256(LoadReportFields128(low)),
+      LoadReportFields128(high),
+      1);
+}
+
+// Same transpose as DecodeSse2(), with records k and k + 8 sharing a register
+// so each 128-bit lane transposes its own block of 8.
+__attribute__((target("avx2")))
+size_t DecodeAvx2(
+    const ControllerCaptureRecord *records,
+    size_t record_count,
+    const ColumnCursor &out)
+{
+  constexpr size_t BLOCK = 16;
+  const __m256i trigger_mask = _mm256_set1_epi16(TRIGGER_MASK);
+  const __m256i low_byte_mask = _mm256_set1_epi16(0x00FF);
+  const __m256i zero = _mm256_setzero_si256();
+
+  size_t i = 0;
+  for (; i + BLOCK <= record_count; i += BLOCK)
+  {
+    const ControllerCaptureRecord *block = records + i;
+
+    __m256i r0 = LoadReportFields256(block + 0, block + 8);
+    __m256i r1 = LoadReportFields256(block + 1, block + 9);
+    __m256i r2 = LoadReportFields256(block + 2, block + 10);
+    __m256i r3 = LoadReportFields256(block + 3, block + 11);
+    __m256i r4 = LoadReportFields256(block + 4, block + 12);
+    __m256i r5 = LoadReportFields256(block + 5, block + 13);
+    __m256i r6 = LoadReportFields256(block + 6, block + 14);
+    __m256i r7 = LoadReportFields256(block + 7, block + 15);
+
+    __m256i t0 = _mm256_unpacklo_epi16(r0, r1);
+    __m256i t1 = _mm256_unpackhi_epi16(r0, r1);
+    __m256i t2 = _mm256_unpacklo_epi16(r2, r3);
+    __m256i t3 = _mm256_unpackhi_epi16(r2, r3);
+    __m256i t4 = _mm256_unpacklo_epi16(r4, r5);
+    __m256i t5 = _mm256_unpackhi_epi16(r4, r5);
+    __m256i t6 = _mm256_unpacklo_epi16(r6, r7);
+    __m256i t7 = _mm256_unpackhi_epi16(r6, r7);
+
+    __m256i u0 = _mm256_unpacklo_epi32(t0, t2);
+    __m256i u1 = _mm256_unpackhi_epi32(t0, t2);
+    __m256i u2 = _mm256_unpacklo_epi32(t1, t3);
+    __m256i u3 = _mm256_unpackhi_epi32(t1, t3);
+    __m256i u4 = _mm256_unpacklo_epi32(t4, t6);
+    __m256i u5 = _mm256_unpackhi_epi32(t4, t6);
+    __m256i u6 = _mm256_unpacklo_epi32(t5, t7);
+    __m256i u7 = _mm256_unpackhi_epi32(t5, t7);
+
+    __m256i dpad_buttons = _mm256_unpacklo_epi64(u3, u7);
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out.left_stick_x + i), _mm256_unpacklo_epi64(u0, u4));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out.left_stick_y + i), _mm256_unpackhi_epi64(u0, u4));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out.right_stick_x + i), _mm256_unpacklo_epi64(u1, u5));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out.right_stick_y + i), _mm256_unpackhi_epi64(u1, u5));
+    _mm256_storeu_si256(
+        reinterpret_cast<__m256i *>(out.left_trigger + i),
+        _mm256_and_si256(_mm256_unpacklo_epi64(u2, u6), trigger_mask));
+    _mm256_storeu_si256(
+        reinterpret_cast<__m256i *>(out.right_trigger + i),
+        _mm256_and_si256(_mm256_unpackhi_epi64(u2, u6), trigger_mask));
+
+    // Packing leaves 8 bytes per lane; gather the two low quadwords.
+    __m256i dpad = _mm256_packus_epi16(_mm256_and_si256(dpad_buttons, low_byte_mask), zero);
+    __m256i buttons = _mm256_packus_epi16(_mm256_srli_epi16(dpad_buttons, 8), zero);
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i *>(out.dpad + i),
+        _mm256_castsi256_si128(_mm256_permute4x64_epi64(dpad, 0x08)));
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i *>(out.buttons + i),
+        _mm256_castsi256_si128(_mm256_permute4x64_epi64(buttons, 0x08)));
+  }
+
+  CopyTimestamps(records, 0, i, out.timestamp_ns);
+  return i;
+}
+
+#endif  // XBOX_CAPTURE_DECODER_X86
+
+}  // namespace
+
+namespace xbox
+{
+
+void ControllerReportColumns::Resize(size_t size)
+{
+  timestamp_ns.resize(size);
+  left_stick_x.resize(size);
+  left_stick_y.resize(size);
+  right_stick_x.resize(size);
+  right_stick_y.resize(size);
+  left_trigger.resize(size);
+  right_trigger.resize(size);
+  dpad.resize(size);
+  buttons.resize(size);
+}
+
+size_t ControllerReportColumns::GetSize() const
+{
+  return timestamp_ns.size();
+}
+
+const char* GetCaptureDecodeIsaName(CaptureDecodeIsa isa)
+{
+  switch (isa)
+  {
+    case CaptureDecodeIsa::SCALAR:
+      return "scalar";
+    case CaptureDecodeIsa::SSE2:
+      return "sse2";
+    case CaptureDecodeIsa::AVX2:
+      return "avx2";
+  }
+  return "unknown";
+}
+
+bool IsCaptureDecodeIsaSupported(CaptureDecodeIsa isa)
+{
+  switch (isa)
+  {
+    case CaptureDecodeIsa::SCALAR:
+      return true;
+#ifdef XBOX_CAPTURE_DECODER_X86
+    case CaptureDecodeIsa::SSE2:
+      return __builtin_cpu_supports("sse2");
+    case CaptureDecodeIsa::AVX2:
+      return __builtin_cpu_supports("avx2");
+#else
+    case CaptureDecodeIsa::SSE2:
+    case CaptureDecodeIsa::AVX2:
+      return false;
+#endif
+  }
+  return false;
+}
+
+CaptureDecodeIsa GetBestCaptureDecodeIsa()
+{
+  if (IsCaptureDecodeIsaSupported(CaptureDecodeIsa::AVX2))
+  {
+    return CaptureDecodeIsa::AVX2;
+  }
+
+  if (IsCaptureDecodeIsaSupported(CaptureDecodeIsa::SSE2))
+  {
+    return CaptureDecodeIsa::SSE2;
+  }
+
+  return CaptureDecodeIsa::SCALAR;
+}
+
+void DecodeCaptureRecords(
+    CaptureDecodeIsa isa,
+    const ControllerCaptureRecord *records,
+    size_t record_count,
+    size_t first_row,
+    ControllerReportColumns *columns)
+{
+  assert(records || record_count == 0);
+  assert(columns);
+  assert(first_row + record_count <= columns->GetSize());
+  assert(IsCaptureDecodeIsaSupported(isa));
+
+  ColumnCursor out{columns, first_row};
+  size_t decoded = 0;
+
+#ifdef XBOX_CAPTURE_DECODER_X86
+  if (isa == CaptureDecodeIsa::AVX2)
+  {
+    decoded = DecodeAvx2(records, record_count, out);
+  }
+  else if (isa == CaptureDecodeIsa::SSE2)
+  {
+    decoded = DecodeSse2(records, record_count, out);
+  }
+#endif
+
+  DecodeScalar(records, decoded, record_count, out);
+}
+
+}  // namespace xbox
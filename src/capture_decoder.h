@@ -0,0 +1,57 @@
+#ifndef XBOXCONTROLLER_CAPTUREDECODER_H
+#define XBOXCONTROLLER_CAPTUREDECODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "src/controller_capture.h"
+
+namespace xbox
+{
+
+// Decoded capture, one array per report field.
+struct ControllerReportColumns
+{
+  std::vector<int64_t> timestamp_ns;
+  std::vector<uint16_t> left_stick_x;
+  std::vector<uint16_t> left_stick_y;
+  std::vector<uint16_t> right_stick_x;
+  std::vector<uint16_t> right_stick_y;
+  std::vector<uint16_t> left_trigger;
+  std::vector<uint16_t> right_trigger;
+  std::vector<uint8_t> dpad;
+  std::vector<uint8_t> buttons;
+
+  void Resize(size_t size);
+  size_t GetSize() const;
+};
+
+enum class CaptureDecodeIsa : uint8_t
+{
+  SCALAR,
+  SSE2,
+  AVX2,
+};
+
+const char* GetCaptureDecodeIsaName(CaptureDecodeIsa isa);
+bool IsCaptureDecodeIsaSupported(CaptureDecodeIsa isa);
+CaptureDecodeIsa GetBestCaptureDecodeIsa();
+
+// Decodes |record_count| records into rows [first_row, first_row +
+// record_count) of |columns|, which must already be large enough. Different
+// threads may decode disjoint row ranges of the same columns concurrently.
+//
+// The SIMD kernels treat report bytes 10-25 of each record as eight 16-bit
+// lanes (four sticks, two triggers, d-pad and buttons, spare) and transpose
+// blocks of 8 (SSE2) or 16 (AVX2) records into column order.
+void DecodeCaptureRecords(
+    CaptureDecodeIsa isa,
+    const ControllerCaptureRecord *records,
+    size_t record_count,
+    size_t first_row,
+    ControllerReportColumns *columns);
+
+}  // namespace xbox
+
+#endif  // XBOXCONTROLLER_CAPTUREDECODER_H
@@ -0,0 +1,138 @@
+#include "src/controller_capture.h"
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#include <iostream>
+
+#include "src/logger.h"
+
+namespace
+{
+
+// About 26k records between writes.
+constexpr size_t CAPTURE_BUFFER_SIZE = 1 << 20;
+
+int64_t RealtimeNanoseconds()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+}  // namespace
+
+namespace xbox
+{
+
+bool ControllerCaptureWriter::Create(
+    const std::string &path,
+    ControllerCaptureWriter *out_writer)
+{
+  assert(out_writer);
+
+  FILE *file = fopen(path.c_str(), "wbe");
+  if (!file)
+  {
+    std::cerr << "Failed to open capture file " << path << ". Error: "
+              << strerror(errno) << std::endl;
+    return false;
+  }
+
+  if (setvbuf(file, nullptr, _IOFBF, CAPTURE_BUFFER_SIZE) != 0)
+  {
+    std::cerr << "Failed to size capture buffer" << std::endl;
+    fclose(file);
+    return false;
+  }
+
+  ControllerCaptureHeader header = {};
+  header.magic = CONTROLLER_CAPTURE_MAGIC;
+  header.version = CONTROLLER_CAPTURE_VERSION;
+  header.record_size = sizeof(ControllerCaptureRecord);
+
+  if (fwrite(&header, sizeof(header), 1, file) != 1)
+  {
+    std::cerr << "Failed to write capture header. Error: " << strerror(errno) << std::endl;
+    fclose(file);
+    return false;
+  }
+
+  *out_writer = ControllerCaptureWriter{file};
+  return true;
+}
+
+ControllerCaptureWriter::ControllerCaptureWriter()
+  : initialized_{false},
+    file_{nullptr} {}
+
+ControllerCaptureWriter::ControllerCaptureWriter(FILE *file)
+  : initialized_{true},
+    file_{file} {}
+
+ControllerCaptureWriter::ControllerCaptureWriter(ControllerCaptureWriter &&other)
+  : initialized_{false},
+    file_{nullptr}
+{
+  StealResources(&other);
+}
+
+ControllerCaptureWriter& ControllerCaptureWriter::operator=(ControllerCaptureWriter &&other)
+{
+  if (this != &other)
+  {
+    Close();
+    StealResources(&other);
+  }
+  return *this;
+}
+
+ControllerCaptureWriter::~ControllerCaptureWriter()
+{
+  Close();
+}
+
+void ControllerCaptureWriter::Append(const uint8_t *buffer, size_t buffer_size)
+{
+  assert(initialized_);
+  assert(buffer);
+
+  if (buffer_size < CONTROLLER_REPORT_SIZE)
+  {
+    return;
+  }
+
+  ControllerCaptureRecord record = {};
+  record.timestamp_ns = RealtimeNanoseconds();
+  memcpy(record.payload, buffer, CONTROLLER_REPORT_SIZE);
+
+  if (fwrite(&record, sizeof(record), 1, file_) != 1)
+  {
+    XBOX_LOG_EVERY(LogLevel::ERROR, 1000, "Failed to append capture record: %s", strerror(errno));
+  }
+}
+
+void ControllerCaptureWriter::Close()
+{
+  if (!initialized_)
+  {
+    return;
+  }
+
+  fclose(file_);
+  file_ = nullptr;
+  initialized_ = false;
+}
+
+void ControllerCaptureWriter::StealResources(ControllerCaptureWriter *other)
+{
+  assert(other);
+
+  initialized_ = other->initialized_;
+  other->initialized_ = false;
+  file_ = other->file_;
+  other->file_ = nullptr;
+}
+
+}  // namespace xbox
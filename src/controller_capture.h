@@ -0,0 +1,99 @@
+#ifndef XBOXCONTROLLER_CONTROLLERCAPTURE_H
+#define XBOXCONTROLLER_CONTROLLERCAPTURE_H
+
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "src/controller_report.h"
+
+namespace xbox
+{
+
+// On-disk capture of raw controller frames, for offline analysis.
+//
+// A capture is a ControllerCaptureHeader followed by fixed-size records, so a
+// reader can seek to any record and split a file into chunks without parsing
+// it. Payload bytes follow doc/packet-traces/packet-structure.txt; frames
+// shorter than a report are not captured.
+
+constexpr uint32_t CONTROLLER_CAPTURE_MAGIC = 0x50414358;  // "XCAP"
+constexpr uint32_t CONTROLLER_CAPTURE_VERSION = 1;
+
+struct ControllerCaptureHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t record_size;
+  uint32_t reserved;
+};
+
+struct ControllerCaptureRecord
+{
+  // CLOCK_REALTIME, so captures line up with other logs.
+  int64_t timestamp_ns;
+  uint8_t payload[CONTROLLER_REPORT_SIZE];
+  // Keeps records 8-byte aligned and lets decoders load 16 bytes starting at
+  // any report field without running off the record.
+  uint8_t padding[7];
+};
+
+static_assert(sizeof(ControllerCaptureRecord) == 40, "Capture record layout changed");
+
+// Appends frames to a capture file through a large stdio buffer, so the input
+// path pays for a memcpy per frame and a write(2) every few thousand frames.
+class ControllerCaptureWriter
+{
+public:
+  static bool Create(const std::string &path, ControllerCaptureWriter *out_writer);
+
+public:
+  ControllerCaptureWriter();
+  explicit ControllerCaptureWriter(FILE *file);
+  ControllerCaptureWriter(ControllerCaptureWriter &&other);
+  ControllerCaptureWriter& operator=(ControllerCaptureWriter &&other);
+  ~ControllerCaptureWriter();
+  void Append(const uint8_t *buffer, size_t buffer_size);
+
+private:
+  void Close();
+  void StealResources(ControllerCaptureWriter *other);
+
+private:
+  ControllerCaptureWriter(const ControllerCaptureWriter &other) = delete;
+  ControllerCaptureWriter& operator=(const ControllerCaptureWriter &other) = delete;
+
+private:
+  bool initialized_;
+  FILE *file_;
+};
+
+// Input pipeline stage that records every raw frame before passing it on.
+// With no writer it is a pass-through.
+template <typename Writer>
+class CaptureWriteStage
+{
+public:
+  CaptureWriteStage() : writer_{nullptr} {}
+  explicit CaptureWriteStage(Writer *writer) : writer_{writer} {}
+
+  template <typename Next>
+  void operator()(Next& next, const uint8_t *buffer, size_t buffer_size) const
+  {
+    assert(buffer);
+
+    if (writer_)
+    {
+      writer_->Append(buffer, buffer_size);
+    }
+    next(buffer, buffer_size);
+  }
+
+private:
+  Writer *writer_;
+};
+
+}  // namespace xbox
+
+#endif  // XBOXCONTROLLER_CONTROLLERCAPTURE_H
@@ -7,8 +7,10 @@
 #include <unistd.h>
 #include <sys/socket.h>
 
+#include <cassert>
 #include <iostream>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <bluetooth/bluetooth.h>
@@ -22,10 +24,11 @@ namespace
 constexpr const char* XBOX_CONTROLLER_NAME = "Xbox Wireless Controller";
 
 // XBOX target bluez name "/org/bluez/hci0/dev_C8_3F_26_11_D7_D3",
-constexpr const char* XBOX_CONTROLLER_BLUEZ_PREFIX = "/org/bluez/hci0/dev_";
+constexpr const char* XBOX_CONTROLLER_BLUEZ_DEVICE_PREFIX = "/dev_";
+constexpr const char* BLUEZ_ADAPTER_PATH_PREFIX = "/org/bluez/";
 constexpr int XBOX_PAIRING_TIMEOUT_SECS = 3;
 
-std::string ToBluezDevicePath(const std::string& address)
+std::string ToBluezDevicePath(const std::string& adapter_path, const std::string& address)
 {
   std::string altered_address = address;
   for (size_t i = 0; i < altered_address.size(); ++i)
@@ -36,7 +39,7 @@ std::string ToBluezDevicePath(const std::string& address)
     }
   }
 
-  return std::string{XBOX_CONTROLLER_BLUEZ_PREFIX} + altered_address;
+  return adapter_path + XBOX_CONTROLLER_BLUEZ_DEVICE_PREFIX + altered_address;
 }
 
 gboolean shutdown_pairing_loop(gpointer data)
@@ -45,15 +48,14 @@ gboolean shutdown_pairing_loop(gpointer data)
   return FALSE;
 }
 
-int bluez_adapter_call_method(GDBusConnection *con, const char *method)
+int bluez_adapter_call_method(GDBusConnection *con, const char *adapter_path, const char *method)
 {
 	GVariant *result = nullptr;
 	GError *error = nullptr;
 
 	result = g_dbus_connection_call_sync(con,
 					     "org.bluez",
-					/* TODO Find the adapter path runtime */
-					     "/org/bluez/hci0",
+					     adapter_path,
 					     "org.bluez.Adapter1",
 					     method,
 					     nullptr,
@@ -75,6 +77,7 @@ int bluez_adapter_call_method(GDBusConnection *con, const char *method)
 
 bool bluez_adapter_set_property(
     GDBusConnection* con,
+    const char *adapter_path,
     const char *prop,
     GVariant *value)
 {
@@ -83,7 +86,7 @@ bool bluez_adapter_set_property(
 
 	result = g_dbus_connection_call_sync(con,
 					     "org.bluez",
-					     "/org/bluez/hci0",
+					     adapter_path,
 					     "org.freedesktop.DBus.Properties",
 					     "Set",
 					     g_variant_new("(ssv)", "org.bluez.Adapter1", prop, value),
@@ -108,6 +111,68 @@ bool bluez_adapter_set_property(
 namespace xbox
 {
 
+bool ParseBluetoothAdapters(const std::string &spec, std::vector<BluetoothAdapter> *out_adapters)
+{
+  assert(out_adapters);
+
+  std::vector<BluetoothAdapter> adapters;
+  size_t start = 0;
+  while (start <= spec.size())
+  {
+    size_t end = spec.find(',', start);
+    if (end == std::string::npos)
+    {
+      end = spec.size();
+    }
+
+    std::string entry = spec.substr(start, end - start);
+    start = end + 1;
+
+    size_t separator = entry.find('=');
+    std::string name = entry.substr(0, separator);
+    std::string bluez_path = (separator == std::string::npos)
+        ? BLUEZ_ADAPTER_PATH_PREFIX + name
+        : entry.substr(separator + 1);
+
+    if (name.empty() || bluez_path.empty())
+    {
+      std::cerr << "Malformed Bluetooth adapter entry: \"" << entry << "\"" << std::endl;
+      return false;
+    }
+
+    int dev_id = hci_devid(name.c_str());
+    if (dev_id < 0)
+    {
+      std::cerr << "Unknown Bluetooth adapter: " << name << std::endl;
+      return false;
+    }
+
+    adapters.push_back(BluetoothAdapter{dev_id, bluez_path});
+  }
+
+  *out_adapters = std::move(adapters);
+  return true;
+}
+
+bool GetDefaultBluetoothAdapter(BluetoothAdapter *out_adapter)
+{
+  assert(out_adapter);
+
+  int dev_id = hci_get_route(nullptr);
+  if (dev_id < 0)
+  {
+    std::cerr << "Failed to get hci route. Error: " << strerror(errno) << std::endl;
+    return false;
+  }
+
+  *out_adapter = BluetoothAdapter{
+      dev_id,
+      BLUEZ_ADAPTER_PATH_PREFIX + std::string{"hci"} + std::to_string(dev_id)};
+  return true;
+}
+
+ControllerManager::ControllerManager(const BluetoothAdapter &adapter) : adapter_{adapter} {}
+
 bool ControllerManager::FindPairableDevices(std::vector<std::string> *out_addresses)
 {
   inquiry_info *ii = nullptr;
@@ -121,13 +186,7 @@ bool ControllerManager::FindPairableDevices(std::vector<std::string> *out_addres
   char name[248] = {0};
   bool succeeded = false;
 
-  dev_id = hci_get_route(nullptr);
-  if (dev_id < 0)
-  {
-    std::cerr << "Failed to get hci route. Error: " << strerror(errno) << std::endl;
-    goto done;
-  }
-
+  dev_id = adapter_.dev_id;
   sock = hci_open_dev(dev_id);
   if (sock < 0)
   {
@@ -192,17 +251,25 @@ done:
 bool ControllerManager::Connect(const std::string& xbox_controller_address)
 {
 	int rc;
+  GMainContext *context;
   GMainLoop *loop;
+  GSource *timeout;
 	GVariant *result;
 	GError *error = nullptr;
   bool successful = false;
 
   std::string bluez_target_name =
-      ToBluezDevicePath(xbox_controller_address);
+      ToBluezDevicePath(adapter_.bluez_path, xbox_controller_address);
 
   std::cout << "bozkurtus -- ControllerManager::Connect() -- bluez_target_name="
             << bluez_target_name << std::endl;
 
+  // Adapters connect on threads of their own. A private context keeps each
+  // thread's pairing loop and its timeout off the shared default context,
+  // where another thread's loop could dispatch or quit it.
+  context = g_main_context_new();
+  g_main_context_push_thread_default(context);
+  loop = g_main_loop_new(context, FALSE);
 
 	GDBusConnection* connection = g_bus_get_sync(G_BUS_TYPE_SYSTEM, nullptr, nullptr);
 	if(!connection) {
@@ -210,15 +277,17 @@ bool ControllerManager::Connect(const std::string& xbox_controller_address)
     goto done;
 	}
 
-	loop = g_main_loop_new(nullptr, FALSE);
-
-	if (bluez_adapter_set_property(connection, "Powered", g_variant_new("b", TRUE)) < 0)
+	if (bluez_adapter_set_property(
+          connection,
+          adapter_.bluez_path.c_str(),
+          "Powered",
+          g_variant_new("b", TRUE)) < 0)
 	{
     std::cerr << "Not able to enable the adapter" << std::endl;
 		goto done;
 	}
 
-	if (bluez_adapter_call_method(connection, "StartDiscovery") < 0)
+	if (bluez_adapter_call_method(connection, adapter_.bluez_path.c_str(), "StartDiscovery") < 0)
 	{
     std::cerr << "Not able to scan for new devices" << std::endl;
 		goto done;
@@ -246,10 +315,13 @@ bool ControllerManager::Connect(const std::string& xbox_controller_address)
     g_variant_unref(result);
   }
 
-  g_timeout_add_seconds(XBOX_PAIRING_TIMEOUT_SECS, shutdown_pairing_loop, loop);
+  timeout = g_timeout_source_new_seconds(XBOX_PAIRING_TIMEOUT_SECS);
+  g_source_set_callback(timeout, shutdown_pairing_loop, loop, nullptr);
+  g_source_attach(timeout, context);
+  g_source_unref(timeout);
 	g_main_loop_run(loop);
 
-	if (bluez_adapter_call_method(connection, "StopDiscovery") < 0)
+	if (bluez_adapter_call_method(connection, adapter_.bluez_path.c_str(), "StopDiscovery") < 0)
   {
     std::cerr << "Failed to stop discovery" << std::endl;
     goto done;
@@ -262,6 +334,9 @@ done:
   {
     g_object_unref(connection);
   }
+  g_main_loop_unref(loop);
+  g_main_context_pop_thread_default(context);
+  g_main_context_unref(context);
 	return successful;
 }
 
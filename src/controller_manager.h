@@ -7,11 +7,33 @@
 namespace xbox
 {
 
+// A local Bluetooth adapter: the HCI device index libbluetooth and the
+// monitor channel use, and the object path BlueZ exposes it under on D-Bus.
+struct BluetoothAdapter
+{
+  int dev_id;
+  std::string bluez_path;
+};
+
+// Parses a comma-separated adapter list such as "hci0,hci1". Each entry may
+// override its BlueZ path, as in "hci1=/org/bluez/hci1"; the default is
+// "/org/bluez/<name>". Every adapter must be present.
+bool ParseBluetoothAdapters(const std::string &spec, std::vector<BluetoothAdapter> *out_adapters);
+
+// The adapter libbluetooth routes to by default, normally the first one up.
+bool GetDefaultBluetoothAdapter(BluetoothAdapter *out_adapter);
+
+// Discovers and connects controllers through one adapter. Controllers
+// connected through different adapters do not share airtime.
 class ControllerManager
 {
 public:
+  explicit ControllerManager(const BluetoothAdapter &adapter);
   bool FindPairableDevices(std::vector<std::string> *out_addresses);
   bool Connect(const std::string& addr);
+
+private:
+  BluetoothAdapter adapter_;
 };
 
 }  // namespace xbox
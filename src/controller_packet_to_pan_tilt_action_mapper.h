@@ -1,50 +1,267 @@
 #ifndef XBOXCONTROLLER_CONTROLLERPACKETTOPANTILTACTIONMAPPER_H
 #define XBOXCONTROLLER_CONTROLLERPACKETTOPANTILTACTIONMAPPER_H
 
+#include <cassert>
 #include <chrono>
 #include <cstdint>
+#include <iostream>
 
 #include "dynamixel/AxA12.h"
+#include "src/controller_report.h"
 #include "src/joystick_input_to_servo_action_mapper.h"
+#include "src/logger.h"
+#include "src/metrics.h"
+#include "src/servo_bus_budget.h"
 
 namespace xbox
 {
 
-class ControllerPacketToPanTiltActionMapper
+template <typename Servo>
+class BasicControllerPacketToPanTiltActionMapper
 {
 public:
   static bool Create(
-      dynamixel::AxA12 *axa12_tilt,
-      dynamixel::AxA12 *axa12_pan,
-      ControllerPacketToPanTiltActionMapper *out_mapper);
+      Servo *axa12_tilt,
+      Servo *axa12_pan,
+      ServoBusBudget *bus_budget,
+      BasicControllerPacketToPanTiltActionMapper *out_mapper);
+  // Restarts both axes from their saved command states without homing; see
+  // BasicJoystickInputToServoActionMapper::Resume().
+  static bool Resume(
+      Servo *axa12_tilt,
+      Servo *axa12_pan,
+      ServoBusBudget *bus_budget,
+      const ServoCommandState &last_tilt_state,
+      const ServoCommandState &last_pan_state,
+      BasicControllerPacketToPanTiltActionMapper *out_mapper);
 
 public:
-  ControllerPacketToPanTiltActionMapper();
-  ControllerPacketToPanTiltActionMapper(
-      JoystickInputToServoActionMapper tilt_action_mapper,
-      JoystickInputToServoActionMapper pan_action_mapper);
-  ControllerPacketToPanTiltActionMapper(ControllerPacketToPanTiltActionMapper &&other);
-  ControllerPacketToPanTiltActionMapper& operator=(ControllerPacketToPanTiltActionMapper &&other);
+  BasicControllerPacketToPanTiltActionMapper();
+  BasicControllerPacketToPanTiltActionMapper(
+      BasicJoystickInputToServoActionMapper<Servo> tilt_action_mapper,
+      BasicJoystickInputToServoActionMapper<Servo> pan_action_mapper);
+  BasicControllerPacketToPanTiltActionMapper(
+      BasicControllerPacketToPanTiltActionMapper &&other);
+  BasicControllerPacketToPanTiltActionMapper& operator=(
+      BasicControllerPacketToPanTiltActionMapper &&other);
   void ProcessPacket(
       const uint8_t *buffer,
       size_t buffer_size);
+  void ProcessReport(const ControllerReport &report);
+  ServoCommandState GetTiltCommandState() const;
+  ServoCommandState GetPanCommandState() const;
+  void InvalidateCommandState();
 
 private:
-  void StealResources(ControllerPacketToPanTiltActionMapper *other);
+  void StealResources(BasicControllerPacketToPanTiltActionMapper *other);
 
 private:
-  ControllerPacketToPanTiltActionMapper(
-      const ControllerPacketToPanTiltActionMapper &other) = delete;
-  ControllerPacketToPanTiltActionMapper& operator=(
-      const ControllerPacketToPanTiltActionMapper &other) = delete;
+  BasicControllerPacketToPanTiltActionMapper(
+      const BasicControllerPacketToPanTiltActionMapper &other) = delete;
+  BasicControllerPacketToPanTiltActionMapper& operator=(
+      const BasicControllerPacketToPanTiltActionMapper &other) = delete;
 
 private:
   bool initialized_;
-  JoystickInputToServoActionMapper tilt_action_mapper_;
-  JoystickInputToServoActionMapper pan_action_mapper_;
+  BasicJoystickInputToServoActionMapper<Servo> tilt_action_mapper_;
+  BasicJoystickInputToServoActionMapper<Servo> pan_action_mapper_;
 };
 
+using ControllerPacketToPanTiltActionMapper =
+    BasicControllerPacketToPanTiltActionMapper<dynamixel::AxA12>;
+
+template <typename Servo>
+bool BasicControllerPacketToPanTiltActionMapper<Servo>::Create(
+    Servo *axa12_tilt,
+    Servo *axa12_pan,
+    ServoBusBudget *bus_budget,
+    BasicControllerPacketToPanTiltActionMapper *out_mapper)
+{
+  assert(axa12_tilt);
+  assert(axa12_pan);
+  assert(bus_budget);
+  assert(out_mapper);
+
+  BasicJoystickInputToServoActionMapper<Servo> tilt_action_mapper;
+  if (!BasicJoystickInputToServoActionMapper<Servo>::Create(
+          axa12_tilt,
+          bus_budget,
+          &tilt_action_mapper))
+  {
+    std::cerr << "Failed to initialize tilt servo joystick mapper" << std::endl;
+    return false;
+  }
+
+  BasicJoystickInputToServoActionMapper<Servo> pan_action_mapper;
+  if (!BasicJoystickInputToServoActionMapper<Servo>::Create(
+          axa12_pan,
+          bus_budget,
+          &pan_action_mapper))
+  {
+    std::cerr << "Failed to initialize pan servo joystick mapper" << std::endl;
+    return false;
+  }
+
+  *out_mapper = BasicControllerPacketToPanTiltActionMapper{
+        std::move(tilt_action_mapper),
+        std::move(pan_action_mapper)};
+  return true;
+}
+
+template <typename Servo>
+bool BasicControllerPacketToPanTiltActionMapper<Servo>::Resume(
+    Servo *axa12_tilt,
+    Servo *axa12_pan,
+    ServoBusBudget *bus_budget,
+    const ServoCommandState &last_tilt_state,
+    const ServoCommandState &last_pan_state,
+    BasicControllerPacketToPanTiltActionMapper *out_mapper)
+{
+  assert(axa12_tilt);
+  assert(axa12_pan);
+  assert(bus_budget);
+  assert(out_mapper);
+
+  BasicJoystickInputToServoActionMapper<Servo> tilt_action_mapper;
+  if (!BasicJoystickInputToServoActionMapper<Servo>::Resume(
+          axa12_tilt,
+          bus_budget,
+          last_tilt_state,
+          &tilt_action_mapper))
+  {
+    std::cerr << "Failed to resume tilt servo joystick mapper" << std::endl;
+    return false;
+  }
+
+  BasicJoystickInputToServoActionMapper<Servo> pan_action_mapper;
+  if (!BasicJoystickInputToServoActionMapper<Servo>::Resume(
+          axa12_pan,
+          bus_budget,
+          last_pan_state,
+          &pan_action_mapper))
+  {
+    std::cerr << "Failed to resume pan servo joystick mapper" << std::endl;
+    return false;
+  }
+
+  *out_mapper = BasicControllerPacketToPanTiltActionMapper{
+        std::move(tilt_action_mapper),
+        std::move(pan_action_mapper)};
+  return true;
+}
+
+template <typename Servo>
+BasicControllerPacketToPanTiltActionMapper<Servo>::BasicControllerPacketToPanTiltActionMapper()
+  : initialized_{false} {}
+
+template <typename Servo>
+BasicControllerPacketToPanTiltActionMapper<Servo>::BasicControllerPacketToPanTiltActionMapper(
+    BasicJoystickInputToServoActionMapper<Servo> tilt_action_mapper,
+    BasicJoystickInputToServoActionMapper<Servo> pan_action_mapper)
+  : initialized_{true},
+    tilt_action_mapper_{std::move(tilt_action_mapper)},
+    pan_action_mapper_{std::move(pan_action_mapper)} {}
+
+template <typename Servo>
+BasicControllerPacketToPanTiltActionMapper<Servo>::BasicControllerPacketToPanTiltActionMapper(
+    BasicControllerPacketToPanTiltActionMapper &&other)
+{
+  StealResources(&other);
+}
+
+template <typename Servo>
+BasicControllerPacketToPanTiltActionMapper<Servo>&
+BasicControllerPacketToPanTiltActionMapper<Servo>::operator=(
+    BasicControllerPacketToPanTiltActionMapper &&other)
+{
+  if (this != &other)
+  {
+    StealResources(&other);
+  }
+  return *this;
+}
+
+template <typename Servo>
+void BasicControllerPacketToPanTiltActionMapper<Servo>::ProcessPacket(
+    const uint8_t *buffer,
+    size_t buffer_size)
+{
+  assert(initialized_);
+  assert(buffer);
+
+  ControllerReport report;
+  if (!DecodeControllerReport(buffer, buffer_size, &report))
+  {
+    IncrementCounter(Counter::PACKETS_REJECTED);
+    XBOX_LOG(
+        LogLevel::WARNING,
+        "Rejecting packet. Expected length %zu but received actual packet size of %zu",
+        CONTROLLER_REPORT_SIZE,
+        buffer_size);
+    return;
+  }
+
+  ProcessReport(report);
+}
+
+template <typename Servo>
+void BasicControllerPacketToPanTiltActionMapper<Servo>::ProcessReport(
+    const ControllerReport &report)
+{
+  assert(initialized_);
+
+  IncrementCounter(Counter::REPORTS_PROCESSED);
+  SetGauge(
+      Gauge::LAST_REPORT_TIMESTAMP_NS,
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch()).count());
+
+  double normalized_tilt_position = NormalizeJoystickInputScalar(report.left_stick_y);
+  double normalized_pan_position = NormalizeJoystickInputScalar(report.left_stick_x);
+
+  if (!tilt_action_mapper_.ProcessInput(normalized_tilt_position))
+  {
+    XBOX_LOG(LogLevel::ERROR, "Failed to process tilt joystick value");
+    return;
+  }
+
+  if (!pan_action_mapper_.ProcessInput(normalized_pan_position))
+  {
+    XBOX_LOG(LogLevel::ERROR, "Failed to process pan joystick value");
+    return;
+  }
+}
+
+template <typename Servo>
+ServoCommandState BasicControllerPacketToPanTiltActionMapper<Servo>::GetTiltCommandState() const
+{
+  return tilt_action_mapper_.GetCommandState();
+}
+
+template <typename Servo>
+ServoCommandState BasicControllerPacketToPanTiltActionMapper<Servo>::GetPanCommandState() const
+{
+  return pan_action_mapper_.GetCommandState();
+}
+
+template <typename Servo>
+void BasicControllerPacketToPanTiltActionMapper<Servo>::InvalidateCommandState()
+{
+  tilt_action_mapper_.InvalidateCommandState();
+  pan_action_mapper_.InvalidateCommandState();
+}
+
+template <typename Servo>
+void BasicControllerPacketToPanTiltActionMapper<Servo>::StealResources(
+    BasicControllerPacketToPanTiltActionMapper *other)
+{
+  assert(other);
+  initialized_ = other->initialized_;
+  other->initialized_ = false;
+  tilt_action_mapper_ = std::move(other->tilt_action_mapper_);
+  pan_action_mapper_ = std::move(other->pan_action_mapper_);
+}
+
 }  // namespace xbox
 
 #endif  // XBOXCONTROLLER_CONTROLLERPACKETTOPANTILTACTIONMAPPER_H
-
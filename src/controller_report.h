@@ -0,0 +1,110 @@
+#ifndef XBOXCONTROLLER_CONTROLLERREPORT_H
+#define XBOXCONTROLLER_CONTROLLERREPORT_H
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+namespace xbox
+{
+
+// Size of an Xbox controller HID report as seen on the HCI monitor channel.
+// Byte layout is documented in doc/packet-traces/packet-structure.txt.
+constexpr size_t CONTROLLER_REPORT_SIZE = 25;
+
+struct ControllerReport
+{
+  uint16_t left_stick_x;
+  uint16_t left_stick_y;
+  uint16_t right_stick_x;
+  uint16_t right_stick_y;
+  uint16_t left_trigger;
+  uint16_t right_trigger;
+  uint8_t dpad;
+  uint8_t buttons;
+};
+
+// Bit positions in the mask returned by GetButtonMask(). Bits 0-7 mirror the
+// button byte; bits 8-11 are the d-pad hat decoded into directions.
+enum class ControllerButton : uint8_t
+{
+  A = 0,
+  B = 1,
+  X = 2,
+  Y = 3,
+  LB = 4,
+  RB = 5,
+  // Not yet confirmed in a trace; assumed to be the stick clicks.
+  L3 = 6,
+  R3 = 7,
+  DPAD_UP = 8,
+  DPAD_RIGHT = 9,
+  DPAD_DOWN = 10,
+  DPAD_LEFT = 11,
+};
+
+constexpr size_t CONTROLLER_BUTTON_COUNT = 12;
+
+constexpr uint16_t ToButtonMask(ControllerButton button)
+{
+  return static_cast<uint16_t>(1u << static_cast<uint8_t>(button));
+}
+
+// The d-pad byte is a hat switch: 0 is released, 1 is up, and each step
+// rotates 45 degrees clockwise through 8 (up-left).
+constexpr std::array<uint16_t, 9> DPAD_HAT_TO_BUTTON_MASK =
+{{
+  0,
+  ToButtonMask(ControllerButton::DPAD_UP),
+  ToButtonMask(ControllerButton::DPAD_UP) | ToButtonMask(ControllerButton::DPAD_RIGHT),
+  ToButtonMask(ControllerButton::DPAD_RIGHT),
+  ToButtonMask(ControllerButton::DPAD_RIGHT) | ToButtonMask(ControllerButton::DPAD_DOWN),
+  ToButtonMask(ControllerButton::DPAD_DOWN),
+  ToButtonMask(ControllerButton::DPAD_DOWN) | ToButtonMask(ControllerButton::DPAD_LEFT),
+  ToButtonMask(ControllerButton::DPAD_LEFT),
+  ToButtonMask(ControllerButton::DPAD_LEFT) | ToButtonMask(ControllerButton::DPAD_UP),
+}};
+
+inline uint16_t GetButtonMask(const ControllerReport &report)
+{
+  uint16_t dpad_mask = (report.dpad < DPAD_HAT_TO_BUTTON_MASK.size())
+      ? DPAD_HAT_TO_BUTTON_MASK[report.dpad]
+      : 0;
+  return dpad_mask | report.buttons;
+}
+
+inline double NormalizeJoystickInputScalar(uint16_t joystick_input_scalar)
+{
+  uint64_t joystick_input_scalar_long = static_cast<uint64_t>(joystick_input_scalar);
+  int64_t signed_scalar_long = joystick_input_scalar_long - 0x8000;
+  return 2.0 * signed_scalar_long / 0x10000;
+}
+
+inline bool DecodeControllerReport(
+    const uint8_t *buffer,
+    size_t buffer_size,
+    ControllerReport *out_report)
+{
+  assert(buffer);
+  assert(out_report);
+
+  if (buffer_size < CONTROLLER_REPORT_SIZE)
+  {
+    return false;
+  }
+
+  out_report->left_stick_x = (buffer[11] << 8) | buffer[10];
+  out_report->left_stick_y = (buffer[13] << 8) | buffer[12];
+  out_report->right_stick_x = (buffer[15] << 8) | buffer[14];
+  out_report->right_stick_y = (buffer[17] << 8) | buffer[16];
+  out_report->left_trigger = ((buffer[19] & 0x03) << 8) | buffer[18];
+  out_report->right_trigger = ((buffer[21] & 0x03) << 8) | buffer[20];
+  out_report->dpad = buffer[22];
+  out_report->buttons = buffer[23];
+  return true;
+}
+
+}  // namespace xbox
+
+#endif  // XBOXCONTROLLER_CONTROLLERREPORT_H
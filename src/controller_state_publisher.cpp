@@ -0,0 +1,174 @@
+#include "src/controller_state_publisher.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <iostream>
+#include <new>
+
+namespace
+{
+
+int64_t MonotonicNanoseconds()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+}  // namespace
+
+namespace xbox
+{
+
+bool ControllerStatePublisher::Create(
+    const std::string &name,
+    ControllerStatePublisher *out_publisher)
+{
+  assert(out_publisher);
+
+  int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0)
+  {
+    std::cerr << "Failed to create controller state segment " << name << ". Error: "
+              << strerror(errno) << std::endl;
+    return false;
+  }
+
+  if (ftruncate(fd, sizeof(SharedControllerState)) < 0)
+  {
+    std::cerr << "Failed to size controller state segment. Error: "
+              << strerror(errno) << std::endl;
+    close(fd);
+    shm_unlink(name.c_str());
+    return false;
+  }
+
+  void *mapping = mmap(
+      nullptr,
+      sizeof(SharedControllerState),
+      PROT_READ | PROT_WRITE,
+      MAP_SHARED,
+      fd,
+      0);
+  close(fd);
+
+  if (mapping == MAP_FAILED)
+  {
+    std::cerr << "Failed to map controller state segment. Error: "
+              << strerror(errno) << std::endl;
+    shm_unlink(name.c_str());
+    return false;
+  }
+
+  memset(mapping, 0, sizeof(SharedControllerState));
+  SharedControllerState *state = new (mapping) SharedControllerState{};
+  state->magic = SHARED_CONTROLLER_STATE_MAGIC;
+  state->version = SHARED_CONTROLLER_STATE_VERSION;
+  state->sequence.store(0, std::memory_order_release);
+
+  *out_publisher = ControllerStatePublisher{name, state};
+  return true;
+}
+
+ControllerStatePublisher::ControllerStatePublisher()
+  : initialized_{false},
+    state_{nullptr},
+    report_count_{0},
+    raw_report_{} {}
+
+ControllerStatePublisher::ControllerStatePublisher(
+    std::string name,
+    SharedControllerState *state)
+  : initialized_{true},
+    name_{std::move(name)},
+    state_{state},
+    report_count_{0},
+    raw_report_{} {}
+
+ControllerStatePublisher::ControllerStatePublisher(ControllerStatePublisher &&other)
+  : initialized_{false},
+    state_{nullptr},
+    report_count_{0},
+    raw_report_{}
+{
+  StealResources(&other);
+}
+
+ControllerStatePublisher& ControllerStatePublisher::operator=(
+    ControllerStatePublisher &&other)
+{
+  if (this != &other)
+  {
+    Close();
+    StealResources(&other);
+  }
+  return *this;
+}
+
+ControllerStatePublisher::~ControllerStatePublisher()
+{
+  Close();
+}
+
+void ControllerStatePublisher::SetRawReport(const ControllerReport &raw_report)
+{
+  raw_report_ = raw_report;
+}
+
+void ControllerStatePublisher::Publish(
+    const ControllerReport &report,
+    const ServoCommandState &tilt,
+    const ServoCommandState &pan)
+{
+  assert(initialized_);
+
+  // Single writer: only this thread ever modifies |sequence|.
+  uint32_t sequence = state_->sequence.load(std::memory_order_relaxed);
+  state_->sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  ControllerStateSnapshot &snapshot = state_->snapshot;
+  snapshot.report_count = ++report_count_;
+  snapshot.report_timestamp_ns = MonotonicNanoseconds();
+  snapshot.report = report;
+  snapshot.raw_report = raw_report_;
+  snapshot.tilt = tilt;
+  snapshot.pan = pan;
+
+  state_->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void ControllerStatePublisher::Close()
+{
+  if (!initialized_)
+  {
+    return;
+  }
+
+  munmap(state_, sizeof(SharedControllerState));
+  shm_unlink(name_.c_str());
+  state_ = nullptr;
+  initialized_ = false;
+}
+
+void ControllerStatePublisher::StealResources(ControllerStatePublisher *other)
+{
+  assert(other);
+
+  initialized_ = other->initialized_;
+  other->initialized_ = false;
+  name_ = std::move(other->name_);
+  state_ = other->state_;
+  other->state_ = nullptr;
+  report_count_ = other->report_count_;
+  raw_report_ = other->raw_report_;
+}
+
+}  // namespace xbox
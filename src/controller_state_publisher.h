@@ -0,0 +1,105 @@
+#ifndef XBOXCONTROLLER_CONTROLLERSTATEPUBLISHER_H
+#define XBOXCONTROLLER_CONTROLLERSTATEPUBLISHER_H
+
+#include <cassert>
+#include <string>
+
+#include "src/controller_report.h"
+#include "src/shared_controller_state.h"
+
+namespace xbox
+{
+
+// Publishes the latest decoded report and commanded servo state into a
+// /dev/shm segment guarded by a seqlock. Publish() is a handful of stores into
+// already-mapped memory; it never makes a system call and never waits on
+// readers. See controller_state_reader.h for the consumer side.
+class ControllerStatePublisher
+{
+public:
+  static bool Create(const std::string &name, ControllerStatePublisher *out_publisher);
+
+public:
+  ControllerStatePublisher();
+  ControllerStatePublisher(std::string name, SharedControllerState *state);
+  ControllerStatePublisher(ControllerStatePublisher &&other);
+  ControllerStatePublisher& operator=(ControllerStatePublisher &&other);
+  ~ControllerStatePublisher();
+  // Keeps |raw_report| for the next Publish(), which stores it next to the
+  // smoothed report.
+  void SetRawReport(const ControllerReport &raw_report);
+  void Publish(
+      const ControllerReport &report,
+      const ServoCommandState &tilt,
+      const ServoCommandState &pan);
+
+private:
+  void Close();
+  void StealResources(ControllerStatePublisher *other);
+
+private:
+  ControllerStatePublisher(const ControllerStatePublisher &other) = delete;
+  ControllerStatePublisher& operator=(const ControllerStatePublisher &other) = delete;
+
+private:
+  bool initialized_;
+  std::string name_;
+  SharedControllerState *state_;
+  uint64_t report_count_;
+  ControllerReport raw_report_;
+};
+
+// Input pipeline stage that hands each report to |publisher| as the raw
+// report before any later stage smooths it. Place it right after decoding.
+class RawReportPublishStage
+{
+public:
+  RawReportPublishStage() : publisher_{nullptr} {}
+  explicit RawReportPublishStage(ControllerStatePublisher *publisher) : publisher_{publisher} {}
+
+  template <typename Next>
+  void operator()(Next& next, const ControllerReport &report) const
+  {
+    assert(publisher_);
+
+    publisher_->SetRawReport(report);
+    next(report);
+  }
+
+private:
+  ControllerStatePublisher *publisher_;
+};
+
+// Input pipeline stage that lets the rest of the pipeline act on a report
+// and then publishes the report together with the servo commands |Mapper|
+// settled on.
+template <typename Mapper>
+class ControllerStatePublishStage
+{
+public:
+  ControllerStatePublishStage() : publisher_{nullptr}, mapper_{nullptr} {}
+  ControllerStatePublishStage(ControllerStatePublisher *publisher, const Mapper *mapper)
+    : publisher_{publisher},
+      mapper_{mapper} {}
+
+  template <typename Next>
+  void operator()(Next& next, const ControllerReport &report) const
+  {
+    assert(publisher_);
+    assert(mapper_);
+
+    next(report);
+    publisher_->Publish(
+        report,
+        mapper_->GetTiltCommandState(),
+        mapper_->GetPanCommandState());
+  }
+
+private:
+  ControllerStatePublisher *publisher_;
+  const Mapper *mapper_;
+};
+
+}  // namespace xbox
+
+#endif  // XBOXCONTROLLER_CONTROLLERSTATEPUBLISHER_H
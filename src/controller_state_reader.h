@@ -0,0 +1,139 @@
+#ifndef XBOXCONTROLLER_CONTROLLERSTATEREADER_H
+#define XBOXCONTROLLER_CONTROLLERSTATEREADER_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+
+#include "src/shared_controller_state.h"
+
+namespace xbox
+{
+
+// Header-only reader for the state xbone publishes to shared memory.
+//
+// Link nothing but this header: Open() maps the segment read-only once, and
+// every Read() after that is a plain seqlock copy with no system call and no
+// store to shared memory, so any number of readers can poll it without
+// slowing down the publisher.
+class ControllerStateReader
+{
+public:
+  static bool Open(const char *name, ControllerStateReader *out_reader)
+  {
+    assert(name);
+    assert(out_reader);
+
+    int fd = shm_open(name, O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0)
+    {
+      std::cerr << "Failed to open controller state segment " << name << ". Error: "
+                << strerror(errno) << std::endl;
+      return false;
+    }
+
+    void *mapping = mmap(nullptr, sizeof(SharedControllerState), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (mapping == MAP_FAILED)
+    {
+      std::cerr << "Failed to map controller state segment. Error: "
+                << strerror(errno) << std::endl;
+      return false;
+    }
+
+    const SharedControllerState *state = static_cast<const SharedControllerState *>(mapping);
+    if (state->magic != SHARED_CONTROLLER_STATE_MAGIC ||
+        state->version != SHARED_CONTROLLER_STATE_VERSION)
+    {
+      std::cerr << "Unexpected controller state segment: magic=0x" << std::hex << state->magic
+                << std::dec << ", version=" << state->version << std::endl;
+      munmap(mapping, sizeof(SharedControllerState));
+      return false;
+    }
+
+    *out_reader = ControllerStateReader{state};
+    return true;
+  }
+
+public:
+  ControllerStateReader() : state_{nullptr} {}
+
+  explicit ControllerStateReader(const SharedControllerState *state) : state_{state} {}
+
+  ControllerStateReader(ControllerStateReader &&other) : state_{other.state_}
+  {
+    other.state_ = nullptr;
+  }
+
+  ControllerStateReader& operator=(ControllerStateReader &&other)
+  {
+    if (this != &other)
+    {
+      Close();
+      state_ = other.state_;
+      other.state_ = nullptr;
+    }
+    return *this;
+  }
+
+  ~ControllerStateReader()
+  {
+    Close();
+  }
+
+  // Copies a consistent snapshot. Returns false only if the writer kept the
+  // segment busy for |max_attempts| consecutive tries.
+  bool Read(ControllerStateSnapshot *out_snapshot, size_t max_attempts = 1000) const
+  {
+    assert(state_);
+    assert(out_snapshot);
+
+    for (size_t attempt = 0; attempt < max_attempts; ++attempt)
+    {
+      uint32_t begin = state_->sequence.load(std::memory_order_acquire);
+      if (begin & 1)
+      {
+        continue;
+      }
+
+      std::memcpy(out_snapshot, &state_->snapshot, sizeof(*out_snapshot));
+      std::atomic_thread_fence(std::memory_order_acquire);
+
+      if (state_->sequence.load(std::memory_order_relaxed) == begin)
+      {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+private:
+  void Close()
+  {
+    if (state_)
+    {
+      munmap(const_cast<SharedControllerState *>(state_), sizeof(SharedControllerState));
+      state_ = nullptr;
+    }
+  }
+
+private:
+  ControllerStateReader(const ControllerStateReader &other) = delete;
+  ControllerStateReader& operator=(const ControllerStateReader &other) = delete;
+
+private:
+  const SharedControllerState *state_;
+};
+
+}  // namespace xbox
+
+#endif  // XBOXCONTROLLER_CONTROLLERSTATEREADER_H
@@ -0,0 +1,159 @@
+#include "src/dynamixel_protocol.h"
+
+#include <cassert>
+
+namespace
+{
+constexpr uint8_t DYNAMIXEL_HEADER_BYTE = 0xFF;
+
+void FinishPacket(xbox::DynamixelPacket *packet)
+{
+  // Length covers instruction, params and checksum.
+  packet->bytes[3] = packet->size - 3;
+
+  uint8_t sum = 0;
+  for (size_t i = 2; i < packet->size; ++i)
+  {
+    sum += packet->bytes[i];
+  }
+  packet->bytes[packet->size++] = ~sum;
+}
+}  // namespace
+
+namespace xbox
+{
+
+void BuildDynamixelWritePacket(
+    uint8_t id,
+    AxA12Address address,
+    uint16_t value,
+    uint8_t width,
+    DynamixelPacket *out_packet)
+{
+  assert(out_packet);
+  assert(width == 1 || width == 2);
+
+  DynamixelPacket &packet = *out_packet;
+  packet.bytes[0] = DYNAMIXEL_HEADER_BYTE;
+  packet.bytes[1] = DYNAMIXEL_HEADER_BYTE;
+  packet.bytes[2] = id;
+  packet.bytes[4] = static_cast<uint8_t>(DynamixelInstruction::WRITE_DATA);
+  packet.bytes[5] = static_cast<uint8_t>(address);
+  packet.bytes[6] = value & 0xFF;
+  packet.size = 7;
+  if (width == 2)
+  {
+    packet.bytes[packet.size++] = value >> 8;
+  }
+  FinishPacket(&packet);
+}
+
+void BuildDynamixelReadPacket(
+    uint8_t id,
+    AxA12Address address,
+    uint8_t width,
+    DynamixelPacket *out_packet)
+{
+  assert(out_packet);
+  assert(width == 1 || width == 2);
+
+  DynamixelPacket &packet = *out_packet;
+  packet.bytes[0] = DYNAMIXEL_HEADER_BYTE;
+  packet.bytes[1] = DYNAMIXEL_HEADER_BYTE;
+  packet.bytes[2] = id;
+  packet.bytes[4] = static_cast<uint8_t>(DynamixelInstruction::READ_DATA);
+  packet.bytes[5] = static_cast<uint8_t>(address);
+  packet.bytes[6] = width;
+  packet.size = 7;
+  FinishPacket(&packet);
+}
+
+void BuildDynamixelPingPacket(uint8_t id, DynamixelPacket *out_packet)
+{
+  assert(out_packet);
+
+  DynamixelPacket &packet = *out_packet;
+  packet.bytes[0] = DYNAMIXEL_HEADER_BYTE;
+  packet.bytes[1] = DYNAMIXEL_HEADER_BYTE;
+  packet.bytes[2] = id;
+  packet.bytes[4] = static_cast<uint8_t>(DynamixelInstruction::PING);
+  packet.size = 5;
+  FinishPacket(&packet);
+}
+
+DynamixelStatusParser::DynamixelStatusParser()
+{
+  Reset();
+}
+
+DynamixelStatusParser::Result DynamixelStatusParser::Feed(uint8_t byte)
+{
+  switch (state_)
+  {
+    case State::HEADER_1:
+      if (byte == DYNAMIXEL_HEADER_BYTE)
+      {
+        state_ = State::HEADER_2;
+      }
+      break;
+    case State::HEADER_2:
+      state_ = (byte == DYNAMIXEL_HEADER_BYTE) ? State::ID : State::HEADER_1;
+      break;
+    case State::ID:
+      // A third 0xFF is still header; ids stop at 0xFE.
+      if (byte != DYNAMIXEL_HEADER_BYTE)
+      {
+        status_.id = byte;
+        sum_ = byte;
+        state_ = State::LENGTH;
+      }
+      break;
+    case State::LENGTH:
+      if (byte < 2 || byte > DYNAMIXEL_MAX_STATUS_PARAMS + 2)
+      {
+        Reset();
+        return Result::MALFORMED;
+      }
+      length_ = byte;
+      sum_ += byte;
+      status_.param_count = 0;
+      state_ = State::ERROR;
+      break;
+    case State::ERROR:
+      status_.error = byte;
+      sum_ += byte;
+      state_ = (length_ > 2) ? State::PARAMS : State::CHECKSUM;
+      break;
+    case State::PARAMS:
+      status_.params[status_.param_count++] = byte;
+      sum_ += byte;
+      if (status_.param_count == length_ - 2)
+      {
+        state_ = State::CHECKSUM;
+      }
+      break;
+    case State::CHECKSUM:
+    {
+      bool valid = static_cast<uint8_t>(~sum_) == byte;
+      state_ = State::HEADER_1;
+      return valid ? Result::COMPLETE : Result::MALFORMED;
+    }
+  }
+
+  return Result::INCOMPLETE;
+}
+
+const DynamixelStatus& DynamixelStatusParser::GetStatus() const
+{
+  return status_;
+}
+
+void DynamixelStatusParser::Reset()
+{
+  state_ = State::HEADER_1;
+  length_ = 0;
+  sum_ = 0;
+  status_ = DynamixelStatus{};
+}
+
+}  // namespace xbox
@@ -0,0 +1,115 @@
+#ifndef XBOXCONTROLLER_DYNAMIXELPROTOCOL_H
+#define XBOXCONTROLLER_DYNAMIXELPROTOCOL_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace xbox
+{
+
+// Dynamixel protocol 1.0 framing, as spoken by the AX-12:
+//
+//   instruction: 0xFF 0xFF id length instruction params... checksum
+//   status:      0xFF 0xFF id length error params... checksum
+//
+// |length| counts the bytes after itself; the checksum is the inverted low
+// byte of the sum of id through the last param.
+
+constexpr uint8_t DYNAMIXEL_BROADCAST_ID = 0xFE;
+constexpr size_t DYNAMIXEL_MAX_PACKET_SIZE = 16;
+constexpr size_t DYNAMIXEL_MAX_STATUS_PARAMS = 8;
+
+enum class DynamixelInstruction : uint8_t
+{
+  PING = 0x01,
+  READ_DATA = 0x02,
+  WRITE_DATA = 0x03,
+};
+
+// AX-12 control table addresses used by xbone.
+enum class AxA12Address : uint8_t
+{
+  // EEPROM; the bus runs at 2000000 / (value + 1) baud.
+  BAUD_RATE = 0x04,
+  CW_ANGLE_LIMIT = 0x06,
+  CCW_ANGLE_LIMIT = 0x08,
+  STATUS_RETURN_LEVEL = 0x10,
+  TORQUE_ENABLE = 0x18,
+  GOAL_POSITION = 0x1E,
+  MOVING_SPEED = 0x20,
+  TORQUE_LIMIT = 0x22,
+  PRESENT_POSITION = 0x24,
+};
+
+struct DynamixelPacket
+{
+  std::array<uint8_t, DYNAMIXEL_MAX_PACKET_SIZE> bytes;
+  uint8_t size;
+};
+
+// Writes |width| (1 or 2) little-endian bytes of |value| at |address|.
+void BuildDynamixelWritePacket(
+    uint8_t id,
+    AxA12Address address,
+    uint16_t value,
+    uint8_t width,
+    DynamixelPacket *out_packet);
+
+void BuildDynamixelReadPacket(
+    uint8_t id,
+    AxA12Address address,
+    uint8_t width,
+    DynamixelPacket *out_packet);
+
+void BuildDynamixelPingPacket(uint8_t id, DynamixelPacket *out_packet);
+
+struct DynamixelStatus
+{
+  uint8_t id;
+  uint8_t error;
+  uint8_t param_count;
+  std::array<uint8_t, DYNAMIXEL_MAX_STATUS_PARAMS> params;
+};
+
+// Incremental status packet parser. Bytes may arrive split across any
+// number of reads; garbage before a header is skipped.
+class DynamixelStatusParser
+{
+public:
+  enum class Result
+  {
+    INCOMPLETE,
+    COMPLETE,
+    // Bad checksum or impossible length; the parser resynchronizes.
+    MALFORMED,
+  };
+
+public:
+  DynamixelStatusParser();
+  Result Feed(uint8_t byte);
+  const DynamixelStatus& GetStatus() const;
+  void Reset();
+
+private:
+  enum class State
+  {
+    HEADER_1,
+    HEADER_2,
+    ID,
+    LENGTH,
+    ERROR,
+    PARAMS,
+    CHECKSUM,
+  };
+
+private:
+  State state_;
+  uint8_t length_;
+  uint8_t sum_;
+  DynamixelStatus status_;
+};
+
+}  // namespace xbox
+
+#endif  // XBOXCONTROLLER_DYNAMIXELPROTOCOL_H
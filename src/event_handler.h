@@ -1,6 +1,8 @@
 #ifndef XBOXCONTROLLER_EVENTHANDLER_H
 #define XBOXCONTROLLER_EVENTHANDLER_H
 
+#include <cstdint>
+
 namespace xbox
 {
 class EventHandler
@@ -8,6 +10,13 @@ class EventHandler
   public:
     virtual int GetFd() const = 0;
     virtual void HandlePacket() = 0;
+    // Called with the ready epoll event mask. Handlers registered for more
+    // than EPOLLIN override this; the default only reads.
+    virtual void HandleEvents(uint32_t events)
+    {
+      (void)events;
+      HandlePacket();
+    }
 };
 }  // namespace xbox
 
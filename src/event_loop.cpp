@@ -10,6 +10,8 @@
 #include <cassert>
 #include <iostream>
 
+#include "src/logger.h"
+
 namespace
 {
 constexpr int INVALID_FD = -1;
@@ -55,13 +57,18 @@ EventLoop& EventLoop::operator=(EventLoop&& other)
 }
 
 bool EventLoop::Add(EventHandler *handler)
+{
+  return Add(handler, EPOLLIN);
+}
+
+bool EventLoop::Add(EventHandler *handler, uint32_t events)
 {
   assert(handler);
   assert(initialized_);
 
   struct epoll_event ev;
   memset(&ev, 0, sizeof(ev));
-  ev.events = EPOLLIN;
+  ev.events = events;
   ev.data.ptr = handler;
 
   if (epoll_ctl(fd_, EPOLL_CTL_ADD, handler->GetFd(), &ev) < 0)
@@ -73,27 +80,58 @@ bool EventLoop::Add(EventHandler *handler)
   return true;
 }
 
+bool EventLoop::Modify(EventHandler *handler, uint32_t events)
+{
+  assert(handler);
+  assert(initialized_);
+
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = events;
+  ev.data.ptr = handler;
+
+  if (epoll_ctl(fd_, EPOLL_CTL_MOD, handler->GetFd(), &ev) < 0)
+  {
+    XBOX_LOG(LogLevel::ERROR, "Failed to modify epoll event. Error: %s", strerror(errno));
+    return false;
+  }
+
+  return true;
+}
+
 bool EventLoop::Run()
 {
   assert(initialized_);
 
   while (true)
   {
-    struct epoll_event events[2];
-    int active_fds = epoll_wait(fd_, events, 2, -1);
-
-    if (active_fds < 0)
+    if (!RunOnce(-1))
     {
-      std::cerr << "Epoll active fd count less than zero. Error: " << strerror(errno)
-                << std::endl;
       return false;
     }
+  }
 
-    for (size_t i = 0; i < active_fds; ++i)
-    {
-      EventHandler *handler = (EventHandler *)events[i].data.ptr;
-      handler->HandlePacket();
-    }
+  return true;
+}
+
+bool EventLoop::RunOnce(int timeout_ms)
+{
+  assert(initialized_);
+
+  struct epoll_event events[2];
+  int active_fds = epoll_wait(fd_, events, 2, timeout_ms);
+
+  if (active_fds < 0)
+  {
+    std::cerr << "Epoll active fd count less than zero. Error: " << strerror(errno)
+              << std::endl;
+    return false;
+  }
+
+  for (size_t i = 0; i < active_fds; ++i)
+  {
+    EventHandler *handler = (EventHandler *)events[i].data.ptr;
+    handler->HandleEvents(events[i].events);
   }
 
   return true;
@@ -24,7 +24,12 @@ class EventLoop
     EventLoop(EventLoop&& other);
     EventLoop& operator=(EventLoop&& other);
     bool Add(EventHandler *handler);
+    // Registers |handler| for the epoll |events| mask instead of EPOLLIN.
+    bool Add(EventHandler *handler, uint32_t events);
+    bool Modify(EventHandler *handler, uint32_t events);
     bool Run();
+    // Waits up to |timeout_ms| (-1 blocks) and dispatches whatever is ready.
+    bool RunOnce(int timeout_ms);
 
   private:
     void CloseResources();
@@ -0,0 +1,68 @@
+#ifndef XBOXCONTROLLER_EXTERNALCOMMANDRING_H
+#define XBOXCONTROLLER_EXTERNALCOMMANDRING_H
+
+#include <atomic>
+#include <cstdint>
+
+namespace xbox
+{
+
+// Layout of the shared memory segment external trackers push pan/tilt
+// commands into. Shared by ExternalCommandSource (xbone, the only consumer)
+// and the header-only ExternalCommandWriter (the only producer); bump
+// EXTERNAL_COMMAND_RING_VERSION on any change.
+
+constexpr const char* EXTERNAL_COMMAND_RING_NAME = "/xbone-external-commands";
+constexpr uint32_t EXTERNAL_COMMAND_RING_MAGIC = 0x58424352;  // "XBCR"
+constexpr uint32_t EXTERNAL_COMMAND_RING_VERSION = 1;
+// Power of two, so the free-running indices wrap onto slots with a mask.
+constexpr uint32_t EXTERNAL_COMMAND_RING_CAPACITY = 64;
+
+static_assert((EXTERNAL_COMMAND_RING_CAPACITY & (EXTERNAL_COMMAND_RING_CAPACITY - 1)) == 0,
+              "Ring capacity must be a power of two");
+
+enum ExternalServoCommandFlags : uint8_t
+{
+  // The servo should be driven by this command. Without it the servo is left
+  // as it is.
+  EXTERNAL_SERVO_COMMAND_VALID = 1 << 0,
+};
+
+struct ExternalServoCommand
+{
+  uint16_t goal_position;
+  uint16_t moving_speed;
+  uint8_t flags;
+  uint8_t reserved[3];
+};
+
+struct ExternalCommand
+{
+  // CLOCK_MONOTONIC, comparable across processes on the same host.
+  int64_t timestamp_ns;
+  ExternalServoCommand tilt;
+  ExternalServoCommand pan;
+};
+
+struct SharedExternalCommandRing
+{
+  uint32_t magic;
+  uint32_t version;
+  // Free-running; head - tail is the number of queued commands. Each index
+  // has a single writer and lives on its own cache line.
+  alignas(64) std::atomic<uint32_t> head;
+  alignas(64) std::atomic<uint32_t> tail;
+  // Refreshed by the consumer on every poll, so a tracker can tell whether
+  // anyone is listening.
+  alignas(64) std::atomic<int64_t> consumer_timestamp_ns;
+  alignas(64) ExternalCommand slots[EXTERNAL_COMMAND_RING_CAPACITY];
+};
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2,
+              "Ring indices must be lock free to be shared across processes");
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2,
+              "Consumer timestamp must be lock free to be shared across processes");
+
+}  // namespace xbox
+
+#endif  // XBOXCONTROLLER_EXTERNALCOMMANDRING_H
@@ -0,0 +1,159 @@
+#include "src/external_command_source.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <iostream>
+#include <new>
+
+namespace xbox
+{
+
+bool ExternalCommandSource::Create(
+    const std::string &name,
+    ExternalCommandSource *out_source)
+{
+  assert(out_source);
+
+  // Group-writable: the tracker runs as its own user.
+  int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0660);
+  if (fd < 0)
+  {
+    std::cerr << "Failed to create external command ring " << name << ". Error: "
+              << strerror(errno) << std::endl;
+    return false;
+  }
+
+  // shm_open() applies the umask, which usually strips the group write bit.
+  if (fchmod(fd, 0660) < 0)
+  {
+    std::cerr << "Failed to make external command ring group-writable. Error: "
+              << strerror(errno) << std::endl;
+    close(fd);
+    shm_unlink(name.c_str());
+    return false;
+  }
+
+  if (ftruncate(fd, sizeof(SharedExternalCommandRing)) < 0)
+  {
+    std::cerr << "Failed to size external command ring. Error: "
+              << strerror(errno) << std::endl;
+    close(fd);
+    shm_unlink(name.c_str());
+    return false;
+  }
+
+  void *mapping = mmap(
+      nullptr,
+      sizeof(SharedExternalCommandRing),
+      PROT_READ | PROT_WRITE,
+      MAP_SHARED,
+      fd,
+      0);
+  close(fd);
+
+  if (mapping == MAP_FAILED)
+  {
+    std::cerr << "Failed to map external command ring. Error: "
+              << strerror(errno) << std::endl;
+    shm_unlink(name.c_str());
+    return false;
+  }
+
+  memset(mapping, 0, sizeof(SharedExternalCommandRing));
+  SharedExternalCommandRing *ring = new (mapping) SharedExternalCommandRing{};
+  ring->head.store(0, std::memory_order_relaxed);
+  ring->tail.store(0, std::memory_order_relaxed);
+  ring->consumer_timestamp_ns.store(0, std::memory_order_relaxed);
+  ring->magic = EXTERNAL_COMMAND_RING_MAGIC;
+  ring->version = EXTERNAL_COMMAND_RING_VERSION;
+  std::atomic_thread_fence(std::memory_order_release);
+
+  *out_source = ExternalCommandSource{name, ring};
+  return true;
+}
+
+ExternalCommandSource::ExternalCommandSource()
+  : initialized_{false},
+    ring_{nullptr} {}
+
+ExternalCommandSource::ExternalCommandSource(
+    std::string name,
+    SharedExternalCommandRing *ring)
+  : initialized_{true},
+    name_{std::move(name)},
+    ring_{ring} {}
+
+ExternalCommandSource::ExternalCommandSource(ExternalCommandSource &&other)
+  : initialized_{false},
+    ring_{nullptr}
+{
+  StealResources(&other);
+}
+
+ExternalCommandSource& ExternalCommandSource::operator=(ExternalCommandSource &&other)
+{
+  if (this != &other)
+  {
+    Close();
+    StealResources(&other);
+  }
+  return *this;
+}
+
+ExternalCommandSource::~ExternalCommandSource()
+{
+  Close();
+}
+
+bool ExternalCommandSource::PollLatest(int64_t now_ns, ExternalCommand *out_command)
+{
+  assert(initialized_);
+  assert(out_command);
+
+  ring_->consumer_timestamp_ns.store(now_ns, std::memory_order_relaxed);
+
+  // Single consumer: only this thread ever modifies |tail|.
+  uint32_t tail = ring_->tail.load(std::memory_order_relaxed);
+  uint32_t head = ring_->head.load(std::memory_order_acquire);
+  if (head == tail)
+  {
+    return false;
+  }
+
+  // The producer cannot reuse the newest slot until |tail| moves past it.
+  *out_command = ring_->slots[(head - 1) & (EXTERNAL_COMMAND_RING_CAPACITY - 1)];
+  ring_->tail.store(head, std::memory_order_release);
+  return true;
+}
+
+void ExternalCommandSource::Close()
+{
+  if (!initialized_)
+  {
+    return;
+  }
+
+  munmap(ring_, sizeof(SharedExternalCommandRing));
+  shm_unlink(name_.c_str());
+  ring_ = nullptr;
+  initialized_ = false;
+}
+
+void ExternalCommandSource::StealResources(ExternalCommandSource *other)
+{
+  assert(other);
+
+  initialized_ = other->initialized_;
+  other->initialized_ = false;
+  name_ = std::move(other->name_);
+  ring_ = other->ring_;
+  other->ring_ = nullptr;
+}
+
+}  // namespace xbox
@@ -0,0 +1,49 @@
+#ifndef XBOXCONTROLLER_EXTERNALCOMMANDSOURCE_H
+#define XBOXCONTROLLER_EXTERNALCOMMANDSOURCE_H
+
+#include <cstdint>
+#include <string>
+
+#include "src/external_command_ring.h"
+
+namespace xbox
+{
+
+// xbone's end of the external command ring: creates the /dev/shm segment and
+// consumes what the tracker pushes. Polling is a couple of loads and one
+// store into already-mapped memory; it never makes a system call and never
+// waits on the producer. See external_command_writer.h for the producer side.
+class ExternalCommandSource
+{
+public:
+  static bool Create(const std::string &name, ExternalCommandSource *out_source);
+
+public:
+  ExternalCommandSource();
+  ExternalCommandSource(std::string name, SharedExternalCommandRing *ring);
+  ExternalCommandSource(ExternalCommandSource &&other);
+  ExternalCommandSource& operator=(ExternalCommandSource &&other);
+  ~ExternalCommandSource();
+
+  // Drains the ring and keeps only the newest command, since older targets
+  // are already superseded. Returns false if nothing was queued. |now_ns| is
+  // CLOCK_MONOTONIC and is published for IsConsumerAlive().
+  bool PollLatest(int64_t now_ns, ExternalCommand *out_command);
+
+private:
+  void Close();
+  void StealResources(ExternalCommandSource *other);
+
+private:
+  ExternalCommandSource(const ExternalCommandSource &other) = delete;
+  ExternalCommandSource& operator=(const ExternalCommandSource &other) = delete;
+
+private:
+  bool initialized_;
+  std::string name_;
+  SharedExternalCommandRing *ring_;
+};
+
+}  // namespace xbox
+
+#endif  // XBOXCONTROLLER_EXTERNALCOMMANDSOURCE_H
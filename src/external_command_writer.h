@@ -0,0 +1,158 @@
+#ifndef XBOXCONTROLLER_EXTERNALCOMMANDWRITER_H
+#define XBOXCONTROLLER_EXTERNALCOMMANDWRITER_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+
+#include "src/external_command_ring.h"
+
+namespace xbox
+{
+
+// Header-only producer for the command ring xbone polls, for a tracker
+// process that wants to steer the pan/tilt head.
+//
+// Link nothing but this header: Open() maps the segment once, and every
+// Push() after that is a slot copy and one release store, with no system call
+// and no lock, so it is safe to call from a camera callback. Exactly one
+// writer may push into a ring at a time. xbone recreates the segment when it
+// restarts; reopen it when IsConsumerAlive() stays false.
+class ExternalCommandWriter
+{
+public:
+  static bool Open(const char *name, ExternalCommandWriter *out_writer)
+  {
+    assert(name);
+    assert(out_writer);
+
+    int fd = shm_open(name, O_RDWR | O_CLOEXEC, 0);
+    if (fd < 0)
+    {
+      std::cerr << "Failed to open external command ring " << name << ". Error: "
+                << strerror(errno) << std::endl;
+      return false;
+    }
+
+    void *mapping = mmap(
+        nullptr,
+        sizeof(SharedExternalCommandRing),
+        PROT_READ | PROT_WRITE,
+        MAP_SHARED,
+        fd,
+        0);
+    close(fd);
+
+    if (mapping == MAP_FAILED)
+    {
+      std::cerr << "Failed to map external command ring. Error: "
+                << strerror(errno) << std::endl;
+      return false;
+    }
+
+    SharedExternalCommandRing *ring = static_cast<SharedExternalCommandRing *>(mapping);
+    if (ring->magic != EXTERNAL_COMMAND_RING_MAGIC ||
+        ring->version != EXTERNAL_COMMAND_RING_VERSION)
+    {
+      std::cerr << "Unexpected external command ring: magic=0x" << std::hex << ring->magic
+                << std::dec << ", version=" << ring->version << std::endl;
+      munmap(mapping, sizeof(SharedExternalCommandRing));
+      return false;
+    }
+
+    *out_writer = ExternalCommandWriter{ring};
+    return true;
+  }
+
+  // CLOCK_MONOTONIC now, for ExternalCommand::timestamp_ns. Served from the
+  // vDSO, not a system call.
+  static int64_t Now()
+  {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+  }
+
+public:
+  ExternalCommandWriter() : ring_{nullptr} {}
+
+  explicit ExternalCommandWriter(SharedExternalCommandRing *ring) : ring_{ring} {}
+
+  ExternalCommandWriter(ExternalCommandWriter &&other) : ring_{other.ring_}
+  {
+    other.ring_ = nullptr;
+  }
+
+  ExternalCommandWriter& operator=(ExternalCommandWriter &&other)
+  {
+    if (this != &other)
+    {
+      Close();
+      ring_ = other.ring_;
+      other.ring_ = nullptr;
+    }
+    return *this;
+  }
+
+  ~ExternalCommandWriter()
+  {
+    Close();
+  }
+
+  // Queues |command|. Returns false without blocking if the ring is full,
+  // which only happens if xbone has stopped polling.
+  bool Push(const ExternalCommand &command)
+  {
+    assert(ring_);
+
+    uint32_t head = ring_->head.load(std::memory_order_relaxed);
+    uint32_t tail = ring_->tail.load(std::memory_order_acquire);
+    if (head - tail >= EXTERNAL_COMMAND_RING_CAPACITY)
+    {
+      return false;
+    }
+
+    ring_->slots[head & (EXTERNAL_COMMAND_RING_CAPACITY - 1)] = command;
+    ring_->head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Whether xbone polled the ring within the last |max_age|.
+  bool IsConsumerAlive(std::chrono::nanoseconds max_age) const
+  {
+    assert(ring_);
+
+    int64_t polled_ns = ring_->consumer_timestamp_ns.load(std::memory_order_relaxed);
+    return polled_ns != 0 && Now() - polled_ns <= max_age.count();
+  }
+
+private:
+  void Close()
+  {
+    if (ring_)
+    {
+      munmap(ring_, sizeof(SharedExternalCommandRing));
+      ring_ = nullptr;
+    }
+  }
+
+private:
+  ExternalCommandWriter(const ExternalCommandWriter &other) = delete;
+  ExternalCommandWriter& operator=(const ExternalCommandWriter &other) = delete;
+
+private:
+  SharedExternalCommandRing *ring_;
+};
+
+}  // namespace xbox
+
+#endif  // XBOXCONTROLLER_EXTERNALCOMMANDWRITER_H
@@ -0,0 +1,490 @@
+#ifndef XBOXCONTROLLER_EXTERNALCONTROLARBITER_H
+#define XBOXCONTROLLER_EXTERNALCONTROLARBITER_H
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+
+#include "src/controller_report.h"
+#include "src/event_handler.h"
+#include "src/external_command_source.h"
+#include "src/joystick_input_to_servo_action_mapper.h"
+#include "src/logger.h"
+#include "src/metrics.h"
+#include "src/periodic_timer.h"
+#include "src/shared_controller_state.h"
+
+namespace xbox
+{
+namespace external_control_internal
+{
+// Faster than any tracker we expect, so a new target waits half a period at
+// most.
+constexpr std::chrono::milliseconds EXTERNAL_COMMAND_POLL_PERIOD{5};
+// A tracker that falls silent this long loses the head and the servos stop.
+constexpr std::chrono::milliseconds EXTERNAL_COMMAND_TIMEOUT{250};
+// After the stick returns to center, the tracker waits this long before
+// taking the head back, so a brief pause in manual control does not hand it
+// over.
+constexpr std::chrono::milliseconds JOYSTICK_RELEASE_HOLD{1000};
+}  // namespace external_control_internal
+
+enum class ControlOwner : uint8_t
+{
+  JOYSTICK,
+  EXTERNAL,
+};
+
+// Whether the left stick is outside the deadzone on either axis, using the
+// same buckets as the joystick mapper.
+inline bool IsStickDeflected(const ControllerReport &report)
+{
+  return QuantizeJoystickSpeed(NormalizeJoystickInputScalar(report.left_stick_y)) != 0 ||
+      QuantizeJoystickSpeed(NormalizeJoystickInputScalar(report.left_stick_x)) != 0;
+}
+
+// Decides whether the joystick or an external tracker drives the pan/tilt
+// servos, and stands in for |Mapper| in the input pipeline.
+//
+// The stick always wins: a report outside the deadzone takes control back at
+// once and is handed to |Mapper| in the same pass. While the joystick owns
+// the head every report goes to |Mapper|, as without an arbiter. A timerfd
+// on the event loop polls the command ring; once the stick has been centered
+// for JOYSTICK_RELEASE_HOLD and the tracker's newest command is fresh, the
+// tracker owns the head and centered reports are no longer forwarded. Its
+// commands are clamped to the joint travel limits and written register by
+// register, skipping values the servo already holds. If the tracker goes
+// quiet for EXTERNAL_COMMAND_TIMEOUT, torque is released and the joystick
+// owns the head again.
+template <typename Mapper, typename Servo, typename Scheduler>
+class BasicExternalControlArbiter final : public EventHandler
+{
+public:
+  static bool Create(
+      ExternalCommandSource *source,
+      Mapper *mapper,
+      Servo *tilt_servo,
+      Servo *pan_servo,
+      Scheduler *scheduler,
+      BasicExternalControlArbiter *out_arbiter);
+
+public:
+  BasicExternalControlArbiter();
+  BasicExternalControlArbiter(
+      int timer_fd,
+      ExternalCommandSource *source,
+      Mapper *mapper,
+      Servo *tilt_servo,
+      Servo *pan_servo,
+      Scheduler *scheduler);
+  BasicExternalControlArbiter(BasicExternalControlArbiter &&other);
+  BasicExternalControlArbiter& operator=(BasicExternalControlArbiter &&other);
+  ~BasicExternalControlArbiter();
+  int GetFd() const override;
+  void HandlePacket() override;
+  void ProcessReport(const ControllerReport &report);
+  ServoCommandState GetTiltCommandState() const;
+  ServoCommandState GetPanCommandState() const;
+  ControlOwner GetOwner() const;
+  // Forgets what the registers hold, for both the tracker's axes and
+  // |Mapper|, after writes were lost.
+  void InvalidateCommandState();
+
+private:
+  struct ExternalAxis
+  {
+    Servo *servo;
+    // What the arbiter last wrote; meaningless while |known| is false.
+    ServoCommandState state;
+    bool known;
+  };
+
+  enum Axis
+  {
+    TILT,
+    PAN,
+    AXIS_COUNT,
+  };
+
+  static int64_t NowNanoseconds();
+  static bool WriteAxis(ExternalAxis *axis, const ExternalServoCommand &command);
+  void ApplyCommand(const ExternalCommand &command);
+  void ReturnToJoystick();
+  void Close();
+  void StealResources(BasicExternalControlArbiter *other);
+
+private:
+  BasicExternalControlArbiter(const BasicExternalControlArbiter &other) = delete;
+  BasicExternalControlArbiter& operator=(const BasicExternalControlArbiter &other) = delete;
+
+private:
+  bool initialized_;
+  int timer_fd_;
+  ExternalCommandSource *source_;
+  Mapper *mapper_;
+  Scheduler *scheduler_;
+  std::array<ExternalAxis, AXIS_COUNT> axes_;
+  ControlOwner owner_;
+  int64_t last_deflection_ns_;
+  ExternalCommand latest_command_;
+  bool has_command_;
+};
+
+template <typename Mapper, typename Servo, typename Scheduler>
+bool BasicExternalControlArbiter<Mapper, Servo, Scheduler>::Create(
+    ExternalCommandSource *source,
+    Mapper *mapper,
+    Servo *tilt_servo,
+    Servo *pan_servo,
+    Scheduler *scheduler,
+    BasicExternalControlArbiter *out_arbiter)
+{
+  using namespace external_control_internal;
+
+  assert(source);
+  assert(mapper);
+  assert(tilt_servo);
+  assert(pan_servo);
+  assert(scheduler);
+  assert(out_arbiter);
+
+  int timer_fd;
+  if (!OpenPeriodicTimer(EXTERNAL_COMMAND_POLL_PERIOD, &timer_fd))
+  {
+    std::cerr << "Failed to open external command poll timer" << std::endl;
+    return false;
+  }
+
+  *out_arbiter = BasicExternalControlArbiter{
+      timer_fd,
+      source,
+      mapper,
+      tilt_servo,
+      pan_servo,
+      scheduler};
+  return true;
+}
+
+template <typename Mapper, typename Servo, typename Scheduler>
+BasicExternalControlArbiter<Mapper, Servo, Scheduler>::BasicExternalControlArbiter()
+  : initialized_{false},
+    timer_fd_{-1},
+    source_{nullptr},
+    mapper_{nullptr},
+    scheduler_{nullptr},
+    axes_{},
+    owner_{ControlOwner::JOYSTICK},
+    last_deflection_ns_{0},
+    latest_command_{},
+    has_command_{false} {}
+
+template <typename Mapper, typename Servo, typename Scheduler>
+BasicExternalControlArbiter<Mapper, Servo, Scheduler>::BasicExternalControlArbiter(
+    int timer_fd,
+    ExternalCommandSource *source,
+    Mapper *mapper,
+    Servo *tilt_servo,
+    Servo *pan_servo,
+    Scheduler *scheduler)
+  : initialized_{true},
+    timer_fd_{timer_fd},
+    source_{source},
+    mapper_{mapper},
+    scheduler_{scheduler},
+    axes_{},
+    owner_{ControlOwner::JOYSTICK},
+    last_deflection_ns_{0},
+    latest_command_{},
+    has_command_{false}
+{
+  axes_[TILT].servo = tilt_servo;
+  axes_[PAN].servo = pan_servo;
+}
+
+template <typename Mapper, typename Servo, typename Scheduler>
+BasicExternalControlArbiter<Mapper, Servo, Scheduler>::BasicExternalControlArbiter(
+    BasicExternalControlArbiter &&other)
+  : initialized_{false},
+    timer_fd_{-1}
+{
+  StealResources(&other);
+}
+
+template <typename Mapper, typename Servo, typename Scheduler>
+BasicExternalControlArbiter<Mapper, Servo, Scheduler>&
+BasicExternalControlArbiter<Mapper, Servo, Scheduler>::operator=(
+    BasicExternalControlArbiter &&other)
+{
+  if (this != &other)
+  {
+    Close();
+    StealResources(&other);
+  }
+  return *this;
+}
+
+template <typename Mapper, typename Servo, typename Scheduler>
+BasicExternalControlArbiter<Mapper, Servo, Scheduler>::~BasicExternalControlArbiter()
+{
+  Close();
+}
+
+template <typename Mapper, typename Servo, typename Scheduler>
+int BasicExternalControlArbiter<Mapper, Servo, Scheduler>::GetFd() const
+{
+  assert(initialized_);
+  return timer_fd_;
+}
+
+template <typename Mapper, typename Servo, typename Scheduler>
+void BasicExternalControlArbiter<Mapper, Servo, Scheduler>::HandlePacket()
+{
+  using namespace external_control_internal;
+
+  assert(initialized_);
+
+  if (ReadTimerExpirations(timer_fd_) == 0)
+  {
+    return;
+  }
+
+  int64_t now = NowNanoseconds();
+  ExternalCommand command;
+  bool received = source_->PollLatest(now, &command);
+  if (received)
+  {
+    IncrementCounter(Counter::EXTERNAL_COMMANDS_RECEIVED);
+    latest_command_ = command;
+    has_command_ = true;
+  }
+
+  bool fresh = has_command_ &&
+      now - latest_command_.timestamp_ns <=
+          std::chrono::nanoseconds{EXTERNAL_COMMAND_TIMEOUT}.count();
+
+  if (owner_ == ControlOwner::JOYSTICK)
+  {
+    if (!fresh ||
+        now - last_deflection_ns_ < std::chrono::nanoseconds{JOYSTICK_RELEASE_HOLD}.count())
+    {
+      return;
+    }
+
+    XBOX_LOG(LogLevel::INFO, "External tracker takes over the pan/tilt head");
+    owner_ = ControlOwner::EXTERNAL;
+    // The mapper may have left the registers anywhere.
+    for (ExternalAxis &axis : axes_)
+    {
+      axis.known = false;
+    }
+    ApplyCommand(latest_command_);
+    return;
+  }
+
+  if (!fresh)
+  {
+    IncrementCounter(Counter::EXTERNAL_COMMANDS_EXPIRED);
+    XBOX_LOG(LogLevel::WARNING, "External tracker went quiet; stopping the pan/tilt head");
+    for (ExternalAxis &axis : axes_)
+    {
+      axis.servo->SetTorqueEnabled(false);
+    }
+    if (!scheduler_->Flush())
+    {
+      XBOX_LOG(LogLevel::ERROR, "Failed to stop servos after external tracker timeout");
+    }
+    ReturnToJoystick();
+    return;
+  }
+
+  if (received)
+  {
+    ApplyCommand(latest_command_);
+  }
+}
+
+template <typename Mapper, typename Servo, typename Scheduler>
+void BasicExternalControlArbiter<Mapper, Servo, Scheduler>::ProcessReport(
+    const ControllerReport &report)
+{
+  assert(initialized_);
+
+  if (IsStickDeflected(report))
+  {
+    last_deflection_ns_ = NowNanoseconds();
+    if (owner_ == ControlOwner::EXTERNAL)
+    {
+      IncrementCounter(Counter::JOYSTICK_OVERRIDES);
+      XBOX_LOG(LogLevel::INFO, "Joystick overrides the external tracker");
+      ReturnToJoystick();
+    }
+  }
+
+  if (owner_ == ControlOwner::JOYSTICK)
+  {
+    mapper_->ProcessReport(report);
+  }
+}
+
+template <typename Mapper, typename Servo, typename Scheduler>
+ServoCommandState BasicExternalControlArbiter<Mapper, Servo, Scheduler>::GetTiltCommandState() const
+{
+  return owner_ == ControlOwner::JOYSTICK
+      ? mapper_->GetTiltCommandState()
+      : axes_[TILT].state;
+}
+
+template <typename Mapper, typename Servo, typename Scheduler>
+ServoCommandState BasicExternalControlArbiter<Mapper, Servo, Scheduler>::GetPanCommandState() const
+{
+  return owner_ == ControlOwner::JOYSTICK
+      ? mapper_->GetPanCommandState()
+      : axes_[PAN].state;
+}
+
+template <typename Mapper, typename Servo, typename Scheduler>
+ControlOwner BasicExternalControlArbiter<Mapper, Servo, Scheduler>::GetOwner() const
+{
+  return owner_;
+}
+
+template <typename Mapper, typename Servo, typename Scheduler>
+void BasicExternalControlArbiter<Mapper, Servo, Scheduler>::InvalidateCommandState()
+{
+  for (ExternalAxis &axis : axes_)
+  {
+    axis.known = false;
+  }
+  mapper_->InvalidateCommandState();
+}
+
+template <typename Mapper, typename Servo, typename Scheduler>
+int64_t BasicExternalControlArbiter<Mapper, Servo, Scheduler>::NowNanoseconds()
+{
+  // steady_clock is CLOCK_MONOTONIC, the clock trackers stamp commands with.
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+template <typename Mapper, typename Servo, typename Scheduler>
+bool BasicExternalControlArbiter<Mapper, Servo, Scheduler>::WriteAxis(
+    ExternalAxis *axis,
+    const ExternalServoCommand &command)
+{
+  using namespace joystick_mapper_internal;
+
+  if ((command.flags & EXTERNAL_SERVO_COMMAND_VALID) == 0)
+  {
+    return true;
+  }
+
+  uint16_t goal_position = std::min(
+      std::max(command.goal_position, GOAL_POSITION_LIMIT_LOW),
+      GOAL_POSITION_LIMIT_HIGH);
+  // A moving speed of 0 means "as fast as possible" in joint mode.
+  uint16_t moving_speed = std::min(
+      std::max(command.moving_speed, uint16_t{1}),
+      MAX_MOVEMENT_SPEED);
+
+  // The AX-12 acts on each write as it lands, so the speed goes first.
+  if (!axis->known || moving_speed != axis->state.moving_speed)
+  {
+    if (!axis->servo->SetMovingSpeed(moving_speed))
+    {
+      return false;
+    }
+    axis->state.moving_speed = moving_speed;
+  }
+
+  if (!axis->known || goal_position != axis->state.goal_position)
+  {
+    if (!axis->servo->SetGoalPosition(goal_position))
+    {
+      return false;
+    }
+    axis->state.goal_position = goal_position;
+    axis->state.positive_direction = goal_position > GOAL_POSITION_NEUTRAL;
+  }
+
+  if (!axis->known || !axis->state.torque_enabled)
+  {
+    if (!axis->servo->SetTorqueEnabled(true))
+    {
+      return false;
+    }
+    axis->state.torque_enabled = true;
+  }
+
+  axis->known = true;
+  return true;
+}
+
+template <typename Mapper, typename Servo, typename Scheduler>
+void BasicExternalControlArbiter<Mapper, Servo, Scheduler>::ApplyCommand(
+    const ExternalCommand &command)
+{
+  if (!WriteAxis(&axes_[TILT], command.tilt) || !WriteAxis(&axes_[PAN], command.pan))
+  {
+    XBOX_LOG(LogLevel::ERROR, "Failed to queue external servo command");
+  }
+
+  bool flushed = scheduler_->Flush();
+  if (!flushed)
+  {
+    XBOX_LOG_EVERY(LogLevel::ERROR, 1000, "Failed to flush external servo command");
+  }
+
+  // Some writes may not have landed.
+  if (scheduler_->TakeLostWrites() || !flushed)
+  {
+    InvalidateCommandState();
+  }
+}
+
+template <typename Mapper, typename Servo, typename Scheduler>
+void BasicExternalControlArbiter<Mapper, Servo, Scheduler>::ReturnToJoystick()
+{
+  owner_ = ControlOwner::JOYSTICK;
+  // The tracker left the registers somewhere the mapper did not put them.
+  mapper_->InvalidateCommandState();
+}
+
+template <typename Mapper, typename Servo, typename Scheduler>
+void BasicExternalControlArbiter<Mapper, Servo, Scheduler>::Close()
+{
+  if (timer_fd_ >= 0)
+  {
+    close(timer_fd_);
+    timer_fd_ = -1;
+  }
+  initialized_ = false;
+}
+
+template <typename Mapper, typename Servo, typename Scheduler>
+void BasicExternalControlArbiter<Mapper, Servo, Scheduler>::StealResources(
+    BasicExternalControlArbiter *other)
+{
+  assert(other);
+
+  initialized_ = other->initialized_;
+  other->initialized_ = false;
+  timer_fd_ = other->timer_fd_;
+  other->timer_fd_ = -1;
+  source_ = other->source_;
+  mapper_ = other->mapper_;
+  scheduler_ = other->scheduler_;
+  axes_ = other->axes_;
+  owner_ = other->owner_;
+  last_deflection_ns_ = other->last_deflection_ns_;
+  latest_command_ = other->latest_command_;
+  has_command_ = other->has_command_;
+}
+
+}  // namespace xbox
+
+#endif  // XBOXCONTROLLER_EXTERNALCONTROLARBITER_H
@@ -0,0 +1,133 @@
+#include "src/gpio_line.h"
+
+#include <fcntl.h>
+#include <linux/gpio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <iostream>
+
+#include "src/logger.h"
+
+namespace
+{
+constexpr int INVALID_FD = -1;
+const char GPIO_CONSUMER_LABEL[] = "xbone";
+}  // namespace
+
+namespace xbox
+{
+
+bool GpioLineOutput::Create(
+    const std::string &chip_path,
+    uint32_t line,
+    bool initial_value,
+    GpioLineOutput *out_line)
+{
+  assert(out_line);
+
+  int chip_fd = open(chip_path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (chip_fd < 0)
+  {
+    std::cerr << "Failed to open " << chip_path << ". Error: " << strerror(errno) << std::endl;
+    return false;
+  }
+
+  struct gpiohandle_request request;
+  memset(&request, 0, sizeof(request));
+  request.lineoffsets[0] = line;
+  request.lines = 1;
+  request.flags = GPIOHANDLE_REQUEST_OUTPUT;
+  request.default_values[0] = initial_value ? 1 : 0;
+  strncpy(request.consumer_label, GPIO_CONSUMER_LABEL, sizeof(request.consumer_label) - 1);
+
+  int result = ioctl(chip_fd, GPIO_GET_LINEHANDLE_IOCTL, &request);
+  close(chip_fd);
+  if (result < 0)
+  {
+    std::cerr << "Failed to request GPIO line " << line << " on " << chip_path
+              << ". Error: " << strerror(errno) << std::endl;
+    return false;
+  }
+
+  *out_line = GpioLineOutput{request.fd};
+  return true;
+}
+
+GpioLineOutput::GpioLineOutput()
+  : initialized_{false},
+    fd_{INVALID_FD} {}
+
+GpioLineOutput::GpioLineOutput(int fd)
+  : initialized_{true},
+    fd_{fd} {}
+
+GpioLineOutput::GpioLineOutput(GpioLineOutput &&other)
+{
+  StealResources(&other);
+}
+
+GpioLineOutput& GpioLineOutput::operator=(GpioLineOutput &&other)
+{
+  if (this != &other)
+  {
+    Close();
+    StealResources(&other);
+  }
+  return *this;
+}
+
+GpioLineOutput::~GpioLineOutput()
+{
+  Close();
+}
+
+void GpioLineOutput::Set()
+{
+  Write(true);
+}
+
+void GpioLineOutput::Clear()
+{
+  Write(false);
+}
+
+void GpioLineOutput::Write(bool value)
+{
+  assert(initialized_);
+
+  struct gpiohandle_data data;
+  memset(&data, 0, sizeof(data));
+  data.values[0] = value ? 1 : 0;
+
+  if (ioctl(fd_, GPIOHANDLE_SET_LINE_VALUES_IOCTL, &data) < 0)
+  {
+    XBOX_LOG_EVERY(LogLevel::ERROR, 1000, "Failed to write GPIO line. Error: %s", strerror(errno));
+  }
+}
+
+void GpioLineOutput::Close()
+{
+  if (!initialized_)
+  {
+    return;
+  }
+
+  close(fd_);
+  fd_ = INVALID_FD;
+  initialized_ = false;
+}
+
+void GpioLineOutput::StealResources(GpioLineOutput *other)
+{
+  assert(other);
+
+  initialized_ = other->initialized_;
+  other->initialized_ = false;
+  fd_ = other->fd_;
+  other->fd_ = INVALID_FD;
+}
+
+}  // namespace xbox
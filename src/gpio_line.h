@@ -0,0 +1,47 @@
+#ifndef XBOXCONTROLLER_GPIOLINE_H
+#define XBOXCONTROLLER_GPIOLINE_H
+
+#include <cstdint>
+#include <string>
+
+namespace xbox
+{
+
+// A single output line requested from a GPIO character device
+// (/dev/gpiochipN). Set() and Clear() are one ioctl each, so the line can be
+// toggled from the event loop thread between bus transactions.
+class GpioLineOutput
+{
+public:
+  static bool Create(
+      const std::string &chip_path,
+      uint32_t line,
+      bool initial_value,
+      GpioLineOutput *out_line);
+
+public:
+  GpioLineOutput();
+  explicit GpioLineOutput(int fd);
+  GpioLineOutput(GpioLineOutput &&other);
+  GpioLineOutput& operator=(GpioLineOutput &&other);
+  ~GpioLineOutput();
+  void Set();
+  void Clear();
+
+private:
+  void Write(bool value);
+  void Close();
+  void StealResources(GpioLineOutput *other);
+
+private:
+  GpioLineOutput(const GpioLineOutput &other) = delete;
+  GpioLineOutput& operator=(const GpioLineOutput &other) = delete;
+
+private:
+  bool initialized_;
+  int fd_;
+};
+
+}  // namespace xbox
+
+#endif  // XBOXCONTROLLER_GPIOLINE_H
@@ -0,0 +1,117 @@
+#ifndef XBOXCONTROLLER_INPUTPIPELINE_H
+#define XBOXCONTROLLER_INPUTPIPELINE_H
+
+#include <cassert>
+#include <cstdint>
+#include <utility>
+
+#include "src/controller_report.h"
+#include "src/metrics.h"
+#include "src/tracepoints.h"
+
+namespace xbox
+{
+
+// Compile-time composition of the per-report input path.
+//
+// A stage is any callable of the form |stage(next, inputs...)| that does its
+// work and then invokes |next| with its outputs. The final element of a
+// pipeline is a sink callable that only takes inputs. MakeInputPipeline()
+// nests the stages into a single concrete type, so the chain
+//
+//   BasicBluetoothChannel -> ReportDecodeStage -> PanTiltMapperSink -> Servo
+//
+// has no std::function or virtual call between frame receipt and servo write.
+// The runtime-polymorphic BluetoothChannel remains available for callers that
+// need to swap the callback at runtime.
+
+template <typename Stage, typename Next>
+class InputPipelineLink
+{
+public:
+  InputPipelineLink() = default;
+  InputPipelineLink(Stage stage, Next next)
+    : stage_{std::move(stage)},
+      next_{std::move(next)} {}
+
+  template <typename... Inputs>
+  void operator()(Inputs&&... inputs)
+  {
+    stage_(next_, std::forward<Inputs>(inputs)...);
+  }
+
+  Stage& GetStage() { return stage_; }
+  Next& GetNext() { return next_; }
+
+private:
+  Stage stage_;
+  Next next_;
+};
+
+template <typename Sink>
+Sink MakeInputPipeline(Sink sink)
+{
+  return sink;
+}
+
+template <typename Stage, typename Next, typename... Rest>
+auto MakeInputPipeline(Stage stage, Next next, Rest... rest)
+    -> InputPipelineLink<Stage, decltype(MakeInputPipeline(std::move(next), std::move(rest)...))>
+{
+  using Tail = decltype(MakeInputPipeline(std::move(next), std::move(rest)...));
+  return InputPipelineLink<Stage, Tail>{
+      std::move(stage),
+      MakeInputPipeline(std::move(next), std::move(rest)...)};
+}
+
+// Decodes a raw HID frame into a ControllerReport. Frames that are too short
+// to be controller reports are dropped.
+class ReportDecodeStage
+{
+public:
+  template <typename Next>
+  void operator()(Next& next, const uint8_t *buffer, size_t buffer_size) const
+  {
+    assert(buffer);
+
+    ControllerReport report;
+    if (!DecodeControllerReport(buffer, buffer_size, &report))
+    {
+      IncrementCounter(Counter::PACKETS_REJECTED);
+      XBOX_TRACE1(report_rejected, buffer_size);
+      return;
+    }
+
+    XBOX_TRACE5(
+        report_decoded,
+        report.left_stick_x,
+        report.left_stick_y,
+        report.right_stick_x,
+        report.right_stick_y,
+        GetButtonMask(report));
+    next(report);
+  }
+};
+
+// Terminal stage that hands decoded reports to a pan/tilt mapper owned
+// elsewhere.
+template <typename Mapper>
+class PanTiltMapperSink
+{
+public:
+  PanTiltMapperSink() : mapper_{nullptr} {}
+  explicit PanTiltMapperSink(Mapper *mapper) : mapper_{mapper} {}
+
+  void operator()(const ControllerReport &report) const
+  {
+    assert(mapper_);
+    mapper_->ProcessReport(report);
+  }
+
+private:
+  Mapper *mapper_;
+};
+
+}  // namespace xbox
+
+#endif  // XBOXCONTROLLER_INPUTPIPELINE_H
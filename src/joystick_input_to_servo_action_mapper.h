@@ -1,46 +1,413 @@
 #ifndef XBOXCONTROLLER_JOYSTICKINPUTTOSERVOACTIONMAPPER_H
 #define XBOXCONTROLLER_JOYSTICKINPUTTOSERVOACTIONMAPPER_H
 
+#include <array>
+#include <cassert>
 #include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
 
 #include "dynamixel/AxA12.h"
+#include "src/axis_state_machine.h"
+#include "src/logger.h"
+#include "src/metrics.h"
+#include "src/servo_bus_budget.h"
+#include "src/shared_controller_state.h"
+#include "src/tracepoints.h"
 
 namespace xbox
 {
+namespace joystick_mapper_internal
+{
+constexpr uint16_t GOAL_POSITION_LIMIT_LOW = 400;
+constexpr uint16_t GOAL_POSITION_LIMIT_HIGH = 650;
+constexpr uint16_t GOAL_POSITION_NEUTRAL = 512;
+
+constexpr uint16_t LOW_MOVEMENT_SPEED = 0x00F;
+constexpr uint16_t MAX_MOVEMENT_SPEED = 0x0FF;
+constexpr std::array<uint16_t, 3> MOVEMENT_SPEEDS =
+{{
+  0,
+  LOW_MOVEMENT_SPEED,
+  MAX_MOVEMENT_SPEED,
+}};
+
+constexpr uint16_t MAX_TORQUE = 0x3FF;
+
+}  // namespace joystick_mapper_internal
+
+// Buckets a normalized joystick deflection into one of MOVEMENT_SPEEDS. Only
+// the magnitude is used; the sign is the caller's direction.
+inline uint16_t QuantizeJoystickSpeed(double value)
+{
+  using namespace joystick_mapper_internal;
+
+  assert(!MOVEMENT_SPEEDS.empty());
+  double magnitude = std::abs(value);
+  size_t index = (magnitude >= 1)
+      ? MOVEMENT_SPEEDS.size() - 1
+      : magnitude * MOVEMENT_SPEEDS.size();
+
+  assert(index < MOVEMENT_SPEEDS.size());
+  return MOVEMENT_SPEEDS[index];
+}
+
+// The axis command for a deflection whose speed bucket is |speed|, one of
+// MOVEMENT_SPEEDS.
+inline AxisCommand GetAxisCommand(uint16_t speed, bool positive_direction)
+{
+  using namespace joystick_mapper_internal;
+
+  static_assert(MOVEMENT_SPEEDS.size() == 3, "Axis commands assume stop, slow and fast");
+  if (speed == 0)
+  {
+    return AxisCommand::STOP;
+  }
+
+  bool fast = speed == MAX_MOVEMENT_SPEED;
+  if (positive_direction)
+  {
+    return fast ? AxisCommand::POSITIVE_FAST : AxisCommand::POSITIVE_SLOW;
+  }
+  return fast ? AxisCommand::NEGATIVE_FAST : AxisCommand::NEGATIVE_SLOW;
+}
+
+// Writes the travel limits and full torque shared by every pan/tilt servo.
+// Through a ScheduledServo, values the servo already holds are not rewritten.
+template <typename Servo>
+bool ConfigurePanTiltServoLimits(Servo *servo)
+{
+  using namespace joystick_mapper_internal;
+
+  assert(servo);
+
+  if (!servo->SetClockWiseAngleLimit(GOAL_POSITION_LIMIT_LOW))
+  {
+    std::cerr << "Failed to set servo clockwise angle limit: 0x"
+              << std::hex << GOAL_POSITION_LIMIT_LOW << std::dec << std::endl;
+    return false;
+  }
 
-class JoystickInputToServoActionMapper
+  if (!servo->SetCounterClockWiseAngleLimit(GOAL_POSITION_LIMIT_HIGH))
+  {
+    std::cerr << "Failed to set servo counter clockwise angle limit: 0x"
+              << std::hex << GOAL_POSITION_LIMIT_HIGH << std::dec << std::endl;
+    return false;
+  }
+
+  if (!servo->SetTorqueLimit(MAX_TORQUE))
+  {
+    std::cerr << "Failed to initialize servo with max torque" << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+// Writes the joint-mode configuration shared by every pan/tilt servo: neutral
+// goal, then ConfigurePanTiltServoLimits().
+template <typename Servo>
+bool ConfigurePanTiltServo(Servo *servo)
+{
+  using namespace joystick_mapper_internal;
+
+  assert(servo);
+
+  if (!servo->SetGoalPosition(GOAL_POSITION_NEUTRAL))
+  {
+    std::cerr << "Failed to initialize AxA12 to neutral position" << std::endl;
+    return false;
+  }
+
+  return ConfigurePanTiltServoLimits(servo);
+}
+
+// Maps a normalized joystick axis onto motion commands for a single servo.
+//
+// Each input is quantized to an AxisCommand and looked up in the axis
+// transition table (see axis_state_machine.h), which lists the registers that
+// actually change; only those are written.
+//
+// |Servo| is the concrete servo type the mapper drives. Production code uses
+// dynamixel::AxA12; anything exposing the same setters (e.g. a fake servo in a
+// benchmark) can be substituted without virtual dispatch on the write path.
+template <typename Servo>
+class BasicJoystickInputToServoActionMapper
 {
 public:
-  static bool Create(dynamixel::AxA12 *servo, JoystickInputToServoActionMapper *out_mapper);
+  static bool Create(
+      Servo *servo,
+      ServoBusBudget *bus_budget,
+      BasicJoystickInputToServoActionMapper *out_mapper);
+  // Like Create(), but leaves the servo where it is instead of homing it, for
+  // a restart that saved GetCommandState() as |last_state|. The registers are
+  // treated as unknown, so the first input rewrites everything it needs.
+  static bool Resume(
+      Servo *servo,
+      ServoBusBudget *bus_budget,
+      const ServoCommandState &last_state,
+      BasicJoystickInputToServoActionMapper *out_mapper);
 
 public:
-  JoystickInputToServoActionMapper();
-  JoystickInputToServoActionMapper(
-      dynamixel::AxA12 *servo,
+  BasicJoystickInputToServoActionMapper();
+  BasicJoystickInputToServoActionMapper(
+      Servo *servo,
+      ServoRateLimiter rate_limiter,
       bool inverted=false);
-  JoystickInputToServoActionMapper(JoystickInputToServoActionMapper &&other);
-  JoystickInputToServoActionMapper& operator=(JoystickInputToServoActionMapper &&other);
+  BasicJoystickInputToServoActionMapper(BasicJoystickInputToServoActionMapper &&other);
+  BasicJoystickInputToServoActionMapper& operator=(BasicJoystickInputToServoActionMapper &&other);
   bool ProcessInput(double value);
+  ServoCommandState GetCommandState() const;
+  // Forgets what the registers hold, after something else has written them.
+  // The next input rewrites every register it depends on.
+  void InvalidateCommandState();
 
 private:
-  bool StopServoMovement();
-  void StealResources(JoystickInputToServoActionMapper *other);
+  bool ApplyTransition(AxisTransition transition, uint16_t speed, uint16_t goal_position);
+  void StealResources(BasicJoystickInputToServoActionMapper *other);
 
 private:
-  JoystickInputToServoActionMapper(const JoystickInputToServoActionMapper &other) = delete;
-  JoystickInputToServoActionMapper& operator=(
-      const JoystickInputToServoActionMapper &other) = delete;
+  BasicJoystickInputToServoActionMapper(
+      const BasicJoystickInputToServoActionMapper &other) = delete;
+  BasicJoystickInputToServoActionMapper& operator=(
+      const BasicJoystickInputToServoActionMapper &other) = delete;
 
 private:
   bool initialized_;
-  dynamixel::AxA12 *servo_;
+  Servo *servo_;
   bool inverted_;
-  std::chrono::steady_clock::time_point lockout_timepoint_;
-  size_t movement_speed_;
-  bool is_positive_movement_direction_;
-  uint16_t stopped_position_;
+  ServoRateLimiter rate_limiter_;
+  AxisState state_;
+  // Last values written to the registers.
+  uint16_t moving_speed_;
+  uint16_t goal_position_;
 };
 
+using JoystickInputToServoActionMapper =
+    BasicJoystickInputToServoActionMapper<dynamixel::AxA12>;
+
+template <typename Servo>
+bool BasicJoystickInputToServoActionMapper<Servo>::Create(
+    Servo *servo,
+    ServoBusBudget *bus_budget,
+    BasicJoystickInputToServoActionMapper *out_mapper)
+{
+  assert(servo);
+  assert(bus_budget);
+  assert(out_mapper);
+
+  if (!ConfigurePanTiltServo(servo))
+  {
+    return false;
+  }
+
+  *out_mapper = BasicJoystickInputToServoActionMapper{servo, ServoRateLimiter{bus_budget}};
+  return true;
+}
+
+template <typename Servo>
+bool BasicJoystickInputToServoActionMapper<Servo>::Resume(
+    Servo *servo,
+    ServoBusBudget *bus_budget,
+    const ServoCommandState &last_state,
+    BasicJoystickInputToServoActionMapper *out_mapper)
+{
+  assert(servo);
+  assert(bus_budget);
+  assert(out_mapper);
+
+  if (!ConfigurePanTiltServoLimits(servo))
+  {
+    return false;
+  }
+
+  BasicJoystickInputToServoActionMapper mapper{servo, ServoRateLimiter{bus_budget}};
+  mapper.state_ = AxisState::UNKNOWN;
+  mapper.moving_speed_ = last_state.moving_speed;
+  mapper.goal_position_ = last_state.goal_position;
+  *out_mapper = std::move(mapper);
+  return true;
+}
+
+template <typename Servo>
+BasicJoystickInputToServoActionMapper<Servo>::BasicJoystickInputToServoActionMapper()
+  : initialized_{false} {}
+
+template <typename Servo>
+BasicJoystickInputToServoActionMapper<Servo>::BasicJoystickInputToServoActionMapper(
+    Servo *servo,
+    ServoRateLimiter rate_limiter,
+    bool inverted)
+  : initialized_{true},
+    servo_{servo},
+    inverted_{inverted},
+    rate_limiter_{rate_limiter},
+    state_{AxisState::STOPPED},
+    moving_speed_{0},
+    goal_position_{joystick_mapper_internal::GOAL_POSITION_NEUTRAL} {}
+
+template <typename Servo>
+BasicJoystickInputToServoActionMapper<Servo>::BasicJoystickInputToServoActionMapper(
+    BasicJoystickInputToServoActionMapper &&other)
+{
+  StealResources(&other);
+}
+
+template <typename Servo>
+BasicJoystickInputToServoActionMapper<Servo>&
+BasicJoystickInputToServoActionMapper<Servo>::operator=(
+    BasicJoystickInputToServoActionMapper &&other)
+{
+  if (this != &other)
+  {
+    StealResources(&other);
+  }
+  return *this;
+}
+
+template <typename Servo>
+bool BasicJoystickInputToServoActionMapper<Servo>::ProcessInput(double value)
+{
+  using namespace joystick_mapper_internal;
+
+  assert(initialized_);
+
+  uint16_t target_speed = QuantizeJoystickSpeed(value);
+  XBOX_TRACE4(
+      mapper_input,
+      servo_,
+      static_cast<int32_t>(value * 1000),
+      target_speed,
+      value > 0);
+
+  AxisCommand command = GetAxisCommand(target_speed, value > 0);
+  AxisTransition transition = GetAxisTransition(state_, command);
+  if (transition.writes == 0)
+  {
+    state_ = transition.next_state;
+    return true;
+  }
+
+  size_t planned_writes = CountAxisWrites(transition.writes);
+  if (command == AxisCommand::STOP)
+  {
+    // Stops always go out immediately; the bucket absorbs the debt.
+    rate_limiter_.ForceAcquire(std::chrono::steady_clock::now(), planned_writes);
+    XBOX_TRACE2(mapper_stop, servo_, moving_speed_);
+  }
+  else if (!rate_limiter_.TryAcquire(std::chrono::steady_clock::now(), planned_writes))
+  {
+    IncrementCounter(Counter::MAPPER_RATE_LIMITED);
+    XBOX_TRACE2(mapper_rate_limited, servo_, planned_writes);
+    return true;
+  }
+
+  uint16_t target_position = (value > 0) ? GOAL_POSITION_LIMIT_HIGH : GOAL_POSITION_LIMIT_LOW;
+  if (!ApplyTransition(transition, target_speed, target_position))
+  {
+    XBOX_LOG(LogLevel::ERROR, "Failed to apply servo transition. Value=%f", value);
+    return false;
+  }
+
+  return true;
+}
+
+template <typename Servo>
+ServoCommandState BasicJoystickInputToServoActionMapper<Servo>::GetCommandState() const
+{
+  using namespace joystick_mapper_internal;
+
+  assert(initialized_);
+
+  bool moving = IsAxisMoving(state_);
+  ServoCommandState state = {};
+  state.moving_speed = moving ? moving_speed_ : 0;
+  state.goal_position = goal_position_;
+  state.torque_enabled = moving;
+  state.positive_direction = goal_position_ == GOAL_POSITION_LIMIT_HIGH;
+  return state;
+}
+
+template <typename Servo>
+void BasicJoystickInputToServoActionMapper<Servo>::InvalidateCommandState()
+{
+  assert(initialized_);
+  state_ = AxisState::UNKNOWN;
+}
+
+template <typename Servo>
+bool BasicJoystickInputToServoActionMapper<Servo>::ApplyTransition(
+    AxisTransition transition,
+    uint16_t speed,
+    uint16_t goal_position)
+{
+  XBOX_LOG_EVERY(
+      LogLevel::DEBUG,
+      100,
+      "JoystickInputToServoActionMapper::ApplyTransition() -- state=%u, next_state=%u, "
+      "writes=0x%x",
+      static_cast<unsigned int>(state_),
+      static_cast<unsigned int>(transition.next_state),
+      transition.writes);
+
+  // Until every write lands, the registers are a mix of old and new values.
+  state_ = AxisState::UNKNOWN;
+
+  if ((transition.writes & AXIS_WRITE_MOVING_SPEED) != 0)
+  {
+    if (!servo_->SetMovingSpeed(speed))
+    {
+      XBOX_LOG(LogLevel::ERROR, "Failed to set movement speed: %u", speed);
+      return false;
+    }
+    moving_speed_ = speed;
+  }
+
+  if ((transition.writes & AXIS_WRITE_GOAL_POSITION) != 0)
+  {
+    if (!servo_->SetGoalPosition(goal_position))
+    {
+      XBOX_LOG(LogLevel::ERROR, "Failed to set goal position: 0x%x", goal_position);
+      return false;
+    }
+    goal_position_ = goal_position;
+  }
+
+  if ((transition.writes & AXIS_WRITE_TORQUE_ENABLE) != 0 && !servo_->SetTorqueEnabled(true))
+  {
+    XBOX_LOG(LogLevel::ERROR, "Failed to re-enable torque");
+    return false;
+  }
+
+  if ((transition.writes & AXIS_WRITE_TORQUE_DISABLE) != 0 && !servo_->SetTorqueEnabled(false))
+  {
+    XBOX_LOG(LogLevel::ERROR, "Failed to disable torque in order to stop motion");
+    return false;
+  }
+
+  state_ = transition.next_state;
+  return true;
+}
+
+template <typename Servo>
+void BasicJoystickInputToServoActionMapper<Servo>::StealResources(
+    BasicJoystickInputToServoActionMapper *other)
+{
+  assert(other);
+
+  initialized_ = other->initialized_;
+  other->initialized_ = false;
+  servo_ = other->servo_;
+  other->servo_ = nullptr;
+  inverted_ = other->inverted_;
+  rate_limiter_ = other->rate_limiter_;
+  state_ = other->state_;
+  other->state_ = AxisState::STOPPED;
+  moving_speed_ = other->moving_speed_;
+  goal_position_ = other->goal_position_;
+}
+
 }  // namespace xbox
 
 #endif  // XBOXCONTROLLER_JOYSTICKINPUTTOSERVOACTIONMAPPER_H
@@ -0,0 +1,341 @@
+#include "src/logger.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <array>
+#include <cassert>
+#include <iostream>
+#include <thread>
+
+namespace
+{
+using xbox::LOG_MESSAGE_SIZE;
+using xbox::LOG_RING_CAPACITY;
+using xbox::LogLevel;
+using xbox::LogSite;
+
+static_assert((LOG_RING_CAPACITY & (LOG_RING_CAPACITY - 1)) == 0,
+              "Log ring capacity must be a power of two");
+
+constexpr std::chrono::milliseconds DRAIN_INTERVAL{50};
+constexpr size_t DRAIN_BUFFER_SIZE = 64 * 1024;
+
+struct LogRecord
+{
+  int64_t timestamp_ns;
+  const LogSite *site;
+  uint32_t suppressed;
+  LogLevel level;
+  char message[LOG_MESSAGE_SIZE];
+};
+
+struct LogSlot
+{
+  std::atomic<uint64_t> sequence;
+  LogRecord record;
+};
+
+// Bounded multi-producer, single-consumer ring. Each slot carries a sequence
+// number so producers claim slots with a single CAS and the consumer never
+// contends with them.
+class LogRing
+{
+public:
+  LogRing() : enqueue_position_{0}, dequeue_position_{0}
+  {
+    for (size_t i = 0; i < LOG_RING_CAPACITY; ++i)
+    {
+      slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  LogRecord* BeginPush(uint64_t *out_position)
+  {
+    uint64_t position = enqueue_position_.load(std::memory_order_relaxed);
+    while (true)
+    {
+      LogSlot &slot = slots_[position & (LOG_RING_CAPACITY - 1)];
+      uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+      int64_t difference = static_cast<int64_t>(sequence - position);
+
+      if (difference == 0)
+      {
+        if (enqueue_position_.compare_exchange_weak(
+                position,
+                position + 1,
+                std::memory_order_relaxed))
+        {
+          *out_position = position;
+          return &slot.record;
+        }
+      }
+      else if (difference < 0)
+      {
+        return nullptr;
+      }
+      else
+      {
+        position = enqueue_position_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  void EndPush(uint64_t position)
+  {
+    slots_[position & (LOG_RING_CAPACITY - 1)].sequence.store(
+        position + 1,
+        std::memory_order_release);
+  }
+
+  bool Pop(LogRecord *out_record)
+  {
+    LogSlot &slot = slots_[dequeue_position_ & (LOG_RING_CAPACITY - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != dequeue_position_ + 1)
+    {
+      return false;
+    }
+
+    *out_record = slot.record;
+    slot.sequence.store(dequeue_position_ + LOG_RING_CAPACITY, std::memory_order_release);
+    ++dequeue_position_;
+    return true;
+  }
+
+private:
+  std::array<LogSlot, LOG_RING_CAPACITY> slots_;
+  alignas(64) std::atomic<uint64_t> enqueue_position_;
+  alignas(64) uint64_t dequeue_position_;
+};
+
+LogRing log_ring;
+std::atomic<uint8_t> minimum_log_level{static_cast<uint8_t>(LogLevel::INFO)};
+std::atomic<uint64_t> dropped_log_records{0};
+std::atomic<bool> drain_thread_running{false};
+std::thread drain_thread;
+
+int64_t NowNanoseconds()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+char LevelToChar(LogLevel level)
+{
+  switch (level)
+  {
+    case LogLevel::DEBUG:
+      return 'D';
+    case LogLevel::INFO:
+      return 'I';
+    case LogLevel::WARNING:
+      return 'W';
+    case LogLevel::ERROR:
+      return 'E';
+  }
+  return '?';
+}
+
+void WriteFully(const char *buffer, size_t length)
+{
+  while (length > 0)
+  {
+    ssize_t written = write(STDERR_FILENO, buffer, length);
+    if (written <= 0)
+    {
+      return;
+    }
+    buffer += written;
+    length -= written;
+  }
+}
+
+void DrainRing(std::array<char, DRAIN_BUFFER_SIZE> *buffer)
+{
+  assert(buffer);
+
+  size_t used = 0;
+  LogRecord record;
+  uint64_t reported_drops = dropped_log_records.exchange(0, std::memory_order_relaxed);
+
+  if (reported_drops > 0)
+  {
+    used += snprintf(
+        buffer->data(),
+        buffer->size(),
+        "[W logger] dropped %llu log records (ring full)\n",
+        static_cast<unsigned long long>(reported_drops));
+  }
+
+  while (log_ring.Pop(&record))
+  {
+    // Worst case line: prefix + message + suppression suffix.
+    if (buffer->size() - used < LOG_MESSAGE_SIZE + 256)
+    {
+      WriteFully(buffer->data(), used);
+      used = 0;
+    }
+
+    const char *file = record.site->GetFile();
+    const char *basename = strrchr(file, '/');
+    int written = snprintf(
+        buffer->data() + used,
+        buffer->size() - used,
+        "[%c %lld.%06lld %s:%d] %s",
+        LevelToChar(record.level),
+        static_cast<long long>(record.timestamp_ns / 1000000000),
+        static_cast<long long>((record.timestamp_ns / 1000) % 1000000),
+        basename ? basename + 1 : file,
+        record.site->GetLine(),
+        record.message);
+    used += written;
+
+    if (record.suppressed > 0)
+    {
+      used += snprintf(
+          buffer->data() + used,
+          buffer->size() - used,
+          " (suppressed %u similar)",
+          record.suppressed);
+    }
+
+    buffer->at(used++) = '\n';
+  }
+
+  if (used > 0)
+  {
+    WriteFully(buffer->data(), used);
+  }
+}
+
+void RunDrainThread()
+{
+  std::array<char, DRAIN_BUFFER_SIZE> buffer;
+  while (drain_thread_running.load(std::memory_order_acquire))
+  {
+    DrainRing(&buffer);
+    std::this_thread::sleep_for(DRAIN_INTERVAL);
+  }
+
+  DrainRing(&buffer);
+}
+
+}  // namespace
+
+namespace xbox
+{
+
+LogSite::LogSite(const char *file, int line, std::chrono::milliseconds interval)
+  : file_{file},
+    line_{line},
+    interval_ns_{std::chrono::duration_cast<std::chrono::nanoseconds>(interval).count()},
+    next_admit_ns_{0},
+    suppressed_{0} {}
+
+bool LogSite::Admit(int64_t now_ns, uint32_t *out_suppressed)
+{
+  assert(out_suppressed);
+
+  int64_t next_admit_ns = next_admit_ns_.load(std::memory_order_relaxed);
+  if (now_ns < next_admit_ns ||
+      !next_admit_ns_.compare_exchange_strong(
+          next_admit_ns,
+          now_ns + interval_ns_,
+          std::memory_order_relaxed))
+  {
+    suppressed_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  *out_suppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+  return true;
+}
+
+const char* LogSite::GetFile() const
+{
+  return file_;
+}
+
+int LogSite::GetLine() const
+{
+  return line_;
+}
+
+bool StartAsyncLogger()
+{
+  if (drain_thread_running.exchange(true))
+  {
+    std::cerr << "Async logger already running" << std::endl;
+    return false;
+  }
+
+  drain_thread = std::thread{RunDrainThread};
+  return true;
+}
+
+void StopAsyncLogger()
+{
+  if (!drain_thread_running.exchange(false))
+  {
+    return;
+  }
+
+  drain_thread.join();
+}
+
+ScopedAsyncLogger::~ScopedAsyncLogger()
+{
+  StopAsyncLogger();
+}
+
+void SetMinimumLogLevel(LogLevel level)
+{
+  minimum_log_level.store(static_cast<uint8_t>(level), std::memory_order_relaxed);
+}
+
+bool IsLogLevelEnabled(LogLevel level)
+{
+  return static_cast<uint8_t>(level) >= minimum_log_level.load(std::memory_order_relaxed);
+}
+
+uint64_t GetDroppedLogRecordCount()
+{
+  return dropped_log_records.load(std::memory_order_relaxed);
+}
+
+void LogToRing(LogLevel level, LogSite *site, const char *format, ...)
+{
+  assert(site);
+  assert(format);
+
+  int64_t now_ns = NowNanoseconds();
+  uint32_t suppressed;
+  if (!site->Admit(now_ns, &suppressed))
+  {
+    return;
+  }
+
+  uint64_t position;
+  LogRecord *record = log_ring.BeginPush(&position);
+  if (!record)
+  {
+    dropped_log_records.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  record->timestamp_ns = now_ns;
+  record->site = site;
+  record->suppressed = suppressed;
+  record->level = level;
+
+  va_list args;
+  va_start(args, format);
+  vsnprintf(record->message, sizeof(record->message), format, args);
+  va_end(args);
+
+  log_ring.EndPush(position);
+}
+
+}  // namespace xbox
@@ -0,0 +1,99 @@
+#ifndef XBOXCONTROLLER_LOGGER_H
+#define XBOXCONTROLLER_LOGGER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace xbox
+{
+
+// Asynchronous, rate-limited logging for the control path.
+//
+// XBOX_LOG() formats into a fixed-size record and pushes it onto a lock-free
+// ring. A background thread started by StartAsyncLogger() drains the ring and
+// writes batches to stderr; the caller never blocks on I/O and never flushes.
+// Each call site carries its own rate limit. Messages arriving inside a
+// site's interval are counted and reported with the next admitted message.
+// If the ring is full the record is dropped and counted instead.
+
+enum class LogLevel : uint8_t
+{
+  DEBUG,
+  INFO,
+  WARNING,
+  ERROR,
+};
+
+constexpr size_t LOG_MESSAGE_SIZE = 200;
+// Records queued between two drains; more are dropped.
+constexpr size_t LOG_RING_CAPACITY = 1024;
+constexpr std::chrono::milliseconds DEFAULT_LOG_SITE_INTERVAL{1000};
+
+class LogSite
+{
+public:
+  LogSite(const char *file, int line, std::chrono::milliseconds interval);
+
+  // Returns true if a message from this site may be emitted at |now_ns|.
+  // On success |out_suppressed| receives the number of messages dropped
+  // since the last admitted one.
+  bool Admit(int64_t now_ns, uint32_t *out_suppressed);
+  const char* GetFile() const;
+  int GetLine() const;
+
+private:
+  LogSite(const LogSite &other) = delete;
+  LogSite& operator=(const LogSite &other) = delete;
+
+private:
+  const char *file_;
+  int line_;
+  int64_t interval_ns_;
+  std::atomic<int64_t> next_admit_ns_;
+  std::atomic<uint32_t> suppressed_;
+};
+
+bool StartAsyncLogger();
+void StopAsyncLogger();
+
+// Calls StopAsyncLogger() when it goes out of scope, so every way out of
+// main() writes the queued records and joins the drain thread. A drain
+// thread still running when statics are destroyed aborts the process.
+class ScopedAsyncLogger
+{
+public:
+  ScopedAsyncLogger() = default;
+  ~ScopedAsyncLogger();
+
+private:
+  ScopedAsyncLogger(const ScopedAsyncLogger &other) = delete;
+  ScopedAsyncLogger& operator=(const ScopedAsyncLogger &other) = delete;
+};
+
+void SetMinimumLogLevel(LogLevel level);
+bool IsLogLevelEnabled(LogLevel level);
+
+// Number of records lost because the ring was full.
+uint64_t GetDroppedLogRecordCount();
+
+void LogToRing(LogLevel level, LogSite *site, const char *format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+}  // namespace xbox
+
+#define XBOX_LOG_EVERY(level, interval_ms, ...)                                   \
+  do                                                                              \
+  {                                                                               \
+    if (::xbox::IsLogLevelEnabled(level))                                         \
+    {                                                                             \
+      static ::xbox::LogSite xbox_log_site{                                       \
+          __FILE__, __LINE__, std::chrono::milliseconds{interval_ms}};            \
+      ::xbox::LogToRing(level, &xbox_log_site, __VA_ARGS__);                      \
+    }                                                                             \
+  } while (0)
+
+#define XBOX_LOG(level, ...)                                                      \
+  XBOX_LOG_EVERY(level, ::xbox::DEFAULT_LOG_SITE_INTERVAL.count(), __VA_ARGS__)
+
+#endif  // XBOXCONTROLLER_LOGGER_H
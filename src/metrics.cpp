@@ -0,0 +1,133 @@
+#include "src/metrics.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+
+namespace
+{
+using xbox::COUNTER_COUNT;
+using xbox::GAUGE_COUNT;
+using xbox::MAX_METRIC_SHARDS;
+using xbox::MetricCell;
+using xbox::MetricShard;
+
+const std::array<const char*, COUNTER_COUNT> COUNTER_NAMES =
+{{
+  "frames_received",
+  "frames_dropped",
+  "frames_filtered",
+  "packets_rejected",
+  "teleop_datagrams_received",
+  "teleop_datagrams_rejected",
+  "teleop_datagrams_out_of_order",
+  "teleop_datagrams_wrong_session",
+  "teleop_datagrams_stale",
+  "teleop_local_frames_overridden",
+  "reports_processed",
+  "mapper_rate_limited",
+  "wheel_soft_limit_stops",
+  "external_commands_received",
+  "external_commands_expired",
+  "joystick_overrides",
+  "servo_writes",
+  "servo_write_errors",
+  "servo_writes_skipped",
+  "servo_status_timeouts",
+  "servo_writes_resent",
+  "servo_commands_replaced",
+  "servo_commands_expired",
+}};
+
+const std::array<const char*, GAUGE_COUNT> GAUGE_NAMES =
+{{
+  "last_report_timestamp_ns",
+  "teleop_latency_ns",
+}};
+
+std::array<MetricShard, MAX_METRIC_SHARDS> metric_shards;
+MetricShard overflow_shard{{}, true};
+std::atomic<size_t> next_metric_shard{0};
+std::array<MetricCell, GAUGE_COUNT> gauges;
+
+const std::chrono::steady_clock::time_point process_start = std::chrono::steady_clock::now();
+
+}  // namespace
+
+namespace xbox
+{
+
+MetricShard* AcquireMetricShard()
+{
+  size_t index = next_metric_shard.fetch_add(1, std::memory_order_relaxed);
+  if (index >= metric_shards.size())
+  {
+    return &overflow_shard;
+  }
+
+  return &metric_shards[index];
+}
+
+void SetGauge(Gauge gauge, int64_t value)
+{
+  gauges[static_cast<size_t>(gauge)].value.store(value, std::memory_order_relaxed);
+}
+
+int64_t ReadCounter(Counter counter)
+{
+  size_t index = static_cast<size_t>(counter);
+  assert(index < COUNTER_COUNT);
+
+  int64_t total = overflow_shard.counters[index].value.load(std::memory_order_relaxed);
+  for (const MetricShard &shard : metric_shards)
+  {
+    total += shard.counters[index].value.load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+int64_t ReadGauge(Gauge gauge)
+{
+  return gauges[static_cast<size_t>(gauge)].value.load(std::memory_order_relaxed);
+}
+
+size_t FormatMetricsSnapshot(char *buffer, size_t buffer_size)
+{
+  assert(buffer);
+
+  size_t used = 0;
+  auto append = [&] (const char *name, long long value) {
+    if (used >= buffer_size)
+    {
+      return;
+    }
+
+    int written = snprintf(buffer + used, buffer_size - used, "%s %lld\n", name, value);
+    if (written > 0)
+    {
+      used = std::min(buffer_size - 1, used + static_cast<size_t>(written));
+    }
+  };
+
+  append(
+      "uptime_ms",
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::steady_clock::now() - process_start).count());
+
+  for (size_t i = 0; i < COUNTER_COUNT; ++i)
+  {
+    append(COUNTER_NAMES[i], ReadCounter(static_cast<Counter>(i)));
+  }
+
+  for (size_t i = 0; i < GAUGE_COUNT; ++i)
+  {
+    append(GAUGE_NAMES[i], ReadGauge(static_cast<Gauge>(i)));
+  }
+
+  return used;
+}
+
+}  // namespace xbox
@@ -0,0 +1,112 @@
+#ifndef XBOXCONTROLLER_METRICS_H
+#define XBOXCONTROLLER_METRICS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace xbox
+{
+
+// Process-wide runtime counters and gauges.
+//
+// Counters are sharded per thread and every cell sits on its own cache line,
+// so an increment is an uncontended relaxed load/store on memory no other
+// thread writes. Readers sum the shards; they never take a lock and never
+// stall a writer.
+
+enum class Counter : size_t
+{
+  FRAMES_RECEIVED,
+  FRAMES_DROPPED,
+  // Frames from adapters outside the channel's HciAdapterMask.
+  FRAMES_FILTERED,
+  PACKETS_REJECTED,
+  TELEOP_DATAGRAMS_RECEIVED,
+  // Malformed or of another protocol version.
+  TELEOP_DATAGRAMS_REJECTED,
+  TELEOP_DATAGRAMS_OUT_OF_ORDER,
+  // From an older session, or a newer one while the current one is fresh.
+  TELEOP_DATAGRAMS_WRONG_SESSION,
+  TELEOP_DATAGRAMS_STALE,
+  // Local controller frames dropped while a remote station had control.
+  TELEOP_LOCAL_FRAMES_OVERRIDDEN,
+  REPORTS_PROCESSED,
+  MAPPER_RATE_LIMITED,
+  // Wheel mode moves stopped because the position model reached a limit.
+  WHEEL_SOFT_LIMIT_STOPS,
+  EXTERNAL_COMMANDS_RECEIVED,
+  // The external tracker went quiet while it owned the servos.
+  EXTERNAL_COMMANDS_EXPIRED,
+  JOYSTICK_OVERRIDES,
+  SERVO_WRITES,
+  SERVO_WRITE_ERRORS,
+  SERVO_WRITES_SKIPPED,
+  SERVO_STATUS_TIMEOUTS,
+  SERVO_WRITES_RESENT,
+  SERVO_COMMANDS_REPLACED,
+  SERVO_COMMANDS_EXPIRED,
+  COUNT,
+};
+
+enum class Gauge : size_t
+{
+  LAST_REPORT_TIMESTAMP_NS,
+  // One-way latency of the last accepted teleop datagram.
+  TELEOP_LATENCY_NS,
+  COUNT,
+};
+
+constexpr size_t COUNTER_COUNT = static_cast<size_t>(Counter::COUNT);
+constexpr size_t GAUGE_COUNT = static_cast<size_t>(Gauge::COUNT);
+constexpr size_t MAX_METRIC_SHARDS = 16;
+constexpr size_t CACHE_LINE_SIZE = 64;
+
+struct alignas(CACHE_LINE_SIZE) MetricCell
+{
+  std::atomic<int64_t> value;
+};
+
+struct MetricShard
+{
+  MetricCell counters[COUNTER_COUNT];
+  // Set on the overflow shard used once every per-thread shard is taken.
+  // Writers to a shared shard must use atomic read-modify-write.
+  bool shared;
+};
+
+// Claims a shard for the calling thread.
+MetricShard* AcquireMetricShard();
+
+inline MetricShard* GetThreadMetricShard()
+{
+  thread_local MetricShard *shard = AcquireMetricShard();
+  return shard;
+}
+
+inline void IncrementCounter(Counter counter, int64_t delta = 1)
+{
+  MetricShard *shard = GetThreadMetricShard();
+  std::atomic<int64_t> &value = shard->counters[static_cast<size_t>(counter)].value;
+
+  if (shard->shared)
+  {
+    value.fetch_add(delta, std::memory_order_relaxed);
+    return;
+  }
+
+  value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+void SetGauge(Gauge gauge, int64_t value);
+
+int64_t ReadCounter(Counter counter);
+int64_t ReadGauge(Gauge gauge);
+
+// Writes a "name value" line per metric into |buffer|. Returns the number of
+// bytes written, truncating if |buffer_size| is too small.
+size_t FormatMetricsSnapshot(char *buffer, size_t buffer_size);
+
+}  // namespace xbox
+
+#endif  // XBOXCONTROLLER_METRICS_H
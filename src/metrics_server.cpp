@@ -0,0 +1,181 @@
+#include "src/metrics_server.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <iostream>
+
+#include "src/logger.h"
+#include "src/metrics.h"
+
+namespace
+{
+constexpr int INVALID_FD = -1;
+constexpr int LISTEN_BACKLOG = 4;
+constexpr size_t SNAPSHOT_BUFFER_SIZE = 4096;
+}  // namespace
+
+namespace xbox
+{
+
+bool MetricsServer::Create(const std::string &socket_path, MetricsServer *out_server)
+{
+  assert(out_server);
+
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+
+  if (socket_path.size() >= sizeof(address.sun_path))
+  {
+    std::cerr << "Metrics socket path too long: " << socket_path << std::endl;
+    return false;
+  }
+  strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+
+  // The default lives under /run, which is empty after every boot.
+  size_t separator = socket_path.rfind('/');
+  if (separator != std::string::npos && separator > 0)
+  {
+    std::string directory = socket_path.substr(0, separator);
+    if (mkdir(directory.c_str(), 0755) < 0 && errno != EEXIST)
+    {
+      std::cerr << "Failed to create metrics socket directory " << directory << ". Error: "
+                << strerror(errno) << std::endl;
+      return false;
+    }
+  }
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+  {
+    std::cerr << "Failed to open metrics socket. Error: " << strerror(errno) << std::endl;
+    return false;
+  }
+
+  // Remove a stale socket left behind by a previous run, but nothing else
+  // that happens to live at |socket_path|.
+  struct stat existing;
+  if (lstat(socket_path.c_str(), &existing) == 0 && S_ISSOCK(existing.st_mode))
+  {
+    unlink(socket_path.c_str());
+  }
+
+  if (bind(fd, (struct sockaddr *)&address, sizeof(address)) < 0)
+  {
+    std::cerr << "Failed to bind metrics socket " << socket_path << ". Error: "
+              << strerror(errno) << std::endl;
+    close(fd);
+    return false;
+  }
+
+  if (listen(fd, LISTEN_BACKLOG) < 0)
+  {
+    std::cerr << "Failed to listen on metrics socket. Error: " << strerror(errno) << std::endl;
+    close(fd);
+    unlink(socket_path.c_str());
+    return false;
+  }
+
+  *out_server = MetricsServer{fd, socket_path};
+  return true;
+}
+
+MetricsServer::MetricsServer() : initialized_{false}, fd_{INVALID_FD} {}
+
+MetricsServer::MetricsServer(int fd, std::string socket_path)
+  : initialized_{true},
+    fd_{fd},
+    socket_path_{std::move(socket_path)} {}
+
+MetricsServer::MetricsServer(MetricsServer &&other)
+  : initialized_{false},
+    fd_{INVALID_FD}
+{
+  StealResources(&other);
+}
+
+MetricsServer& MetricsServer::operator=(MetricsServer &&other)
+{
+  if (this != &other)
+  {
+    Close();
+    StealResources(&other);
+  }
+  return *this;
+}
+
+MetricsServer::~MetricsServer()
+{
+  Close();
+}
+
+int MetricsServer::GetFd() const
+{
+  assert(initialized_);
+  return fd_;
+}
+
+void MetricsServer::HandlePacket()
+{
+  assert(initialized_);
+
+  char snapshot[SNAPSHOT_BUFFER_SIZE];
+  size_t snapshot_size = 0;
+
+  while (true)
+  {
+    int client_fd = accept4(fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (client_fd < 0)
+    {
+      if (errno != EAGAIN && errno != EWOULDBLOCK)
+      {
+        XBOX_LOG(LogLevel::WARNING, "Failed to accept metrics client: %s", strerror(errno));
+      }
+      return;
+    }
+
+    if (snapshot_size == 0)
+    {
+      snapshot_size = FormatMetricsSnapshot(snapshot, sizeof(snapshot));
+    }
+
+    if (send(client_fd, snapshot, snapshot_size, MSG_DONTWAIT | MSG_NOSIGNAL) < 0)
+    {
+      XBOX_LOG(LogLevel::WARNING, "Failed to send metrics snapshot: %s", strerror(errno));
+    }
+
+    close(client_fd);
+  }
+}
+
+void MetricsServer::Close()
+{
+  if (!initialized_)
+  {
+    return;
+  }
+
+  close(fd_);
+  unlink(socket_path_.c_str());
+  fd_ = INVALID_FD;
+  initialized_ = false;
+}
+
+void MetricsServer::StealResources(MetricsServer *other)
+{
+  assert(other);
+
+  initialized_ = other->initialized_;
+  other->initialized_ = false;
+  fd_ = other->fd_;
+  other->fd_ = INVALID_FD;
+  socket_path_ = std::move(other->socket_path_);
+}
+
+}  // namespace xbox
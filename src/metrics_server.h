@@ -0,0 +1,46 @@
+#ifndef XBOXCONTROLLER_METRICSSERVER_H
+#define XBOXCONTROLLER_METRICSSERVER_H
+
+#include <string>
+
+#include "src/event_handler.h"
+
+namespace xbox
+{
+
+// Serves a metrics snapshot to every client that connects to a Unix domain
+// stream socket, then closes the connection. All socket operations are
+// non-blocking, so a slow or stuck client can at worst get a truncated
+// snapshot; it can never hold up the event loop.
+class MetricsServer : public EventHandler
+{
+public:
+  // Creates the socket's directory if it is missing, but not its parents.
+  static bool Create(const std::string &socket_path, MetricsServer *out_server);
+
+public:
+  MetricsServer();
+  MetricsServer(int fd, std::string socket_path);
+  MetricsServer(MetricsServer &&other);
+  MetricsServer& operator=(MetricsServer &&other);
+  ~MetricsServer();
+  int GetFd() const override;
+  void HandlePacket() override;
+
+private:
+  void Close();
+  void StealResources(MetricsServer *other);
+
+private:
+  MetricsServer(const MetricsServer &other) = delete;
+  MetricsServer& operator=(const MetricsServer &other) = delete;
+
+private:
+  bool initialized_;
+  int fd_;
+  std::string socket_path_;
+};
+
+}  // namespace xbox
+
+#endif  // XBOXCONTROLLER_METRICSSERVER_H
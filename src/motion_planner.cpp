@@ -0,0 +1,151 @@
+#include "src/motion_planner.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace xbox
+{
+
+VelocityRampSegment::VelocityRampSegment()
+  : VelocityRampSegment{0, 0, 0, 0, 1} {}
+
+VelocityRampSegment::VelocityRampSegment(
+    double start_time,
+    double start_velocity,
+    double start_position,
+    double target_velocity,
+    double max_acceleration)
+  : start_time_{start_time},
+    start_velocity_{start_velocity},
+    start_position_{start_position},
+    target_velocity_{target_velocity}
+{
+  assert(max_acceleration > 0);
+
+  double velocity_change = target_velocity - start_velocity;
+  acceleration_ = std::copysign(max_acceleration, velocity_change);
+
+  double ramp_duration = std::abs(velocity_change) / max_acceleration;
+  ramp_end_time_ = start_time + ramp_duration;
+  ramp_end_position_ = start_position
+      + POSITION_UNITS_PER_SPEED_UNIT_SECOND
+          * 0.5 * (start_velocity + target_velocity) * ramp_duration;
+}
+
+AxisSetpoint VelocityRampSegment::Sample(double time) const
+{
+  if (time >= ramp_end_time_)
+  {
+    double cruise_duration = time - ramp_end_time_;
+    return AxisSetpoint{
+        target_velocity_,
+        ramp_end_position_
+            + POSITION_UNITS_PER_SPEED_UNIT_SECOND * target_velocity_ * cruise_duration};
+  }
+
+  double elapsed = std::max(time - start_time_, 0.0);
+  double velocity = start_velocity_ + acceleration_ * elapsed;
+  double position = start_position_
+      + POSITION_UNITS_PER_SPEED_UNIT_SECOND
+          * (start_velocity_ * elapsed + 0.5 * acceleration_ * elapsed * elapsed);
+  return AxisSetpoint{velocity, position};
+}
+
+double VelocityRampSegment::GetTargetVelocity() const
+{
+  return target_velocity_;
+}
+
+bool VelocityRampSegment::IsComplete(double time) const
+{
+  return time >= ramp_end_time_;
+}
+
+TrapezoidalAxisPlanner::TrapezoidalAxisPlanner()
+  : TrapezoidalAxisPlanner{AxisPlannerConfig{1, 0, 0, 0}} {}
+
+TrapezoidalAxisPlanner::TrapezoidalAxisPlanner(const AxisPlannerConfig &config)
+  : config_{config},
+    segment_{0, 0, config.initial_position, 0, config.max_acceleration},
+    requested_velocity_{0} {}
+
+void TrapezoidalAxisPlanner::SetTargetVelocity(double target_velocity, double now)
+{
+  if (target_velocity == requested_velocity_)
+  {
+    return;
+  }
+
+  requested_velocity_ = target_velocity;
+
+  AxisSetpoint current = segment_.Sample(now);
+  current.position = ClampPosition(current.position);
+
+  // Pushing further into a limit the axis already rests against is a no-op.
+  if ((target_velocity > 0 && current.position >= config_.position_limit_high) ||
+      (target_velocity < 0 && current.position <= config_.position_limit_low))
+  {
+    target_velocity = 0;
+  }
+
+  segment_ = VelocityRampSegment{
+      now,
+      current.velocity,
+      current.position,
+      target_velocity,
+      config_.max_acceleration};
+}
+
+AxisSetpoint TrapezoidalAxisPlanner::Update(double now)
+{
+  AxisSetpoint setpoint = segment_.Sample(now);
+
+  // Begin braking once the remaining travel towards the limit we are heading
+  // for is within stopping distance.
+  if (segment_.GetTargetVelocity() != 0 && setpoint.velocity != 0)
+  {
+    double remaining = (setpoint.velocity > 0)
+        ? config_.position_limit_high - setpoint.position
+        : setpoint.position - config_.position_limit_low;
+
+    if (remaining <= GetBrakingDistance(setpoint.velocity))
+    {
+      segment_ = VelocityRampSegment{
+          now,
+          setpoint.velocity,
+          setpoint.position,
+          0,
+          config_.max_acceleration};
+    }
+  }
+
+  setpoint.position = ClampPosition(setpoint.position);
+  return setpoint;
+}
+
+void TrapezoidalAxisPlanner::ResetPosition(double position, double now)
+{
+  AxisSetpoint current = segment_.Sample(now);
+  segment_ = VelocityRampSegment{
+      now,
+      current.velocity,
+      ClampPosition(position),
+      segment_.GetTargetVelocity(),
+      config_.max_acceleration};
+}
+
+double TrapezoidalAxisPlanner::ClampPosition(double position) const
+{
+  return std::min(
+      std::max(position, config_.position_limit_low),
+      config_.position_limit_high);
+}
+
+double TrapezoidalAxisPlanner::GetBrakingDistance(double velocity) const
+{
+  return POSITION_UNITS_PER_SPEED_UNIT_SECOND * velocity * velocity
+      / (2.0 * config_.max_acceleration);
+}
+
+}  // namespace xbox
@@ -0,0 +1,85 @@
+#ifndef XBOXCONTROLLER_MOTIONPLANNER_H
+#define XBOXCONTROLLER_MOTIONPLANNER_H
+
+namespace xbox
+{
+
+// Converts AX-12 moving speed units into goal position units per second:
+// 0.111 rpm per speed unit, 1024 position units per 300 degrees.
+constexpr double POSITION_UNITS_PER_SPEED_UNIT_SECOND = 0.111 * 6.0 * 1024.0 / 300.0;
+
+struct AxisSetpoint
+{
+  // Signed AX-12 moving speed; positive moves towards the high position limit.
+  double velocity;
+  // Estimated goal position units.
+  double position;
+};
+
+// One acceleration-limited move from the velocity at |start_time| to
+// |target_velocity|. Everything needed to sample it is computed once when the
+// segment is built, so sampling is a handful of multiplies.
+class VelocityRampSegment
+{
+public:
+  VelocityRampSegment();
+  VelocityRampSegment(
+      double start_time,
+      double start_velocity,
+      double start_position,
+      double target_velocity,
+      double max_acceleration);
+  AxisSetpoint Sample(double time) const;
+  double GetTargetVelocity() const;
+  bool IsComplete(double time) const;
+
+private:
+  double start_time_;
+  double start_velocity_;
+  double start_position_;
+  double target_velocity_;
+  double acceleration_;
+  double ramp_end_time_;
+  double ramp_end_position_;
+};
+
+struct AxisPlannerConfig
+{
+  // Speed units per second.
+  double max_acceleration;
+  double position_limit_low;
+  double position_limit_high;
+  double initial_position;
+};
+
+// Trapezoidal velocity planner for one servo axis.
+//
+// Stick intent sets a target velocity; the planner ramps to it at
+// |max_acceleration|, cruises, and starts braking early enough to come to rest
+// at a position limit instead of slamming into it. A new segment is built only
+// when the target actually changes or braking has to start.
+class TrapezoidalAxisPlanner
+{
+public:
+  TrapezoidalAxisPlanner();
+  explicit TrapezoidalAxisPlanner(const AxisPlannerConfig &config);
+  void SetTargetVelocity(double target_velocity, double now);
+  AxisSetpoint Update(double now);
+  // Moves the position estimate to a measured |position| at |now|, keeping
+  // the velocity profile.
+  void ResetPosition(double position, double now);
+
+private:
+  double GetBrakingDistance(double velocity) const;
+  double ClampPosition(double position) const;
+
+private:
+  AxisPlannerConfig config_;
+  VelocityRampSegment segment_;
+  // Target requested by the stick, which braking may be overriding.
+  double requested_velocity_;
+};
+
+}  // namespace xbox
+
+#endif  // XBOXCONTROLLER_MOTIONPLANNER_H
@@ -0,0 +1,487 @@
+#ifndef XBOXCONTROLLER_MOTIONSETPOINTSTREAMER_H
+#define XBOXCONTROLLER_MOTIONSETPOINTSTREAMER_H
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+
+#include "src/controller_report.h"
+#include "src/event_handler.h"
+#include "src/joystick_input_to_servo_action_mapper.h"
+#include "src/logger.h"
+#include "src/metrics.h"
+#include "src/motion_planner.h"
+#include "src/periodic_timer.h"
+#include "src/servo_bus_scheduler.h"
+#include "src/shared_controller_state.h"
+
+namespace xbox
+{
+
+// 50 Hz keeps two streaming axes well inside the AX-12 bus budget while still
+// resolving a 250 ms ramp into a dozen steps.
+constexpr std::chrono::milliseconds DEFAULT_CONTROL_PERIOD{20};
+
+// Speed units per second: rest to MAX_MOVEMENT_SPEED in about a quarter second.
+constexpr double DEFAULT_AXIS_MAX_ACCELERATION = 1000.0;
+
+// Control periods an axis at rest waits for its present position before it
+// parks at the profile's estimate instead.
+constexpr uint32_t MAX_REST_POSITION_WAIT_PERIODS = 3;
+
+// Drives the pan/tilt servos from trapezoidal motion profiles.
+//
+// Reports only move each axis' target velocity; the planner turns a target
+// change into a precomputed ramp segment. A timerfd registered on the event
+// loop samples both planners at the control rate, writes whichever speed or
+// goal registers changed and flushes the bus scheduler. A released stick
+// decelerates to rest and parks the goal rather than cutting torque.
+//
+// The profile's position is integrated from the commanded speed, but the
+// AX-12 does not follow speed steps instantly, so the estimate drifts from the
+// horn. Once an axis reaches rest its present position is read, the planner is
+// reseeded from it and the goal is parked there, so stopping never commands a
+// goal the horn is not at. If the read does not answer within
+// MAX_REST_POSITION_WAIT_PERIODS, the goal is parked at the estimate.
+template <typename Servo, typename Scheduler>
+class BasicMotionSetpointStreamer final : public EventHandler
+{
+public:
+  static bool Create(
+      Servo *tilt_servo,
+      Servo *pan_servo,
+      Scheduler *scheduler,
+      std::chrono::nanoseconds control_period,
+      double max_acceleration,
+      BasicMotionSetpointStreamer *out_streamer);
+
+public:
+  BasicMotionSetpointStreamer();
+  BasicMotionSetpointStreamer(
+      int timer_fd,
+      Scheduler *scheduler,
+      Servo *tilt_servo,
+      Servo *pan_servo,
+      const AxisPlannerConfig &planner_config);
+  BasicMotionSetpointStreamer(BasicMotionSetpointStreamer &&other);
+  BasicMotionSetpointStreamer& operator=(BasicMotionSetpointStreamer &&other);
+  ~BasicMotionSetpointStreamer();
+  int GetFd() const override;
+  void HandlePacket() override;
+  void ProcessReport(const ControllerReport &report);
+  ServoCommandState GetTiltCommandState() const;
+  ServoCommandState GetPanCommandState() const;
+  // Forgets what the registers hold, after writes were lost. The next tick
+  // rewrites whatever the profiles ask for.
+  void InvalidateCommandState();
+
+private:
+  struct AxisStream
+  {
+    Servo *servo;
+    TrapezoidalAxisPlanner planner;
+    // Last values written to the servo's registers, unless |known| is false.
+    uint16_t moving_speed;
+    uint16_t goal_position;
+    bool moving;
+    bool known;
+    // At rest and not yet parked, for |rest_wait_periods| so far.
+    bool awaiting_rest_position;
+    uint32_t rest_wait_periods;
+  };
+
+  enum Axis
+  {
+    TILT,
+    PAN,
+    AXIS_COUNT,
+  };
+
+  static double NowSeconds();
+  static void SetAxisIntent(AxisStream *axis, double value, double now);
+  static bool StreamAxis(AxisStream *axis, double now);
+  static ServoCommandState GetAxisCommandState(const AxisStream &axis);
+  void Close();
+  void StealResources(BasicMotionSetpointStreamer *other);
+
+private:
+  BasicMotionSetpointStreamer(const BasicMotionSetpointStreamer &other) = delete;
+  BasicMotionSetpointStreamer& operator=(const BasicMotionSetpointStreamer &other) = delete;
+
+private:
+  bool initialized_;
+  int timer_fd_;
+  Scheduler *scheduler_;
+  std::array<AxisStream, AXIS_COUNT> axes_;
+};
+
+using MotionSetpointStreamer = BasicMotionSetpointStreamer<ScheduledAxA12, ServoBusScheduler>;
+
+template <typename Servo, typename Scheduler>
+bool BasicMotionSetpointStreamer<Servo, Scheduler>::Create(
+    Servo *tilt_servo,
+    Servo *pan_servo,
+    Scheduler *scheduler,
+    std::chrono::nanoseconds control_period,
+    double max_acceleration,
+    BasicMotionSetpointStreamer *out_streamer)
+{
+  using namespace joystick_mapper_internal;
+
+  assert(tilt_servo);
+  assert(pan_servo);
+  assert(scheduler);
+  assert(out_streamer);
+
+  for (Servo *servo : {tilt_servo, pan_servo})
+  {
+    if (!ConfigurePanTiltServo(servo))
+    {
+      return false;
+    }
+
+    // A moving speed of 0 means "as fast as possible" in joint mode, so the
+    // register always holds a real speed, even at rest.
+    if (!servo->SetMovingSpeed(LOW_MOVEMENT_SPEED))
+    {
+      std::cerr << "Failed to set initial servo moving speed" << std::endl;
+      return false;
+    }
+
+    if (!servo->SetTorqueEnabled(true))
+    {
+      std::cerr << "Failed to enable servo torque" << std::endl;
+      return false;
+    }
+  }
+
+  int timer_fd;
+  if (!OpenPeriodicTimer(control_period, &timer_fd))
+  {
+    std::cerr << "Failed to open motion control timer" << std::endl;
+    return false;
+  }
+
+  AxisPlannerConfig planner_config = {
+      max_acceleration,
+      GOAL_POSITION_LIMIT_LOW,
+      GOAL_POSITION_LIMIT_HIGH,
+      GOAL_POSITION_NEUTRAL,
+  };
+
+  *out_streamer = BasicMotionSetpointStreamer{
+      timer_fd,
+      scheduler,
+      tilt_servo,
+      pan_servo,
+      planner_config};
+  return true;
+}
+
+template <typename Servo, typename Scheduler>
+BasicMotionSetpointStreamer<Servo, Scheduler>::BasicMotionSetpointStreamer()
+  : initialized_{false},
+    timer_fd_{-1},
+    scheduler_{nullptr} {}
+
+template <typename Servo, typename Scheduler>
+BasicMotionSetpointStreamer<Servo, Scheduler>::BasicMotionSetpointStreamer(
+    int timer_fd,
+    Scheduler *scheduler,
+    Servo *tilt_servo,
+    Servo *pan_servo,
+    const AxisPlannerConfig &planner_config)
+  : initialized_{true},
+    timer_fd_{timer_fd},
+    scheduler_{scheduler}
+{
+  using namespace joystick_mapper_internal;
+
+  axes_[TILT] = AxisStream{
+      tilt_servo,
+      TrapezoidalAxisPlanner{planner_config},
+      LOW_MOVEMENT_SPEED,
+      GOAL_POSITION_NEUTRAL,
+      false,
+      true,
+      false,
+      0};
+  axes_[PAN] = AxisStream{
+      pan_servo,
+      TrapezoidalAxisPlanner{planner_config},
+      LOW_MOVEMENT_SPEED,
+      GOAL_POSITION_NEUTRAL,
+      false,
+      true,
+      false,
+      0};
+}
+
+template <typename Servo, typename Scheduler>
+BasicMotionSetpointStreamer<Servo, Scheduler>::BasicMotionSetpointStreamer(
+    BasicMotionSetpointStreamer &&other)
+  : initialized_{false},
+    timer_fd_{-1},
+    scheduler_{nullptr}
+{
+  StealResources(&other);
+}
+
+template <typename Servo, typename Scheduler>
+BasicMotionSetpointStreamer<Servo, Scheduler>&
+BasicMotionSetpointStreamer<Servo, Scheduler>::operator=(BasicMotionSetpointStreamer &&other)
+{
+  if (this != &other)
+  {
+    Close();
+    StealResources(&other);
+  }
+  return *this;
+}
+
+template <typename Servo, typename Scheduler>
+BasicMotionSetpointStreamer<Servo, Scheduler>::~BasicMotionSetpointStreamer()
+{
+  Close();
+}
+
+template <typename Servo, typename Scheduler>
+int BasicMotionSetpointStreamer<Servo, Scheduler>::GetFd() const
+{
+  assert(initialized_);
+  return timer_fd_;
+}
+
+template <typename Servo, typename Scheduler>
+void BasicMotionSetpointStreamer<Servo, Scheduler>::HandlePacket()
+{
+  assert(initialized_);
+
+  // Missed ticks are not replayed: the profile is closed form, so sampling it
+  // at the current time catches up in one step.
+  if (ReadTimerExpirations(timer_fd_) == 0)
+  {
+    return;
+  }
+
+  double now = NowSeconds();
+  for (AxisStream &axis : axes_)
+  {
+    if (!StreamAxis(&axis, now))
+    {
+      XBOX_LOG(LogLevel::ERROR, "Failed to stream motion setpoint");
+    }
+  }
+
+  if (!scheduler_->Flush())
+  {
+    XBOX_LOG_EVERY(LogLevel::ERROR, 1000, "Failed to flush motion setpoints");
+  }
+
+  if (scheduler_->TakeLostWrites())
+  {
+    InvalidateCommandState();
+  }
+}
+
+template <typename Servo, typename Scheduler>
+void BasicMotionSetpointStreamer<Servo, Scheduler>::ProcessReport(
+    const ControllerReport &report)
+{
+  assert(initialized_);
+
+  IncrementCounter(Counter::REPORTS_PROCESSED);
+  SetGauge(
+      Gauge::LAST_REPORT_TIMESTAMP_NS,
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch()).count());
+
+  double now = NowSeconds();
+  SetAxisIntent(&axes_[TILT], NormalizeJoystickInputScalar(report.left_stick_y), now);
+  SetAxisIntent(&axes_[PAN], NormalizeJoystickInputScalar(report.left_stick_x), now);
+}
+
+template <typename Servo, typename Scheduler>
+ServoCommandState BasicMotionSetpointStreamer<Servo, Scheduler>::GetTiltCommandState() const
+{
+  return GetAxisCommandState(axes_[TILT]);
+}
+
+template <typename Servo, typename Scheduler>
+ServoCommandState BasicMotionSetpointStreamer<Servo, Scheduler>::GetPanCommandState() const
+{
+  return GetAxisCommandState(axes_[PAN]);
+}
+
+template <typename Servo, typename Scheduler>
+void BasicMotionSetpointStreamer<Servo, Scheduler>::InvalidateCommandState()
+{
+  for (AxisStream &axis : axes_)
+  {
+    axis.known = false;
+  }
+}
+
+template <typename Servo, typename Scheduler>
+double BasicMotionSetpointStreamer<Servo, Scheduler>::NowSeconds()
+{
+  return std::chrono::duration<double>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+template <typename Servo, typename Scheduler>
+void BasicMotionSetpointStreamer<Servo, Scheduler>::SetAxisIntent(
+    AxisStream *axis,
+    double value,
+    double now)
+{
+  // Quantizing keeps the target steady while the stick wobbles inside a
+  // bucket, so the planner only rebuilds its segment on real changes.
+  double target_velocity = std::copysign(QuantizeJoystickSpeed(value), value);
+  axis->planner.SetTargetVelocity(target_velocity, now);
+}
+
+template <typename Servo, typename Scheduler>
+bool BasicMotionSetpointStreamer<Servo, Scheduler>::StreamAxis(AxisStream *axis, double now)
+{
+  using namespace joystick_mapper_internal;
+
+  AxisSetpoint setpoint = axis->planner.Update(now);
+  double speed = std::min(std::round(std::abs(setpoint.velocity)), double{MAX_MOVEMENT_SPEED});
+
+  // Taken every period, so a read that lands while the axis moves again is
+  // dropped rather than parked at later.
+  uint16_t present_position;
+  std::chrono::steady_clock::time_point read_time;
+  bool position_read = axis->servo->TakePresentPosition(&present_position, &read_time);
+
+  if (speed == 0)
+  {
+    if (axis->moving)
+    {
+      // The horn still heads for the old goal at the last, slowest ramp
+      // speed, so it barely moves while the read is in flight.
+      axis->moving = false;
+      axis->awaiting_rest_position = true;
+      axis->rest_wait_periods = 0;
+      axis->servo->RequestPresentPosition();
+      return true;
+    }
+
+    if (axis->awaiting_rest_position)
+    {
+      if (position_read)
+      {
+        axis->planner.ResetPosition(present_position, now);
+        setpoint = axis->planner.Update(now);
+      }
+      else if (++axis->rest_wait_periods < MAX_REST_POSITION_WAIT_PERIODS)
+      {
+        return true;
+      }
+      axis->awaiting_rest_position = false;
+    }
+    else if (axis->known)
+    {
+      return true;
+    }
+
+    // Park where the horn came to rest.
+    uint16_t rest_position = static_cast<uint16_t>(std::round(setpoint.position));
+    if (axis->known && rest_position == axis->goal_position)
+    {
+      return true;
+    }
+
+    if (!axis->known && !axis->servo->SetMovingSpeed(axis->moving_speed))
+    {
+      return false;
+    }
+
+    axis->goal_position = rest_position;
+    if (!axis->servo->SetGoalPosition(rest_position))
+    {
+      return false;
+    }
+    axis->known = true;
+    return true;
+  }
+
+  axis->moving = true;
+  axis->awaiting_rest_position = false;
+
+  uint16_t moving_speed = static_cast<uint16_t>(speed);
+  if (!axis->known || moving_speed != axis->moving_speed)
+  {
+    if (!axis->servo->SetMovingSpeed(moving_speed))
+    {
+      return false;
+    }
+    axis->moving_speed = moving_speed;
+  }
+
+  uint16_t goal_position = (setpoint.velocity > 0)
+      ? GOAL_POSITION_LIMIT_HIGH
+      : GOAL_POSITION_LIMIT_LOW;
+  if (!axis->known || goal_position != axis->goal_position)
+  {
+    if (!axis->servo->SetGoalPosition(goal_position))
+    {
+      return false;
+    }
+    axis->goal_position = goal_position;
+  }
+
+  axis->known = true;
+  return true;
+}
+
+template <typename Servo, typename Scheduler>
+ServoCommandState BasicMotionSetpointStreamer<Servo, Scheduler>::GetAxisCommandState(
+    const AxisStream &axis)
+{
+  using namespace joystick_mapper_internal;
+
+  ServoCommandState state = {};
+  state.moving_speed = axis.moving ? axis.moving_speed : 0;
+  state.goal_position = axis.goal_position;
+  state.torque_enabled = true;
+  state.positive_direction = axis.goal_position == GOAL_POSITION_LIMIT_HIGH;
+  return state;
+}
+
+template <typename Servo, typename Scheduler>
+void BasicMotionSetpointStreamer<Servo, Scheduler>::Close()
+{
+  if (timer_fd_ >= 0)
+  {
+    close(timer_fd_);
+    timer_fd_ = -1;
+  }
+  initialized_ = false;
+}
+
+template <typename Servo, typename Scheduler>
+void BasicMotionSetpointStreamer<Servo, Scheduler>::StealResources(
+    BasicMotionSetpointStreamer *other)
+{
+  assert(other);
+
+  initialized_ = other->initialized_;
+  other->initialized_ = false;
+  timer_fd_ = other->timer_fd_;
+  other->timer_fd_ = -1;
+  scheduler_ = other->scheduler_;
+  other->scheduler_ = nullptr;
+  axes_ = other->axes_;
+}
+
+}  // namespace xbox
+
+#endif  // XBOXCONTROLLER_MOTIONSETPOINTSTREAMER_H
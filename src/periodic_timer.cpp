@@ -0,0 +1,94 @@
+#include "src/periodic_timer.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <iostream>
+
+#include "src/logger.h"
+
+namespace xbox
+{
+
+bool OpenPeriodicTimer(std::chrono::nanoseconds period, int *out_fd)
+{
+  assert(out_fd);
+  assert(period.count() > 0);
+
+  int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (fd < 0)
+  {
+    std::cerr << "Failed to create timerfd. Error: " << strerror(errno) << std::endl;
+    return false;
+  }
+
+  struct itimerspec spec;
+  memset(&spec, 0, sizeof(spec));
+  spec.it_interval.tv_sec = period.count() / 1000000000;
+  spec.it_interval.tv_nsec = period.count() % 1000000000;
+  spec.it_value = spec.it_interval;
+
+  if (timerfd_settime(fd, 0, &spec, nullptr) < 0)
+  {
+    std::cerr << "Failed to arm timerfd. Error: " << strerror(errno) << std::endl;
+    close(fd);
+    return false;
+  }
+
+  *out_fd = fd;
+  return true;
+}
+
+bool OpenOneShotTimer(int *out_fd)
+{
+  assert(out_fd);
+
+  int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (fd < 0)
+  {
+    std::cerr << "Failed to create timerfd. Error: " << strerror(errno) << std::endl;
+    return false;
+  }
+
+  *out_fd = fd;
+  return true;
+}
+
+bool ArmOneShotTimer(int fd, std::chrono::nanoseconds delay)
+{
+  assert(delay.count() >= 0);
+
+  struct itimerspec spec;
+  memset(&spec, 0, sizeof(spec));
+  spec.it_value.tv_sec = delay.count() / 1000000000;
+  spec.it_value.tv_nsec = delay.count() % 1000000000;
+
+  if (timerfd_settime(fd, 0, &spec, nullptr) < 0)
+  {
+    XBOX_LOG(LogLevel::ERROR, "Failed to arm timerfd. Error: %s", strerror(errno));
+    return false;
+  }
+
+  return true;
+}
+
+uint64_t ReadTimerExpirations(int fd)
+{
+  uint64_t expirations = 0;
+  ssize_t result = read(fd, &expirations, sizeof(expirations));
+  if (result != sizeof(expirations))
+  {
+    if (result < 0 && errno != EAGAIN)
+    {
+      XBOX_LOG(LogLevel::ERROR, "Failed to read timerfd. Error: %s", strerror(errno));
+    }
+    return 0;
+  }
+
+  return expirations;
+}
+
+}  // namespace xbox
@@ -0,0 +1,26 @@
+#ifndef XBOXCONTROLLER_PERIODICTIMER_H
+#define XBOXCONTROLLER_PERIODICTIMER_H
+
+#include <chrono>
+#include <cstdint>
+
+namespace xbox
+{
+
+// Opens a non-blocking CLOCK_MONOTONIC timerfd that fires every |period|.
+bool OpenPeriodicTimer(std::chrono::nanoseconds period, int *out_fd);
+
+// Opens a non-blocking CLOCK_MONOTONIC timerfd that starts disarmed.
+bool OpenOneShotTimer(int *out_fd);
+
+// Arms |fd| to fire once after |delay|, replacing any pending expiry. A zero
+// |delay| disarms it.
+bool ArmOneShotTimer(int fd, std::chrono::nanoseconds delay);
+
+// Drains a timerfd. Returns the number of periods elapsed since the last read,
+// or 0 if the timer has not fired.
+uint64_t ReadTimerExpirations(int fd);
+
+}  // namespace xbox
+
+#endif  // XBOXCONTROLLER_PERIODICTIMER_H
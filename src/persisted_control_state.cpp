@@ -0,0 +1,311 @@
+#include "src/persisted_control_state.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <iostream>
+
+namespace
+{
+using xbox::PersistedControlState;
+using xbox::PersistedControlStateSlot;
+
+constexpr const char* BOOT_ID_PATH = "/proc/sys/kernel/random/boot_id";
+
+// FNV-1a; only has to catch torn writes, not tampering.
+uint32_t ComputeChecksum(const void *data, size_t size, uint32_t hash = 2166136261u)
+{
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  for (size_t i = 0; i < size; ++i)
+  {
+    hash ^= bytes[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+uint32_t ComputeSlotChecksum(uint64_t generation, const PersistedControlState &state)
+{
+  return ComputeChecksum(&state, sizeof(state), ComputeChecksum(&generation, sizeof(generation)));
+}
+
+bool IsSlotIntact(const PersistedControlStateSlot &slot)
+{
+  return slot.generation != 0 &&
+      slot.checksum == ComputeSlotChecksum(slot.generation, slot.state);
+}
+
+int64_t BootTimeNanoseconds()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_BOOTTIME, &now);
+  return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+// Leaves |out_boot_id| empty if the kernel does not expose one.
+void ReadBootId(char *out_boot_id)
+{
+  out_boot_id[0] = '\0';
+
+  FILE *file = fopen(BOOT_ID_PATH, "r");
+  if (!file)
+  {
+    return;
+  }
+
+  if (!fgets(out_boot_id, xbox::PERSISTED_BOOT_ID_SIZE, file))
+  {
+    out_boot_id[0] = '\0';
+  }
+  fclose(file);
+  out_boot_id[strcspn(out_boot_id, "\n")] = '\0';
+}
+
+}  // namespace
+
+namespace xbox
+{
+
+bool ControlStateStore::Open(const std::string &path, ControlStateStore *out_store)
+{
+  assert(out_store);
+
+  int fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0)
+  {
+    std::cerr << "Failed to open control state file " << path << ". Error: "
+              << strerror(errno) << std::endl;
+    return false;
+  }
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) < 0)
+  {
+    std::cerr << "Failed to stat control state file. Error: " << strerror(errno) << std::endl;
+    close(fd);
+    return false;
+  }
+
+  bool sized = file_stat.st_size == static_cast<off_t>(sizeof(PersistedControlStateFile));
+  if (!sized && ftruncate(fd, sizeof(PersistedControlStateFile)) < 0)
+  {
+    std::cerr << "Failed to size control state file. Error: " << strerror(errno) << std::endl;
+    close(fd);
+    return false;
+  }
+
+  void *mapping = mmap(
+      nullptr,
+      sizeof(PersistedControlStateFile),
+      PROT_READ | PROT_WRITE,
+      MAP_SHARED,
+      fd,
+      0);
+  close(fd);
+
+  if (mapping == MAP_FAILED)
+  {
+    std::cerr << "Failed to map control state file. Error: " << strerror(errno) << std::endl;
+    return false;
+  }
+
+  PersistedControlStateFile *file = static_cast<PersistedControlStateFile *>(mapping);
+  if (!sized ||
+      file->magic != PERSISTED_CONTROL_STATE_MAGIC ||
+      file->version != PERSISTED_CONTROL_STATE_VERSION)
+  {
+    memset(file, 0, sizeof(*file));
+    file->magic = PERSISTED_CONTROL_STATE_MAGIC;
+    file->version = PERSISTED_CONTROL_STATE_VERSION;
+  }
+
+  char boot_id[PERSISTED_BOOT_ID_SIZE];
+  ReadBootId(boot_id);
+
+  *out_store = ControlStateStore{file, boot_id};
+  return true;
+}
+
+ControlStateStore::ControlStateStore()
+  : initialized_{false},
+    file_{nullptr},
+    boot_id_{},
+    state_{},
+    saved_state_{},
+    saved_generation_{0} {}
+
+ControlStateStore::ControlStateStore(PersistedControlStateFile *file, const char *boot_id)
+  : initialized_{true},
+    file_{file},
+    boot_id_{},
+    state_{},
+    saved_state_{},
+    saved_generation_{0}
+{
+  assert(boot_id);
+  strncpy(boot_id_, boot_id, sizeof(boot_id_) - 1);
+
+  const PersistedControlStateSlot *newest = GetNewestSlot();
+  if (newest)
+  {
+    saved_state_ = newest->state;
+    saved_generation_ = newest->generation;
+  }
+
+  // Whatever an earlier boot left behind must not be saved again as if this
+  // boot had produced it.
+  if (IsFromThisBoot(saved_state_))
+  {
+    state_ = saved_state_;
+  }
+}
+
+ControlStateStore::ControlStateStore(ControlStateStore &&other)
+  : initialized_{false},
+    file_{nullptr}
+{
+  StealResources(&other);
+}
+
+ControlStateStore& ControlStateStore::operator=(ControlStateStore &&other)
+{
+  if (this != &other)
+  {
+    Close();
+    StealResources(&other);
+  }
+  return *this;
+}
+
+ControlStateStore::~ControlStateStore()
+{
+  Close();
+}
+
+bool ControlStateStore::LoadWarmState(PersistedControlState *out_state) const
+{
+  assert(initialized_);
+  assert(out_state);
+
+  if (saved_generation_ == 0 || !IsFromThisBoot(saved_state_))
+  {
+    return false;
+  }
+
+  *out_state = saved_state_;
+  return true;
+}
+
+PersistedControlState& ControlStateStore::GetState()
+{
+  assert(initialized_);
+  return state_;
+}
+
+void ControlStateStore::Save()
+{
+  assert(initialized_);
+
+  memcpy(state_.boot_id, boot_id_, sizeof(state_.boot_id));
+  state_.saved_ns = saved_state_.saved_ns;
+  if (saved_generation_ != 0 && memcmp(&state_, &saved_state_, sizeof(state_)) == 0)
+  {
+    return;
+  }
+
+  state_.saved_ns = BootTimeNanoseconds();
+  uint64_t generation = saved_generation_ + 1;
+  // Overwrite the older slot; the newer one stays intact until this one is.
+  PersistedControlStateSlot &slot = file_->slots[generation % 2];
+  slot.generation = generation;
+  slot.state = state_;
+  slot.checksum = ComputeSlotChecksum(generation, state_);
+
+  saved_state_ = state_;
+  saved_generation_ = generation;
+}
+
+bool ControlStateStore::IsFromThisBoot(const PersistedControlState &state) const
+{
+  return boot_id_[0] != '\0' && strncmp(state.boot_id, boot_id_, sizeof(boot_id_)) == 0;
+}
+
+const PersistedControlStateSlot* ControlStateStore::GetNewestSlot() const
+{
+  const PersistedControlStateSlot *newest = nullptr;
+  for (const PersistedControlStateSlot &slot : file_->slots)
+  {
+    if (IsSlotIntact(slot) && (!newest || slot.generation > newest->generation))
+    {
+      newest = &slot;
+    }
+  }
+  return newest;
+}
+
+void ControlStateStore::Close()
+{
+  if (!initialized_)
+  {
+    return;
+  }
+
+  munmap(file_, sizeof(PersistedControlStateFile));
+  file_ = nullptr;
+  initialized_ = false;
+}
+
+void ControlStateStore::StealResources(ControlStateStore *other)
+{
+  assert(other);
+
+  initialized_ = other->initialized_;
+  other->initialized_ = false;
+  file_ = other->file_;
+  other->file_ = nullptr;
+  memcpy(boot_id_, other->boot_id_, sizeof(boot_id_));
+  state_ = other->state_;
+  saved_state_ = other->saved_state_;
+  saved_generation_ = other->saved_generation_;
+}
+
+void SetPersistedControllerAddresses(
+    const std::vector<std::string> &addresses,
+    PersistedControlState *state)
+{
+  assert(state);
+
+  size_t count = std::min(addresses.size(), MAX_PERSISTED_CONTROLLERS);
+  memset(state->controller_addresses, 0, sizeof(state->controller_addresses));
+  for (size_t i = 0; i < count; ++i)
+  {
+    strncpy(
+        state->controller_addresses[i],
+        addresses[i].c_str(),
+        PERSISTED_BLUETOOTH_ADDRESS_SIZE - 1);
+  }
+  state->controller_count = static_cast<uint8_t>(count);
+}
+
+std::vector<std::string> GetPersistedControllerAddresses(const PersistedControlState &state)
+{
+  std::vector<std::string> addresses;
+  size_t count = std::min<size_t>(state.controller_count, MAX_PERSISTED_CONTROLLERS);
+  for (size_t i = 0; i < count; ++i)
+  {
+    addresses.emplace_back(
+        state.controller_addresses[i],
+        strnlen(state.controller_addresses[i], PERSISTED_BLUETOOTH_ADDRESS_SIZE));
+  }
+  return addresses;
+}
+
+}  // namespace xbox
@@ -0,0 +1,132 @@
+#ifndef XBOXCONTROLLER_PERSISTEDCONTROLSTATE_H
+#define XBOXCONTROLLER_PERSISTEDCONTROLSTATE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace xbox
+{
+
+// Layout of the file xbone keeps its control state in, so a restarted process
+// can resume where the previous one stopped instead of homing the servos and
+// searching for controllers again. Bump
+// PERSISTED_CONTROL_STATE_VERSION on any change; files of another version are
+// ignored and rewritten.
+
+constexpr uint32_t PERSISTED_CONTROL_STATE_MAGIC = 0x53504258;  // "XBPS"
+constexpr uint32_t PERSISTED_CONTROL_STATE_VERSION = 1;
+constexpr size_t PERSISTED_SERVO_COUNT = 2;
+constexpr size_t PERSISTED_SERVO_REGISTER_COUNT = 8;
+constexpr size_t MAX_PERSISTED_CONTROLLERS = 4;
+// "XX:XX:XX:XX:XX:XX" plus terminator.
+constexpr size_t PERSISTED_BLUETOOTH_ADDRESS_SIZE = 18;
+// /proc/sys/kernel/random/boot_id plus terminator.
+constexpr size_t PERSISTED_BOOT_ID_SIZE = 37;
+
+struct PersistedServoState
+{
+  uint8_t id;
+  // Whether a joystick mapper configured the servo and saved the fields
+  // below; planner mode leaves them out.
+  uint8_t has_mapper_state;
+  uint8_t reserved[2];
+  // Last values the mapper wrote.
+  uint16_t moving_speed;
+  uint16_t goal_position;
+  // Scheduler shadows of the EEPROM registers, valid where the register's bit
+  // is set in |known_registers|.
+  uint32_t known_registers;
+  uint16_t register_values[PERSISTED_SERVO_REGISTER_COUNT];
+};
+
+struct PersistedControlState
+{
+  // Servo RAM registers and Bluetooth links do not survive a reboot, so state
+  // from another boot is never resumed.
+  char boot_id[PERSISTED_BOOT_ID_SIZE];
+  uint8_t controller_count;
+  uint8_t reserved[2];
+  // CLOCK_BOOTTIME.
+  int64_t saved_ns;
+  PersistedServoState servos[PERSISTED_SERVO_COUNT];
+  char controller_addresses[MAX_PERSISTED_CONTROLLERS][PERSISTED_BLUETOOTH_ADDRESS_SIZE];
+};
+
+// Two slots are written alternately. A slot is only trusted if its checksum
+// matches, so a write torn by a crash leaves the previous slot in charge.
+struct PersistedControlStateSlot
+{
+  uint64_t generation;
+  PersistedControlState state;
+  uint32_t checksum;
+};
+
+struct PersistedControlStateFile
+{
+  uint32_t magic;
+  uint32_t version;
+  PersistedControlStateSlot slots[2];
+};
+
+// Memory-mapped store for PersistedControlState.
+//
+// Save() is a compare and, when something changed, a copy into the older
+// slot, so it can run once per report. Nothing is msync()ed: the mapping
+// outlives a crashed process, which is all the store is for, since state from
+// another boot is never resumed anyway. Keep the file on tmpfs (/run), where
+// a power cut simply loses it, to spare flash storage.
+class ControlStateStore
+{
+public:
+  static bool Open(const std::string &path, ControlStateStore *out_store);
+
+public:
+  ControlStateStore();
+  ControlStateStore(PersistedControlStateFile *file, const char *boot_id);
+  ControlStateStore(ControlStateStore &&other);
+  ControlStateStore& operator=(ControlStateStore &&other);
+  ~ControlStateStore();
+
+  // Copies the newest intact state saved during this boot. Returns false if
+  // there is none, i.e. on a cold start.
+  bool LoadWarmState(PersistedControlState *out_state) const;
+
+  // The state the next Save() starts from: the newest intact one saved during
+  // this boot, or all zeros. Callers update their part and save it back.
+  PersistedControlState& GetState();
+
+  // Persists GetState(), stamped with this boot, unless it matches what was
+  // last saved.
+  void Save();
+
+private:
+  bool IsFromThisBoot(const PersistedControlState &state) const;
+  const PersistedControlStateSlot* GetNewestSlot() const;
+  void Close();
+  void StealResources(ControlStateStore *other);
+
+private:
+  ControlStateStore(const ControlStateStore &other) = delete;
+  ControlStateStore& operator=(const ControlStateStore &other) = delete;
+
+private:
+  bool initialized_;
+  PersistedControlStateFile *file_;
+  char boot_id_[PERSISTED_BOOT_ID_SIZE];
+  PersistedControlState state_;
+  // Copy of the newest slot, so Save() compares without reading the file.
+  PersistedControlState saved_state_;
+  uint64_t saved_generation_;
+};
+
+// Copies up to MAX_PERSISTED_CONTROLLERS addresses into |state|.
+void SetPersistedControllerAddresses(
+    const std::vector<std::string> &addresses,
+    PersistedControlState *state);
+std::vector<std::string> GetPersistedControllerAddresses(const PersistedControlState &state);
+
+}  // namespace xbox
+
+#endif  // XBOXCONTROLLER_PERSISTEDCONTROLSTATE_H
@@ -0,0 +1,105 @@
+#include "src/servo_bus_budget.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+// Starting estimate before any transaction has been observed: an AX-12 write
+// plus its status packet at 1 Mbps with the default return delay.
+constexpr double INITIAL_TRANSACTION_NS = 1000000.0;
+
+// Weight of each new sample in the moving average.
+constexpr double TRANSACTION_TIME_SMOOTHING = 1.0 / 8.0;
+
+// Leave headroom for reads and retries.
+constexpr double TARGET_BUS_UTILIZATION = 0.8;
+
+// Enough for a full move command: speed, goal position and torque enable.
+constexpr double BURST_WRITES = 3.0;
+}  // namespace
+
+namespace xbox
+{
+
+ServoBusBudget::ServoBusBudget()
+  : average_transaction_ns_{INITIAL_TRANSACTION_NS},
+    servo_count_{0} {}
+
+void ServoBusBudget::RegisterServo()
+{
+  ++servo_count_;
+}
+
+void ServoBusBudget::RecordTransaction(std::chrono::nanoseconds duration)
+{
+  average_transaction_ns_ +=
+      (duration.count() - average_transaction_ns_) * TRANSACTION_TIME_SMOOTHING;
+}
+
+std::chrono::nanoseconds ServoBusBudget::GetAverageTransactionTime() const
+{
+  return std::chrono::nanoseconds{static_cast<int64_t>(average_transaction_ns_)};
+}
+
+size_t ServoBusBudget::GetServoCount() const
+{
+  return servo_count_;
+}
+
+double ServoBusBudget::GetPerServoWriteRate() const
+{
+  double servo_count = static_cast<double>(std::max<size_t>(servo_count_, 1));
+  return TARGET_BUS_UTILIZATION * 1e9 / (average_transaction_ns_ * servo_count);
+}
+
+ServoRateLimiter::ServoRateLimiter()
+  : bus_budget_{nullptr},
+    tokens_{0} {}
+
+ServoRateLimiter::ServoRateLimiter(ServoBusBudget *bus_budget)
+  : bus_budget_{bus_budget},
+    tokens_{BURST_WRITES},
+    last_refill_{std::chrono::steady_clock::now()}
+{
+  assert(bus_budget_);
+  bus_budget_->RegisterServo();
+}
+
+bool ServoRateLimiter::TryAcquire(std::chrono::steady_clock::time_point now, size_t writes)
+{
+  Refill(now);
+
+  if (tokens_ < writes)
+  {
+    return false;
+  }
+
+  tokens_ -= writes;
+  return true;
+}
+
+void ServoRateLimiter::ForceAcquire(std::chrono::steady_clock::time_point now, size_t writes)
+{
+  Refill(now);
+  tokens_ = std::max(tokens_ - writes, -BURST_WRITES);
+}
+
+void ServoRateLimiter::Refill(std::chrono::steady_clock::time_point now)
+{
+  assert(bus_budget_);
+
+  double elapsed_seconds = std::chrono::duration<double>(now - last_refill_).count();
+  last_refill_ = now;
+
+  if (elapsed_seconds <= 0)
+  {
+    return;
+  }
+
+  tokens_ = std::min(
+      tokens_ + elapsed_seconds * bus_budget_->GetPerServoWriteRate(),
+      BURST_WRITES);
+}
+
+}  // namespace xbox
@@ -0,0 +1,60 @@
+#ifndef XBOXCONTROLLER_SERVOBUSBUDGET_H
+#define XBOXCONTROLLER_SERVOBUSBUDGET_H
+
+#include <chrono>
+#include <cstddef>
+
+namespace xbox
+{
+
+// Tracks how long servo transactions take on a shared half-duplex bus and how
+// many servos share it. From that it derives the write rate each servo may
+// sustain while keeping the bus below TARGET_BUS_UTILIZATION.
+class ServoBusBudget
+{
+public:
+  ServoBusBudget();
+  void RegisterServo();
+  void RecordTransaction(std::chrono::nanoseconds duration);
+  std::chrono::nanoseconds GetAverageTransactionTime() const;
+  size_t GetServoCount() const;
+
+  // Sustainable writes per second for any one servo on the bus.
+  double GetPerServoWriteRate() const;
+
+private:
+  ServoBusBudget(const ServoBusBudget &other) = delete;
+  ServoBusBudget& operator=(const ServoBusBudget &other) = delete;
+
+private:
+  double average_transaction_ns_;
+  size_t servo_count_;
+};
+
+// Per-servo token bucket refilled at the rate the shared ServoBusBudget
+// allows. One token pays for one bus transaction.
+class ServoRateLimiter
+{
+public:
+  ServoRateLimiter();
+  explicit ServoRateLimiter(ServoBusBudget *bus_budget);
+
+  // Takes |writes| tokens if available.
+  bool TryAcquire(std::chrono::steady_clock::time_point now, size_t writes);
+
+  // Always succeeds. Used for stop commands, which must never be delayed;
+  // the bucket goes into debt and later non-critical commands pay it back.
+  void ForceAcquire(std::chrono::steady_clock::time_point now, size_t writes);
+
+private:
+  void Refill(std::chrono::steady_clock::time_point now);
+
+private:
+  ServoBusBudget *bus_budget_;
+  double tokens_;
+  std::chrono::steady_clock::time_point last_refill_;
+};
+
+}  // namespace xbox
+
+#endif  // XBOXCONTROLLER_SERVOBUSBUDGET_H
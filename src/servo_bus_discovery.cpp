@@ -0,0 +1,98 @@
+#include "src/servo_bus_discovery.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <cerrno>
+
+#include "src/async_servo_bus.h"
+
+namespace
+{
+// The AX-12 runs at 2000000 / (BAUD_RATE + 1).
+constexpr uint32_t AXA12_BAUD_RATE_CLOCK = 2000000;
+}  // namespace
+
+namespace xbox
+{
+
+uint8_t GetAxA12BaudRateValue(uint32_t baud_rate)
+{
+  assert(baud_rate > 0);
+
+  // Rounded to the nearest divisor: 115200 becomes 16, 117647 baud.
+  uint32_t divisor = (AXA12_BAUD_RATE_CLOCK + baud_rate / 2) / baud_rate;
+  return static_cast<uint8_t>(divisor - 1);
+}
+
+bool LoadServoBusConfiguration(const std::string &path, ServoBusConfiguration *out_configuration)
+{
+  assert(out_configuration);
+
+  FILE *file = fopen(path.c_str(), "r");
+  if (!file)
+  {
+    return false;
+  }
+
+  ServoBusConfiguration configuration{0, {}};
+  unsigned int baud_rate = 0;
+  bool valid = fscanf(file, "baud_rate %u ids", &baud_rate) == 1 &&
+      IsSupportedServoBaudRate(baud_rate);
+
+  unsigned int id = 0;
+  while (valid && fscanf(file, "%u", &id) == 1)
+  {
+    if (id > servo_bus_discovery_internal::MAX_SERVO_ID)
+    {
+      valid = false;
+      break;
+    }
+    configuration.ids.push_back(static_cast<uint8_t>(id));
+  }
+  fclose(file);
+
+  if (!valid || configuration.ids.empty())
+  {
+    std::cerr << "Ignoring invalid servo bus cache " << path << std::endl;
+    return false;
+  }
+
+  configuration.baud_rate = baud_rate;
+  *out_configuration = configuration;
+  return true;
+}
+
+bool SaveServoBusConfiguration(const std::string &path, const ServoBusConfiguration &configuration)
+{
+  std::string temporary_path = path + ".tmp";
+  FILE *file = fopen(temporary_path.c_str(), "w");
+  if (!file)
+  {
+    std::cerr << "Failed to open " << temporary_path << ". Error: " << strerror(errno)
+              << std::endl;
+    return false;
+  }
+
+  fprintf(file, "baud_rate %u\nids", configuration.baud_rate);
+  for (uint8_t id : configuration.ids)
+  {
+    fprintf(file, " %u", id);
+  }
+  fprintf(file, "\n");
+
+  bool written = fflush(file) == 0 && fsync(fileno(file)) == 0;
+  written = fclose(file) == 0 && written;
+  if (!written || rename(temporary_path.c_str(), path.c_str()) < 0)
+  {
+    std::cerr << "Failed to write " << path << ". Error: " << strerror(errno) << std::endl;
+    unlink(temporary_path.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+}  // namespace xbox
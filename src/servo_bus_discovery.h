@@ -0,0 +1,255 @@
+#ifndef XBOXCONTROLLER_SERVOBUSDISCOVERY_H
+#define XBOXCONTROLLER_SERVOBUSDISCOVERY_H
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "src/dynamixel_protocol.h"
+
+namespace xbox
+{
+namespace servo_bus_discovery_internal
+{
+// IDs 0..253; 254 is broadcast.
+constexpr uint8_t MAX_SERVO_ID = 0xFD;
+// The error-rate check pings every servo this many times at a candidate rate
+// and accepts the rate if no more than MAX_PING_FAILURE_RATE go unanswered.
+constexpr size_t ERROR_CHECK_PINGS_PER_SERVO = 50;
+constexpr double MAX_PING_FAILURE_RATE = 0.02;
+// Broadcast writes are never acknowledged, so the baud rate change is sent
+// more than once.
+constexpr size_t BAUD_RATE_WRITE_REPEATS = 2;
+// Time for the servos to store the new rate and switch over.
+constexpr std::chrono::milliseconds BAUD_RATE_SETTLE_TIME{10};
+}  // namespace servo_bus_discovery_internal
+
+// Standard AX-12 rates the UART can be set to, fastest first. 115200 is the
+// nearest UART rate to the AX-12's 117647 (register value 16), 2% off, which
+// the AX-12 tolerates.
+constexpr std::array<uint32_t, 6> STANDARD_SERVO_BAUD_RATES{
+    {1000000, 500000, 115200, 57600, 19200, 9600}};
+
+// What discovery found: the rate the whole bus runs at and the servos on it.
+struct ServoBusConfiguration
+{
+  uint32_t baud_rate;
+  std::vector<uint8_t> ids;
+};
+
+// AX-12 BAUD_RATE register value for |baud_rate|.
+uint8_t GetAxA12BaudRateValue(uint32_t baud_rate);
+
+// The cache is a small text file written by SaveServoBusConfiguration().
+bool LoadServoBusConfiguration(const std::string &path, ServoBusConfiguration *out_configuration);
+
+// Replaces |path| atomically, so a power cut leaves the old cache or the new
+// one, never half of either.
+bool SaveServoBusConfiguration(const std::string &path, const ServoBusConfiguration &configuration);
+
+namespace servo_bus_discovery_internal
+{
+template <typename Bus>
+bool AllAnswer(Bus *bus, const std::vector<uint8_t> &ids)
+{
+  for (uint8_t id : ids)
+  {
+    if (!bus->PingBlocking(id))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Tells every servo listening at any of |current_rates| to switch to
+// |baud_rate|, then follows them.
+template <typename Bus>
+bool MoveBus(Bus *bus, const std::vector<uint32_t> &current_rates, uint32_t baud_rate)
+{
+  for (uint32_t current_rate : current_rates)
+  {
+    if (current_rate == baud_rate)
+    {
+      continue;
+    }
+
+    if (!bus->SetBaudRate(current_rate))
+    {
+      return false;
+    }
+
+    for (size_t i = 0; i < BAUD_RATE_WRITE_REPEATS; ++i)
+    {
+      if (!bus->Write(
+              DYNAMIXEL_BROADCAST_ID,
+              AxA12Address::BAUD_RATE,
+              GetAxA12BaudRateValue(baud_rate),
+              1))
+      {
+        return false;
+      }
+    }
+
+    if (!bus->FlushBlocking())
+    {
+      return false;
+    }
+  }
+
+  std::this_thread::sleep_for(BAUD_RATE_SETTLE_TIME);
+  return bus->SetBaudRate(baud_rate);
+}
+
+template <typename Bus>
+bool PassesErrorRateCheck(Bus *bus, const std::vector<uint8_t> &ids)
+{
+  size_t failures = 0;
+  for (size_t i = 0; i < ERROR_CHECK_PINGS_PER_SERVO; ++i)
+  {
+    for (uint8_t id : ids)
+    {
+      if (!bus->PingBlocking(id))
+      {
+        ++failures;
+      }
+    }
+  }
+
+  size_t allowed = static_cast<size_t>(
+      ERROR_CHECK_PINGS_PER_SERVO * ids.size() * MAX_PING_FAILURE_RATE);
+  std::cout << "Servo bus at " << bus->GetBaudRate() << " baud: " << failures << " of "
+            << ERROR_CHECK_PINGS_PER_SERVO * ids.size() << " pings unanswered" << std::endl;
+  return failures <= allowed;
+}
+}  // namespace servo_bus_discovery_internal
+
+// Finds the servos on |bus| and moves them all to the fastest standard rate
+// that passes an error-rate check.
+//
+// The configuration cached at |cache_path| is tried first: if every servo in
+// it answers at its rate, nothing else is done. Otherwise every ID is pinged
+// at every standard rate, which takes around twenty seconds (mostly timeouts
+// at the slow rates), so the result is cached. An empty |cache_path| always
+// scans. Fails if any of |required_ids| is missing.
+//
+// Blocks on the bus like BasicAsyncServoBus::ReadBlocking(), so it belongs
+// in startup, and must run before anything else is queued on |bus|.
+template <typename Bus>
+bool DiscoverServoBus(
+    Bus *bus,
+    const std::string &cache_path,
+    const std::vector<uint8_t> &required_ids,
+    ServoBusConfiguration *out_configuration)
+{
+  using namespace servo_bus_discovery_internal;
+
+  assert(bus);
+  assert(out_configuration);
+
+  auto has_required_ids = [&required_ids](const std::vector<uint8_t> &ids)
+  {
+    for (uint8_t id : required_ids)
+    {
+      if (std::find(ids.begin(), ids.end(), id) == ids.end())
+      {
+        return false;
+      }
+    }
+    return true;
+  };
+
+  ServoBusConfiguration cached;
+  if (!cache_path.empty() &&
+      LoadServoBusConfiguration(cache_path, &cached) &&
+      has_required_ids(cached.ids) &&
+      bus->SetBaudRate(cached.baud_rate) &&
+      AllAnswer(bus, cached.ids))
+  {
+    std::cout << "Servo bus: using cached configuration at " << cached.baud_rate << " baud"
+              << std::endl;
+    *out_configuration = cached;
+    return true;
+  }
+
+  std::cout << "Servo bus: scanning standard baud rates" << std::endl;
+
+  std::vector<uint8_t> ids;
+  std::vector<uint32_t> occupied_rates;
+  for (uint32_t baud_rate : STANDARD_SERVO_BAUD_RATES)
+  {
+    if (!bus->SetBaudRate(baud_rate))
+    {
+      return false;
+    }
+
+    bool occupied = false;
+    for (uint16_t id = 0; id <= MAX_SERVO_ID; ++id)
+    {
+      if (!bus->PingBlocking(id))
+      {
+        continue;
+      }
+
+      occupied = true;
+      if (std::find(ids.begin(), ids.end(), id) != ids.end())
+      {
+        // Both servos will answer at once after the move.
+        std::cerr << "Servo ID " << id << " found at more than one baud rate" << std::endl;
+        continue;
+      }
+      ids.push_back(id);
+    }
+
+    if (occupied)
+    {
+      std::cout << "Servo bus: found servos at " << baud_rate << " baud" << std::endl;
+      occupied_rates.push_back(baud_rate);
+    }
+  }
+
+  if (ids.empty() || !has_required_ids(ids))
+  {
+    std::cerr << "Servo bus scan did not find every required servo" << std::endl;
+    return false;
+  }
+
+  // A rate that fails the check may still have been taken by some servos, so
+  // later attempts address every rate tried so far.
+  std::vector<uint32_t> possible_rates = occupied_rates;
+  for (uint32_t baud_rate : STANDARD_SERVO_BAUD_RATES)
+  {
+    if (!MoveBus(bus, possible_rates, baud_rate))
+    {
+      return false;
+    }
+
+    if (PassesErrorRateCheck(bus, ids))
+    {
+      *out_configuration = ServoBusConfiguration{baud_rate, ids};
+      if (!cache_path.empty() && !SaveServoBusConfiguration(cache_path, *out_configuration))
+      {
+        std::cerr << "Failed to cache servo bus configuration at " << cache_path << std::endl;
+      }
+      return true;
+    }
+
+    if (std::find(possible_rates.begin(), possible_rates.end(), baud_rate) == possible_rates.end())
+    {
+      possible_rates.push_back(baud_rate);
+    }
+  }
+
+  std::cerr << "No baud rate passed the servo bus error-rate check" << std::endl;
+  return false;
+}
+
+}  // namespace xbox
+
+#endif  // XBOXCONTROLLER_SERVOBUSDISCOVERY_H
@@ -0,0 +1,868 @@
+#ifndef XBOXCONTROLLER_SERVOBUSSCHEDULER_H
+#define XBOXCONTROLLER_SERVOBUSSCHEDULER_H
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <type_traits>
+
+#include "dynamixel/AxA12.h"
+#include "src/controller_report.h"
+#include "src/logger.h"
+#include "src/metrics.h"
+#include "src/servo_bus_budget.h"
+#include "src/tracepoints.h"
+
+namespace xbox
+{
+
+// Ordered by urgency; lower values are issued first.
+enum class ServoCommandPriority : uint8_t
+{
+  STOP,
+  DIRECTION_CHANGE,
+  SPEED_CHANGE,
+  TELEMETRY,
+};
+
+enum class ServoRegister : uint8_t
+{
+  GOAL_POSITION,
+  MOVING_SPEED,
+  TORQUE_ENABLE,
+  TORQUE_LIMIT,
+  CW_ANGLE_LIMIT,
+  CCW_ANGLE_LIMIT,
+  // Read-only; queued reads correct the wheel mode position model.
+  PRESENT_POSITION,
+  COUNT,
+};
+
+constexpr size_t SERVO_REGISTER_COUNT = static_cast<size_t>(ServoRegister::COUNT);
+constexpr size_t MAX_SCHEDULED_SERVOS = 8;
+
+// Size of the AX-12 write instruction packet for |reg|: header, id, length,
+// instruction, address and checksum around the register's data bytes.
+inline size_t GetServoWritePacketSize(ServoRegister reg)
+{
+  size_t data_bytes = (reg == ServoRegister::TORQUE_ENABLE) ? 1 : 2;
+  return 7 + data_bytes;
+}
+
+inline bool IsReadOnlyServoRegister(ServoRegister reg)
+{
+  return reg == ServoRegister::PRESENT_POSITION;
+}
+
+// Registers the AX-12 keeps in EEPROM. Writes to them are slow and wear the
+// cells, and their values survive restarts, so they are worth reading first.
+// TORQUE_LIMIT is RAM: the servo reloads it from Max Torque at power-on and
+// zeroes it on an alarm shutdown, so it is always written.
+inline bool IsPersistentServoRegister(ServoRegister reg)
+{
+  return reg == ServoRegister::CW_ANGLE_LIMIT ||
+      reg == ServoRegister::CCW_ANGLE_LIMIT;
+}
+
+namespace servo_scheduler_internal
+{
+// How long a command stays useful after it was queued. Stops never expire.
+constexpr std::chrono::milliseconds DIRECTION_CHANGE_DEADLINE{50};
+constexpr std::chrono::milliseconds SPEED_CHANGE_DEADLINE{50};
+constexpr std::chrono::milliseconds TELEMETRY_DEADLINE{200};
+
+// Once stops are out, a flush stops issuing further commands after this much
+// bus time, so the next report's stops never wait behind a long backlog.
+constexpr std::chrono::microseconds FLUSH_TIME_BUDGET{5000};
+}  // namespace servo_scheduler_internal
+
+template <typename Servo>
+class BasicServoBusScheduler;
+
+// True for servos whose setters only queue the write on an asynchronous
+// transport. Such a transport times its own transactions for the bus budget.
+template <typename Servo>
+struct IsAsynchronousServo : std::false_type {};
+
+// Told how a write or read an asynchronous transport queued for a scheduled
+// servo turned out.
+class ServoTransactionObserver
+{
+  public:
+    // |succeeded| means the servo acknowledged the write, or a readback found
+    // |value| in the register. Failure means the servo may hold anything.
+    virtual void HandleServoWriteComplete(
+        size_t servo_index,
+        ServoRegister reg,
+        uint16_t value,
+        bool succeeded) = 0;
+
+    // |value| is only meaningful if |succeeded|.
+    virtual void HandleServoReadComplete(
+        size_t servo_index,
+        ServoRegister reg,
+        uint16_t value,
+        bool succeeded) = 0;
+
+  protected:
+    ~ServoTransactionObserver() = default;
+};
+
+// Has |servo| report its writes to |observer| as servo |servo_index|.
+// Synchronous servos know the outcome when the setter returns, so this does
+// nothing; asynchronous transports overload it for their servo type.
+template <typename Servo>
+void AttachServoTransactionObserver(Servo *servo, ServoTransactionObserver *observer, size_t servo_index)
+{
+  (void)servo;
+  (void)observer;
+  (void)servo_index;
+}
+
+// Waits until every write queued for |servo| has gone out and, where the
+// servo answers, been acknowledged. Synchronous setters already did.
+template <typename Servo>
+bool WaitForServoWrites(Servo *servo)
+{
+  (void)servo;
+  return true;
+}
+
+// Queues a read of |servo|'s present position whose answer goes to the
+// attached observer. Returns false if it could not be queued. Synchronous
+// servos are read with GetPresentPosition() instead, so only asynchronous
+// transports overload this.
+template <typename Servo>
+bool RequestServoPresentPosition(Servo *servo)
+{
+  (void)servo;
+  return false;
+}
+
+// Stand-in for a servo that queues writes on a BasicServoBusScheduler instead
+// of issuing them. Exposes the setters the mappers use, so a mapper can be
+// instantiated over it directly. Writes report success once queued; bus
+// failures surface from the scheduler's Flush(), or its TakeLostWrites() once
+// an asynchronous transport reports them. GetKnownValue() tells what the
+// servo has confirmed.
+template <typename Servo>
+class ScheduledServo
+{
+public:
+  ScheduledServo() : scheduler_{nullptr}, index_{0} {}
+  ScheduledServo(BasicServoBusScheduler<Servo> *scheduler, size_t index)
+    : scheduler_{scheduler},
+      index_{index} {}
+
+  bool SetGoalPosition(uint16_t position)
+  {
+    return Enqueue(ServoRegister::GOAL_POSITION, position, ServoCommandPriority::DIRECTION_CHANGE);
+  }
+
+  bool SetMovingSpeed(uint16_t speed)
+  {
+    return Enqueue(ServoRegister::MOVING_SPEED, speed, ServoCommandPriority::SPEED_CHANGE);
+  }
+
+  // For wheel mode, where moving speed alone starts, stops and reverses the
+  // servo, so the caller knows which of those a write is.
+  bool SetMovingSpeed(uint16_t speed, ServoCommandPriority priority)
+  {
+    return Enqueue(ServoRegister::MOVING_SPEED, speed, priority);
+  }
+
+  bool SetTorqueEnabled(bool enabled)
+  {
+    return Enqueue(
+        ServoRegister::TORQUE_ENABLE,
+        enabled,
+        enabled ? ServoCommandPriority::DIRECTION_CHANGE : ServoCommandPriority::STOP);
+  }
+
+  bool SetTorqueLimit(uint16_t limit)
+  {
+    return Enqueue(ServoRegister::TORQUE_LIMIT, limit, ServoCommandPriority::TELEMETRY);
+  }
+
+  bool SetClockWiseAngleLimit(uint16_t limit)
+  {
+    return Enqueue(ServoRegister::CW_ANGLE_LIMIT, limit, ServoCommandPriority::TELEMETRY);
+  }
+
+  bool SetCounterClockWiseAngleLimit(uint16_t limit)
+  {
+    return Enqueue(ServoRegister::CCW_ANGLE_LIMIT, limit, ServoCommandPriority::TELEMETRY);
+  }
+
+  // Queues a present position read; TakePresentPosition() returns the answer.
+  void RequestPresentPosition()
+  {
+    Enqueue(ServoRegister::PRESENT_POSITION, 0, ServoCommandPriority::TELEMETRY);
+  }
+
+  bool TakePresentPosition(
+      uint16_t *out_position,
+      std::chrono::steady_clock::time_point *out_time)
+  {
+    assert(scheduler_);
+    return scheduler_->TakePresentPosition(index_, out_position, out_time);
+  }
+
+  bool GetKnownValue(ServoRegister reg, uint16_t *out_value) const
+  {
+    assert(scheduler_);
+    return scheduler_->GetKnownValue(index_, reg, out_value);
+  }
+
+private:
+  bool Enqueue(ServoRegister reg, uint16_t value, ServoCommandPriority priority)
+  {
+    assert(scheduler_);
+    scheduler_->Enqueue(index_, reg, value, priority);
+    return true;
+  }
+
+private:
+  BasicServoBusScheduler<Servo> *scheduler_;
+  size_t index_;
+};
+
+// Orders servo bus writes by priority class and deadline.
+//
+// At most one command per (servo, register) is queued; a newer write to the
+// same register replaces the older one. Flush() issues every queued stop
+// first. The remaining commands are grouped per servo and the groups go out
+// in order of their most urgent priority, then earliest deadline; inside a
+// group the original write order is kept, since the AX-12 acts on each write
+// as it lands. Commands past their deadline are dropped. Flush() runs once
+// per report after all axes were mapped, so a stop on one axis never waits
+// behind a speed tweak on another.
+//
+// A write that expires or fails leaves the servo holding something its
+// mapper does not expect. TakeLostWrites() tells whoever flushes, so the
+// mapper can forget what it believes the registers hold.
+//
+// Every register has a shadow of the value last confirmed in it: when the
+// setter returns for a synchronous servo, and when the transport reports back
+// (HandleServoWriteComplete()) for an asynchronous one, whose setters succeed
+// as soon as the write is queued. Persistent registers are read-compare-write:
+// once ReadPersistentRegisters() has loaded what the servos hold, a write that
+// would store the same value is dropped instead of reaching the bus.
+//
+// PRESENT_POSITION reads queue like writes, at TELEMETRY priority. Their
+// answers are kept for TakePresentPosition(); one that expires or fails is
+// simply not answered, and loses no write.
+template <typename Servo>
+class BasicServoBusScheduler final : public ServoTransactionObserver
+{
+public:
+  explicit BasicServoBusScheduler(ServoBusBudget *bus_budget)
+    : bus_budget_{bus_budget},
+      servo_count_{0},
+      pending_count_{0},
+      next_sequence_{0},
+      lost_writes_{false},
+      failed_write_count_{0}
+  {
+    known_registers_.fill(0);
+    fresh_positions_.fill(false);
+    present_positions_.fill(0);
+    for (std::array<uint16_t, SERVO_REGISTER_COUNT> &values : issued_values_)
+    {
+      values.fill(0);
+    }
+  }
+
+  bool GetScheduledServo(Servo *servo, ScheduledServo<Servo> **out_servo)
+  {
+    assert(servo);
+    assert(out_servo);
+
+    if (servo_count_ == servos_.size())
+    {
+      std::cerr << "Servo bus scheduler supports at most " << servos_.size()
+                << " servos" << std::endl;
+      return false;
+    }
+
+    servos_[servo_count_] = servo;
+    scheduled_servos_[servo_count_] = ScheduledServo<Servo>{this, servo_count_};
+    AttachServoTransactionObserver(servo, this, servo_count_);
+    *out_servo = &scheduled_servos_[servo_count_];
+    ++servo_count_;
+    return true;
+  }
+
+  void Enqueue(
+      size_t servo_index,
+      ServoRegister reg,
+      uint16_t value,
+      ServoCommandPriority priority)
+  {
+    using namespace servo_scheduler_internal;
+
+    assert(servo_index < servo_count_);
+
+    auto now = std::chrono::steady_clock::now();
+    PendingCommand command;
+    command.servo_index = static_cast<uint8_t>(servo_index);
+    command.reg = reg;
+    command.value = value;
+    command.priority = priority;
+    command.sequence = next_sequence_++;
+
+    switch (priority)
+    {
+      case ServoCommandPriority::STOP:
+        command.deadline = std::chrono::steady_clock::time_point::max();
+        break;
+      case ServoCommandPriority::DIRECTION_CHANGE:
+        command.deadline = now + DIRECTION_CHANGE_DEADLINE;
+        break;
+      case ServoCommandPriority::SPEED_CHANGE:
+        command.deadline = now + SPEED_CHANGE_DEADLINE;
+        break;
+      case ServoCommandPriority::TELEMETRY:
+        command.deadline = now + TELEMETRY_DEADLINE;
+        break;
+    }
+
+    for (size_t i = 0; i < pending_count_; ++i)
+    {
+      if (pending_[i].servo_index == command.servo_index && pending_[i].reg == reg)
+      {
+        pending_[i] = command;
+        IncrementCounter(Counter::SERVO_COMMANDS_REPLACED);
+        return;
+      }
+    }
+
+    assert(pending_count_ < pending_.size());
+    pending_[pending_count_++] = command;
+  }
+
+  // Reads the persistent registers of every registered servo. Call once after
+  // registering the servos and before the first Flush(). A register that
+  // fails to read is left unknown and written unconditionally.
+  void ReadPersistentRegisters()
+  {
+    for (size_t servo_index = 0; servo_index < servo_count_; ++servo_index)
+    {
+      for (size_t i = 0; i < SERVO_REGISTER_COUNT; ++i)
+      {
+        ServoRegister reg = static_cast<ServoRegister>(i);
+        if (!IsPersistentServoRegister(reg))
+        {
+          continue;
+        }
+
+        uint16_t value;
+        if (!Read(servo_index, reg, &value))
+        {
+          std::cerr << "Failed to read servo " << servo_index << " register "
+                    << i << "; it will be rewritten" << std::endl;
+          continue;
+        }
+
+        SetKnownValue(servo_index, reg, value);
+      }
+    }
+  }
+
+  // The value last read from or confirmed written to register |reg|.
+  // Returns false if it is unknown.
+  bool GetKnownValue(size_t servo_index, ServoRegister reg, uint16_t *out_value) const
+  {
+    assert(servo_index < servo_count_);
+    assert(out_value);
+
+    if (!(known_registers_[servo_index] & GetRegisterBit(reg)))
+    {
+      return false;
+    }
+
+    *out_value = known_values_[servo_index][static_cast<size_t>(reg)];
+    return true;
+  }
+
+  // Issues queued commands, within FLUSH_TIME_BUDGET once the stops are out.
+  // Expired commands are dropped. Returns false if any write failed.
+  bool Flush()
+  {
+    return IssuePending(true);
+  }
+
+  // Issues every queued command regardless of time budget and deadlines, for
+  // configuration that must all land before control starts, and waits for
+  // the writes to complete. Returns false if any write failed. Blocks on an
+  // asynchronous transport, so never call it from an event handler.
+  bool FlushConfiguration()
+  {
+    size_t failed_write_count = failed_write_count_;
+    bool succeeded = true;
+    while (pending_count_ > 0)
+    {
+      if (!IssuePending(false))
+      {
+        succeeded = false;
+      }
+    }
+
+    for (size_t i = 0; i < servo_count_; ++i)
+    {
+      if (!WaitForServoWrites(servos_[i]))
+      {
+        succeeded = false;
+      }
+    }
+
+    return succeeded && failed_write_count_ == failed_write_count;
+  }
+
+  size_t GetPendingCount() const
+  {
+    return pending_count_;
+  }
+
+  // The present position of servo |servo_index| and when it was read, if a
+  // read answered since the last call.
+  bool TakePresentPosition(
+      size_t servo_index,
+      uint16_t *out_position,
+      std::chrono::steady_clock::time_point *out_time)
+  {
+    assert(servo_index < servo_count_);
+    assert(out_position);
+    assert(out_time);
+
+    if (!fresh_positions_[servo_index])
+    {
+      return false;
+    }
+
+    fresh_positions_[servo_index] = false;
+    *out_position = present_positions_[servo_index];
+    *out_time = present_position_times_[servo_index];
+    return true;
+  }
+
+  // Whether a write expired or failed since the last call.
+  bool TakeLostWrites()
+  {
+    bool lost_writes = lost_writes_;
+    lost_writes_ = false;
+    return lost_writes;
+  }
+
+  void HandleServoWriteComplete(
+      size_t servo_index,
+      ServoRegister reg,
+      uint16_t value,
+      bool succeeded) override
+  {
+    assert(servo_index < servo_count_);
+
+    if (!succeeded)
+    {
+      ForgetValue(servo_index, reg);
+      lost_writes_ = true;
+      ++failed_write_count_;
+      return;
+    }
+
+    // A confirmation of an older write says nothing once a newer one is out.
+    if (issued_values_[servo_index][static_cast<size_t>(reg)] == value)
+    {
+      SetKnownValue(servo_index, reg, value);
+    }
+  }
+
+  void HandleServoReadComplete(
+      size_t servo_index,
+      ServoRegister reg,
+      uint16_t value,
+      bool succeeded) override
+  {
+    assert(servo_index < servo_count_);
+    assert(reg == ServoRegister::PRESENT_POSITION);
+    (void)reg;
+
+    if (succeeded)
+    {
+      SetPresentPosition(servo_index, value);
+    }
+  }
+
+private:
+  struct PendingCommand
+  {
+    std::chrono::steady_clock::time_point deadline;
+    uint64_t sequence;
+    uint16_t value;
+    uint8_t servo_index;
+    ServoRegister reg;
+    ServoCommandPriority priority;
+  };
+
+  // With |enforce_limits| false, the time budget and deadlines are ignored.
+  bool IssuePending(bool enforce_limits)
+  {
+    using namespace servo_scheduler_internal;
+
+    if (pending_count_ == 0)
+    {
+      return true;
+    }
+
+    std::array<ServoCommandPriority, MAX_SCHEDULED_SERVOS> group_priority;
+    std::array<std::chrono::steady_clock::time_point, MAX_SCHEDULED_SERVOS> group_deadline;
+    group_priority.fill(ServoCommandPriority::TELEMETRY);
+    group_deadline.fill(std::chrono::steady_clock::time_point::max());
+
+    for (size_t i = 0; i < pending_count_; ++i)
+    {
+      const PendingCommand &command = pending_[i];
+      if (command.priority == ServoCommandPriority::STOP)
+      {
+        continue;
+      }
+
+      group_priority[command.servo_index] =
+          std::min(group_priority[command.servo_index], command.priority);
+      group_deadline[command.servo_index] =
+          std::min(group_deadline[command.servo_index], command.deadline);
+    }
+
+    std::sort(
+        pending_.begin(),
+        pending_.begin() + pending_count_,
+        [&] (const PendingCommand &lhs, const PendingCommand &rhs) {
+          bool lhs_stop = lhs.priority == ServoCommandPriority::STOP;
+          bool rhs_stop = rhs.priority == ServoCommandPriority::STOP;
+          if (lhs_stop != rhs_stop)
+          {
+            return lhs_stop;
+          }
+          if (!lhs_stop && lhs.servo_index != rhs.servo_index)
+          {
+            if (group_priority[lhs.servo_index] != group_priority[rhs.servo_index])
+            {
+              return group_priority[lhs.servo_index] < group_priority[rhs.servo_index];
+            }
+            if (group_deadline[lhs.servo_index] != group_deadline[rhs.servo_index])
+            {
+              return group_deadline[lhs.servo_index] < group_deadline[rhs.servo_index];
+            }
+            return lhs.servo_index < rhs.servo_index;
+          }
+          return lhs.sequence < rhs.sequence;
+        });
+
+    bool succeeded = true;
+    auto flush_start = std::chrono::steady_clock::now();
+    size_t issued = 0;
+
+    for (; issued < pending_count_; ++issued)
+    {
+      const PendingCommand &command = pending_[issued];
+      auto now = std::chrono::steady_clock::now();
+
+      if (enforce_limits && command.priority != ServoCommandPriority::STOP)
+      {
+        if (now - flush_start > FLUSH_TIME_BUDGET)
+        {
+          break;
+        }
+
+        if (now > command.deadline)
+        {
+          IncrementCounter(Counter::SERVO_COMMANDS_EXPIRED);
+          if (!IsReadOnlyServoRegister(command.reg))
+          {
+            lost_writes_ = true;
+          }
+          continue;
+        }
+      }
+
+      if (IsReadOnlyServoRegister(command.reg))
+      {
+        IssueRead(command);
+        continue;
+      }
+
+      if (!Issue(command))
+      {
+        lost_writes_ = true;
+        succeeded = false;
+      }
+    }
+
+    // Keep whatever the time budget cut off, in order, for the next flush.
+    std::move(pending_.begin() + issued, pending_.begin() + pending_count_, pending_.begin());
+    pending_count_ -= issued;
+    return succeeded;
+  }
+
+  uint32_t GetRegisterBit(ServoRegister reg) const
+  {
+    return 1u << static_cast<size_t>(reg);
+  }
+
+  bool IsKnownValue(size_t servo_index, ServoRegister reg, uint16_t value) const
+  {
+    return (known_registers_[servo_index] & GetRegisterBit(reg)) &&
+        known_values_[servo_index][static_cast<size_t>(reg)] == value;
+  }
+
+  void SetKnownValue(size_t servo_index, ServoRegister reg, uint16_t value)
+  {
+    known_registers_[servo_index] |= GetRegisterBit(reg);
+    known_values_[servo_index][static_cast<size_t>(reg)] = value;
+  }
+
+  void ForgetValue(size_t servo_index, ServoRegister reg)
+  {
+    known_registers_[servo_index] &= ~GetRegisterBit(reg);
+  }
+
+  void SetPresentPosition(size_t servo_index, uint16_t position)
+  {
+    present_positions_[servo_index] = position;
+    present_position_times_[servo_index] = std::chrono::steady_clock::now();
+    fresh_positions_[servo_index] = true;
+  }
+
+  void IssueRead(const PendingCommand &command)
+  {
+    assert(command.reg == ServoRegister::PRESENT_POSITION);
+
+    Servo *servo = servos_[command.servo_index];
+    if (IsAsynchronousServo<Servo>::value)
+    {
+      if (!RequestServoPresentPosition(servo))
+      {
+        XBOX_LOG_EVERY(LogLevel::ERROR, 1000, "Failed to queue servo position read");
+      }
+      return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    uint16_t position;
+    bool succeeded = servo->GetPresentPosition(&position);
+    if (bus_budget_)
+    {
+      bus_budget_->RecordTransaction(std::chrono::steady_clock::now() - start);
+    }
+
+    if (!succeeded)
+    {
+      XBOX_LOG_EVERY(
+          LogLevel::ERROR,
+          1000,
+          "Failed to read position of servo %u",
+          command.servo_index);
+      return;
+    }
+
+    SetPresentPosition(command.servo_index, position);
+  }
+
+  bool Read(size_t servo_index, ServoRegister reg, uint16_t *out_value)
+  {
+    Servo *servo = servos_[servo_index];
+    auto start = std::chrono::steady_clock::now();
+    bool succeeded = false;
+
+    switch (reg)
+    {
+      case ServoRegister::CW_ANGLE_LIMIT:
+        succeeded = servo->GetClockWiseAngleLimit(out_value);
+        break;
+      case ServoRegister::CCW_ANGLE_LIMIT:
+        succeeded = servo->GetCounterClockWiseAngleLimit(out_value);
+        break;
+      default:
+        assert(false);
+        break;
+    }
+
+    if (bus_budget_ && !IsAsynchronousServo<Servo>::value)
+    {
+      bus_budget_->RecordTransaction(std::chrono::steady_clock::now() - start);
+    }
+
+    return succeeded;
+  }
+
+  bool Issue(const PendingCommand &command)
+  {
+    if (IsPersistentServoRegister(command.reg) &&
+        IsKnownValue(command.servo_index, command.reg, command.value))
+    {
+      IncrementCounter(Counter::SERVO_WRITES_SKIPPED);
+      XBOX_TRACE3(
+          servo_write_skipped,
+          command.servo_index,
+          static_cast<uint8_t>(command.reg),
+          command.value);
+      return true;
+    }
+
+    Servo *servo = servos_[command.servo_index];
+    XBOX_TRACE4(
+        servo_write_start,
+        command.servo_index,
+        static_cast<uint8_t>(command.reg),
+        command.value,
+        GetServoWritePacketSize(command.reg));
+    auto start = std::chrono::steady_clock::now();
+    bool succeeded = false;
+
+    switch (command.reg)
+    {
+      case ServoRegister::GOAL_POSITION:
+        succeeded = servo->SetGoalPosition(command.value);
+        break;
+      case ServoRegister::MOVING_SPEED:
+        succeeded = servo->SetMovingSpeed(command.value);
+        break;
+      case ServoRegister::TORQUE_ENABLE:
+        succeeded = servo->SetTorqueEnabled(command.value != 0);
+        break;
+      case ServoRegister::TORQUE_LIMIT:
+        succeeded = servo->SetTorqueLimit(command.value);
+        break;
+      case ServoRegister::CW_ANGLE_LIMIT:
+        succeeded = servo->SetClockWiseAngleLimit(command.value);
+        break;
+      case ServoRegister::CCW_ANGLE_LIMIT:
+        succeeded = servo->SetCounterClockWiseAngleLimit(command.value);
+        break;
+      case ServoRegister::PRESENT_POSITION:
+      case ServoRegister::COUNT:
+        assert(false);
+        break;
+    }
+
+    std::chrono::nanoseconds duration = std::chrono::steady_clock::now() - start;
+    XBOX_TRACE5(
+        servo_write_end,
+        command.servo_index,
+        static_cast<uint8_t>(command.reg),
+        command.value,
+        succeeded,
+        duration.count());
+
+    if (bus_budget_ && !IsAsynchronousServo<Servo>::value)
+    {
+      bus_budget_->RecordTransaction(duration);
+    }
+
+    // Until an asynchronous write is confirmed the register may hold the old
+    // value or the new one.
+    issued_values_[command.servo_index][static_cast<size_t>(command.reg)] = command.value;
+    if (succeeded && !IsAsynchronousServo<Servo>::value)
+    {
+      SetKnownValue(command.servo_index, command.reg, command.value);
+    }
+    else
+    {
+      ForgetValue(command.servo_index, command.reg);
+    }
+
+    IncrementCounter(Counter::SERVO_WRITES);
+    if (!succeeded)
+    {
+      IncrementCounter(Counter::SERVO_WRITE_ERRORS);
+      XBOX_LOG(
+          LogLevel::ERROR,
+          "Servo write failed: servo=%u, register=%u, value=0x%x",
+          command.servo_index,
+          static_cast<unsigned int>(command.reg),
+          command.value);
+    }
+
+    return succeeded;
+  }
+
+private:
+  BasicServoBusScheduler(const BasicServoBusScheduler &other) = delete;
+  BasicServoBusScheduler& operator=(const BasicServoBusScheduler &other) = delete;
+
+private:
+  ServoBusBudget *bus_budget_;
+  std::array<Servo *, MAX_SCHEDULED_SERVOS> servos_;
+  std::array<ScheduledServo<Servo>, MAX_SCHEDULED_SERVOS> scheduled_servos_;
+  size_t servo_count_;
+  std::array<PendingCommand, MAX_SCHEDULED_SERVOS * SERVO_REGISTER_COUNT> pending_;
+  size_t pending_count_;
+  uint64_t next_sequence_;
+  bool lost_writes_;
+  // Asynchronous writes reported failed so far.
+  size_t failed_write_count_;
+  // Last value read from or confirmed written to each register, valid where
+  // the register's bit is set in |known_registers_|.
+  std::array<std::array<uint16_t, SERVO_REGISTER_COUNT>, MAX_SCHEDULED_SERVOS> known_values_;
+  std::array<uint32_t, MAX_SCHEDULED_SERVOS> known_registers_;
+  // Last value issued to each register.
+  std::array<std::array<uint16_t, SERVO_REGISTER_COUNT>, MAX_SCHEDULED_SERVOS> issued_values_;
+  // Last present position read, valid until taken where |fresh_positions_|.
+  std::array<uint16_t, MAX_SCHEDULED_SERVOS> present_positions_;
+  std::array<std::chrono::steady_clock::time_point, MAX_SCHEDULED_SERVOS> present_position_times_;
+  std::array<bool, MAX_SCHEDULED_SERVOS> fresh_positions_;
+};
+
+using ServoBusScheduler = BasicServoBusScheduler<dynamixel::AxA12>;
+using ScheduledAxA12 = ScheduledServo<dynamixel::AxA12>;
+
+// Input pipeline stage that lets the rest of the pipeline queue its servo
+// commands for a report and then flushes them onto the bus in one go.
+//
+// When writes were lost, |mapper| is told to forget its command state
+// (InvalidateCommandState()), so the next report rewrites the registers
+// instead of being de-duplicated against values the servo never received.
+template <typename Scheduler, typename Mapper>
+class ServoSchedulerFlushStage
+{
+public:
+  ServoSchedulerFlushStage() : scheduler_{nullptr}, mapper_{nullptr} {}
+  ServoSchedulerFlushStage(Scheduler *scheduler, Mapper *mapper)
+    : scheduler_{scheduler},
+      mapper_{mapper} {}
+
+  template <typename Next>
+  void operator()(Next& next, const ControllerReport &report) const
+  {
+    assert(scheduler_);
+    assert(mapper_);
+
+    if (scheduler_->TakeLostWrites())
+    {
+      mapper_->InvalidateCommandState();
+    }
+
+    next(report);
+
+    if (!scheduler_->Flush())
+    {
+      XBOX_LOG_EVERY(LogLevel::ERROR, 1000, "Failed to flush servo commands");
+    }
+
+    if (scheduler_->TakeLostWrites())
+    {
+      mapper_->InvalidateCommandState();
+    }
+  }
+
+private:
+  Scheduler *scheduler_;
+  Mapper *mapper_;
+};
+
+}  // namespace xbox
+
+#endif  // XBOXCONTROLLER_SERVOBUSSCHEDULER_H
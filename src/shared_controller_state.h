@@ -0,0 +1,56 @@
+#ifndef XBOXCONTROLLER_SHAREDCONTROLLERSTATE_H
+#define XBOXCONTROLLER_SHAREDCONTROLLERSTATE_H
+
+#include <atomic>
+#include <cstdint>
+
+#include "src/controller_report.h"
+
+namespace xbox
+{
+
+// Layout of the shared memory segment xbone publishes the live controller
+// and servo state into. Shared by ControllerStatePublisher and the header-only
+// ControllerStateReader; bump SHARED_CONTROLLER_STATE_VERSION on any change.
+
+constexpr const char* SHARED_CONTROLLER_STATE_NAME = "/xbone-controller-state";
+constexpr uint32_t SHARED_CONTROLLER_STATE_MAGIC = 0x58425354;  // "XBST"
+constexpr uint32_t SHARED_CONTROLLER_STATE_VERSION = 2;
+
+struct ServoCommandState
+{
+  uint16_t moving_speed;
+  uint16_t goal_position;
+  uint8_t torque_enabled;
+  uint8_t positive_direction;
+  uint8_t reserved[2];
+};
+
+struct ControllerStateSnapshot
+{
+  uint64_t report_count;
+  // CLOCK_MONOTONIC, comparable across processes on the same host.
+  int64_t report_timestamp_ns;
+  // Stick axes after smoothing, as the mapper saw them.
+  ControllerReport report;
+  // The same report as decoded, before smoothing.
+  ControllerReport raw_report;
+  ServoCommandState tilt;
+  ServoCommandState pan;
+};
+
+struct SharedControllerState
+{
+  uint32_t magic;
+  uint32_t version;
+  // Odd while the writer is mid-update.
+  alignas(64) std::atomic<uint32_t> sequence;
+  ControllerStateSnapshot snapshot;
+};
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2,
+              "Seqlock counter must be lock free to be shared across processes");
+
+}  // namespace xbox
+
+#endif  // XBOXCONTROLLER_SHAREDCONTROLLERSTATE_H
@@ -0,0 +1,690 @@
+#include "src/simulation.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+#include "src/metrics.h"
+#include "src/motion_planner.h"
+#include "src/periodic_timer.h"
+#include "src/wheel_mode_mapper.h"
+
+namespace
+{
+constexpr int INVALID_FD = -1;
+
+// Same size as the header ReceiveHciMonitorFrame() strips.
+constexpr size_t HCI_MONITOR_HEADER_SIZE = 6;
+
+// Full circle of the SWEEP pattern.
+constexpr double SWEEP_PERIOD_SECONDS = 2.0;
+// Dwell time per position of the STEPS pattern.
+constexpr double STEP_DURATION_SECONDS = 0.5;
+constexpr std::array<double, 8> STEP_DEFLECTIONS = {{0, 0.5, 1.0, 0.5, 0, -0.5, -1.0, -0.5}};
+// Amplitude of the jitter the RANDOM pattern adds, in normalized units.
+constexpr double RANDOM_JITTER = 0.05;
+
+// Socket send buffer for the synthetic channel. Large enough to absorb a
+// burst of catch-up frames after the process was descheduled.
+constexpr int SIMULATED_SOCKET_BUFFER_SIZE = 1 << 20;
+
+int64_t NowNanoseconds()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+double NowSeconds()
+{
+  return std::chrono::duration<double>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint16_t ToRawStickValue(double normalized)
+{
+  // Inverse of NormalizeJoystickInputScalar().
+  double raw = std::round(normalized * 0x8000 + 0x8000);
+  return static_cast<uint16_t>(std::min(std::max(raw, 0.0), 65535.0));
+}
+
+void WriteStickValue(uint8_t *payload, size_t offset, double normalized)
+{
+  uint16_t raw = ToRawStickValue(normalized);
+  payload[offset] = raw & 0xFF;
+  payload[offset + 1] = raw >> 8;
+}
+
+// Uniform in [0, 1).
+double NextRandom(uint64_t *state)
+{
+  // xorshift64*
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+  return ((*state * 0x2545F4914F6CDD1DULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+size_t ReadResidentSetKilobytes()
+{
+  FILE *statm = fopen("/proc/self/statm", "r");
+  if (!statm)
+  {
+    return 0;
+  }
+
+  unsigned long size_pages = 0;
+  unsigned long resident_pages = 0;
+  int fields = fscanf(statm, "%lu %lu", &size_pages, &resident_pages);
+  fclose(statm);
+
+  if (fields != 2)
+  {
+    return 0;
+  }
+
+  return resident_pages * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+size_t ReadPeakResidentSetKilobytes()
+{
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) < 0)
+  {
+    return 0;
+  }
+  return usage.ru_maxrss;
+}
+
+}  // namespace
+
+namespace xbox
+{
+
+bool ParseStickPattern(const std::string &name, StickPattern *out_pattern)
+{
+  assert(out_pattern);
+
+  if (name == "sweep")
+  {
+    *out_pattern = StickPattern::SWEEP;
+  }
+  else if (name == "steps")
+  {
+    *out_pattern = StickPattern::STEPS;
+  }
+  else if (name == "random")
+  {
+    *out_pattern = StickPattern::RANDOM;
+  }
+  else
+  {
+    return false;
+  }
+
+  return true;
+}
+
+SimulatedServo::SimulatedServo()
+  : position_{0},
+    position_time_{std::chrono::steady_clock::now()},
+    goal_position_{0},
+    moving_speed_{0},
+    torque_enabled_{false},
+    torque_limit_{0},
+    cw_angle_limit_{0},
+    ccw_angle_limit_{0},
+    write_count_{0} {}
+
+bool SimulatedServo::SetGoalPosition(uint16_t position)
+{
+  SettlePosition();
+  goal_position_ = position;
+  ++write_count_;
+  return true;
+}
+
+bool SimulatedServo::SetMovingSpeed(uint16_t speed)
+{
+  SettlePosition();
+  moving_speed_ = speed;
+  ++write_count_;
+  return true;
+}
+
+bool SimulatedServo::SetTorqueEnabled(bool enabled)
+{
+  torque_enabled_ = enabled;
+  ++write_count_;
+  return true;
+}
+
+bool SimulatedServo::SetTorqueLimit(uint16_t limit)
+{
+  torque_limit_ = limit;
+  ++write_count_;
+  return true;
+}
+
+bool SimulatedServo::SetClockWiseAngleLimit(uint16_t limit)
+{
+  SettlePosition();
+  cw_angle_limit_ = limit;
+  ++write_count_;
+  return true;
+}
+
+bool SimulatedServo::SetCounterClockWiseAngleLimit(uint16_t limit)
+{
+  SettlePosition();
+  ccw_angle_limit_ = limit;
+  ++write_count_;
+  return true;
+}
+
+bool SimulatedServo::GetPresentPosition(uint16_t *out_position) const
+{
+  assert(out_position);
+
+  *out_position = static_cast<uint16_t>(std::lround(GetPosition(std::chrono::steady_clock::now())));
+  return true;
+}
+
+bool SimulatedServo::GetTorqueLimit(uint16_t *out_limit) const
+{
+  assert(out_limit);
+  *out_limit = torque_limit_;
+  return true;
+}
+
+bool SimulatedServo::GetClockWiseAngleLimit(uint16_t *out_limit) const
+{
+  assert(out_limit);
+  *out_limit = cw_angle_limit_;
+  return true;
+}
+
+bool SimulatedServo::GetCounterClockWiseAngleLimit(uint16_t *out_limit) const
+{
+  assert(out_limit);
+  *out_limit = ccw_angle_limit_;
+  return true;
+}
+
+uint64_t SimulatedServo::GetWriteCount() const
+{
+  return write_count_;
+}
+
+double SimulatedServo::GetPosition(std::chrono::steady_clock::time_point now) const
+{
+  using namespace wheel_mode_internal;
+
+  double elapsed = std::chrono::duration<double>(now - position_time_).count();
+  if (cw_angle_limit_ != WHEEL_MODE_ANGLE_LIMIT || ccw_angle_limit_ != WHEEL_MODE_ANGLE_LIMIT)
+  {
+    // A joint mode speed of 0 is the servo's top speed.
+    uint16_t speed = moving_speed_ & WHEEL_SPEED_MAGNITUDE_MASK;
+    double step = (speed == 0 ? WHEEL_SPEED_MAGNITUDE_MASK : speed)
+        * POSITION_UNITS_PER_SPEED_UNIT_SECOND * elapsed;
+    double distance = goal_position_ - position_;
+    return std::abs(distance) <= step ? goal_position_ : position_ + std::copysign(step, distance);
+  }
+
+  double position = position_ +
+      DecodeWheelSpeed(moving_speed_) * POSITION_UNITS_PER_SPEED_UNIT_SECOND * elapsed;
+  // Wheel mode turns endlessly; the register wraps with the horn.
+  position = std::fmod(position, 1024.0);
+  return position < 0 ? position + 1024.0 : std::min(position, 1023.0);
+}
+
+void SimulatedServo::SettlePosition()
+{
+  auto now = std::chrono::steady_clock::now();
+  position_ = GetPosition(now);
+  position_time_ = now;
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+  Reset();
+}
+
+void LatencyHistogram::Record(std::chrono::nanoseconds latency)
+{
+  uint64_t latency_ns = static_cast<uint64_t>(std::max<int64_t>(latency.count(), 1));
+  size_t bucket = 63 - __builtin_clzll(latency_ns);
+  ++buckets_[bucket];
+  ++count_;
+  max_ns_ = std::max<int64_t>(max_ns_, latency_ns);
+}
+
+std::chrono::nanoseconds LatencyHistogram::GetQuantile(double quantile) const
+{
+  if (count_ == 0)
+  {
+    return std::chrono::nanoseconds{0};
+  }
+
+  uint64_t target = static_cast<uint64_t>(std::ceil(quantile * count_));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < buckets_.size(); ++i)
+  {
+    seen += buckets_[i];
+    if (seen >= target)
+    {
+      int64_t upper_bound_ns = (i + 1 < 63) ? (int64_t{1} << (i + 1)) : max_ns_;
+      return std::chrono::nanoseconds{std::min(upper_bound_ns, max_ns_)};
+    }
+  }
+
+  return std::chrono::nanoseconds{max_ns_};
+}
+
+std::chrono::nanoseconds LatencyHistogram::GetMax() const
+{
+  return std::chrono::nanoseconds{max_ns_};
+}
+
+uint64_t LatencyHistogram::GetCount() const
+{
+  return count_;
+}
+
+void LatencyHistogram::Reset()
+{
+  buckets_.fill(0);
+  count_ = 0;
+  max_ns_ = 0;
+}
+
+bool SyntheticReportGenerator::Create(
+    double report_rate_hz,
+    size_t controller_count,
+    StickPattern pattern,
+    SimulationStats *stats,
+    SyntheticReportGenerator *out_generator,
+    int *out_channel_fd)
+{
+  assert(report_rate_hz > 0);
+  assert(controller_count > 0);
+  assert(stats);
+  assert(out_generator);
+  assert(out_channel_fd);
+
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds) < 0)
+  {
+    std::cerr << "Failed to create simulated channel. Error: " << strerror(errno) << std::endl;
+    return false;
+  }
+
+  int buffer_size = SIMULATED_SOCKET_BUFFER_SIZE;
+  setsockopt(fds[1], SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof(buffer_size));
+  setsockopt(fds[0], SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+
+  // Each tick emits one report per controller.
+  std::chrono::nanoseconds period{static_cast<int64_t>(1e9 / report_rate_hz)};
+  int timer_fd;
+  if (!OpenPeriodicTimer(period, &timer_fd))
+  {
+    std::cerr << "Failed to open synthetic report timer" << std::endl;
+    close(fds[0]);
+    close(fds[1]);
+    return false;
+  }
+
+  *out_generator = SyntheticReportGenerator{
+      timer_fd,
+      fds[1],
+      controller_count,
+      pattern,
+      stats};
+  *out_channel_fd = fds[0];
+  return true;
+}
+
+SyntheticReportGenerator::SyntheticReportGenerator()
+  : initialized_{false},
+    timer_fd_{INVALID_FD},
+    socket_fd_{INVALID_FD} {}
+
+SyntheticReportGenerator::SyntheticReportGenerator(
+    int timer_fd,
+    int socket_fd,
+    size_t controller_count,
+    StickPattern pattern,
+    SimulationStats *stats)
+  : initialized_{true},
+    timer_fd_{timer_fd},
+    socket_fd_{socket_fd},
+    controller_count_{controller_count},
+    pattern_{pattern},
+    stats_{stats},
+    random_state_{0x9E3779B97F4A7C15ULL},
+    start_seconds_{NowSeconds()} {}
+
+SyntheticReportGenerator::SyntheticReportGenerator(SyntheticReportGenerator &&other)
+  : initialized_{false},
+    timer_fd_{INVALID_FD},
+    socket_fd_{INVALID_FD}
+{
+  StealResources(&other);
+}
+
+SyntheticReportGenerator& SyntheticReportGenerator::operator=(SyntheticReportGenerator &&other)
+{
+  if (this != &other)
+  {
+    Close();
+    StealResources(&other);
+  }
+  return *this;
+}
+
+SyntheticReportGenerator::~SyntheticReportGenerator()
+{
+  Close();
+}
+
+int SyntheticReportGenerator::GetFd() const
+{
+  assert(initialized_);
+  return timer_fd_;
+}
+
+void SyntheticReportGenerator::HandlePacket()
+{
+  assert(initialized_);
+
+  // Ticks missed while descheduled are made up, so the offered load matches
+  // the configured rate on average.
+  uint64_t expirations = ReadTimerExpirations(timer_fd_);
+  double time_seconds = NowSeconds() - start_seconds_;
+
+  for (uint64_t tick = 0; tick < expirations; ++tick)
+  {
+    for (size_t controller = 0; controller < controller_count_; ++controller)
+    {
+      SendReport(controller, time_seconds);
+    }
+  }
+}
+
+void SyntheticReportGenerator::SendReport(size_t controller_index, double time_seconds)
+{
+  uint8_t frame[HCI_MONITOR_HEADER_SIZE + SIMULATED_FRAME_PAYLOAD_SIZE] = {};
+  uint8_t *payload = frame + HCI_MONITOR_HEADER_SIZE;
+
+  FillReport(controller_index, time_seconds, payload);
+
+  int64_t sent_ns = NowNanoseconds();
+  memcpy(payload + SIMULATED_FRAME_TIMESTAMP_OFFSET, &sent_ns, sizeof(sent_ns));
+  payload[SIMULATED_FRAME_TIMESTAMP_OFFSET + sizeof(sent_ns)] =
+      static_cast<uint8_t>(controller_index);
+
+  if (send(socket_fd_, frame, sizeof(frame), MSG_DONTWAIT) < 0)
+  {
+    ++stats_->frames_send_failed;
+    return;
+  }
+
+  ++stats_->frames_sent;
+}
+
+void SyntheticReportGenerator::FillReport(
+    size_t controller_index,
+    double time_seconds,
+    uint8_t *payload)
+{
+  // Controllers run the same pattern, spread evenly in phase.
+  double phase = static_cast<double>(controller_index) / controller_count_;
+  double x = 0;
+  double y = 0;
+
+  switch (pattern_)
+  {
+    case StickPattern::SWEEP:
+    {
+      double angle = 2.0 * M_PI * (time_seconds / SWEEP_PERIOD_SECONDS + phase);
+      x = std::sin(angle);
+      y = std::cos(angle);
+      break;
+    }
+    case StickPattern::STEPS:
+    {
+      size_t step = static_cast<size_t>(
+          time_seconds / STEP_DURATION_SECONDS + phase * STEP_DEFLECTIONS.size());
+      x = STEP_DEFLECTIONS[step % STEP_DEFLECTIONS.size()];
+      y = STEP_DEFLECTIONS[(step + 2) % STEP_DEFLECTIONS.size()];
+      break;
+    }
+    case StickPattern::RANDOM:
+    {
+      double dx = NextRandom(&random_state_);
+      double dy = NextRandom(&random_state_);
+      double angle = 2.0 * M_PI * (time_seconds / SWEEP_PERIOD_SECONDS + phase);
+      x = std::sin(angle) + RANDOM_JITTER * (2.0 * dx - 1.0);
+      y = std::cos(angle) + RANDOM_JITTER * (2.0 * dy - 1.0);
+      break;
+    }
+  }
+
+  WriteStickValue(payload, 10, x);
+  WriteStickValue(payload, 12, y);
+  WriteStickValue(payload, 14, 0);
+  WriteStickValue(payload, 16, 0);
+}
+
+void SyntheticReportGenerator::Close()
+{
+  if (!initialized_)
+  {
+    return;
+  }
+
+  close(timer_fd_);
+  close(socket_fd_);
+  timer_fd_ = INVALID_FD;
+  socket_fd_ = INVALID_FD;
+  initialized_ = false;
+}
+
+void SyntheticReportGenerator::StealResources(SyntheticReportGenerator *other)
+{
+  assert(other);
+
+  initialized_ = other->initialized_;
+  other->initialized_ = false;
+  timer_fd_ = other->timer_fd_;
+  other->timer_fd_ = INVALID_FD;
+  socket_fd_ = other->socket_fd_;
+  other->socket_fd_ = INVALID_FD;
+  controller_count_ = other->controller_count_;
+  pattern_ = other->pattern_;
+  stats_ = other->stats_;
+  random_state_ = other->random_state_;
+  start_seconds_ = other->start_seconds_;
+}
+
+bool SimulationStatsReporter::Create(
+    std::chrono::seconds interval,
+    SimulationStats *stats,
+    const SimulatedServo *tilt_servo,
+    const SimulatedServo *pan_servo,
+    SimulationStatsReporter *out_reporter)
+{
+  assert(stats);
+  assert(tilt_servo);
+  assert(pan_servo);
+  assert(out_reporter);
+
+  int timer_fd;
+  if (!OpenPeriodicTimer(interval, &timer_fd))
+  {
+    std::cerr << "Failed to open simulation stats timer" << std::endl;
+    return false;
+  }
+
+  *out_reporter = SimulationStatsReporter{timer_fd, stats, tilt_servo, pan_servo};
+  return true;
+}
+
+SimulationStatsReporter::SimulationStatsReporter()
+  : initialized_{false},
+    timer_fd_{INVALID_FD} {}
+
+SimulationStatsReporter::SimulationStatsReporter(
+    int timer_fd,
+    SimulationStats *stats,
+    const SimulatedServo *tilt_servo,
+    const SimulatedServo *pan_servo)
+  : initialized_{true},
+    timer_fd_{timer_fd},
+    stats_{stats},
+    tilt_servo_{tilt_servo},
+    pan_servo_{pan_servo},
+    start_{std::chrono::steady_clock::now()},
+    last_report_{start_},
+    last_reports_completed_{0} {}
+
+SimulationStatsReporter::SimulationStatsReporter(SimulationStatsReporter &&other)
+  : initialized_{false},
+    timer_fd_{INVALID_FD}
+{
+  StealResources(&other);
+}
+
+SimulationStatsReporter& SimulationStatsReporter::operator=(SimulationStatsReporter &&other)
+{
+  if (this != &other)
+  {
+    Close();
+    StealResources(&other);
+  }
+  return *this;
+}
+
+SimulationStatsReporter::~SimulationStatsReporter()
+{
+  Close();
+}
+
+int SimulationStatsReporter::GetFd() const
+{
+  assert(initialized_);
+  return timer_fd_;
+}
+
+void SimulationStatsReporter::HandlePacket()
+{
+  assert(initialized_);
+
+  if (ReadTimerExpirations(timer_fd_) == 0)
+  {
+    return;
+  }
+
+  PrintReport();
+}
+
+void SimulationStatsReporter::PrintReport()
+{
+  assert(initialized_);
+
+  auto now = std::chrono::steady_clock::now();
+  double elapsed_seconds = std::chrono::duration<double>(now - start_).count();
+  double interval_seconds = std::chrono::duration<double>(now - last_report_).count();
+  uint64_t interval_reports = stats_->reports_completed - last_reports_completed_;
+
+  const LatencyHistogram &latency = stats_->interval_latency;
+  printf(
+      "[simulate] t=%.0fs reports=%" PRIu64 " rate=%.0f/s sent=%" PRIu64
+      " send_failed=%" PRIu64 " latency_us p50=%.1f p99=%.1f p999=%.1f max=%.1f"
+      " total_max=%.1f servo_writes=%" PRIu64 " rejected=%" PRId64
+      " rss_kb=%zu peak_rss_kb=%zu\n",
+      elapsed_seconds,
+      stats_->reports_completed,
+      interval_seconds > 0 ? interval_reports / interval_seconds : 0.0,
+      stats_->frames_sent,
+      stats_->frames_send_failed,
+      latency.GetQuantile(0.5).count() / 1e3,
+      latency.GetQuantile(0.99).count() / 1e3,
+      latency.GetQuantile(0.999).count() / 1e3,
+      latency.GetMax().count() / 1e3,
+      stats_->total_latency.GetMax().count() / 1e3,
+      tilt_servo_->GetWriteCount() + pan_servo_->GetWriteCount(),
+      ReadCounter(Counter::PACKETS_REJECTED),
+      ReadResidentSetKilobytes(),
+      ReadPeakResidentSetKilobytes());
+  fflush(stdout);
+
+  stats_->interval_latency.Reset();
+  last_report_ = now;
+  last_reports_completed_ = stats_->reports_completed;
+}
+
+void SimulationStatsReporter::PrintSummary() const
+{
+  assert(initialized_);
+
+  double elapsed_seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start_).count();
+
+  const LatencyHistogram &latency = stats_->total_latency;
+  printf(
+      "[simulate] summary duration=%.0fs reports=%" PRIu64 " rate=%.0f/s sent=%" PRIu64
+      " send_failed=%" PRIu64 " latency_us p50=%.1f p99=%.1f p999=%.1f max=%.1f"
+      " servo_writes=%" PRIu64 " rss_kb=%zu peak_rss_kb=%zu\n",
+      elapsed_seconds,
+      stats_->reports_completed,
+      elapsed_seconds > 0 ? stats_->reports_completed / elapsed_seconds : 0.0,
+      stats_->frames_sent,
+      stats_->frames_send_failed,
+      latency.GetQuantile(0.5).count() / 1e3,
+      latency.GetQuantile(0.99).count() / 1e3,
+      latency.GetQuantile(0.999).count() / 1e3,
+      latency.GetMax().count() / 1e3,
+      tilt_servo_->GetWriteCount() + pan_servo_->GetWriteCount(),
+      ReadResidentSetKilobytes(),
+      ReadPeakResidentSetKilobytes());
+  fflush(stdout);
+}
+
+void SimulationStatsReporter::Close()
+{
+  if (!initialized_)
+  {
+    return;
+  }
+
+  close(timer_fd_);
+  timer_fd_ = INVALID_FD;
+  initialized_ = false;
+}
+
+void SimulationStatsReporter::StealResources(SimulationStatsReporter *other)
+{
+  assert(other);
+
+  initialized_ = other->initialized_;
+  other->initialized_ = false;
+  timer_fd_ = other->timer_fd_;
+  other->timer_fd_ = INVALID_FD;
+  stats_ = other->stats_;
+  tilt_servo_ = other->tilt_servo_;
+  pan_servo_ = other->pan_servo_;
+  start_ = other->start_;
+  last_report_ = other->last_report_;
+  last_reports_completed_ = other->last_reports_completed_;
+}
+
+}  // namespace xbox
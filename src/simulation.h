@@ -0,0 +1,241 @@
+#ifndef XBOXCONTROLLER_SIMULATION_H
+#define XBOXCONTROLLER_SIMULATION_H
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "src/controller_report.h"
+#include "src/event_handler.h"
+
+namespace xbox
+{
+
+// Synthetic frames carry the report followed by this trailer, which the
+// decoder ignores: the send timestamp in steady_clock nanoseconds and the
+// index of the controller that produced the report.
+constexpr size_t SIMULATED_FRAME_TIMESTAMP_OFFSET = CONTROLLER_REPORT_SIZE;
+constexpr size_t SIMULATED_FRAME_PAYLOAD_SIZE = CONTROLLER_REPORT_SIZE + sizeof(int64_t) + 1;
+
+enum class StickPattern : uint8_t
+{
+  // Both axes trace a circle at full deflection.
+  SWEEP,
+  // Jumps between rest, half and full deflection in both directions.
+  STEPS,
+  // SWEEP with uniform jitter, so the sticks keep crossing speed buckets.
+  RANDOM,
+};
+
+bool ParseStickPattern(const std::string &name, StickPattern *out_pattern);
+
+// In-memory stand-in for dynamixel::AxA12. Writes land in a register shadow
+// and are counted; nothing touches a bus. In joint mode the horn heads for
+// the goal at the moving speed; in wheel mode it turns at it.
+class SimulatedServo
+{
+public:
+  SimulatedServo();
+  bool SetGoalPosition(uint16_t position);
+  bool SetMovingSpeed(uint16_t speed);
+  bool SetTorqueEnabled(bool enabled);
+  bool SetTorqueLimit(uint16_t limit);
+  bool SetClockWiseAngleLimit(uint16_t limit);
+  bool SetCounterClockWiseAngleLimit(uint16_t limit);
+  bool GetPresentPosition(uint16_t *out_position) const;
+  bool GetTorqueLimit(uint16_t *out_limit) const;
+  bool GetClockWiseAngleLimit(uint16_t *out_limit) const;
+  bool GetCounterClockWiseAngleLimit(uint16_t *out_limit) const;
+  uint64_t GetWriteCount() const;
+
+private:
+  SimulatedServo(const SimulatedServo &other) = delete;
+  SimulatedServo& operator=(const SimulatedServo &other) = delete;
+
+private:
+  double GetPosition(std::chrono::steady_clock::time_point now) const;
+  // Fixes the position before a write changes how it moves.
+  void SettlePosition();
+
+private:
+  // Position at |position_time_|.
+  double position_;
+  std::chrono::steady_clock::time_point position_time_;
+  uint16_t goal_position_;
+  uint16_t moving_speed_;
+  bool torque_enabled_;
+  uint16_t torque_limit_;
+  uint16_t cw_angle_limit_;
+  uint16_t ccw_angle_limit_;
+  uint64_t write_count_;
+};
+
+// Log2-bucketed latency histogram. Recording is a count-leading-zeros and an
+// increment, so it is cheap enough to run on every report.
+class LatencyHistogram
+{
+public:
+  LatencyHistogram();
+  void Record(std::chrono::nanoseconds latency);
+  // Upper bound of the bucket holding the |quantile| sample.
+  std::chrono::nanoseconds GetQuantile(double quantile) const;
+  std::chrono::nanoseconds GetMax() const;
+  uint64_t GetCount() const;
+  void Reset();
+
+private:
+  static constexpr size_t BUCKET_COUNT = 64;
+
+private:
+  std::array<uint64_t, BUCKET_COUNT> buckets_;
+  uint64_t count_;
+  int64_t max_ns_;
+};
+
+struct SimulationStats
+{
+  uint64_t frames_sent;
+  uint64_t frames_send_failed;
+  uint64_t reports_completed;
+  // Per interval; reset whenever stats are printed.
+  LatencyHistogram interval_latency;
+  LatencyHistogram total_latency;
+};
+
+// Produces synthetic controller frames on a timer and writes them into one
+// end of a socketpair. The other end behaves like the HCI monitor socket, so
+// BluetoothChannel and the rest of the pipeline run unmodified.
+class SyntheticReportGenerator : public EventHandler
+{
+public:
+  static bool Create(
+      double report_rate_hz,
+      size_t controller_count,
+      StickPattern pattern,
+      SimulationStats *stats,
+      SyntheticReportGenerator *out_generator,
+      int *out_channel_fd);
+
+public:
+  SyntheticReportGenerator();
+  SyntheticReportGenerator(
+      int timer_fd,
+      int socket_fd,
+      size_t controller_count,
+      StickPattern pattern,
+      SimulationStats *stats);
+  SyntheticReportGenerator(SyntheticReportGenerator &&other);
+  SyntheticReportGenerator& operator=(SyntheticReportGenerator &&other);
+  ~SyntheticReportGenerator();
+  int GetFd() const override;
+  void HandlePacket() override;
+
+private:
+  void SendReport(size_t controller_index, double time_seconds);
+  void FillReport(size_t controller_index, double time_seconds, uint8_t *payload);
+  void Close();
+  void StealResources(SyntheticReportGenerator *other);
+
+private:
+  SyntheticReportGenerator(const SyntheticReportGenerator &other) = delete;
+  SyntheticReportGenerator& operator=(const SyntheticReportGenerator &other) = delete;
+
+private:
+  bool initialized_;
+  int timer_fd_;
+  int socket_fd_;
+  size_t controller_count_;
+  StickPattern pattern_;
+  SimulationStats *stats_;
+  uint64_t random_state_;
+  double start_seconds_;
+};
+
+// Periodically prints throughput, latency and memory statistics.
+class SimulationStatsReporter : public EventHandler
+{
+public:
+  static bool Create(
+      std::chrono::seconds interval,
+      SimulationStats *stats,
+      const SimulatedServo *tilt_servo,
+      const SimulatedServo *pan_servo,
+      SimulationStatsReporter *out_reporter);
+
+public:
+  SimulationStatsReporter();
+  SimulationStatsReporter(
+      int timer_fd,
+      SimulationStats *stats,
+      const SimulatedServo *tilt_servo,
+      const SimulatedServo *pan_servo);
+  SimulationStatsReporter(SimulationStatsReporter &&other);
+  SimulationStatsReporter& operator=(SimulationStatsReporter &&other);
+  ~SimulationStatsReporter();
+  int GetFd() const override;
+  void HandlePacket() override;
+  void PrintReport();
+  // Whole-run totals, for the end of a bounded run.
+  void PrintSummary() const;
+
+private:
+  void Close();
+  void StealResources(SimulationStatsReporter *other);
+
+private:
+  SimulationStatsReporter(const SimulationStatsReporter &other) = delete;
+  SimulationStatsReporter& operator=(const SimulationStatsReporter &other) = delete;
+
+private:
+  bool initialized_;
+  int timer_fd_;
+  SimulationStats *stats_;
+  const SimulatedServo *tilt_servo_;
+  const SimulatedServo *pan_servo_;
+  std::chrono::steady_clock::time_point start_;
+  std::chrono::steady_clock::time_point last_report_;
+  uint64_t last_reports_completed_;
+};
+
+// BluetoothChannel callback wrapping an input pipeline. Measures the time from
+// a synthetic frame being generated to the pipeline finishing with it.
+template <typename Pipeline>
+class SimulationLatencyProbe
+{
+public:
+  SimulationLatencyProbe() : stats_{nullptr} {}
+  SimulationLatencyProbe(Pipeline &&pipeline, SimulationStats *stats)
+    : pipeline_{std::move(pipeline)},
+      stats_{stats} {}
+
+  void operator()(const uint8_t *buffer, size_t buffer_size)
+  {
+    pipeline_(buffer, buffer_size);
+
+    if (buffer_size < SIMULATED_FRAME_PAYLOAD_SIZE)
+    {
+      return;
+    }
+
+    int64_t sent_ns;
+    memcpy(&sent_ns, buffer + SIMULATED_FRAME_TIMESTAMP_OFFSET, sizeof(sent_ns));
+    std::chrono::nanoseconds latency{
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count() - sent_ns};
+
+    ++stats_->reports_completed;
+    stats_->interval_latency.Record(latency);
+    stats_->total_latency.Record(latency);
+  }
+
+private:
+  Pipeline pipeline_;
+  SimulationStats *stats_;
+};
+
+}  // namespace xbox
+
+#endif  // XBOXCONTROLLER_SIMULATION_H
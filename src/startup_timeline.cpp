@@ -0,0 +1,146 @@
+#include "src/startup_timeline.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace
+{
+constexpr int64_t UNRECORDED = -1;
+
+const std::array<const char*, xbox::STARTUP_PHASE_COUNT> STARTUP_PHASE_NAMES =
+{{
+  "monitor_channel",
+  "bluetooth_connect",
+  "servo_bus",
+  "servo_configuration",
+}};
+
+double ToMilliseconds(int64_t ns)
+{
+  return ns / 1e6;
+}
+}  // namespace
+
+namespace xbox
+{
+
+StartupTimeline::StartupTimeline()
+  : origin_{std::chrono::steady_clock::now()},
+    reported_{false}
+{
+  for (size_t i = 0; i < STARTUP_PHASE_COUNT; ++i)
+  {
+    begin_ns_[i].store(UNRECORDED, std::memory_order_relaxed);
+    end_ns_[i].store(UNRECORDED, std::memory_order_relaxed);
+  }
+}
+
+void StartupTimeline::BeginPhase(StartupPhase phase)
+{
+  begin_ns_[static_cast<size_t>(phase)].store(GetElapsedNs(), std::memory_order_release);
+}
+
+void StartupTimeline::EndPhase(StartupPhase phase)
+{
+  end_ns_[static_cast<size_t>(phase)].store(GetElapsedNs(), std::memory_order_release);
+}
+
+void StartupTimeline::PrintReport(std::ostream &out) const
+{
+  char line[128];
+  int64_t last_end_ns = 0;
+  int64_t total_duration_ns = 0;
+
+  out << "Startup timing (ms since start):" << std::endl;
+  snprintf(line, sizeof(line), "  %-20s %10s %10s %10s", "phase", "begin", "end", "duration");
+  out << line << std::endl;
+
+  for (size_t i = 0; i < STARTUP_PHASE_COUNT; ++i)
+  {
+    int64_t begin_ns = begin_ns_[i].load(std::memory_order_acquire);
+    int64_t end_ns = end_ns_[i].load(std::memory_order_acquire);
+    if (begin_ns == UNRECORDED)
+    {
+      continue;
+    }
+
+    if (end_ns == UNRECORDED)
+    {
+      snprintf(
+          line,
+          sizeof(line),
+          "  %-20s %10.1f %10s %10s",
+          STARTUP_PHASE_NAMES[i],
+          ToMilliseconds(begin_ns),
+          "-",
+          "-");
+      out << line << std::endl;
+      continue;
+    }
+
+    last_end_ns = std::max(last_end_ns, end_ns);
+    total_duration_ns += end_ns - begin_ns;
+    snprintf(
+        line,
+        sizeof(line),
+        "  %-20s %10.1f %10.1f %10.1f",
+        STARTUP_PHASE_NAMES[i],
+        ToMilliseconds(begin_ns),
+        ToMilliseconds(end_ns),
+        ToMilliseconds(end_ns - begin_ns));
+    out << line << std::endl;
+  }
+
+  int64_t first_command_ns =
+      end_ns_[static_cast<size_t>(StartupPhase::SERVO_CONFIGURATION)].load(std::memory_order_acquire);
+  if (first_command_ns != UNRECORDED)
+  {
+    snprintf(line, sizeof(line), "  time to first servo command: %.1f ms", ToMilliseconds(first_command_ns));
+    out << line << std::endl;
+  }
+
+  snprintf(
+      line,
+      sizeof(line),
+      "  startup wall clock: %.1f ms (%.1f ms if run serially)",
+      ToMilliseconds(last_end_ns),
+      ToMilliseconds(total_duration_ns));
+  out << line << std::endl;
+}
+
+void StartupTimeline::PrintReportOnceComplete(std::ostream &out)
+{
+  if (!IsComplete() || reported_.exchange(true, std::memory_order_acq_rel))
+  {
+    return;
+  }
+
+  PrintReport(out);
+}
+
+int64_t StartupTimeline::GetElapsedNs() const
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - origin_).count();
+}
+
+bool StartupTimeline::IsComplete() const
+{
+  if (end_ns_[static_cast<size_t>(StartupPhase::SERVO_CONFIGURATION)].load(std::memory_order_acquire) ==
+      UNRECORDED)
+  {
+    return false;
+  }
+
+  for (size_t i = 0; i < STARTUP_PHASE_COUNT; ++i)
+  {
+    if (begin_ns_[i].load(std::memory_order_acquire) != UNRECORDED &&
+        end_ns_[i].load(std::memory_order_acquire) == UNRECORDED)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace xbox
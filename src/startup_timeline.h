@@ -0,0 +1,58 @@
+#ifndef XBOXCONTROLLER_STARTUPTIMELINE_H
+#define XBOXCONTROLLER_STARTUPTIMELINE_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+namespace xbox
+{
+
+enum class StartupPhase : size_t
+{
+  MONITOR_CHANNEL,
+  BLUETOOTH_CONNECT,
+  SERVO_BUS,
+  // Ends once the initial configuration, including the neutral goal
+  // position, has been written: the first servo command of the run.
+  SERVO_CONFIGURATION,
+  COUNT,
+};
+
+constexpr size_t STARTUP_PHASE_COUNT = static_cast<size_t>(StartupPhase::COUNT);
+
+// Wall-clock start and end of each startup phase, relative to construction.
+// Phases run on different threads; recording is lock-free.
+class StartupTimeline
+{
+public:
+  StartupTimeline();
+  void BeginPhase(StartupPhase phase);
+  void EndPhase(StartupPhase phase);
+  void PrintReport(std::ostream &out) const;
+  // Prints the report the first time it is called once SERVO_CONFIGURATION
+  // and every other phase that began have ended. Call it after ending each
+  // phase, so whichever finishes last prints.
+  void PrintReportOnceComplete(std::ostream &out);
+
+private:
+  StartupTimeline(const StartupTimeline &other) = delete;
+  StartupTimeline& operator=(const StartupTimeline &other) = delete;
+
+private:
+  int64_t GetElapsedNs() const;
+  bool IsComplete() const;
+
+private:
+  std::chrono::steady_clock::time_point origin_;
+  // Nanoseconds since |origin_|, or -1 while not yet recorded.
+  std::array<std::atomic<int64_t>, STARTUP_PHASE_COUNT> begin_ns_;
+  std::array<std::atomic<int64_t>, STARTUP_PHASE_COUNT> end_ns_;
+  std::atomic<bool> reported_;
+};
+
+}  // namespace xbox
+
+#endif  // XBOXCONTROLLER_STARTUPTIMELINE_H
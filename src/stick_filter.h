@@ -0,0 +1,157 @@
+#ifndef XBOXCONTROLLER_STICKFILTER_H
+#define XBOXCONTROLLER_STICKFILTER_H
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+
+#include "src/controller_report.h"
+
+namespace xbox
+{
+
+struct OneEuroFilterConfig
+{
+  // Cutoff applied while the input is still. Lower removes more jitter.
+  double min_cutoff_hz;
+  // How quickly the cutoff opens up with input speed. Higher cuts lag.
+  double beta;
+  // Cutoff for the speed estimate itself.
+  double derivative_cutoff_hz;
+};
+
+// Defaults tuned on normalized [-1, 1] stick values: steady holds get about
+// 1 Hz of bandwidth, a full-range flick opens the filter past 10 Hz.
+constexpr OneEuroFilterConfig DEFAULT_STICK_FILTER_CONFIG = {1.0, 0.5, 1.0};
+
+// Adaptive low-pass filter (Casiez et al., "1 Euro Filter"). The cutoff
+// follows the estimated input speed, so slow drift and sensor noise are
+// smoothed heavily while fast motion passes with little lag. Constant time,
+// no allocation.
+class OneEuroFilter
+{
+public:
+  OneEuroFilter() : OneEuroFilter{DEFAULT_STICK_FILTER_CONFIG} {}
+
+  explicit OneEuroFilter(const OneEuroFilterConfig &config)
+    : config_{config},
+      initialized_{false},
+      value_{0},
+      derivative_{0},
+      timestamp_seconds_{0} {}
+
+  double Filter(double value, double timestamp_seconds)
+  {
+    if (!initialized_)
+    {
+      initialized_ = true;
+      value_ = value;
+      derivative_ = 0;
+      timestamp_seconds_ = timestamp_seconds;
+      return value_;
+    }
+
+    double elapsed_seconds = timestamp_seconds - timestamp_seconds_;
+    if (elapsed_seconds <= 0)
+    {
+      return value_;
+    }
+    timestamp_seconds_ = timestamp_seconds;
+
+    double raw_derivative = (value - value_) / elapsed_seconds;
+    derivative_ += Alpha(config_.derivative_cutoff_hz, elapsed_seconds)
+        * (raw_derivative - derivative_);
+
+    double cutoff_hz = config_.min_cutoff_hz + config_.beta * std::abs(derivative_);
+    value_ += Alpha(cutoff_hz, elapsed_seconds) * (value - value_);
+    return value_;
+  }
+
+  void Reset()
+  {
+    initialized_ = false;
+  }
+
+private:
+  static double Alpha(double cutoff_hz, double elapsed_seconds)
+  {
+    double time_constant = 1.0 / (2.0 * M_PI * cutoff_hz);
+    return 1.0 / (1.0 + time_constant / elapsed_seconds);
+  }
+
+private:
+  OneEuroFilterConfig config_;
+  bool initialized_;
+  double value_;
+  double derivative_;
+  double timestamp_seconds_;
+};
+
+// Input pipeline stage that smooths the four stick axes of every report
+// before passing it on. Triggers and buttons are left untouched.
+class StickSmoothingStage
+{
+public:
+  enum Axis
+  {
+    LEFT_STICK_X,
+    LEFT_STICK_Y,
+    RIGHT_STICK_X,
+    RIGHT_STICK_Y,
+    AXIS_COUNT,
+  };
+
+public:
+  StickSmoothingStage()
+  {
+    filters_.fill(OneEuroFilter{DEFAULT_STICK_FILTER_CONFIG});
+  }
+
+  explicit StickSmoothingStage(const OneEuroFilterConfig &config)
+  {
+    filters_.fill(OneEuroFilter{config});
+  }
+
+  explicit StickSmoothingStage(const std::array<OneEuroFilterConfig, AXIS_COUNT> &configs)
+  {
+    for (size_t i = 0; i < filters_.size(); ++i)
+    {
+      filters_[i] = OneEuroFilter{configs[i]};
+    }
+  }
+
+  template <typename Next>
+  void operator()(Next& next, const ControllerReport &report)
+  {
+    double timestamp_seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    ControllerReport smoothed = report;
+    smoothed.left_stick_x = Smooth(LEFT_STICK_X, report.left_stick_x, timestamp_seconds);
+    smoothed.left_stick_y = Smooth(LEFT_STICK_Y, report.left_stick_y, timestamp_seconds);
+    smoothed.right_stick_x = Smooth(RIGHT_STICK_X, report.right_stick_x, timestamp_seconds);
+    smoothed.right_stick_y = Smooth(RIGHT_STICK_Y, report.right_stick_y, timestamp_seconds);
+    next(smoothed);
+  }
+
+private:
+  uint16_t Smooth(Axis axis, uint16_t raw_value, double timestamp_seconds)
+  {
+    double filtered = filters_[axis].Filter(
+        NormalizeJoystickInputScalar(raw_value),
+        timestamp_seconds);
+
+    // Inverse of NormalizeJoystickInputScalar().
+    double raw = std::round(filtered * 0x8000 + 0x8000);
+    return static_cast<uint16_t>(std::min(std::max(raw, 0.0), 65535.0));
+  }
+
+private:
+  std::array<OneEuroFilter, AXIS_COUNT> filters_;
+};
+
+}  // namespace xbox
+
+#endif  // XBOXCONTROLLER_STICKFILTER_H
@@ -0,0 +1,124 @@
+#include "src/teleop_channel.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+
+#include <cstdlib>
+#include <iostream>
+
+namespace xbox
+{
+
+bool ParseTeleopAddress(const std::string &spec, struct sockaddr_in *out_address)
+{
+  assert(out_address);
+
+  size_t colon = spec.rfind(':');
+  if (colon == std::string::npos || colon + 1 == spec.size())
+  {
+    std::cerr << "Expected host:port, got \"" << spec << "\"" << std::endl;
+    return false;
+  }
+
+  std::string host = spec.substr(0, colon);
+  std::string port = spec.substr(colon + 1);
+
+  char *end;
+  unsigned long port_value = strtoul(port.c_str(), &end, 10);
+  if (*end != '\0' || port_value == 0 || port_value > 0xFFFF)
+  {
+    std::cerr << "Invalid port \"" << port << "\"" << std::endl;
+    return false;
+  }
+
+  memset(out_address, 0, sizeof(*out_address));
+  out_address->sin_family = AF_INET;
+  out_address->sin_port = htons(static_cast<uint16_t>(port_value));
+  if (host.empty())
+  {
+    out_address->sin_addr.s_addr = htonl(INADDR_ANY);
+  }
+  else if (inet_pton(AF_INET, host.c_str(), &out_address->sin_addr) != 1)
+  {
+    std::cerr << "Invalid IPv4 address \"" << host << "\"" << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+bool OpenTeleopSocket(const std::string &address, int *out_fd)
+{
+  assert(out_fd);
+
+  struct sockaddr_in bind_address;
+  if (!ParseTeleopAddress(address, &bind_address))
+  {
+    return false;
+  }
+
+  int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+  {
+    std::cerr << "Failed to open teleop socket. Error: " << strerror(errno) << std::endl;
+    return false;
+  }
+
+  if (bind(fd, reinterpret_cast<struct sockaddr *>(&bind_address), sizeof(bind_address)) < 0)
+  {
+    std::cerr << "Failed to bind teleop socket to " << address << ". Error: "
+              << strerror(errno) << std::endl;
+    close(fd);
+    return false;
+  }
+
+  *out_fd = fd;
+  return true;
+}
+
+int ReceiveTeleopBatch(int fd, TeleopReceiveBatch *batch)
+{
+  assert(batch);
+
+  struct mmsghdr messages[TELEOP_RECEIVE_BATCH_SIZE];
+  struct iovec iovs[TELEOP_RECEIVE_BATCH_SIZE];
+  memset(messages, 0, sizeof(messages));
+
+  for (size_t i = 0; i < TELEOP_RECEIVE_BATCH_SIZE; ++i)
+  {
+    iovs[i].iov_base = batch->buffers[i].data();
+    iovs[i].iov_len = batch->buffers[i].size();
+    messages[i].msg_hdr.msg_iov = &iovs[i];
+    messages[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  int count = recvmmsg(fd, messages, TELEOP_RECEIVE_BATCH_SIZE, MSG_DONTWAIT, nullptr);
+  if (count < 0)
+  {
+    if (errno != EAGAIN && errno != EWOULDBLOCK)
+    {
+      XBOX_LOG(LogLevel::ERROR, "Failed to receive teleop datagrams: %s", strerror(errno));
+    }
+    return -1;
+  }
+
+  for (int i = 0; i < count; ++i)
+  {
+    batch->sizes[i] = (messages[i].msg_hdr.msg_flags & MSG_TRUNC) != 0
+        ? 0
+        : messages[i].msg_len;
+  }
+  return count;
+}
+
+int64_t GetTeleopClockNanoseconds()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+}  // namespace xbox
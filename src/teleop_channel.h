@@ -0,0 +1,401 @@
+#ifndef XBOXCONTROLLER_TELEOPCHANNEL_H
+#define XBOXCONTROLLER_TELEOPCHANNEL_H
+
+#include <netinet/in.h>
+#include <unistd.h>
+
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include "src/event_handler.h"
+#include "src/logger.h"
+#include "src/metrics.h"
+#include "src/teleop_protocol.h"
+#include "src/tracepoints.h"
+
+namespace xbox
+{
+namespace teleop_channel_internal
+{
+// A datagram delayed by more than the session's best delivery moves that
+// baseline up by this fraction of the difference, so clock drift between the
+// hosts is absorbed while a burst of late datagrams barely shifts it.
+constexpr int64_t DELAY_BASELINE_RISE_DIVISOR = 1024;
+}  // namespace teleop_channel_internal
+
+// Datagrams taken per recvmmsg(). A station sending at the controller's
+// report rate never queues this many between two wakeups, so one call usually
+// drains the socket.
+constexpr size_t TELEOP_RECEIVE_BATCH_SIZE = 16;
+
+struct TeleopReceiveBatch
+{
+  std::array<std::array<uint8_t, TELEOP_DATAGRAM_SIZE>, TELEOP_RECEIVE_BATCH_SIZE> buffers;
+  // 0 for datagrams that did not fit their buffer.
+  std::array<size_t, TELEOP_RECEIVE_BATCH_SIZE> sizes;
+};
+
+// Parses "host:port" into an IPv4 address. An empty host means any address.
+bool ParseTeleopAddress(const std::string &spec, struct sockaddr_in *out_address);
+
+// Opens a non-blocking UDP socket bound to |address|, "host:port".
+bool OpenTeleopSocket(const std::string &address, int *out_fd);
+
+// Receives up to TELEOP_RECEIVE_BATCH_SIZE datagrams with one recvmmsg().
+// Returns how many arrived, or a negative value on error.
+int ReceiveTeleopBatch(int fd, TeleopReceiveBatch *batch);
+
+// CLOCK_REALTIME, the clock send timestamps are taken on. One-way latency is
+// only meaningful if both hosts keep it synchronized (NTP or PTP).
+int64_t GetTeleopClockNanoseconds();
+
+// Event loop handler for datagrams from a remote operator station.
+//
+// |Callback| receives the payload of every accepted datagram, exactly as
+// BasicBluetoothChannel hands over monitor frames, so both channels can feed
+// the same input pipeline. Anything not accepted is counted and dropped,
+// since a late report would undo a newer one.
+//
+// Sessions and sequence numbers only move forward. Within the current
+// session a datagram must be newer than the last accepted one. A higher
+// session (a restarted station) takes over only once the current one has
+// been quiet for |session_timeout|, judged by our own clock at receive time;
+// a lower one is never accepted again.
+//
+// Unless |max_delay| is zero, a datagram is also dropped if it took more than
+// |max_delay| longer to arrive than the fastest one of its session. Comparing
+// against the session's own best delivery cancels the offset between the
+// hosts' clocks, so they need not be synchronized.
+template <typename Callback>
+class BasicTeleopChannel final : public EventHandler
+{
+public:
+  using PacketCallback = Callback;
+
+public:
+  static bool Create(
+      const std::string &address,
+      PacketCallback &&callback,
+      std::chrono::nanoseconds max_delay,
+      std::chrono::nanoseconds session_timeout,
+      BasicTeleopChannel *out_channel);
+
+public:
+  BasicTeleopChannel();
+  BasicTeleopChannel(
+      int fd,
+      PacketCallback &&callback,
+      std::chrono::nanoseconds max_delay,
+      std::chrono::nanoseconds session_timeout);
+  BasicTeleopChannel(BasicTeleopChannel &&other);
+  BasicTeleopChannel& operator=(BasicTeleopChannel &&other);
+  ~BasicTeleopChannel();
+  int GetFd() const override;
+  void HandlePacket() override;
+
+private:
+  bool Accept(
+      const TeleopDatagram &datagram,
+      int64_t latency_ns,
+      std::chrono::steady_clock::time_point receive_time);
+  void Close();
+  void StealResources(BasicTeleopChannel *other);
+
+private:
+  BasicTeleopChannel(const BasicTeleopChannel &other) = delete;
+  BasicTeleopChannel& operator=(const BasicTeleopChannel &other) = delete;
+
+private:
+  bool initialized_;
+  int fd_;
+  PacketCallback callback_;
+  std::chrono::nanoseconds max_delay_;
+  std::chrono::nanoseconds session_timeout_;
+  bool has_session_;
+  uint32_t session_;
+  uint32_t last_sequence_;
+  std::chrono::steady_clock::time_point last_receive_time_;
+  // Send-to-receive time of the session's fastest datagram, clock offset
+  // included.
+  int64_t delay_baseline_ns_;
+};
+
+template <typename Callback>
+bool BasicTeleopChannel<Callback>::Create(
+    const std::string &address,
+    PacketCallback &&callback,
+    std::chrono::nanoseconds max_delay,
+    std::chrono::nanoseconds session_timeout,
+    BasicTeleopChannel *out_channel)
+{
+  assert(out_channel);
+
+  int fd;
+  if (!OpenTeleopSocket(address, &fd))
+  {
+    return false;
+  }
+
+  *out_channel = BasicTeleopChannel{fd, std::move(callback), max_delay, session_timeout};
+  return true;
+}
+
+template <typename Callback>
+BasicTeleopChannel<Callback>::BasicTeleopChannel()
+  : initialized_{false},
+    fd_{-1},
+    callback_{},
+    max_delay_{0},
+    session_timeout_{0},
+    has_session_{false},
+    session_{0},
+    last_sequence_{0},
+    last_receive_time_{},
+    delay_baseline_ns_{0} {}
+
+template <typename Callback>
+BasicTeleopChannel<Callback>::BasicTeleopChannel(
+    int fd,
+    PacketCallback &&callback,
+    std::chrono::nanoseconds max_delay,
+    std::chrono::nanoseconds session_timeout)
+  : initialized_{true},
+    fd_{fd},
+    callback_{std::move(callback)},
+    max_delay_{max_delay},
+    session_timeout_{session_timeout},
+    has_session_{false},
+    session_{0},
+    last_sequence_{0},
+    last_receive_time_{},
+    delay_baseline_ns_{0} {}
+
+template <typename Callback>
+BasicTeleopChannel<Callback>::BasicTeleopChannel(BasicTeleopChannel &&other)
+  : initialized_{false},
+    fd_{-1},
+    callback_{},
+    max_delay_{0},
+    session_timeout_{0},
+    has_session_{false},
+    session_{0},
+    last_sequence_{0},
+    last_receive_time_{},
+    delay_baseline_ns_{0}
+{
+  StealResources(&other);
+}
+
+template <typename Callback>
+BasicTeleopChannel<Callback>& BasicTeleopChannel<Callback>::operator=(
+    BasicTeleopChannel &&other)
+{
+  if (&other != this)
+  {
+    Close();
+    StealResources(&other);
+  }
+
+  return *this;
+}
+
+template <typename Callback>
+BasicTeleopChannel<Callback>::~BasicTeleopChannel()
+{
+  Close();
+}
+
+template <typename Callback>
+int BasicTeleopChannel<Callback>::GetFd() const
+{
+  assert(initialized_);
+  return fd_;
+}
+
+template <typename Callback>
+void BasicTeleopChannel<Callback>::HandlePacket()
+{
+  assert(initialized_);
+
+  TeleopReceiveBatch batch;
+  int count = ReceiveTeleopBatch(fd_, &batch);
+  if (count <= 0)
+  {
+    return;
+  }
+
+  // One read of each clock per batch: datagrams later in it waited just as
+  // long.
+  int64_t now_ns = GetTeleopClockNanoseconds();
+  auto receive_time = std::chrono::steady_clock::now();
+  for (int i = 0; i < count; ++i)
+  {
+    TeleopDatagram datagram;
+    if (!DecodeTeleopDatagram(batch.buffers[i].data(), batch.sizes[i], &datagram))
+    {
+      IncrementCounter(Counter::TELEOP_DATAGRAMS_REJECTED);
+      continue;
+    }
+
+    int64_t latency_ns = now_ns - datagram.send_timestamp_ns;
+    if (!Accept(datagram, latency_ns, receive_time))
+    {
+      continue;
+    }
+
+    IncrementCounter(Counter::TELEOP_DATAGRAMS_RECEIVED);
+    SetGauge(Gauge::TELEOP_LATENCY_NS, latency_ns);
+    XBOX_TRACE2(teleop_datagram, datagram.sequence, latency_ns);
+    callback_(datagram.payload, sizeof(datagram.payload));
+  }
+}
+
+template <typename Callback>
+bool BasicTeleopChannel<Callback>::Accept(
+    const TeleopDatagram &datagram,
+    int64_t latency_ns,
+    std::chrono::steady_clock::time_point receive_time)
+{
+  using namespace teleop_channel_internal;
+
+  bool new_session = !has_session_ || datagram.session != session_;
+  if (new_session && has_session_ &&
+      (datagram.session < session_ || receive_time - last_receive_time_ < session_timeout_))
+  {
+    IncrementCounter(Counter::TELEOP_DATAGRAMS_WRONG_SESSION);
+    return false;
+  }
+
+  if (!new_session && !IsTeleopSequenceNewer(datagram.sequence, last_sequence_))
+  {
+    IncrementCounter(Counter::TELEOP_DATAGRAMS_OUT_OF_ORDER);
+    return false;
+  }
+
+  if (new_session || latency_ns < delay_baseline_ns_)
+  {
+    delay_baseline_ns_ = latency_ns;
+  }
+  else
+  {
+    delay_baseline_ns_ += (latency_ns - delay_baseline_ns_) / DELAY_BASELINE_RISE_DIVISOR;
+  }
+
+  if (max_delay_.count() != 0 && latency_ns - delay_baseline_ns_ > max_delay_.count())
+  {
+    IncrementCounter(Counter::TELEOP_DATAGRAMS_STALE);
+    return false;
+  }
+
+  if (new_session)
+  {
+    XBOX_LOG(
+        LogLevel::INFO,
+        "Teleop session %08x started at sequence %u",
+        datagram.session,
+        datagram.sequence);
+    has_session_ = true;
+    session_ = datagram.session;
+  }
+
+  last_sequence_ = datagram.sequence;
+  last_receive_time_ = receive_time;
+  return true;
+}
+
+template <typename Callback>
+void BasicTeleopChannel<Callback>::Close()
+{
+  if (!initialized_)
+  {
+    return;
+  }
+
+  close(fd_);
+  fd_ = -1;
+  initialized_ = false;
+}
+
+template <typename Callback>
+void BasicTeleopChannel<Callback>::StealResources(BasicTeleopChannel *other)
+{
+  assert(other);
+
+  initialized_ = other->initialized_;
+  other->initialized_ = false;
+  fd_ = other->fd_;
+  other->fd_ = -1;
+  callback_ = std::move(other->callback_);
+  max_delay_ = other->max_delay_;
+  session_timeout_ = other->session_timeout_;
+  has_session_ = other->has_session_;
+  session_ = other->session_;
+  last_sequence_ = other->last_sequence_;
+  last_receive_time_ = other->last_receive_time_;
+  delay_baseline_ns_ = other->delay_baseline_ns_;
+}
+
+// Arbitrates between the local controller and a remote station feeding the
+// same input pipeline, the way BasicExternalControlArbiter arbitrates between
+// stick and tracker: the station wins while its session is fresh, that is
+// while its last accepted datagram arrived less than |hold| ago by our own
+// clock. Local frames are dropped meanwhile and pass again once the station
+// goes quiet.
+//
+// Stands in for |Pipeline| as the Bluetooth channel's callback; the teleop
+// channel hands its datagrams to HandleRemoteFrame().
+template <typename Pipeline>
+class TeleopInputArbiter
+{
+public:
+  TeleopInputArbiter() : pipeline_{}, hold_{0}, has_remote_{false}, last_remote_time_{} {}
+  TeleopInputArbiter(Pipeline &&pipeline, std::chrono::nanoseconds hold)
+    : pipeline_{std::move(pipeline)},
+      hold_{hold},
+      has_remote_{false},
+      last_remote_time_{} {}
+
+  // A frame from the local controller.
+  void operator()(const uint8_t *buffer, size_t length)
+  {
+    if (has_remote_)
+    {
+      if (std::chrono::steady_clock::now() - last_remote_time_ < hold_)
+      {
+        IncrementCounter(Counter::TELEOP_LOCAL_FRAMES_OVERRIDDEN);
+        return;
+      }
+
+      XBOX_LOG(LogLevel::INFO, "Teleop station went quiet; the local controller has control");
+      has_remote_ = false;
+    }
+
+    pipeline_(buffer, length);
+  }
+
+  void HandleRemoteFrame(const uint8_t *buffer, size_t length)
+  {
+    if (!has_remote_)
+    {
+      XBOX_LOG(LogLevel::INFO, "Teleop station has control");
+      has_remote_ = true;
+    }
+
+    last_remote_time_ = std::chrono::steady_clock::now();
+    pipeline_(buffer, length);
+  }
+
+private:
+  Pipeline pipeline_;
+  std::chrono::nanoseconds hold_;
+  bool has_remote_;
+  std::chrono::steady_clock::time_point last_remote_time_;
+};
+
+}  // namespace xbox
+
+#endif  // XBOXCONTROLLER_TELEOPCHANNEL_H
@@ -0,0 +1,110 @@
+#ifndef XBOXCONTROLLER_TELEOPPROTOCOL_H
+#define XBOXCONTROLLER_TELEOPPROTOCOL_H
+
+#include <endian.h>
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "src/controller_report.h"
+
+namespace xbox
+{
+
+// Wire format of the UDP datagrams a remote operator station drives xbone
+// with. One datagram carries one controller report, little endian:
+//
+//   0  magic             "XBTP"
+//   4  version
+//   5  reserved[3]
+//   8  session           higher for every sender run than for the last
+//   12 sequence          +1 per datagram within a session
+//   16 send_timestamp_ns CLOCK_REALTIME when the datagram was sent
+//   24 payload           the controller's HID report, as on the HCI monitor
+//                        channel (doc/packet-traces/packet-structure.txt)
+//
+// Carrying the raw report keeps the receiver on the Bluetooth decode path and
+// lets a station forward its local controller's frames untouched.
+
+constexpr uint32_t TELEOP_DATAGRAM_MAGIC = 0x50544258;  // "XBTP"
+constexpr uint8_t TELEOP_DATAGRAM_VERSION = 1;
+constexpr size_t TELEOP_DATAGRAM_HEADER_SIZE = 24;
+constexpr size_t TELEOP_DATAGRAM_SIZE = TELEOP_DATAGRAM_HEADER_SIZE + CONTROLLER_REPORT_SIZE;
+
+struct TeleopDatagram
+{
+  uint32_t session;
+  uint32_t sequence;
+  int64_t send_timestamp_ns;
+  uint8_t payload[CONTROLLER_REPORT_SIZE];
+};
+
+// Whether |sequence| comes after |last| in serial number arithmetic, so the
+// counter may wrap.
+inline bool IsTeleopSequenceNewer(uint32_t sequence, uint32_t last)
+{
+  return static_cast<int32_t>(sequence - last) > 0;
+}
+
+// Writes TELEOP_DATAGRAM_SIZE bytes into |buffer|.
+inline void EncodeTeleopDatagram(const TeleopDatagram &datagram, uint8_t *buffer)
+{
+  assert(buffer);
+
+  uint32_t magic = htole32(TELEOP_DATAGRAM_MAGIC);
+  uint32_t session = htole32(datagram.session);
+  uint32_t sequence = htole32(datagram.sequence);
+  uint64_t send_timestamp_ns = htole64(static_cast<uint64_t>(datagram.send_timestamp_ns));
+
+  memcpy(buffer, &magic, sizeof(magic));
+  buffer[4] = TELEOP_DATAGRAM_VERSION;
+  memset(buffer + 5, 0, 3);
+  memcpy(buffer + 8, &session, sizeof(session));
+  memcpy(buffer + 12, &sequence, sizeof(sequence));
+  memcpy(buffer + 16, &send_timestamp_ns, sizeof(send_timestamp_ns));
+  memcpy(buffer + TELEOP_DATAGRAM_HEADER_SIZE, datagram.payload, sizeof(datagram.payload));
+}
+
+// Fails on anything but a complete datagram of the current version.
+inline bool DecodeTeleopDatagram(
+    const uint8_t *buffer,
+    size_t buffer_size,
+    TeleopDatagram *out_datagram)
+{
+  assert(buffer);
+  assert(out_datagram);
+
+  if (buffer_size != TELEOP_DATAGRAM_SIZE)
+  {
+    return false;
+  }
+
+  uint32_t magic;
+  memcpy(&magic, buffer, sizeof(magic));
+  if (le32toh(magic) != TELEOP_DATAGRAM_MAGIC || buffer[4] != TELEOP_DATAGRAM_VERSION)
+  {
+    return false;
+  }
+
+  uint32_t session;
+  uint32_t sequence;
+  uint64_t send_timestamp_ns;
+  memcpy(&session, buffer + 8, sizeof(session));
+  memcpy(&sequence, buffer + 12, sizeof(sequence));
+  memcpy(&send_timestamp_ns, buffer + 16, sizeof(send_timestamp_ns));
+
+  out_datagram->session = le32toh(session);
+  out_datagram->sequence = le32toh(sequence);
+  out_datagram->send_timestamp_ns = static_cast<int64_t>(le64toh(send_timestamp_ns));
+  memcpy(
+      out_datagram->payload,
+      buffer + TELEOP_DATAGRAM_HEADER_SIZE,
+      sizeof(out_datagram->payload));
+  return true;
+}
+
+}  // namespace xbox
+
+#endif  // XBOXCONTROLLER_TELEOPPROTOCOL_H
@@ -0,0 +1,60 @@
+#ifndef XBOXCONTROLLER_TRACEPOINTS_H
+#define XBOXCONTROLLER_TRACEPOINTS_H
+
+// USDT static probes under the "xbone" provider.
+//
+// With <sys/sdt.h> (systemtap-sdt-dev) available, each probe compiles to a
+// single nop plus an ELF note describing where its arguments live, so it is
+// free until perf, bpftrace or SystemTap attaches to it:
+//
+//   bpftrace -e 'usdt:./xbone:xbone:servo_write_end { @[arg1] = hist(arg4); }'
+//
+// Without the header the probes compile away and their arguments are not
+// evaluated. Probe arguments must be integers or pointers.
+//
+// Probes:
+//   frame_received(fd, bytes)
+//   frame_dropped(fd)
+//   teleop_datagram(sequence, latency_ns)
+//   report_decoded(left_stick_x, left_stick_y, right_stick_x, right_stick_y, button_mask)
+//   report_rejected(bytes)
+//   mapper_input(servo, value_milli, target_speed, positive_direction)
+//   mapper_rate_limited(servo, planned_writes)
+//   mapper_stop(servo, previous_speed)
+//   servo_write_start(servo_index, register, value, packet_bytes)
+//   servo_write_end(servo_index, register, value, succeeded, duration_ns)
+//   servo_write_skipped(servo_index, register, value)
+
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define XBOX_HAVE_SDT 1
+#endif
+#endif
+
+#ifdef XBOX_HAVE_SDT
+
+#define XBOX_TRACE1(name, a1) DTRACE_PROBE1(xbone, name, a1)
+#define XBOX_TRACE2(name, a1, a2) DTRACE_PROBE2(xbone, name, a1, a2)
+#define XBOX_TRACE3(name, a1, a2, a3) DTRACE_PROBE3(xbone, name, a1, a2, a3)
+#define XBOX_TRACE4(name, a1, a2, a3, a4) DTRACE_PROBE4(xbone, name, a1, a2, a3, a4)
+#define XBOX_TRACE5(name, a1, a2, a3, a4, a5) DTRACE_PROBE5(xbone, name, a1, a2, a3, a4, a5)
+
+#else
+
+#define XBOX_TRACE1(name, a1) \
+  do { (void)sizeof(a1); } while (0)
+#define XBOX_TRACE2(name, a1, a2) \
+  do { (void)sizeof(a1); (void)sizeof(a2); } while (0)
+#define XBOX_TRACE3(name, a1, a2, a3) \
+  do { (void)sizeof(a1); (void)sizeof(a2); (void)sizeof(a3); } while (0)
+#define XBOX_TRACE4(name, a1, a2, a3, a4) \
+  do { (void)sizeof(a1); (void)sizeof(a2); (void)sizeof(a3); (void)sizeof(a4); } while (0)
+#define XBOX_TRACE5(name, a1, a2, a3, a4, a5) \
+  do { \
+    (void)sizeof(a1); (void)sizeof(a2); (void)sizeof(a3); (void)sizeof(a4); (void)sizeof(a5); \
+  } while (0)
+
+#endif  // XBOX_HAVE_SDT
+
+#endif  // XBOXCONTROLLER_TRACEPOINTS_H
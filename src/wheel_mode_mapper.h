@@ -0,0 +1,540 @@
+#ifndef XBOXCONTROLLER_WHEELMODEMAPPER_H
+#define XBOXCONTROLLER_WHEELMODEMAPPER_H
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+
+#include "src/controller_report.h"
+#include "src/event_handler.h"
+#include "src/joystick_input_to_servo_action_mapper.h"
+#include "src/logger.h"
+#include "src/metrics.h"
+#include "src/motion_planner.h"
+#include "src/periodic_timer.h"
+#include "src/servo_bus_scheduler.h"
+#include "src/shared_controller_state.h"
+
+namespace xbox
+{
+namespace wheel_mode_internal
+{
+// Both angle limits at 0 put the AX-12 in wheel (endless turn) mode.
+constexpr uint16_t WHEEL_MODE_ANGLE_LIMIT = 0;
+// In wheel mode bits 0-9 of the moving speed are the output and bit 10 turns
+// clockwise, towards lower positions.
+constexpr uint16_t WHEEL_SPEED_MAGNITUDE_MASK = 0x3FF;
+constexpr uint16_t WHEEL_SPEED_CLOCKWISE = 0x400;
+// Control periods between present position reads that correct the model.
+constexpr uint32_t POSITION_CORRECTION_PERIODS = 5;
+}  // namespace wheel_mode_internal
+
+// Moving speed register value for a signed wheel speed; positive turns
+// towards higher positions, like the joint mode mappers.
+inline uint16_t EncodeWheelSpeed(int32_t velocity)
+{
+  using namespace wheel_mode_internal;
+
+  uint16_t magnitude = static_cast<uint16_t>(
+      std::min<int32_t>(std::abs(velocity), WHEEL_SPEED_MAGNITUDE_MASK));
+  return velocity < 0 ? (magnitude | WHEEL_SPEED_CLOCKWISE) : magnitude;
+}
+
+// Inverse of EncodeWheelSpeed().
+inline int32_t DecodeWheelSpeed(uint16_t speed)
+{
+  using namespace wheel_mode_internal;
+
+  int32_t magnitude = speed & WHEEL_SPEED_MAGNITUDE_MASK;
+  return (speed & WHEEL_SPEED_CLOCKWISE) ? -magnitude : magnitude;
+}
+
+// Drives the pan/tilt servos in wheel mode, purely through signed moving
+// speed: starting, stopping and reversing an axis are each one register
+// write, with no goal position or torque toggling.
+//
+// Wheel mode has no hardware travel limits, so each axis keeps a position
+// model, seeded from the servo's present position at startup and advanced by
+// the speed the servo last confirmed (POSITION_UNITS_PER_SPEED_UNIT_SECOND);
+// a speed that is only queued, or was dropped, does not move the model. A
+// move is stopped once the model, looking one control period ahead, would
+// cross the joint mode limits; the control timer re-checks them between
+// reports, since a held stick sends none. The AX-12 treats wheel mode speed
+// as an output ratio, not a regulated speed, so the model drifts under load.
+// Every POSITION_CORRECTION_PERIODS control periods the timer queues a
+// present position read, and each answer resets the model to where the horn
+// was read; the limits sit inside the mechanical range to absorb the drift
+// in between.
+//
+// Both axes are stopped when the mapper is destroyed. A process that dies
+// without running destructors leaves them turning.
+template <typename Servo, typename Scheduler>
+class BasicWheelModeMapper final : public EventHandler
+{
+public:
+  static bool Create(
+      Servo *tilt_servo,
+      Servo *pan_servo,
+      Scheduler *scheduler,
+      std::chrono::nanoseconds control_period,
+      uint16_t tilt_position,
+      uint16_t pan_position,
+      BasicWheelModeMapper *out_mapper);
+
+public:
+  BasicWheelModeMapper();
+  BasicWheelModeMapper(
+      int timer_fd,
+      Scheduler *scheduler,
+      std::chrono::nanoseconds control_period,
+      Servo *tilt_servo,
+      Servo *pan_servo,
+      uint16_t tilt_position,
+      uint16_t pan_position);
+  BasicWheelModeMapper(BasicWheelModeMapper &&other);
+  BasicWheelModeMapper& operator=(BasicWheelModeMapper &&other);
+  ~BasicWheelModeMapper();
+  int GetFd() const override;
+  void HandlePacket() override;
+  void ProcessReport(const ControllerReport &report);
+  ServoCommandState GetTiltCommandState() const;
+  ServoCommandState GetPanCommandState() const;
+  // Forgets the speeds last written, after writes were lost. The next
+  // report or control tick rewrites them.
+  void InvalidateCommandState();
+
+private:
+  struct WheelAxis
+  {
+    Servo *servo;
+    // Estimated position at |model_time|.
+    double position;
+    double model_time;
+    // Signed speed the servo last confirmed, which moves the model.
+    int32_t velocity;
+    // Signed speed last written, and the one the stick asks for.
+    int32_t commanded_velocity;
+    int32_t requested_velocity;
+    // Whether the servo is expected to end up at |commanded_velocity|.
+    bool known;
+  };
+
+  enum Axis
+  {
+    TILT,
+    PAN,
+    AXIS_COUNT,
+  };
+
+  static double NowSeconds();
+  static double ToSeconds(std::chrono::steady_clock::time_point time);
+  static void AdvanceModel(WheelAxis *axis, double now);
+  static void UpdateModel(WheelAxis *axis, double now);
+  bool DriveAxis(WheelAxis *axis, double now);
+  static ServoCommandState GetAxisCommandState(const WheelAxis &axis);
+  void Close();
+  void StealResources(BasicWheelModeMapper *other);
+
+private:
+  BasicWheelModeMapper(const BasicWheelModeMapper &other) = delete;
+  BasicWheelModeMapper& operator=(const BasicWheelModeMapper &other) = delete;
+
+private:
+  bool initialized_;
+  int timer_fd_;
+  Scheduler *scheduler_;
+  double lookahead_seconds_;
+  uint32_t periods_since_correction_;
+  std::array<WheelAxis, AXIS_COUNT> axes_;
+};
+
+using WheelModeMapper = BasicWheelModeMapper<ScheduledAxA12, ServoBusScheduler>;
+
+template <typename Servo, typename Scheduler>
+bool BasicWheelModeMapper<Servo, Scheduler>::Create(
+    Servo *tilt_servo,
+    Servo *pan_servo,
+    Scheduler *scheduler,
+    std::chrono::nanoseconds control_period,
+    uint16_t tilt_position,
+    uint16_t pan_position,
+    BasicWheelModeMapper *out_mapper)
+{
+  using namespace joystick_mapper_internal;
+  using namespace wheel_mode_internal;
+
+  assert(tilt_servo);
+  assert(pan_servo);
+  assert(scheduler);
+  assert(out_mapper);
+
+  // In joint mode a moving speed of 0 means full speed, so the servos are
+  // brought to rest before the limits change and that 0 starts meaning stop.
+  for (Servo *servo : {tilt_servo, pan_servo})
+  {
+    if (!servo->SetTorqueEnabled(false) ||
+        !servo->SetMovingSpeed(0, ServoCommandPriority::STOP))
+    {
+      XBOX_LOG(LogLevel::ERROR, "Failed to stop servo before entering wheel mode");
+      return false;
+    }
+  }
+
+  if (!scheduler->FlushConfiguration())
+  {
+    XBOX_LOG(LogLevel::ERROR, "Failed to stop servos before entering wheel mode");
+    return false;
+  }
+
+  for (Servo *servo : {tilt_servo, pan_servo})
+  {
+    if (!servo->SetClockWiseAngleLimit(WHEEL_MODE_ANGLE_LIMIT) ||
+        !servo->SetCounterClockWiseAngleLimit(WHEEL_MODE_ANGLE_LIMIT))
+    {
+      XBOX_LOG(LogLevel::ERROR, "Failed to put servo in wheel mode");
+      return false;
+    }
+
+    if (!servo->SetTorqueLimit(MAX_TORQUE))
+    {
+      XBOX_LOG(LogLevel::ERROR, "Failed to initialize servo with max torque");
+      return false;
+    }
+
+    // Stays on: speed 0 holds the horn, and no transition toggles it.
+    if (!servo->SetTorqueEnabled(true))
+    {
+      XBOX_LOG(LogLevel::ERROR, "Failed to enable servo torque");
+      return false;
+    }
+  }
+
+  int timer_fd;
+  if (!OpenPeriodicTimer(control_period, &timer_fd))
+  {
+    XBOX_LOG(LogLevel::ERROR, "Failed to open wheel mode control timer");
+    return false;
+  }
+
+  *out_mapper = BasicWheelModeMapper{
+      timer_fd,
+      scheduler,
+      control_period,
+      tilt_servo,
+      pan_servo,
+      tilt_position,
+      pan_position};
+  return true;
+}
+
+template <typename Servo, typename Scheduler>
+BasicWheelModeMapper<Servo, Scheduler>::BasicWheelModeMapper()
+  : initialized_{false},
+    timer_fd_{-1},
+    scheduler_{nullptr},
+    lookahead_seconds_{0},
+    periods_since_correction_{0} {}
+
+template <typename Servo, typename Scheduler>
+BasicWheelModeMapper<Servo, Scheduler>::BasicWheelModeMapper(
+    int timer_fd,
+    Scheduler *scheduler,
+    std::chrono::nanoseconds control_period,
+    Servo *tilt_servo,
+    Servo *pan_servo,
+    uint16_t tilt_position,
+    uint16_t pan_position)
+  : initialized_{true},
+    timer_fd_{timer_fd},
+    scheduler_{scheduler},
+    lookahead_seconds_{std::chrono::duration<double>(control_period).count()},
+    periods_since_correction_{0}
+{
+  double now = NowSeconds();
+  axes_[TILT] = WheelAxis{tilt_servo, static_cast<double>(tilt_position), now, 0, 0, 0, true};
+  axes_[PAN] = WheelAxis{pan_servo, static_cast<double>(pan_position), now, 0, 0, 0, true};
+}
+
+template <typename Servo, typename Scheduler>
+BasicWheelModeMapper<Servo, Scheduler>::BasicWheelModeMapper(BasicWheelModeMapper &&other)
+  : initialized_{false},
+    timer_fd_{-1},
+    scheduler_{nullptr},
+    lookahead_seconds_{0},
+    periods_since_correction_{0}
+{
+  StealResources(&other);
+}
+
+template <typename Servo, typename Scheduler>
+BasicWheelModeMapper<Servo, Scheduler>&
+BasicWheelModeMapper<Servo, Scheduler>::operator=(BasicWheelModeMapper &&other)
+{
+  if (this != &other)
+  {
+    Close();
+    StealResources(&other);
+  }
+  return *this;
+}
+
+template <typename Servo, typename Scheduler>
+BasicWheelModeMapper<Servo, Scheduler>::~BasicWheelModeMapper()
+{
+  Close();
+}
+
+template <typename Servo, typename Scheduler>
+int BasicWheelModeMapper<Servo, Scheduler>::GetFd() const
+{
+  assert(initialized_);
+  return timer_fd_;
+}
+
+template <typename Servo, typename Scheduler>
+void BasicWheelModeMapper<Servo, Scheduler>::HandlePacket()
+{
+  using namespace wheel_mode_internal;
+
+  assert(initialized_);
+
+  if (ReadTimerExpirations(timer_fd_) == 0)
+  {
+    return;
+  }
+
+  double now = NowSeconds();
+  for (WheelAxis &axis : axes_)
+  {
+    if (!DriveAxis(&axis, now))
+    {
+      XBOX_LOG(LogLevel::ERROR, "Failed to enforce wheel mode soft limit");
+    }
+  }
+
+  if (++periods_since_correction_ >= POSITION_CORRECTION_PERIODS)
+  {
+    periods_since_correction_ = 0;
+    for (WheelAxis &axis : axes_)
+    {
+      axis.servo->RequestPresentPosition();
+    }
+  }
+
+  if (!scheduler_->Flush())
+  {
+    XBOX_LOG_EVERY(LogLevel::ERROR, 1000, "Failed to flush wheel mode speeds");
+  }
+
+  if (scheduler_->TakeLostWrites())
+  {
+    InvalidateCommandState();
+  }
+}
+
+template <typename Servo, typename Scheduler>
+void BasicWheelModeMapper<Servo, Scheduler>::ProcessReport(const ControllerReport &report)
+{
+  assert(initialized_);
+
+  IncrementCounter(Counter::REPORTS_PROCESSED);
+  SetGauge(
+      Gauge::LAST_REPORT_TIMESTAMP_NS,
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch()).count());
+
+  double tilt_value = NormalizeJoystickInputScalar(report.left_stick_y);
+  double pan_value = NormalizeJoystickInputScalar(report.left_stick_x);
+  axes_[TILT].requested_velocity =
+      static_cast<int32_t>(std::copysign(QuantizeJoystickSpeed(tilt_value), tilt_value));
+  axes_[PAN].requested_velocity =
+      static_cast<int32_t>(std::copysign(QuantizeJoystickSpeed(pan_value), pan_value));
+
+  double now = NowSeconds();
+  for (WheelAxis &axis : axes_)
+  {
+    if (!DriveAxis(&axis, now))
+    {
+      XBOX_LOG(LogLevel::ERROR, "Failed to set wheel mode speed");
+    }
+  }
+}
+
+template <typename Servo, typename Scheduler>
+ServoCommandState BasicWheelModeMapper<Servo, Scheduler>::GetTiltCommandState() const
+{
+  return GetAxisCommandState(axes_[TILT]);
+}
+
+template <typename Servo, typename Scheduler>
+ServoCommandState BasicWheelModeMapper<Servo, Scheduler>::GetPanCommandState() const
+{
+  return GetAxisCommandState(axes_[PAN]);
+}
+
+template <typename Servo, typename Scheduler>
+void BasicWheelModeMapper<Servo, Scheduler>::InvalidateCommandState()
+{
+  for (WheelAxis &axis : axes_)
+  {
+    axis.known = false;
+  }
+}
+
+template <typename Servo, typename Scheduler>
+double BasicWheelModeMapper<Servo, Scheduler>::NowSeconds()
+{
+  return std::chrono::duration<double>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+template <typename Servo, typename Scheduler>
+double BasicWheelModeMapper<Servo, Scheduler>::ToSeconds(
+    std::chrono::steady_clock::time_point time)
+{
+  return std::chrono::duration<double>(time.time_since_epoch()).count();
+}
+
+template <typename Servo, typename Scheduler>
+void BasicWheelModeMapper<Servo, Scheduler>::AdvanceModel(WheelAxis *axis, double now)
+{
+  axis->position +=
+      axis->velocity * POSITION_UNITS_PER_SPEED_UNIT_SECOND * (now - axis->model_time);
+  axis->model_time = now;
+}
+
+// Brings the model up to |now|: restarts it from a present position read if
+// one answered, then takes on the speed the servo has confirmed since. The
+// confirmation landed somewhere in the periods the old speed covered, which
+// the next correction absorbs.
+template <typename Servo, typename Scheduler>
+void BasicWheelModeMapper<Servo, Scheduler>::UpdateModel(WheelAxis *axis, double now)
+{
+  uint16_t present_position;
+  std::chrono::steady_clock::time_point read_time;
+  if (axis->servo->TakePresentPosition(&present_position, &read_time))
+  {
+    axis->position = present_position;
+    axis->model_time = std::min(ToSeconds(read_time), now);
+  }
+
+  AdvanceModel(axis, now);
+
+  uint16_t speed;
+  if (axis->servo->GetKnownValue(ServoRegister::MOVING_SPEED, &speed))
+  {
+    axis->velocity = DecodeWheelSpeed(speed);
+  }
+}
+
+template <typename Servo, typename Scheduler>
+bool BasicWheelModeMapper<Servo, Scheduler>::DriveAxis(WheelAxis *axis, double now)
+{
+  using namespace joystick_mapper_internal;
+
+  UpdateModel(axis, now);
+
+  int32_t velocity = axis->requested_velocity;
+  double next_position =
+      axis->position + velocity * POSITION_UNITS_PER_SPEED_UNIT_SECOND * lookahead_seconds_;
+  if ((velocity > 0 && next_position >= GOAL_POSITION_LIMIT_HIGH) ||
+      (velocity < 0 && next_position <= GOAL_POSITION_LIMIT_LOW))
+  {
+    if (axis->commanded_velocity != 0)
+    {
+      IncrementCounter(Counter::WHEEL_SOFT_LIMIT_STOPS);
+    }
+    velocity = 0;
+  }
+
+  if (axis->known && velocity == axis->commanded_velocity)
+  {
+    return true;
+  }
+
+  ServoCommandPriority priority = ServoCommandPriority::SPEED_CHANGE;
+  if (velocity == 0)
+  {
+    priority = ServoCommandPriority::STOP;
+  }
+  else if ((velocity > 0) != (axis->commanded_velocity > 0) || axis->commanded_velocity == 0)
+  {
+    priority = ServoCommandPriority::DIRECTION_CHANGE;
+  }
+
+  if (!axis->servo->SetMovingSpeed(EncodeWheelSpeed(velocity), priority))
+  {
+    return false;
+  }
+
+  axis->commanded_velocity = velocity;
+  axis->known = true;
+  return true;
+}
+
+template <typename Servo, typename Scheduler>
+ServoCommandState BasicWheelModeMapper<Servo, Scheduler>::GetAxisCommandState(
+    const WheelAxis &axis)
+{
+  using namespace joystick_mapper_internal;
+
+  ServoCommandState state = {};
+  state.moving_speed = static_cast<uint16_t>(std::abs(axis.commanded_velocity));
+  // The modelled position, where the joint mode mappers publish their goal.
+  state.goal_position = static_cast<uint16_t>(
+      std::round(std::max(axis.position, 0.0)));
+  state.torque_enabled = true;
+  state.positive_direction = axis.commanded_velocity > 0;
+  return state;
+}
+
+template <typename Servo, typename Scheduler>
+void BasicWheelModeMapper<Servo, Scheduler>::Close()
+{
+  if (initialized_)
+  {
+    for (WheelAxis &axis : axes_)
+    {
+      axis.servo->SetMovingSpeed(0, ServoCommandPriority::STOP);
+      axis.commanded_velocity = 0;
+    }
+
+    if (!scheduler_->Flush())
+    {
+      XBOX_LOG(LogLevel::ERROR, "Failed to stop servos on leaving wheel mode");
+    }
+  }
+
+  if (timer_fd_ >= 0)
+  {
+    close(timer_fd_);
+    timer_fd_ = -1;
+  }
+  initialized_ = false;
+}
+
+template <typename Servo, typename Scheduler>
+void BasicWheelModeMapper<Servo, Scheduler>::StealResources(BasicWheelModeMapper *other)
+{
+  assert(other);
+
+  initialized_ = other->initialized_;
+  other->initialized_ = false;
+  timer_fd_ = other->timer_fd_;
+  other->timer_fd_ = -1;
+  scheduler_ = other->scheduler_;
+  other->scheduler_ = nullptr;
+  lookahead_seconds_ = other->lookahead_seconds_;
+  periods_since_correction_ = other->periods_since_correction_;
+  axes_ = other->axes_;
+}
+
+}  // namespace xbox
+
+#endif  // XBOXCONTROLLER_WHEELMODEMAPPER_H
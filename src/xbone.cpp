@@ -1,7 +1,15 @@
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <array>
 #include <cassert>
+#include <chrono>
 #include <cstdlib>
 #include <iostream>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
 #include "Gpio/OutputPin.h"
@@ -14,10 +22,155 @@
 #include "dynamixel/AxA12.h"
 #include "dynamixel/AxA12Factory.h"
 
+#include "gflags/gflags.h"
+
+#include "src/async_servo_bus.h"
 #include "src/bluetooth_channel.h"
+#include "src/button_event_dispatcher.h"
 #include "src/controller_manager.h"
+#include "src/controller_capture.h"
 #include "src/controller_packet_to_pan_tilt_action_mapper.h"
+#include "src/controller_state_publisher.h"
 #include "src/event_loop.h"
+#include "src/external_command_source.h"
+#include "src/external_control_arbiter.h"
+#include "src/gpio_line.h"
+#include "src/input_pipeline.h"
+#include "src/logger.h"
+#include "src/metrics_server.h"
+#include "src/motion_setpoint_streamer.h"
+#include "src/persisted_control_state.h"
+#include "src/servo_bus_budget.h"
+#include "src/servo_bus_discovery.h"
+#include "src/servo_bus_scheduler.h"
+#include "src/simulation.h"
+#include "src/startup_timeline.h"
+#include "src/stick_filter.h"
+#include "src/teleop_channel.h"
+#include "src/wheel_mode_mapper.h"
+
+DEFINE_string(
+    control_mode,
+    "direct",
+    "How stick input drives the servos. \"direct\" maps each report straight "
+    "to servo writes; \"planner\" streams acceleration-limited setpoints at "
+    "the control rate; \"wheel\" runs the servos in endless-turn mode, "
+    "steered by signed speed alone within software position limits.");
+
+DEFINE_bool(
+    external_commands,
+    false,
+    "Accept pan/tilt commands from an external tracker through the shared "
+    "memory ring in external_command_writer.h. Moving the stick out of the "
+    "deadzone always takes control back. Requires --control_mode=direct.");
+
+DEFINE_double(
+    stick_filter_min_cutoff_hz,
+    xbox::DEFAULT_STICK_FILTER_CONFIG.min_cutoff_hz,
+    "One-Euro stick filter cutoff while the stick is still. Lower removes "
+    "more jitter but adds lag.");
+DEFINE_double(
+    stick_filter_beta,
+    xbox::DEFAULT_STICK_FILTER_CONFIG.beta,
+    "How quickly the One-Euro stick filter cutoff opens up as the stick "
+    "moves. Higher cuts lag on fast moves.");
+DEFINE_double(
+    stick_filter_derivative_cutoff_hz,
+    xbox::DEFAULT_STICK_FILTER_CONFIG.derivative_cutoff_hz,
+    "Cutoff for the One-Euro stick filter's speed estimate.");
+
+DEFINE_bool(
+    simulate,
+    false,
+    "Run the full pipeline against synthetic controllers and in-memory servos "
+    "instead of Bluetooth and the AX-12 bus.");
+DEFINE_double(simulate_report_rate_hz, 1000, "Reports per second per simulated controller.");
+DEFINE_int32(simulate_controllers, 1, "Number of simulated controllers.");
+DEFINE_string(simulate_pattern, "sweep", "Simulated stick pattern: sweep, steps or random.");
+DEFINE_int32(
+    simulate_duration_s,
+    0,
+    "Stop the simulation after this many seconds. 0 runs until killed.");
+DEFINE_int32(simulate_stats_interval_s, 10, "Seconds between simulation statistics reports.");
+DEFINE_string(
+    capture_path,
+    "",
+    "Record every raw controller frame to this file for xbone_capture_decode. "
+    "Empty disables capture.");
+DEFINE_string(
+    bluetooth_adapters,
+    "",
+    "Comma-separated adapters to connect controllers through, e.g. \"hci0,hci1\"; "
+    "controllers are spread across them and frames from other adapters are "
+    "ignored. An entry may set its BlueZ path: \"hci1=/org/bluez/hci1\". Empty "
+    "uses the default adapter and accepts frames from any.");
+DEFINE_string(
+    teleop_listen,
+    "",
+    "Also accept controller reports from a remote operator station as UDP "
+    "datagrams (see teleop_protocol.h) on this host:port, e.g. \":47047\". "
+    "Empty disables.");
+DEFINE_int32(
+    teleop_max_age_ms,
+    100,
+    "Drop teleop datagrams that took this much longer to arrive than the "
+    "fastest one of their session. Measured against the session's own best "
+    "delivery, so the station's clock need not be synchronized with ours; 0 "
+    "disables the check.");
+DEFINE_int32(
+    teleop_session_timeout_ms,
+    500,
+    "A remote station keeps control, and newer sessions are refused, until it "
+    "has sent nothing for this long. Local controller reports are dropped "
+    "meanwhile.");
+DEFINE_string(
+    servo_transport,
+    "dynamixel",
+    "How servo commands reach the bus. \"dynamixel\" uses the blocking AxA12 "
+    "driver; \"async\" drives the UART and direction pin from the event loop.");
+DEFINE_string(servo_uart_device, "/dev/serial0", "UART for --servo_transport=async.");
+DEFINE_int32(servo_baud_rate, 1000000, "Servo bus baud rate for --servo_transport=async.");
+DEFINE_bool(
+    servo_baud_discovery,
+    false,
+    "With --servo_transport=async, find the servos at any standard baud rate "
+    "and move the bus to the fastest reliable one, ignoring --servo_baud_rate.");
+DEFINE_string(
+    servo_bus_cache,
+    "/var/lib/xbone/servo-bus.cache",
+    "Where --servo_baud_discovery keeps its result so later starts skip the "
+    "scan. Empty always scans.");
+DEFINE_string(
+    servo_status_return,
+    "all",
+    "Which instructions the servos answer with --servo_transport=async. \"all\" "
+    "acknowledges every write; \"reads\" sends writes unacknowledged and "
+    "verifies them with idle-time readback.");
+DEFINE_string(
+    control_state_path,
+    "/run/xbone/control-state",
+    "File the servo and controller state is kept in, so a restart within the "
+    "same boot resumes without homing the servos, re-reading their EEPROM or "
+    "searching for controllers. Empty always starts cold.");
+DEFINE_string(
+    metrics_socket_path,
+    "/run/xbone/metrics.sock",
+    "Unix socket that serves a metrics snapshot to every client that "
+    "connects. Its directory is created if missing and a stale socket left "
+    "there is replaced. xbone runs without metrics if it cannot be opened. "
+    "Empty disables.");
+DEFINE_string(
+    button_outputs,
+    "",
+    "Comma-separated buttons to mirror on GPIO lines of --button_gpio_chip, "
+    "as BUTTON:LINE, high while held, or BUTTON:LINE:toggle, flipped on each "
+    "press; e.g. \"A:17,DPAD_UP:27:toggle\". Buttons are A, B, X, Y, LB, RB, "
+    "L3, R3 and DPAD_UP/RIGHT/DOWN/LEFT. Empty binds nothing.");
+DEFINE_string(button_gpio_chip, "/dev/gpiochip0", "GPIO chip holding the --button_outputs lines.");
+DEFINE_string(
+    servo_gpio_chip,
+    "/dev/gpiochip0",
+    "GPIO chip holding the bus direction pin for --servo_transport=async.");
 
 namespace
 {
@@ -33,50 +186,235 @@ const std::string XBOX_CONTROLLER_ADDRESS_2 = "C8:3F:26:11:D7:D3";
 const std::string XBOX_CONTROLLER_ADDRESS_1 = "C8:3F:26:08:94:3F";
 constexpr int GPIO_PIN_INDEX = 17;
 
-void MapXbonePacketToServoAction(
-    xbox::ControllerPacketToPanTiltActionMapper* mapper,
-    const uint8_t* buffer,
-    size_t buffer_length)
+const std::string CONTROL_MODE_DIRECT = "direct";
+const std::string CONTROL_MODE_PLANNER = "planner";
+const std::string CONTROL_MODE_WHEEL = "wheel";
+
+const std::string SERVO_TRANSPORT_DYNAMIXEL = "dynamixel";
+const std::string SERVO_TRANSPORT_ASYNC = "async";
+
+constexpr uint8_t SERVO_ID_TILT = 1;
+constexpr uint8_t SERVO_ID_PAN = 2;
+
+// The synthetic frame trailer stores the controller index in one byte.
+constexpr int MAX_SIMULATED_CONTROLLERS = 255;
+constexpr std::chrono::milliseconds SIMULATION_POLL_TIMEOUT{100};
+
+// Reports from real controllers, read off the HCI monitor channel. The
+// channel is opened before any controller connects, so no report is missed
+// while the rest of startup finishes.
+class HciMonitorInput
 {
-  assert(mapper);
-  assert(buffer);
-  mapper->ProcessPacket(buffer, buffer_length); 
-}
+public:
+  HciMonitorInput(int monitor_fd, xbox::HciAdapterMask adapter_mask)
+    : monitor_fd_{monitor_fd},
+      adapter_mask_{adapter_mask} {}
 
-}  // namespace
+  bool Open(int *out_fd) const
+  {
+    *out_fd = monitor_fd_;
+    return true;
+  }
 
-int main(int argc, char** argv)
+  xbox::HciAdapterMask GetAdapterMask() const
+  {
+    return adapter_mask_;
+  }
+
+  template <typename Pipeline>
+  Pipeline Wrap(Pipeline &&pipeline) const
+  {
+    return std::move(pipeline);
+  }
+
+  bool Run(xbox::EventLoop *event_loop) const
+  {
+    return event_loop->Run();
+  }
+
+private:
+  int monitor_fd_;
+  xbox::HciAdapterMask adapter_mask_;
+};
+
+// Discovers and connects controllers on a worker thread, so the inquiry and
+// per-controller connects overlap servo bring-up. The worker signals an
+// eventfd when done; the event loop then joins it and prints the startup
+// timing report.
+//
+// Controllers are dealt round-robin across |adapters|, each of which connects
+// its share on its own thread.
+//
+// With a |control_state_store|, the controllers connected during this boot
+// are tried first and the inquiry only runs if none of them connects. The
+// ones that connect are saved back once the worker is joined.
+class BluetoothConnectPhase : public xbox::EventHandler
 {
-  xbox::ControllerManager manager;
-  std::vector<std::string> addresses;
+public:
+  BluetoothConnectPhase(
+      std::vector<xbox::BluetoothAdapter> adapters,
+      xbox::ControlStateStore *control_state_store,
+      xbox::StartupTimeline *timeline)
+    : adapters_{std::move(adapters)},
+      control_state_store_{control_state_store},
+      timeline_{timeline},
+      fd_{-1}
+  {
+    xbox::PersistedControlState warm_state;
+    if (control_state_store_ && control_state_store_->LoadWarmState(&warm_state))
+    {
+      known_addresses_ = xbox::GetPersistedControllerAddresses(warm_state);
+    }
+  }
 
-  std::cout << "Searching for pairable XBox controllers..." << std::endl;
+  ~BluetoothConnectPhase()
+  {
+    if (worker_.joinable())
+    {
+      worker_.join();
+    }
+
+    if (fd_ >= 0)
+    {
+      close(fd_);
+    }
+  }
 
-  if (!manager.FindPairableDevices(&addresses))
+  bool Start()
   {
-    std::cerr << "Failed to find pairable xbox controllers" << std::endl;
+    fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fd_ < 0)
+    {
+      std::cerr << "Failed to create eventfd. Error: " << strerror(errno) << std::endl;
+      return false;
+    }
+
+    timeline_->BeginPhase(xbox::StartupPhase::BLUETOOTH_CONNECT);
+    worker_ = std::thread{[this] {
+      ConnectControllers();
+      timeline_->EndPhase(xbox::StartupPhase::BLUETOOTH_CONNECT);
+
+      uint64_t done = 1;
+      if (write(fd_, &done, sizeof(done)) != sizeof(done))
+      {
+        std::cerr << "Failed to signal Bluetooth connect completion" << std::endl;
+      }
+    }};
+    return true;
   }
 
-  if (addresses.empty())
+  int GetFd() const override
   {
-    std::cout << "No XBox controllers found! Attempting to connect "
-              << XBOX_CONTROLLER_ADDRESS_1 << std::endl;
+    return fd_;
+  }
 
-    if (!manager.Connect(XBOX_CONTROLLER_ADDRESS_1))
+  void HandlePacket() override
+  {
+    uint64_t done;
+    if (read(fd_, &done, sizeof(done)) != sizeof(done))
     {
-      std::cerr << "Failed to pair!" << std::endl;
+      return;
     }
-    else
+
+    worker_.join();
+    timeline_->PrintReportOnceComplete(std::cout);
+
+    if (control_state_store_ && !connected_addresses_.empty())
     {
-      std::cout << "Successfully paired!" << std::endl;
+      xbox::SetPersistedControllerAddresses(
+          connected_addresses_,
+          &control_state_store_->GetState());
+      control_state_store_->Save();
     }
   }
-  else
+
+private:
+  void ConnectControllers()
   {
+    if (adapters_.empty())
+    {
+      std::cerr << "No Bluetooth adapter to connect controllers through" << std::endl;
+      return;
+    }
+
+    if (!known_addresses_.empty())
+    {
+      std::cout << "Reconnecting " << known_addresses_.size()
+                << " XBox controller(s) from the previous run..." << std::endl;
+      ConnectAll(known_addresses_);
+      if (!connected_addresses_.empty())
+      {
+        return;
+      }
+    }
+
+    // Every adapter sees the same controllers, so one inquiry is enough.
+    std::vector<std::string> addresses;
+
+    std::cout << "Searching for pairable XBox controllers..." << std::endl;
+
+    xbox::ControllerManager inquiry_manager{adapters_.front()};
+    if (!inquiry_manager.FindPairableDevices(&addresses))
+    {
+      std::cerr << "Failed to find pairable xbox controllers" << std::endl;
+    }
+
+    if (addresses.empty())
+    {
+      std::cout << "No XBox controllers found! Attempting to connect "
+                << XBOX_CONTROLLER_ADDRESS_1 << std::endl;
+      addresses.push_back(XBOX_CONTROLLER_ADDRESS_1);
+    }
+
+    ConnectAll(addresses);
+  }
+
+  void ConnectAll(const std::vector<std::string> &addresses)
+  {
+    std::vector<std::vector<std::string>> assignments(adapters_.size());
+    std::vector<std::vector<std::string>> connected(adapters_.size());
+    for (size_t i = 0; i < addresses.size(); ++i)
+    {
+      assignments[i % adapters_.size()].push_back(addresses[i]);
+    }
+
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < adapters_.size(); ++i)
+    {
+      if (assignments[i].empty())
+      {
+        continue;
+      }
+
+      workers.emplace_back([this, i, &assignments, &connected] {
+        ConnectThrough(adapters_[i], assignments[i], &connected[i]);
+      });
+    }
+
+    for (std::thread &worker : workers)
+    {
+      worker.join();
+    }
+
+    for (const std::vector<std::string> &adapter_connected : connected)
+    {
+      connected_addresses_.insert(
+          connected_addresses_.end(),
+          adapter_connected.begin(),
+          adapter_connected.end());
+    }
+  }
+
+  static void ConnectThrough(
+      const xbox::BluetoothAdapter &adapter,
+      const std::vector<std::string> &addresses,
+      std::vector<std::string> *out_connected)
+  {
+    xbox::ControllerManager manager{adapter};
     for (const std::string& addr : addresses)
     {
       std::cout << "XBox Controller Bluetooth Address: "
-                <<  addr << std::endl;
+                <<  addr << " via " << adapter.bluez_path << std::endl;
 
       std::cout << "Attempting to pair..." << std::endl;
       if (!manager.Connect(addr))
@@ -86,62 +424,881 @@ int main(int argc, char** argv)
       else
       {
         std::cout << "Successfully paired!" << std::endl;
+        out_connected->push_back(addr);
       }
     }
   }
 
-  RpiSystemContext system_context;
-  RpiPinManager gpio_manager;
-  AxA12Factory axa12_factory;
-  if (!AxA12Factory::Create(
-            &system_context,
-            &gpio_manager,
-            GPIO_PIN_INDEX,
-            &axa12_factory))
+private:
+  BluetoothConnectPhase(const BluetoothConnectPhase &other) = delete;
+  BluetoothConnectPhase& operator=(const BluetoothConnectPhase &other) = delete;
+
+private:
+  std::vector<xbox::BluetoothAdapter> adapters_;
+  xbox::ControlStateStore *control_state_store_;
+  xbox::StartupTimeline *timeline_;
+  int fd_;
+  std::thread worker_;
+  std::vector<std::string> known_addresses_;
+  // Written by the worker, read once it is joined.
+  std::vector<std::string> connected_addresses_;
+};
+
+// Reports from a SyntheticReportGenerator. Every report's end-to-end latency
+// is recorded, and the loop stops after |duration| unless it is zero.
+class SimulatedInput
+{
+public:
+  SimulatedInput(
+      int channel_fd,
+      xbox::SimulationStats *stats,
+      xbox::SimulationStatsReporter *stats_reporter,
+      std::chrono::seconds duration)
+    : channel_fd_{channel_fd},
+      stats_{stats},
+      stats_reporter_{stats_reporter},
+      duration_{duration} {}
+
+  bool Open(int *out_fd) const
   {
-    std::cerr << "Failed to create AxA12Factory" << std::endl;
-    return EXIT_FAILURE;
+    *out_fd = channel_fd_;
+    return true;
   }
-  AxA12 *axa12_tilt;
-  uint8_t id_tilt = 1;
-  if (!axa12_factory.Get(id_tilt, &axa12_tilt))
+
+  xbox::HciAdapterMask GetAdapterMask() const
   {
-    std::cerr << "Failed to initialize AxA12 servo" << std::endl;
+    return xbox::ALL_HCI_ADAPTERS;
+  }
+
+  template <typename Pipeline>
+  xbox::SimulationLatencyProbe<Pipeline> Wrap(Pipeline &&pipeline) const
+  {
+    return xbox::SimulationLatencyProbe<Pipeline>{std::move(pipeline), stats_};
+  }
+
+  bool Run(xbox::EventLoop *event_loop) const
+  {
+    if (duration_.count() == 0)
+    {
+      return event_loop->Run();
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + duration_;
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+      if (!event_loop->RunOnce(SIMULATION_POLL_TIMEOUT.count()))
+      {
+        return false;
+      }
+    }
+
+    stats_reporter_->PrintSummary();
+    return true;
+  }
+
+private:
+  int channel_fd_;
+  xbox::SimulationStats *stats_;
+  xbox::SimulationStatsReporter *stats_reporter_;
+  std::chrono::seconds duration_;
+};
+
+// Hands teleop frames to the TeleopInputArbiter owned by |Channel|.
+template <typename Channel>
+class RemoteFrameForwarder
+{
+public:
+  RemoteFrameForwarder() : channel_{nullptr} {}
+  explicit RemoteFrameForwarder(Channel *channel) : channel_{channel} {}
+
+  void operator()(const uint8_t *buffer, size_t buffer_size) const
+  {
+    assert(channel_);
+    channel_->GetCallback().HandleRemoteFrame(buffer, buffer_size);
+  }
+
+private:
+  Channel *channel_;
+};
+
+// Servos in scheduler registration order, which is also their order in
+// PersistedControlState.
+constexpr uint8_t PERSISTED_SERVO_IDS[] = {SERVO_ID_TILT, SERVO_ID_PAN};
+static_assert(
+    sizeof(PERSISTED_SERVO_IDS) == xbox::PERSISTED_SERVO_COUNT,
+    "Every persisted servo needs an id");
+static_assert(
+    xbox::SERVO_REGISTER_COUNT <= xbox::PERSISTED_SERVO_REGISTER_COUNT,
+    "PersistedServoState cannot hold every register shadow");
+
+// Whether |state| was saved for the servos this process drives.
+bool IsControlStateForServos(const xbox::PersistedControlState &state)
+{
+  for (size_t i = 0; i < xbox::PERSISTED_SERVO_COUNT; ++i)
+  {
+    if (state.servos[i].id != PERSISTED_SERVO_IDS[i])
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+xbox::ServoCommandState GetPersistedCommandState(const xbox::PersistedServoState &state)
+{
+  xbox::ServoCommandState command_state = {};
+  command_state.moving_speed = state.moving_speed;
+  command_state.goal_position = state.goal_position;
+  return command_state;
+}
+
+// Whether the registers |scheduler| read back hold what |state| saved.
+template <typename Scheduler>
+bool MatchesRegisterShadows(const xbox::PersistedControlState &state, const Scheduler &scheduler)
+{
+  for (size_t servo_index = 0; servo_index < xbox::PERSISTED_SERVO_COUNT; ++servo_index)
+  {
+    const xbox::PersistedServoState &servo = state.servos[servo_index];
+    for (size_t i = 0; i < xbox::SERVO_REGISTER_COUNT; ++i)
+    {
+      uint16_t value;
+      if ((servo.known_registers & (1u << i)) &&
+          (!scheduler.GetKnownValue(servo_index, static_cast<xbox::ServoRegister>(i), &value) ||
+              value != servo.register_values[i]))
+      {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Where |servo|'s horn is, to seed the wheel mode position model. Assumes
+// neutral if the servo does not answer.
+template <typename Servo>
+uint16_t ReadPresentPosition(Servo *servo)
+{
+  uint16_t position;
+  if (!servo->GetPresentPosition(&position))
+  {
+    std::cerr << "Failed to read servo position; assuming neutral" << std::endl;
+    return xbox::joystick_mapper_internal::GOAL_POSITION_NEUTRAL;
+  }
+  return position;
+}
+
+// Input pipeline stage that saves the mapper's command state and the
+// scheduler's register shadows to |store| once each report has been handled.
+// Save() only touches the file when something changed. Without a store it
+// does nothing.
+template <typename Mapper, typename Scheduler>
+class ControlStatePersistStage
+{
+public:
+  ControlStatePersistStage()
+    : store_{nullptr},
+      mapper_{nullptr},
+      scheduler_{nullptr},
+      save_command_state_{false} {}
+
+  // |save_command_state| is false for mappers without a Resume().
+  ControlStatePersistStage(
+      xbox::ControlStateStore *store,
+      const Mapper *mapper,
+      const Scheduler *scheduler,
+      bool save_command_state)
+    : store_{store},
+      mapper_{mapper},
+      scheduler_{scheduler},
+      save_command_state_{save_command_state} {}
+
+  template <typename Next>
+  void operator()(Next& next, const xbox::ControllerReport &report) const
+  {
+    next(report);
+    Save();
+  }
+
+  void Save() const
+  {
+    if (!store_)
+    {
+      return;
+    }
+
+    xbox::PersistedControlState &state = store_->GetState();
+    SaveServo(0, mapper_->GetTiltCommandState(), &state.servos[0]);
+    SaveServo(1, mapper_->GetPanCommandState(), &state.servos[1]);
+    store_->Save();
+  }
+
+private:
+  void SaveServo(
+      size_t servo_index,
+      const xbox::ServoCommandState &command_state,
+      xbox::PersistedServoState *out_state) const
+  {
+    out_state->id = PERSISTED_SERVO_IDS[servo_index];
+    out_state->has_mapper_state = save_command_state_;
+    out_state->moving_speed = save_command_state_ ? command_state.moving_speed : 0;
+    out_state->goal_position = save_command_state_ ? command_state.goal_position : 0;
+    out_state->known_registers = 0;
+    for (size_t i = 0; i < xbox::SERVO_REGISTER_COUNT; ++i)
+    {
+      xbox::ServoRegister reg = static_cast<xbox::ServoRegister>(i);
+      uint16_t value = 0;
+      if (xbox::IsPersistentServoRegister(reg) &&
+          scheduler_->GetKnownValue(servo_index, reg, &value))
+      {
+        out_state->known_registers |= 1u << i;
+      }
+      out_state->register_values[i] = value;
+    }
+  }
+
+private:
+  xbox::ControlStateStore *store_;
+  const Mapper *mapper_;
+  const Scheduler *scheduler_;
+  bool save_command_state_;
+};
+
+// Builds the input pipeline in front of |mapper|, attaches it to |input| and
+// runs the event loop. |Mapper| is anything that consumes decoded reports and
+// exposes the per-axis command state for publishing. Raw frames are recorded
+// to |capture_writer| when it is not null.
+template <typename Input, typename Mapper, typename... ExtraStages>
+bool RunInputPipeline(
+    const Input &input,
+    Mapper *mapper,
+    xbox::ControllerCaptureWriter *capture_writer,
+    xbox::ControllerStatePublisher *state_publisher,
+    xbox::ButtonEventDispatcher *button_dispatcher,
+    xbox::EventLoop *event_loop,
+    ExtraStages... extra_stages)
+{
+  auto input_callback = input.Wrap(xbox::MakeInputPipeline(
+      xbox::CaptureWriteStage<xbox::ControllerCaptureWriter>{capture_writer},
+      xbox::ReportDecodeStage{},
+      xbox::RawReportPublishStage{state_publisher},
+      xbox::StickSmoothingStage{xbox::OneEuroFilterConfig{
+          FLAGS_stick_filter_min_cutoff_hz,
+          FLAGS_stick_filter_beta,
+          FLAGS_stick_filter_derivative_cutoff_hz}},
+      xbox::ButtonDispatchStage<xbox::ButtonEventDispatcher>{button_dispatcher},
+      xbox::ControllerStatePublishStage<Mapper>{state_publisher, mapper},
+      extra_stages...,
+      xbox::PanTiltMapperSink<Mapper>{mapper}));
+  using InputArbiter = xbox::TeleopInputArbiter<decltype(input_callback)>;
+  using InputBluetoothChannel = xbox::BasicBluetoothChannel<InputArbiter>;
+
+  int input_fd;
+  if (!input.Open(&input_fd))
+  {
+    std::cerr << "Failed to initialize BluetoothChannel" << std::endl;
     return false;
   }
 
-  AxA12 *axa12_pan;
-  uint8_t id_pan = 2;
-  if (!axa12_factory.Get(id_pan, &axa12_pan))
+  InputBluetoothChannel bluetooth_channel{
+      input_fd,
+      InputArbiter{
+          std::move(input_callback),
+          std::chrono::milliseconds{FLAGS_teleop_session_timeout_ms}},
+      input.GetAdapterMask()};
+  if (!event_loop->Add(&bluetooth_channel))
   {
-    std::cerr << "Failed to initialize AxA12 servo" << std::endl;
+    std::cerr << "Failed to add BluetoothChannel to EventLoop" << std::endl;
     return false;
   }
 
-  xbox::ControllerPacketToPanTiltActionMapper pan_tilt_action_mapper;
-  if (!xbox::ControllerPacketToPanTiltActionMapper::Create(
-            axa12_tilt,
-            axa12_pan,
-            &pan_tilt_action_mapper))
+  // Remote reports go through the same pipeline instance, so stick smoothing
+  // and the mapper see a single stream; the arbiter keeps the local ones out
+  // of it while the station has control.
+  using TeleopChannel =
+      xbox::BasicTeleopChannel<RemoteFrameForwarder<InputBluetoothChannel>>;
+  TeleopChannel teleop_channel;
+  if (!FLAGS_teleop_listen.empty())
+  {
+    if (!TeleopChannel::Create(
+            FLAGS_teleop_listen,
+            RemoteFrameForwarder<InputBluetoothChannel>{&bluetooth_channel},
+            std::chrono::milliseconds{FLAGS_teleop_max_age_ms},
+            std::chrono::milliseconds{FLAGS_teleop_session_timeout_ms},
+            &teleop_channel))
+    {
+      std::cerr << "Failed to initialize TeleopChannel" << std::endl;
+      return false;
+    }
+
+    if (!event_loop->Add(&teleop_channel))
+    {
+      std::cerr << "Failed to add TeleopChannel to EventLoop" << std::endl;
+      return false;
+    }
+  }
+
+  if (!input.Run(event_loop))
+  {
+    std::cerr << "Failed to run EventLoop" << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+// Sets up the bus scheduler and the --control_mode mapper over |tilt| and
+// |pan|, then runs the input pipeline from |input|. Configuration time is
+// recorded on |startup_timeline| when it is not null.
+//
+// With a |control_state_store| holding state from earlier in this boot, the
+// register shadows are restored instead of read back and a direct mode
+// mapper resumes without homing. The state is saved after every report.
+template <typename Servo, typename Input>
+bool RunServoControl(
+    Servo *tilt,
+    Servo *pan,
+    const Input &input,
+    xbox::ServoBusBudget *servo_bus_budget,
+    xbox::ControlStateStore *control_state_store,
+    xbox::StartupTimeline *startup_timeline,
+    xbox::ControllerCaptureWriter *capture_writer,
+    xbox::ControllerStatePublisher *state_publisher,
+    xbox::ButtonEventDispatcher *button_dispatcher,
+    xbox::EventLoop *event_loop)
+{
+  using ServoBusScheduler = xbox::BasicServoBusScheduler<Servo>;
+  using ScheduledServo = xbox::ScheduledServo<Servo>;
+  using PanTiltActionMapper = xbox::BasicControllerPacketToPanTiltActionMapper<ScheduledServo>;
+  using MotionSetpointStreamer =
+      xbox::BasicMotionSetpointStreamer<ScheduledServo, ServoBusScheduler>;
+  using ExternalControlArbiter =
+      xbox::BasicExternalControlArbiter<PanTiltActionMapper, ScheduledServo, ServoBusScheduler>;
+  using DirectPersistStage = ControlStatePersistStage<PanTiltActionMapper, ServoBusScheduler>;
+  using PlannerPersistStage = ControlStatePersistStage<MotionSetpointStreamer, ServoBusScheduler>;
+  using WheelModeMapper = xbox::BasicWheelModeMapper<ScheduledServo, ServoBusScheduler>;
+  using WheelPersistStage = ControlStatePersistStage<WheelModeMapper, ServoBusScheduler>;
+
+  ServoBusScheduler servo_bus_scheduler{servo_bus_budget};
+
+  ScheduledServo *scheduled_tilt;
+  ScheduledServo *scheduled_pan;
+  if (!servo_bus_scheduler.GetScheduledServo(tilt, &scheduled_tilt) ||
+      !servo_bus_scheduler.GetScheduledServo(pan, &scheduled_pan))
+  {
+    std::cerr << "Failed to register servos with bus scheduler" << std::endl;
+    return false;
+  }
+
+  if (startup_timeline)
+  {
+    startup_timeline->BeginPhase(xbox::StartupPhase::SERVO_CONFIGURATION);
+  }
+
+  xbox::PersistedControlState warm_state;
+  bool warm_start = control_state_store &&
+      control_state_store->LoadWarmState(&warm_state) &&
+      IsControlStateForServos(warm_state);
+  // The angle limits live in EEPROM and rarely change between runs; only the
+  // registers that differ get rewritten by the configuration below. A warm
+  // start reads them too: the servos may have been power-cycled or written by
+  // something else since the state was saved, and if they no longer hold
+  // what it says, the rest of it is not trusted either.
+  servo_bus_scheduler.ReadPersistentRegisters();
+  if (warm_start && !MatchesRegisterShadows(warm_state, servo_bus_scheduler))
+  {
+    std::cout << "Servos no longer hold the state saved earlier in this boot; "
+              << "starting over" << std::endl;
+    warm_start = false;
+  }
+  else if (warm_start)
+  {
+    std::cout << "Resuming servo state saved earlier in this boot" << std::endl;
+  }
+
+  if (FLAGS_control_mode == CONTROL_MODE_PLANNER)
+  {
+    MotionSetpointStreamer setpoint_streamer;
+    if (!MotionSetpointStreamer::Create(
+              scheduled_tilt,
+              scheduled_pan,
+              &servo_bus_scheduler,
+              xbox::DEFAULT_CONTROL_PERIOD,
+              xbox::DEFAULT_AXIS_MAX_ACCELERATION,
+              &setpoint_streamer))
+    {
+      std::cerr << "Failed to initialize MotionSetpointStreamer" << std::endl;
+      return false;
+    }
+
+    if (!servo_bus_scheduler.FlushConfiguration())
+    {
+      std::cerr << "Failed to write initial servo configuration" << std::endl;
+      return false;
+    }
+
+    if (startup_timeline)
+    {
+      startup_timeline->EndPhase(xbox::StartupPhase::SERVO_CONFIGURATION);
+      startup_timeline->PrintReportOnceComplete(std::cout);
+    }
+
+    if (!event_loop->Add(&setpoint_streamer))
+    {
+      std::cerr << "Failed to add MotionSetpointStreamer to EventLoop" << std::endl;
+      return false;
+    }
+
+    // The streamer always homes, so only the register shadows are saved.
+    PlannerPersistStage persist_stage{
+        control_state_store,
+        &setpoint_streamer,
+        &servo_bus_scheduler,
+        false};
+    persist_stage.Save();
+
+    // Servo writes happen on the streamer's timer, not per report.
+    return RunInputPipeline(
+        input,
+        &setpoint_streamer,
+        capture_writer,
+        state_publisher,
+        button_dispatcher,
+        event_loop,
+        persist_stage);
+  }
+
+  if (FLAGS_control_mode == CONTROL_MODE_WHEEL)
+  {
+    // Read before anything is queued, to seed the position models.
+    uint16_t tilt_position = ReadPresentPosition(tilt);
+    uint16_t pan_position = ReadPresentPosition(pan);
+
+    WheelModeMapper wheel_mode_mapper;
+    if (!WheelModeMapper::Create(
+              scheduled_tilt,
+              scheduled_pan,
+              &servo_bus_scheduler,
+              xbox::DEFAULT_CONTROL_PERIOD,
+              tilt_position,
+              pan_position,
+              &wheel_mode_mapper))
+    {
+      std::cerr << "Failed to initialize WheelModeMapper" << std::endl;
+      return false;
+    }
+
+    if (!servo_bus_scheduler.FlushConfiguration())
+    {
+      std::cerr << "Failed to write initial servo configuration" << std::endl;
+      return false;
+    }
+
+    if (startup_timeline)
+    {
+      startup_timeline->EndPhase(xbox::StartupPhase::SERVO_CONFIGURATION);
+      startup_timeline->PrintReportOnceComplete(std::cout);
+    }
+
+    if (!event_loop->Add(&wheel_mode_mapper))
+    {
+      std::cerr << "Failed to add WheelModeMapper to EventLoop" << std::endl;
+      return false;
+    }
+
+    // Positions are re-read on every start, so only the register shadows are
+    // saved.
+    WheelPersistStage persist_stage{
+        control_state_store,
+        &wheel_mode_mapper,
+        &servo_bus_scheduler,
+        false};
+    persist_stage.Save();
+
+    return RunInputPipeline(
+        input,
+        &wheel_mode_mapper,
+        capture_writer,
+        state_publisher,
+        button_dispatcher,
+        event_loop,
+        persist_stage,
+        xbox::ServoSchedulerFlushStage<ServoBusScheduler, WheelModeMapper>{
+            &servo_bus_scheduler,
+            &wheel_mode_mapper});
+  }
+
+  PanTiltActionMapper pan_tilt_action_mapper;
+  if (warm_start &&
+      warm_state.servos[0].has_mapper_state &&
+      warm_state.servos[1].has_mapper_state)
+  {
+    if (!PanTiltActionMapper::Resume(
+              scheduled_tilt,
+              scheduled_pan,
+              servo_bus_budget,
+              GetPersistedCommandState(warm_state.servos[0]),
+              GetPersistedCommandState(warm_state.servos[1]),
+              &pan_tilt_action_mapper))
+    {
+      std::cerr << "Failed to resume controller-servo mapper" << std::endl;
+      return false;
+    }
+  }
+  else if (!PanTiltActionMapper::Create(
+                scheduled_tilt,
+                scheduled_pan,
+                servo_bus_budget,
+                &pan_tilt_action_mapper))
   {
     std::cerr << "Failed to initialize controller-servo mapper" << std::endl;
+    return false;
+  }
+
+  if (!servo_bus_scheduler.FlushConfiguration())
+  {
+    std::cerr << "Failed to write initial servo configuration" << std::endl;
+    return false;
+  }
+
+  if (startup_timeline)
+  {
+    startup_timeline->EndPhase(xbox::StartupPhase::SERVO_CONFIGURATION);
+    startup_timeline->PrintReportOnceComplete(std::cout);
+  }
+
+  // Saved from the joystick mapper even while the arbiter is in charge: it is
+  // what resumes after a restart.
+  DirectPersistStage persist_stage{
+      control_state_store,
+      &pan_tilt_action_mapper,
+      &servo_bus_scheduler,
+      true};
+  persist_stage.Save();
+
+  if (FLAGS_external_commands)
+  {
+    xbox::ExternalCommandSource external_command_source;
+    if (!xbox::ExternalCommandSource::Create(
+              xbox::EXTERNAL_COMMAND_RING_NAME,
+              &external_command_source))
+    {
+      std::cerr << "Failed to initialize ExternalCommandSource" << std::endl;
+      return false;
+    }
+
+    ExternalControlArbiter arbiter;
+    if (!ExternalControlArbiter::Create(
+              &external_command_source,
+              &pan_tilt_action_mapper,
+              scheduled_tilt,
+              scheduled_pan,
+              &servo_bus_scheduler,
+              &arbiter))
+    {
+      std::cerr << "Failed to initialize ExternalControlArbiter" << std::endl;
+      return false;
+    }
+
+    if (!event_loop->Add(&arbiter))
+    {
+      std::cerr << "Failed to add ExternalControlArbiter to EventLoop" << std::endl;
+      return false;
+    }
+
+    // The arbiter stands in for the mapper, forwarding the reports the
+    // joystick owns.
+    return RunInputPipeline(
+        input,
+        &arbiter,
+        capture_writer,
+        state_publisher,
+        button_dispatcher,
+        event_loop,
+        persist_stage,
+        xbox::ServoSchedulerFlushStage<ServoBusScheduler, ExternalControlArbiter>{
+            &servo_bus_scheduler,
+            &arbiter});
+  }
+
+  return RunInputPipeline(
+      input,
+      &pan_tilt_action_mapper,
+      capture_writer,
+      state_publisher,
+      button_dispatcher,
+      event_loop,
+      persist_stage,
+      xbox::ServoSchedulerFlushStage<ServoBusScheduler, PanTiltActionMapper>{
+          &servo_bus_scheduler,
+          &pan_tilt_action_mapper});
+}
+
+// Soak-test mode: synthetic controllers feed the real pipeline, mappers and
+// event loop, which drive in-memory servos.
+bool RunSimulation(
+    xbox::ControllerCaptureWriter *capture_writer,
+    xbox::ControllerStatePublisher *state_publisher,
+    xbox::ButtonEventDispatcher *button_dispatcher,
+    xbox::EventLoop *event_loop)
+{
+  xbox::StickPattern pattern;
+  if (!xbox::ParseStickPattern(FLAGS_simulate_pattern, &pattern))
+  {
+    std::cerr << "Unknown --simulate_pattern: " << FLAGS_simulate_pattern << std::endl;
+    return false;
+  }
+
+  if (FLAGS_simulate_report_rate_hz <= 0 ||
+      FLAGS_simulate_controllers <= 0 ||
+      FLAGS_simulate_controllers > MAX_SIMULATED_CONTROLLERS ||
+      FLAGS_simulate_duration_s < 0 ||
+      FLAGS_simulate_stats_interval_s <= 0)
+  {
+    std::cerr << "Invalid simulation parameters" << std::endl;
+    return false;
+  }
+
+  xbox::SimulationStats stats = {};
+
+  xbox::SyntheticReportGenerator report_generator;
+  int channel_fd;
+  if (!xbox::SyntheticReportGenerator::Create(
+          FLAGS_simulate_report_rate_hz,
+          FLAGS_simulate_controllers,
+          pattern,
+          &stats,
+          &report_generator,
+          &channel_fd))
+  {
+    std::cerr << "Failed to initialize SyntheticReportGenerator" << std::endl;
+    return false;
+  }
+
+  if (!event_loop->Add(&report_generator))
+  {
+    std::cerr << "Failed to add SyntheticReportGenerator to EventLoop" << std::endl;
+    close(channel_fd);
+    return false;
+  }
+
+  xbox::SimulatedServo tilt;
+  xbox::SimulatedServo pan;
+
+  xbox::SimulationStatsReporter stats_reporter;
+  if (!xbox::SimulationStatsReporter::Create(
+          std::chrono::seconds{FLAGS_simulate_stats_interval_s},
+          &stats,
+          &tilt,
+          &pan,
+          &stats_reporter))
+  {
+    std::cerr << "Failed to initialize SimulationStatsReporter" << std::endl;
+    close(channel_fd);
+    return false;
+  }
+
+  if (!event_loop->Add(&stats_reporter))
+  {
+    std::cerr << "Failed to add SimulationStatsReporter to EventLoop" << std::endl;
+    close(channel_fd);
+    return false;
+  }
+
+  std::cout << "Simulating " << FLAGS_simulate_controllers << " controller(s) at "
+            << FLAGS_simulate_report_rate_hz << " Hz, pattern "
+            << FLAGS_simulate_pattern << ", control mode " << FLAGS_control_mode
+            << std::endl;
+
+  xbox::ServoBusBudget servo_bus_budget;
+  return RunServoControl(
+      &tilt,
+      &pan,
+      SimulatedInput{
+          channel_fd,
+          &stats,
+          &stats_reporter,
+          std::chrono::seconds{FLAGS_simulate_duration_s}},
+      &servo_bus_budget,
+      nullptr,
+      nullptr,
+      capture_writer,
+      state_publisher,
+      button_dispatcher,
+      event_loop);
+}
+
+// Brings up the AX-12 bus on the event loop thread (see BasicAsyncServoBus)
+// and runs servo control over it.
+template <typename Input>
+bool RunAsyncServoControl(
+    const Input &input,
+    xbox::ServoBusBudget *servo_bus_budget,
+    xbox::ControlStateStore *control_state_store,
+    xbox::StartupTimeline *startup_timeline,
+    xbox::ControllerCaptureWriter *capture_writer,
+    xbox::ControllerStatePublisher *state_publisher,
+    xbox::ButtonEventDispatcher *button_dispatcher,
+    xbox::EventLoop *event_loop)
+{
+  using AsyncServoBus = xbox::BasicAsyncServoBus<xbox::GpioLineOutput>;
+  using AsyncServo = xbox::AsyncServo<AsyncServoBus>;
+
+  xbox::ServoStatusReturn status_return;
+  if (!xbox::ParseServoStatusReturn(FLAGS_servo_status_return, &status_return))
+  {
+    std::cerr << "Unknown --servo_status_return: " << FLAGS_servo_status_return << std::endl;
+    return false;
+  }
+
+  xbox::GpioLineOutput direction_pin;
+  if (!xbox::GpioLineOutput::Create(
+          FLAGS_servo_gpio_chip,
+          GPIO_PIN_INDEX,
+          false,
+          &direction_pin))
+  {
+    std::cerr << "Failed to initialize servo bus direction pin" << std::endl;
+    return false;
+  }
+
+  int uart_fd;
+  if (!xbox::OpenServoUart(FLAGS_servo_uart_device, FLAGS_servo_baud_rate, &uart_fd))
+  {
+    std::cerr << "Failed to open servo UART" << std::endl;
+    return false;
+  }
+
+  AsyncServoBus servo_bus{
+      &direction_pin,
+      static_cast<uint32_t>(FLAGS_servo_baud_rate),
+      status_return,
+      servo_bus_budget};
+  if (!servo_bus.Start(uart_fd, event_loop))
+  {
+    std::cerr << "Failed to start servo bus" << std::endl;
+    return false;
+  }
+
+  xbox::ServoBusConfiguration bus_configuration;
+  if (FLAGS_servo_baud_discovery &&
+      !xbox::DiscoverServoBus(
+          &servo_bus,
+          FLAGS_servo_bus_cache,
+          {SERVO_ID_TILT, SERVO_ID_PAN},
+          &bus_configuration))
+  {
+    std::cerr << "Servo bus discovery failed" << std::endl;
+    return false;
+  }
+
+  if (!servo_bus.ConfigureStatusReturn(SERVO_ID_TILT) ||
+      !servo_bus.ConfigureStatusReturn(SERVO_ID_PAN))
+  {
+    std::cerr << "Failed to start servo bus" << std::endl;
+    return false;
+  }
+
+  AsyncServo tilt{&servo_bus, SERVO_ID_TILT};
+  AsyncServo pan{&servo_bus, SERVO_ID_PAN};
+  startup_timeline->EndPhase(xbox::StartupPhase::SERVO_BUS);
+
+  return RunServoControl(
+      &tilt,
+      &pan,
+      input,
+      servo_bus_budget,
+      control_state_store,
+      startup_timeline,
+      capture_writer,
+      state_publisher,
+      button_dispatcher,
+      event_loop);
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (FLAGS_control_mode != CONTROL_MODE_DIRECT &&
+      FLAGS_control_mode != CONTROL_MODE_PLANNER &&
+      FLAGS_control_mode != CONTROL_MODE_WHEEL)
+  {
+    std::cerr << "Unknown --control_mode: " << FLAGS_control_mode << std::endl;
     return EXIT_FAILURE;
   }
 
-  xbox::BluetoothChannel bluetooth_channel;
-  if (!xbox::BluetoothChannel::Create(
-          [&] (const uint8_t *buffer, size_t length) {
-              MapXbonePacketToServoAction(
-                  &pan_tilt_action_mapper,
-                  buffer,
-                  length);
-          },
-          &bluetooth_channel))
+  // The planner and wheel mode drive the servos from their own timers; there
+  // is no per-report joint mode mapper for the arbiter to stand in for.
+  if (FLAGS_external_commands && FLAGS_control_mode != CONTROL_MODE_DIRECT)
+  {
+    std::cerr << "--external_commands requires --control_mode=" << CONTROL_MODE_DIRECT
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (FLAGS_stick_filter_min_cutoff_hz <= 0 ||
+      FLAGS_stick_filter_beta < 0 ||
+      FLAGS_stick_filter_derivative_cutoff_hz <= 0)
+  {
+    std::cerr << "Stick filter cutoffs must be positive and --stick_filter_beta "
+              << "must not be negative" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (FLAGS_teleop_max_age_ms < 0 || FLAGS_teleop_session_timeout_ms < 0)
+  {
+    std::cerr << "--teleop_max_age_ms and --teleop_session_timeout_ms must not be negative"
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (FLAGS_servo_transport != SERVO_TRANSPORT_DYNAMIXEL &&
+      FLAGS_servo_transport != SERVO_TRANSPORT_ASYNC)
+  {
+    std::cerr << "Unknown --servo_transport: " << FLAGS_servo_transport << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (!xbox::StartAsyncLogger())
+  {
+    std::cerr << "Failed to start async logger" << std::endl;
+    return EXIT_FAILURE;
+  }
+  // Declared before everything that logs, so it stops the logger last.
+  xbox::ScopedAsyncLogger async_logger;
+
+  xbox::ControllerStatePublisher state_publisher;
+  if (!xbox::ControllerStatePublisher::Create(
+          xbox::SHARED_CONTROLLER_STATE_NAME,
+          &state_publisher))
+  {
+    std::cerr << "Failed to initialize ControllerStatePublisher" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::vector<xbox::ButtonOutputBinding> button_outputs;
+  if (!xbox::ParseButtonOutputBindings(FLAGS_button_outputs, &button_outputs))
   {
-    std::cerr << "Failed to initialize BluetoothChannel" << std::endl;
     return EXIT_FAILURE;
   }
 
+  // Declared before the dispatcher, which keeps pointers to them. Unbound
+  // buttons are never visited.
+  std::array<xbox::GpioLineOutput, xbox::CONTROLLER_BUTTON_COUNT> button_lines;
+  xbox::ButtonEventDispatcher button_dispatcher;
+  for (const xbox::ButtonOutputBinding &binding : button_outputs)
+  {
+    xbox::GpioLineOutput &line = button_lines[static_cast<size_t>(binding.button)];
+    if (!xbox::GpioLineOutput::Create(FLAGS_button_gpio_chip, binding.line, false, &line))
+    {
+      std::cerr << "Failed to open button output line " << binding.line << std::endl;
+      return EXIT_FAILURE;
+    }
+    button_dispatcher.BindOutputPin(binding.button, &line, binding.mode);
+  }
+
   xbox::EventLoop event_loop;
   if (!xbox::EventLoop::Create(&event_loop))
   {
@@ -149,15 +1306,173 @@ int main(int argc, char** argv)
     return EXIT_FAILURE;
   }
 
-  if (!event_loop.Add(&bluetooth_channel))
+  // Metrics are only for observing the rig, so failing to serve them never
+  // stops the control path.
+  xbox::MetricsServer metrics_server;
+  if (!FLAGS_metrics_socket_path.empty())
   {
-    std::cerr << "Failed to add BluetoothChannel to EventLoop" << std::endl;
+    if (!xbox::MetricsServer::Create(FLAGS_metrics_socket_path, &metrics_server))
+    {
+      std::cerr << "Continuing without metrics" << std::endl;
+    }
+    else if (!event_loop.Add(&metrics_server))
+    {
+      std::cerr << "Failed to add MetricsServer to EventLoop. Continuing without metrics"
+                << std::endl;
+      metrics_server = xbox::MetricsServer{};
+    }
+  }
+
+  xbox::ControllerCaptureWriter capture_writer;
+  if (!FLAGS_capture_path.empty() &&
+      !xbox::ControllerCaptureWriter::Create(FLAGS_capture_path, &capture_writer))
+  {
+    std::cerr << "Failed to initialize ControllerCaptureWriter" << std::endl;
     return EXIT_FAILURE;
   }
+  xbox::ControllerCaptureWriter *active_capture_writer =
+      FLAGS_capture_path.empty() ? nullptr : &capture_writer;
 
-  if (!event_loop.Run())
+  if (FLAGS_simulate)
+  {
+    bool simulation_succeeded = RunSimulation(
+        active_capture_writer,
+        &state_publisher,
+        &button_dispatcher,
+        &event_loop);
+    return simulation_succeeded ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  xbox::ControlStateStore control_state_store;
+  xbox::ControlStateStore *active_control_state_store = nullptr;
+  if (!FLAGS_control_state_path.empty())
+  {
+    if (xbox::ControlStateStore::Open(FLAGS_control_state_path, &control_state_store))
+    {
+      active_control_state_store = &control_state_store;
+    }
+    else
+    {
+      std::cerr << "Continuing without saved control state" << std::endl;
+    }
+  }
+
+  // Phases run concurrently: the monitor channel opens first, controllers
+  // connect on a worker thread and the servo bus comes up meanwhile.
+  xbox::StartupTimeline startup_timeline;
+
+  startup_timeline.BeginPhase(xbox::StartupPhase::MONITOR_CHANNEL);
+  int monitor_fd;
+  if (!xbox::OpenHciMonitorSocket(&monitor_fd))
+  {
+    std::cerr << "Failed to initialize BluetoothChannel" << std::endl;
+    return EXIT_FAILURE;
+  }
+  startup_timeline.EndPhase(xbox::StartupPhase::MONITOR_CHANNEL);
+
+  std::vector<xbox::BluetoothAdapter> bluetooth_adapters;
+  xbox::HciAdapterMask adapter_mask = xbox::ALL_HCI_ADAPTERS;
+  if (!FLAGS_bluetooth_adapters.empty())
+  {
+    if (!xbox::ParseBluetoothAdapters(FLAGS_bluetooth_adapters, &bluetooth_adapters))
+    {
+      std::cerr << "Invalid --bluetooth_adapters: " << FLAGS_bluetooth_adapters << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    adapter_mask = 0;
+    for (const xbox::BluetoothAdapter &adapter : bluetooth_adapters)
+    {
+      if (adapter.dev_id >= 64)
+      {
+        std::cerr << "Bluetooth adapter index too large to filter: hci" << adapter.dev_id
+                  << std::endl;
+        return EXIT_FAILURE;
+      }
+      adapter_mask |= xbox::HciAdapterMask{1} << adapter.dev_id;
+    }
+  }
+  else
+  {
+    xbox::BluetoothAdapter default_adapter;
+    if (xbox::GetDefaultBluetoothAdapter(&default_adapter))
+    {
+      bluetooth_adapters.push_back(default_adapter);
+    }
+  }
+
+  BluetoothConnectPhase bluetooth_connect_phase{
+      std::move(bluetooth_adapters),
+      active_control_state_store,
+      &startup_timeline};
+  if (!bluetooth_connect_phase.Start())
+  {
+    std::cerr << "Failed to start Bluetooth connect phase" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (!event_loop.Add(&bluetooth_connect_phase))
+  {
+    std::cerr << "Failed to add Bluetooth connect phase to EventLoop" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  startup_timeline.BeginPhase(xbox::StartupPhase::SERVO_BUS);
+  xbox::ServoBusBudget servo_bus_budget;
+
+  if (FLAGS_servo_transport == SERVO_TRANSPORT_ASYNC)
+  {
+    bool control_succeeded = RunAsyncServoControl(
+        HciMonitorInput{monitor_fd, adapter_mask},
+        &servo_bus_budget,
+        active_control_state_store,
+        &startup_timeline,
+        active_capture_writer,
+        &state_publisher,
+        &button_dispatcher,
+        &event_loop);
+    return control_succeeded ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  RpiSystemContext system_context;
+  RpiPinManager gpio_manager;
+  AxA12Factory axa12_factory;
+  if (!AxA12Factory::Create(
+            &system_context,
+            &gpio_manager,
+            GPIO_PIN_INDEX,
+            &axa12_factory))
+  {
+    std::cerr << "Failed to create AxA12Factory" << std::endl;
+    return EXIT_FAILURE;
+  }
+  AxA12 *axa12_tilt;
+  if (!axa12_factory.Get(SERVO_ID_TILT, &axa12_tilt))
+  {
+    std::cerr << "Failed to initialize AxA12 servo" << std::endl;
+    return false;
+  }
+
+  AxA12 *axa12_pan;
+  if (!axa12_factory.Get(SERVO_ID_PAN, &axa12_pan))
+  {
+    std::cerr << "Failed to initialize AxA12 servo" << std::endl;
+    return false;
+  }
+  startup_timeline.EndPhase(xbox::StartupPhase::SERVO_BUS);
+
+  if (!RunServoControl(
+          axa12_tilt,
+          axa12_pan,
+          HciMonitorInput{monitor_fd, adapter_mask},
+          &servo_bus_budget,
+          active_control_state_store,
+          &startup_timeline,
+          active_capture_writer,
+          &state_publisher,
+          &button_dispatcher,
+          &event_loop))
   {
-    std::cerr << "Failed to run EventLoop" << std::endl;
     return EXIT_FAILURE;
   }
 
@@ -0,0 +1,167 @@
+#include "src/axis_state_machine.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+namespace xbox
+{
+namespace
+{
+constexpr uint16_t UNKNOWN_VALUE = 0xFFFF;
+
+// What the three registers the state machine drives hold. Speed is 1 slow or
+// 2 fast and direction 1 positive or 2 negative, like the table's own model,
+// but derived here from the state and command names.
+struct Registers
+{
+  uint16_t torque;
+  uint16_t speed;
+  uint16_t direction;
+};
+
+bool IsPositive(AxisCommand command)
+{
+  return command == AxisCommand::POSITIVE_SLOW || command == AxisCommand::POSITIVE_FAST;
+}
+
+bool IsFast(AxisCommand command)
+{
+  return command == AxisCommand::POSITIVE_FAST || command == AxisCommand::NEGATIVE_FAST;
+}
+
+// The moving command each MOVING_* and STOPPING_* state was entered with.
+AxisCommand GetMotion(AxisState state)
+{
+  switch (state)
+  {
+    case AxisState::MOVING_POSITIVE_SLOW:
+    case AxisState::STOPPING_POSITIVE_SLOW:
+      return AxisCommand::POSITIVE_SLOW;
+    case AxisState::MOVING_POSITIVE_FAST:
+    case AxisState::STOPPING_POSITIVE_FAST:
+      return AxisCommand::POSITIVE_FAST;
+    case AxisState::MOVING_NEGATIVE_SLOW:
+    case AxisState::STOPPING_NEGATIVE_SLOW:
+      return AxisCommand::NEGATIVE_SLOW;
+    case AxisState::MOVING_NEGATIVE_FAST:
+    case AxisState::STOPPING_NEGATIVE_FAST:
+      return AxisCommand::NEGATIVE_FAST;
+    default:
+      return AxisCommand::STOP;
+  }
+}
+
+bool IsStopping(AxisState state)
+{
+  return state >= AxisState::STOPPING_POSITIVE_SLOW && state <= AxisState::STOPPING_NEGATIVE_FAST;
+}
+
+Registers GetRegisters(AxisState state)
+{
+  if (state == AxisState::UNKNOWN)
+  {
+    return Registers{UNKNOWN_VALUE, UNKNOWN_VALUE, UNKNOWN_VALUE};
+  }
+  if (state == AxisState::STOPPED)
+  {
+    return Registers{0, UNKNOWN_VALUE, UNKNOWN_VALUE};
+  }
+
+  AxisCommand motion = GetMotion(state);
+  return Registers{
+      static_cast<uint16_t>(IsStopping(state) ? 0 : 1),
+      static_cast<uint16_t>(IsFast(motion) ? 2 : 1),
+      static_cast<uint16_t>(IsPositive(motion) ? 1 : 2)};
+}
+
+// Applies |writes| for |command| the way the mapper does.
+Registers Apply(Registers registers, uint8_t writes, AxisCommand command)
+{
+  if (writes & AXIS_WRITE_MOVING_SPEED)
+  {
+    registers.speed = IsFast(command) ? 2 : 1;
+  }
+  if (writes & AXIS_WRITE_GOAL_POSITION)
+  {
+    registers.direction = IsPositive(command) ? 1 : 2;
+  }
+  if (writes & AXIS_WRITE_TORQUE_ENABLE)
+  {
+    registers.torque = 1;
+  }
+  if (writes & AXIS_WRITE_TORQUE_DISABLE)
+  {
+    registers.torque = 0;
+  }
+  return registers;
+}
+
+TEST(AxisStateMachineTest, EveryTransitionReachesItsStateWithMinimalWrites)
+{
+  for (size_t s = 0; s < AXIS_STATE_COUNT; ++s)
+  {
+    for (size_t c = 0; c < AXIS_COMMAND_COUNT; ++c)
+    {
+      AxisState state = static_cast<AxisState>(s);
+      AxisCommand command = static_cast<AxisCommand>(c);
+      SCOPED_TRACE(testing::Message() << "state=" << s << " command=" << c);
+
+      AxisTransition transition = GetAxisTransition(state, command);
+      Registers before = GetRegisters(state);
+      Registers after = Apply(before, transition.writes, command);
+
+      EXPECT_FALSE(
+          (transition.writes & AXIS_WRITE_TORQUE_ENABLE) &&
+          (transition.writes & AXIS_WRITE_TORQUE_DISABLE));
+
+      if (command == AxisCommand::STOP)
+      {
+        EXPECT_EQ(0, after.torque);
+        EXPECT_FALSE(IsAxisMoving(transition.next_state));
+        EXPECT_EQ(before.torque != 0, (transition.writes & AXIS_WRITE_TORQUE_DISABLE) != 0);
+        EXPECT_EQ(0, transition.writes & ~AXIS_WRITE_TORQUE_DISABLE);
+        if (state != AxisState::UNKNOWN)
+        {
+          // Speed and goal are kept, so a later resume can reuse them.
+          EXPECT_EQ(before.speed, GetRegisters(transition.next_state).speed);
+          EXPECT_EQ(before.direction, GetRegisters(transition.next_state).direction);
+        }
+        continue;
+      }
+
+      Registers expected = GetRegisters(transition.next_state);
+      EXPECT_TRUE(IsAxisMoving(transition.next_state));
+      EXPECT_EQ(command, GetMotion(transition.next_state));
+      EXPECT_EQ(expected.torque, after.torque);
+      EXPECT_EQ(expected.speed, after.speed);
+      EXPECT_EQ(expected.direction, after.direction);
+
+      // Nothing is rewritten with what the register already holds.
+      EXPECT_EQ(before.speed != expected.speed, (transition.writes & AXIS_WRITE_MOVING_SPEED) != 0);
+      EXPECT_EQ(
+          before.direction != expected.direction,
+          (transition.writes & AXIS_WRITE_GOAL_POSITION) != 0);
+      EXPECT_EQ(before.torque != 1, (transition.writes & AXIS_WRITE_TORQUE_ENABLE) != 0);
+      EXPECT_EQ(0, transition.writes & AXIS_WRITE_TORQUE_DISABLE);
+    }
+  }
+}
+
+TEST(AxisStateMachineTest, RepeatingACommandWritesNothing)
+{
+  for (size_t s = 0; s < AXIS_STATE_COUNT; ++s)
+  {
+    for (size_t c = 0; c < AXIS_COMMAND_COUNT; ++c)
+    {
+      AxisCommand command = static_cast<AxisCommand>(c);
+      AxisTransition first = GetAxisTransition(static_cast<AxisState>(s), command);
+      AxisTransition repeat = GetAxisTransition(first.next_state, command);
+      EXPECT_EQ(0, repeat.writes) << "state=" << s << " command=" << c;
+      EXPECT_EQ(first.next_state, repeat.next_state) << "state=" << s << " command=" << c;
+    }
+  }
+}
+
+}  // namespace
+}  // namespace xbox
@@ -0,0 +1,178 @@
+#include "src/button_event_dispatcher.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace xbox
+{
+namespace
+{
+using Write = std::pair<int, bool>;
+
+// Records every Set() and Clear() into a log shared by all pins of a test.
+class FakePin
+{
+public:
+  FakePin(int id, std::vector<Write> *writes) : id_{id}, writes_{writes} {}
+
+  void Set() { writes_->push_back(Write{id_, true}); }
+  void Clear() { writes_->push_back(Write{id_, false}); }
+
+private:
+  int id_;
+  std::vector<Write> *writes_;
+};
+
+using FakeDispatcher = BasicButtonEventDispatcher<FakePin>;
+
+constexpr uint16_t A = ToButtonMask(ControllerButton::A);
+constexpr uint16_t B = ToButtonMask(ControllerButton::B);
+constexpr uint16_t X = ToButtonMask(ControllerButton::X);
+constexpr uint16_t DPAD_UP = ToButtonMask(ControllerButton::DPAD_UP);
+
+// Handler that records which button fired and drives |pin| to the press state.
+struct RecordingHandler
+{
+  ControllerButton button;
+  FakePin *pin;
+  std::vector<std::pair<ControllerButton, bool>> *calls;
+
+  static void Handle(void *context, bool pressed, GpioWriteBatch<FakePin> *batch)
+  {
+    RecordingHandler *handler = static_cast<RecordingHandler *>(context);
+    handler->calls->push_back(std::make_pair(handler->button, pressed));
+    if (handler->pin)
+    {
+      batch->Write(handler->pin, pressed);
+    }
+  }
+};
+
+TEST(ButtonEventDispatcherTest, FollowPinTracksTheButton)
+{
+  std::vector<Write> writes;
+  FakePin pin{1, &writes};
+  FakeDispatcher dispatcher;
+  dispatcher.BindOutputPin(ControllerButton::A, &pin, ButtonOutputMode::FOLLOW);
+
+  dispatcher.ProcessButtons(A);
+  dispatcher.ProcessButtons(0);
+  dispatcher.ProcessButtons(A);
+
+  EXPECT_EQ((std::vector<Write>{{1, true}, {1, false}, {1, true}}), writes);
+}
+
+TEST(ButtonEventDispatcherTest, TogglePinFlipsOnPressOnly)
+{
+  std::vector<Write> writes;
+  FakePin pin{1, &writes};
+  FakeDispatcher dispatcher;
+  dispatcher.BindOutputPin(ControllerButton::DPAD_UP, &pin, ButtonOutputMode::TOGGLE);
+
+  dispatcher.ProcessButtons(DPAD_UP);
+  dispatcher.ProcessButtons(0);
+  dispatcher.ProcessButtons(DPAD_UP);
+  dispatcher.ProcessButtons(0);
+
+  EXPECT_EQ((std::vector<Write>{{1, true}, {1, false}}), writes);
+}
+
+TEST(ButtonEventDispatcherTest, OnlyChangedBoundButtonsReachTheirHandlers)
+{
+  std::vector<std::pair<ControllerButton, bool>> calls;
+  RecordingHandler a_handler{ControllerButton::A, nullptr, &calls};
+  RecordingHandler x_handler{ControllerButton::X, nullptr, &calls};
+  FakeDispatcher dispatcher;
+  dispatcher.Bind(ControllerButton::A, &RecordingHandler::Handle, &a_handler);
+  dispatcher.Bind(ControllerButton::X, &RecordingHandler::Handle, &x_handler);
+
+  // B is unbound; A stays held across the second report.
+  dispatcher.ProcessButtons(A | B);
+  dispatcher.ProcessButtons(A | X);
+  dispatcher.ProcessButtons(X);
+
+  std::vector<std::pair<ControllerButton, bool>> expected = {
+      {ControllerButton::A, true},
+      {ControllerButton::X, true},
+      {ControllerButton::A, false},
+  };
+  EXPECT_EQ(expected, calls);
+}
+
+TEST(ButtonEventDispatcherTest, HandlersSharingAPinWriteItOnceWithTheFinalLevel)
+{
+  std::vector<Write> writes;
+  std::vector<std::pair<ControllerButton, bool>> calls;
+  FakePin pin{1, &writes};
+  RecordingHandler a_handler{ControllerButton::A, &pin, &calls};
+  RecordingHandler b_handler{ControllerButton::B, &pin, &calls};
+  FakeDispatcher dispatcher;
+  dispatcher.Bind(ControllerButton::A, &RecordingHandler::Handle, &a_handler);
+  dispatcher.Bind(ControllerButton::B, &RecordingHandler::Handle, &b_handler);
+
+  // A is pressed, then released in the same report that presses B. Handlers
+  // run from the lowest bit, so B's level is the last one written.
+  dispatcher.ProcessButtons(A);
+  writes.clear();
+  dispatcher.ProcessButtons(B);
+
+  std::vector<std::pair<ControllerButton, bool>> expected = {
+      {ControllerButton::A, true},
+      {ControllerButton::A, false},
+      {ControllerButton::B, true},
+  };
+  EXPECT_EQ(expected, calls);
+  EXPECT_EQ((std::vector<Write>{{1, true}}), writes);
+}
+
+TEST(ButtonEventDispatcherTest, UnchangedReportWritesNothing)
+{
+  std::vector<Write> writes;
+  FakePin pin{1, &writes};
+  FakeDispatcher dispatcher;
+  dispatcher.BindOutputPin(ControllerButton::A, &pin, ButtonOutputMode::FOLLOW);
+
+  dispatcher.ProcessButtons(A | B);
+  writes.clear();
+  dispatcher.ProcessButtons(A | B);
+  // A change on an unbound button alone is no change either.
+  dispatcher.ProcessButtons(A);
+
+  EXPECT_TRUE(writes.empty());
+}
+
+TEST(ParseButtonOutputBindingsTest, ParsesFollowAndToggleEntries)
+{
+  std::vector<ButtonOutputBinding> bindings;
+  ASSERT_TRUE(ParseButtonOutputBindings("A:17,DPAD_LEFT:27:toggle", &bindings));
+
+  ASSERT_EQ(2u, bindings.size());
+  EXPECT_EQ(ControllerButton::A, bindings[0].button);
+  EXPECT_EQ(17u, bindings[0].line);
+  EXPECT_EQ(ButtonOutputMode::FOLLOW, bindings[0].mode);
+  EXPECT_EQ(ControllerButton::DPAD_LEFT, bindings[1].button);
+  EXPECT_EQ(27u, bindings[1].line);
+  EXPECT_EQ(ButtonOutputMode::TOGGLE, bindings[1].mode);
+}
+
+TEST(ParseButtonOutputBindingsTest, EmptySpecBindsNothing)
+{
+  std::vector<ButtonOutputBinding> bindings(1);
+  ASSERT_TRUE(ParseButtonOutputBindings("", &bindings));
+  EXPECT_TRUE(bindings.empty());
+}
+
+TEST(ParseButtonOutputBindingsTest, RejectsMalformedEntries)
+{
+  std::vector<ButtonOutputBinding> bindings;
+  for (const char *spec : {"A", "A:", "Z:17", "A:17x", "A:17:blink", "A:17,"})
+  {
+    EXPECT_FALSE(ParseButtonOutputBindings(spec, &bindings)) << spec;
+  }
+}
+
+}  // namespace
+}  // namespace xbox
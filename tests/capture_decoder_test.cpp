@@ -0,0 +1,153 @@
+#include "src/capture_decoder.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace xbox
+{
+namespace
+{
+// Off the 8 and 16 record SIMD blocks on purpose, so every kernel's tail runs.
+constexpr size_t RECORD_COUNTS[] = {0, 1, 7, 8, 9, 15, 16, 17, 31, 33, 100, 1023};
+
+constexpr CaptureDecodeIsa ALL_ISAS[] = {
+    CaptureDecodeIsa::SCALAR,
+    CaptureDecodeIsa::SSE2,
+    CaptureDecodeIsa::AVX2,
+};
+
+// Records with every payload and padding byte random, so trigger bits the
+// decoder must mask off and the spare lane are set too.
+std::vector<ControllerCaptureRecord> MakeRecords(size_t count)
+{
+  std::mt19937 random{static_cast<uint32_t>(count)};
+  std::uniform_int_distribution<int> byte{0, 0xFF};
+
+  std::vector<ControllerCaptureRecord> records(count);
+  for (size_t i = 0; i < count; ++i)
+  {
+    records[i].timestamp_ns = 1000000000 + 1000000 * static_cast<int64_t>(i);
+    for (uint8_t &value : records[i].payload)
+    {
+      value = static_cast<uint8_t>(byte(random));
+    }
+    for (uint8_t &value : records[i].padding)
+    {
+      value = static_cast<uint8_t>(byte(random));
+    }
+  }
+  return records;
+}
+
+ControllerReportColumns Decode(
+    CaptureDecodeIsa isa,
+    const std::vector<ControllerCaptureRecord> &records)
+{
+  ControllerReportColumns columns;
+  columns.Resize(records.size());
+  DecodeCaptureRecords(isa, records.data(), records.size(), 0, &columns);
+  return columns;
+}
+
+void ExpectColumnsEqual(
+    const ControllerReportColumns &expected,
+    const ControllerReportColumns &actual)
+{
+  EXPECT_EQ(expected.timestamp_ns, actual.timestamp_ns);
+  EXPECT_EQ(expected.left_stick_x, actual.left_stick_x);
+  EXPECT_EQ(expected.left_stick_y, actual.left_stick_y);
+  EXPECT_EQ(expected.right_stick_x, actual.right_stick_x);
+  EXPECT_EQ(expected.right_stick_y, actual.right_stick_y);
+  EXPECT_EQ(expected.left_trigger, actual.left_trigger);
+  EXPECT_EQ(expected.right_trigger, actual.right_trigger);
+  EXPECT_EQ(expected.dpad, actual.dpad);
+  EXPECT_EQ(expected.buttons, actual.buttons);
+}
+
+TEST(CaptureDecoderTest, ScalarDecodesEachField)
+{
+  std::vector<ControllerCaptureRecord> records(1);
+  records[0].timestamp_ns = 42;
+  for (size_t i = 0; i < sizeof(records[0].payload); ++i)
+  {
+    records[0].payload[i] = static_cast<uint8_t>(i);
+  }
+  // Only the low two bits of each trigger's high byte count.
+  records[0].payload[19] = 0xFE;
+  records[0].payload[21] = 0x07;
+
+  ControllerReportColumns columns = Decode(CaptureDecodeIsa::SCALAR, records);
+  ASSERT_EQ(1u, columns.GetSize());
+  EXPECT_EQ(42, columns.timestamp_ns[0]);
+  EXPECT_EQ(0x0B0A, columns.left_stick_x[0]);
+  EXPECT_EQ(0x0D0C, columns.left_stick_y[0]);
+  EXPECT_EQ(0x0F0E, columns.right_stick_x[0]);
+  EXPECT_EQ(0x1110, columns.right_stick_y[0]);
+  EXPECT_EQ(0x0212, columns.left_trigger[0]);
+  EXPECT_EQ(0x0314, columns.right_trigger[0]);
+  EXPECT_EQ(0x16, columns.dpad[0]);
+  EXPECT_EQ(0x17, columns.buttons[0]);
+}
+
+TEST(CaptureDecoderTest, EverySupportedKernelMatchesScalar)
+{
+  for (size_t count : RECORD_COUNTS)
+  {
+    std::vector<ControllerCaptureRecord> records = MakeRecords(count);
+    ControllerReportColumns reference = Decode(CaptureDecodeIsa::SCALAR, records);
+
+    for (CaptureDecodeIsa isa : ALL_ISAS)
+    {
+      if (!IsCaptureDecodeIsaSupported(isa))
+      {
+        continue;
+      }
+
+      SCOPED_TRACE(testing::Message() << GetCaptureDecodeIsaName(isa) << " " << count);
+      ExpectColumnsEqual(reference, Decode(isa, records));
+    }
+  }
+}
+
+TEST(CaptureDecoderTest, ChunksDecodedOnSeveralThreadsMatchOneDecode)
+{
+  // Chunk edges fall mid-block, as xbone_capture_decode's do.
+  constexpr size_t RECORD_COUNT = 1000;
+  constexpr size_t CHUNK_SIZE = 333;
+  std::vector<ControllerCaptureRecord> records = MakeRecords(RECORD_COUNT);
+  ControllerReportColumns reference = Decode(CaptureDecodeIsa::SCALAR, records);
+
+  for (CaptureDecodeIsa isa : ALL_ISAS)
+  {
+    if (!IsCaptureDecodeIsaSupported(isa))
+    {
+      continue;
+    }
+
+    ControllerReportColumns columns;
+    columns.Resize(RECORD_COUNT);
+    std::vector<std::thread> threads;
+    for (size_t begin = 0; begin < RECORD_COUNT; begin += CHUNK_SIZE)
+    {
+      size_t end = std::min(RECORD_COUNT, begin + CHUNK_SIZE);
+      threads.emplace_back([&, begin, end] {
+        DecodeCaptureRecords(isa, records.data() + begin, end - begin, begin, &columns);
+      });
+    }
+    for (std::thread &thread : threads)
+    {
+      thread.join();
+    }
+
+    SCOPED_TRACE(GetCaptureDecodeIsaName(isa));
+    ExpectColumnsEqual(reference, columns);
+  }
+}
+
+}  // namespace
+}  // namespace xbox
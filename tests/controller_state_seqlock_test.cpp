@@ -0,0 +1,159 @@
+#include "src/controller_state_publisher.h"
+#include "src/controller_state_reader.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <new>
+#include <string>
+#include <thread>
+
+namespace xbox
+{
+namespace
+{
+constexpr uint64_t CONCURRENT_PUBLISH_COUNT = 200000;
+
+std::string GetSegmentName()
+{
+  return "/xbone-seqlock-test-" + std::to_string(getpid());
+}
+
+// Every field of the snapshot published as number |i|, so a torn copy shows
+// up as fields that disagree.
+void Publish(ControllerStatePublisher *publisher, uint64_t i)
+{
+  uint16_t value = static_cast<uint16_t>(i);
+  ControllerReport report = {};
+  report.left_stick_x = value;
+  report.left_stick_y = static_cast<uint16_t>(~value);
+  report.buttons = static_cast<uint8_t>(value);
+
+  ControllerReport raw_report = report;
+  raw_report.right_stick_x = value;
+  publisher->SetRawReport(raw_report);
+
+  ServoCommandState tilt = {};
+  tilt.moving_speed = value;
+  tilt.goal_position = static_cast<uint16_t>(value + 1);
+  ServoCommandState pan = {};
+  pan.moving_speed = static_cast<uint16_t>(value + 2);
+  pan.goal_position = static_cast<uint16_t>(value + 3);
+  publisher->Publish(report, tilt, pan);
+}
+
+// Whether |snapshot| is exactly what Publish() wrote for its report count.
+bool IsConsistent(const ControllerStateSnapshot &snapshot)
+{
+  if (snapshot.report_count == 0)
+  {
+    return true;
+  }
+
+  uint16_t value = static_cast<uint16_t>(snapshot.report_count);
+  return snapshot.report.left_stick_x == value &&
+      snapshot.report.left_stick_y == static_cast<uint16_t>(~value) &&
+      snapshot.report.buttons == static_cast<uint8_t>(value) &&
+      snapshot.raw_report.right_stick_x == value &&
+      snapshot.tilt.moving_speed == value &&
+      snapshot.tilt.goal_position == static_cast<uint16_t>(value + 1) &&
+      snapshot.pan.moving_speed == static_cast<uint16_t>(value + 2) &&
+      snapshot.pan.goal_position == static_cast<uint16_t>(value + 3);
+}
+
+TEST(ControllerStateSeqlockTest, ReaderSeesLatestSnapshot)
+{
+  std::string name = GetSegmentName();
+  ControllerStatePublisher publisher;
+  ASSERT_TRUE(ControllerStatePublisher::Create(name, &publisher));
+  ControllerStateReader reader;
+  ASSERT_TRUE(ControllerStateReader::Open(name.c_str(), &reader));
+
+  ControllerStateSnapshot snapshot;
+  ASSERT_TRUE(reader.Read(&snapshot));
+  EXPECT_EQ(0u, snapshot.report_count);
+
+  Publish(&publisher, 1);
+  Publish(&publisher, 2);
+
+  ASSERT_TRUE(reader.Read(&snapshot));
+  EXPECT_EQ(2u, snapshot.report_count);
+  EXPECT_TRUE(IsConsistent(snapshot));
+}
+
+TEST(ControllerStateSeqlockTest, ConcurrentReadsAreNeverTorn)
+{
+  std::string name = GetSegmentName();
+  ControllerStatePublisher publisher;
+  ASSERT_TRUE(ControllerStatePublisher::Create(name, &publisher));
+  ControllerStateReader reader;
+  ASSERT_TRUE(ControllerStateReader::Open(name.c_str(), &reader));
+
+  std::atomic<bool> done{false};
+  std::thread writer([&] {
+    for (uint64_t i = 1; i <= CONCURRENT_PUBLISH_COUNT; ++i)
+    {
+      Publish(&publisher, i);
+    }
+    done.store(true, std::memory_order_release);
+  });
+
+  uint64_t last_count = 0;
+  uint64_t torn_reads = 0;
+  uint64_t backwards_reads = 0;
+  while (!done.load(std::memory_order_acquire))
+  {
+    ControllerStateSnapshot snapshot;
+    if (!reader.Read(&snapshot))
+    {
+      continue;
+    }
+
+    if (!IsConsistent(snapshot))
+    {
+      ++torn_reads;
+    }
+    if (snapshot.report_count < last_count)
+    {
+      ++backwards_reads;
+    }
+    last_count = snapshot.report_count;
+  }
+  writer.join();
+
+  EXPECT_EQ(0u, torn_reads);
+  EXPECT_EQ(0u, backwards_reads);
+
+  ControllerStateSnapshot snapshot;
+  ASSERT_TRUE(reader.Read(&snapshot));
+  EXPECT_EQ(CONCURRENT_PUBLISH_COUNT, snapshot.report_count);
+}
+
+TEST(ControllerStateSeqlockTest, ReadGivesUpWhileWriterIsMidUpdate)
+{
+  void *mapping = mmap(
+      nullptr,
+      sizeof(SharedControllerState),
+      PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_ANONYMOUS,
+      -1,
+      0);
+  ASSERT_NE(MAP_FAILED, mapping);
+  SharedControllerState *state = new (mapping) SharedControllerState{};
+  state->sequence.store(1, std::memory_order_release);
+
+  // The reader unmaps the segment when it goes away.
+  ControllerStateReader reader{state};
+  ControllerStateSnapshot snapshot;
+  EXPECT_FALSE(reader.Read(&snapshot, 10));
+
+  state->sequence.store(2, std::memory_order_release);
+  EXPECT_TRUE(reader.Read(&snapshot, 10));
+}
+
+}  // namespace
+}  // namespace xbox
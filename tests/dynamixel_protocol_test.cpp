@@ -0,0 +1,141 @@
+#include "src/dynamixel_protocol.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace xbox
+{
+namespace
+{
+using Result = DynamixelStatusParser::Result;
+
+std::vector<uint8_t> GetBytes(const DynamixelPacket &packet)
+{
+  return std::vector<uint8_t>(packet.bytes.begin(), packet.bytes.begin() + packet.size);
+}
+
+// Feeds |bytes| one at a time and returns every result that was not
+// INCOMPLETE, in order.
+std::vector<Result> Feed(DynamixelStatusParser *parser, const std::vector<uint8_t> &bytes)
+{
+  std::vector<Result> results;
+  for (uint8_t byte : bytes)
+  {
+    Result result = parser->Feed(byte);
+    if (result != Result::INCOMPLETE)
+    {
+      results.push_back(result);
+    }
+  }
+  return results;
+}
+
+// The instruction packets below are the examples from the AX-12 manual.
+TEST(DynamixelPacketTest, BuildsWritePackets)
+{
+  DynamixelPacket packet;
+  BuildDynamixelWritePacket(
+      DYNAMIXEL_BROADCAST_ID,
+      static_cast<AxA12Address>(0x03),
+      1,
+      1,
+      &packet);
+  EXPECT_EQ(
+      (std::vector<uint8_t>{0xFF, 0xFF, 0xFE, 0x04, 0x03, 0x03, 0x01, 0xF6}),
+      GetBytes(packet));
+
+  BuildDynamixelWritePacket(1, AxA12Address::GOAL_POSITION, 0x0200, 2, &packet);
+  EXPECT_EQ(
+      (std::vector<uint8_t>{0xFF, 0xFF, 0x01, 0x05, 0x03, 0x1E, 0x00, 0x02, 0xD6}),
+      GetBytes(packet));
+}
+
+TEST(DynamixelPacketTest, BuildsReadAndPingPackets)
+{
+  DynamixelPacket packet;
+  BuildDynamixelReadPacket(1, static_cast<AxA12Address>(0x2B), 1, &packet);
+  EXPECT_EQ(
+      (std::vector<uint8_t>{0xFF, 0xFF, 0x01, 0x04, 0x02, 0x2B, 0x01, 0xCC}),
+      GetBytes(packet));
+
+  BuildDynamixelPingPacket(1, &packet);
+  EXPECT_EQ((std::vector<uint8_t>{0xFF, 0xFF, 0x01, 0x02, 0x01, 0xFB}), GetBytes(packet));
+}
+
+TEST(DynamixelStatusParserTest, ParsesStatusWithParams)
+{
+  DynamixelStatusParser parser;
+  std::vector<Result> results = Feed(&parser, {0xFF, 0xFF, 0x01, 0x03, 0x00, 0x20, 0xDB});
+
+  ASSERT_EQ(std::vector<Result>{Result::COMPLETE}, results);
+  const DynamixelStatus &status = parser.GetStatus();
+  EXPECT_EQ(1, status.id);
+  EXPECT_EQ(0, status.error);
+  ASSERT_EQ(1, status.param_count);
+  EXPECT_EQ(0x20, status.params[0]);
+}
+
+TEST(DynamixelStatusParserTest, ParsesStatusWithoutParamsAndReportsErrors)
+{
+  DynamixelStatusParser parser;
+  // Error 0x20: overload.
+  std::vector<Result> results = Feed(&parser, {0xFF, 0xFF, 0x02, 0x02, 0x20, 0xDB});
+
+  ASSERT_EQ(std::vector<Result>{Result::COMPLETE}, results);
+  EXPECT_EQ(2, parser.GetStatus().id);
+  EXPECT_EQ(0x20, parser.GetStatus().error);
+  EXPECT_EQ(0, parser.GetStatus().param_count);
+}
+
+TEST(DynamixelStatusParserTest, SkipsGarbageAndExtraHeaderBytes)
+{
+  DynamixelStatusParser parser;
+  std::vector<Result> results = Feed(
+      &parser,
+      {0x12, 0xFF, 0x34, 0xFF, 0xFF, 0xFF, 0x01, 0x04, 0x00, 0x00, 0x02, 0xF8});
+
+  ASSERT_EQ(std::vector<Result>{Result::COMPLETE}, results);
+  ASSERT_EQ(2, parser.GetStatus().param_count);
+  EXPECT_EQ(0x00, parser.GetStatus().params[0]);
+  EXPECT_EQ(0x02, parser.GetStatus().params[1]);
+}
+
+TEST(DynamixelStatusParserTest, BadChecksumIsMalformedAndTheNextPacketParses)
+{
+  DynamixelStatusParser parser;
+  std::vector<Result> results = Feed(
+      &parser,
+      {0xFF, 0xFF, 0x01, 0x03, 0x00, 0x20, 0xDA,
+       0xFF, 0xFF, 0x01, 0x03, 0x00, 0x21, 0xDA});
+
+  EXPECT_EQ((std::vector<Result>{Result::MALFORMED, Result::COMPLETE}), results);
+  EXPECT_EQ(0x21, parser.GetStatus().params[0]);
+}
+
+TEST(DynamixelStatusParserTest, ImpossibleLengthIsMalformed)
+{
+  for (uint8_t length : {uint8_t{0}, uint8_t{1}, uint8_t{DYNAMIXEL_MAX_STATUS_PARAMS + 3}})
+  {
+    DynamixelStatusParser parser;
+    EXPECT_EQ(std::vector<Result>{Result::MALFORMED}, Feed(&parser, {0xFF, 0xFF, 0x01, length}));
+    EXPECT_EQ(
+        std::vector<Result>{Result::COMPLETE},
+        Feed(&parser, {0xFF, 0xFF, 0x01, 0x02, 0x00, 0xFC}));
+  }
+}
+
+TEST(DynamixelStatusParserTest, ResetDropsAPartialPacket)
+{
+  DynamixelStatusParser parser;
+  Feed(&parser, {0xFF, 0xFF, 0x01, 0x03});
+  parser.Reset();
+
+  EXPECT_EQ(
+      std::vector<Result>{Result::COMPLETE},
+      Feed(&parser, {0xFF, 0xFF, 0x01, 0x02, 0x00, 0xFC}));
+}
+
+}  // namespace
+}  // namespace xbox
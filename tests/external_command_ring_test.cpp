@@ -0,0 +1,172 @@
+#include "src/external_command_source.h"
+#include "src/external_command_writer.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+namespace xbox
+{
+namespace
+{
+constexpr int64_t CONCURRENT_PUSH_COUNT = 100000;
+
+std::string GetSegmentName()
+{
+  return "/xbone-command-ring-test-" + std::to_string(getpid());
+}
+
+// Every field of command number |i|, so a torn slot shows up as fields that
+// disagree.
+ExternalCommand MakeCommand(int64_t i)
+{
+  uint16_t value = static_cast<uint16_t>(i);
+  ExternalCommand command = {};
+  command.timestamp_ns = i;
+  command.tilt.goal_position = value;
+  command.tilt.moving_speed = static_cast<uint16_t>(~value);
+  command.tilt.flags = EXTERNAL_SERVO_COMMAND_VALID;
+  command.pan.goal_position = static_cast<uint16_t>(value + 1);
+  command.pan.moving_speed = static_cast<uint16_t>(value + 2);
+  return command;
+}
+
+bool IsConsistent(const ExternalCommand &command)
+{
+  ExternalCommand expected = MakeCommand(command.timestamp_ns);
+  return command.tilt.goal_position == expected.tilt.goal_position &&
+      command.tilt.moving_speed == expected.tilt.moving_speed &&
+      command.tilt.flags == expected.tilt.flags &&
+      command.pan.goal_position == expected.pan.goal_position &&
+      command.pan.moving_speed == expected.pan.moving_speed;
+}
+
+class ExternalCommandRingTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    name_ = GetSegmentName();
+    ASSERT_TRUE(ExternalCommandSource::Create(name_, &source_));
+    ASSERT_TRUE(ExternalCommandWriter::Open(name_.c_str(), &writer_));
+  }
+
+  std::string name_;
+  ExternalCommandSource source_;
+  ExternalCommandWriter writer_;
+};
+
+TEST_F(ExternalCommandRingTest, PollOnEmptyRingOnlyMarksTheConsumerAlive)
+{
+  EXPECT_FALSE(writer_.IsConsumerAlive(std::chrono::seconds{1}));
+
+  ExternalCommand command;
+  EXPECT_FALSE(source_.PollLatest(ExternalCommandWriter::Now(), &command));
+  EXPECT_TRUE(writer_.IsConsumerAlive(std::chrono::seconds{1}));
+}
+
+TEST_F(ExternalCommandRingTest, PollKeepsOnlyTheNewestCommand)
+{
+  for (int64_t i = 1; i <= 3; ++i)
+  {
+    ASSERT_TRUE(writer_.Push(MakeCommand(i)));
+  }
+
+  ExternalCommand command;
+  ASSERT_TRUE(source_.PollLatest(0, &command));
+  EXPECT_EQ(3, command.timestamp_ns);
+  EXPECT_TRUE(IsConsistent(command));
+  EXPECT_FALSE(source_.PollLatest(0, &command));
+}
+
+TEST_F(ExternalCommandRingTest, FullRingRejectsPushesUntilPolled)
+{
+  // Several laps, so the free-running indices wrap around the slots.
+  int64_t next = 1;
+  for (int lap = 0; lap < 3; ++lap)
+  {
+    for (uint32_t i = 0; i < EXTERNAL_COMMAND_RING_CAPACITY; ++i)
+    {
+      ASSERT_TRUE(writer_.Push(MakeCommand(next++)));
+    }
+    EXPECT_FALSE(writer_.Push(MakeCommand(next)));
+
+    ExternalCommand command;
+    ASSERT_TRUE(source_.PollLatest(0, &command));
+    EXPECT_EQ(next - 1, command.timestamp_ns);
+    EXPECT_TRUE(IsConsistent(command));
+  }
+}
+
+TEST_F(ExternalCommandRingTest, ConcurrentPollsSeeWholeCommandsInOrder)
+{
+  std::atomic<bool> done{false};
+  std::thread producer([&] {
+    for (int64_t i = 1; i <= CONCURRENT_PUSH_COUNT; ++i)
+    {
+      while (!writer_.Push(MakeCommand(i)))
+      {
+        std::this_thread::yield();
+      }
+    }
+    done.store(true, std::memory_order_release);
+  });
+
+  int64_t last = 0;
+  uint64_t torn_commands = 0;
+  uint64_t backwards_commands = 0;
+  while (true)
+  {
+    bool producer_done = done.load(std::memory_order_acquire);
+    ExternalCommand command;
+    if (source_.PollLatest(0, &command))
+    {
+      if (!IsConsistent(command))
+      {
+        ++torn_commands;
+      }
+      if (command.timestamp_ns <= last)
+      {
+        ++backwards_commands;
+      }
+      last = command.timestamp_ns;
+    }
+    else if (producer_done)
+    {
+      break;
+    }
+    else
+    {
+      std::this_thread::yield();
+    }
+  }
+  producer.join();
+
+  EXPECT_EQ(0u, torn_commands);
+  EXPECT_EQ(0u, backwards_commands);
+  EXPECT_EQ(CONCURRENT_PUSH_COUNT, last);
+}
+
+TEST(ExternalCommandRingPermissionsTest, SegmentIsGroupWritableDespiteUmask)
+{
+  std::string name = GetSegmentName();
+  mode_t old_umask = umask(022);
+  ExternalCommandSource source;
+  bool created = ExternalCommandSource::Create(name, &source);
+  umask(old_umask);
+  ASSERT_TRUE(created);
+
+  struct stat segment_stat;
+  ASSERT_EQ(0, stat(("/dev/shm" + name).c_str(), &segment_stat));
+  EXPECT_EQ(0660u, segment_stat.st_mode & 0777);
+}
+
+}  // namespace
+}  // namespace xbox
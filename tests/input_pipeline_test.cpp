@@ -0,0 +1,153 @@
+#include "src/input_pipeline.h"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace xbox
+{
+namespace
+{
+// Records its name, then passes whatever it was given on unchanged.
+class RecordingStage
+{
+public:
+  RecordingStage(const char *name, std::vector<std::string> *trace)
+    : name_{name},
+      trace_{trace} {}
+
+  template <typename Next, typename... Inputs>
+  void operator()(Next& next, const Inputs&... inputs) const
+  {
+    trace_->push_back(name_);
+    next(inputs...);
+  }
+
+private:
+  const char *name_;
+  std::vector<std::string> *trace_;
+};
+
+// Passes only reports with the A button held.
+class ButtonFilterStage
+{
+public:
+  explicit ButtonFilterStage(std::vector<std::string> *trace) : trace_{trace} {}
+
+  template <typename Next>
+  void operator()(Next& next, const ControllerReport &report) const
+  {
+    trace_->push_back("filter");
+    if (GetButtonMask(report) & ToButtonMask(ControllerButton::A))
+    {
+      next(report);
+    }
+  }
+
+private:
+  std::vector<std::string> *trace_;
+};
+
+class RecordingMapper
+{
+public:
+  explicit RecordingMapper(std::vector<std::string> *trace) : trace_{trace} {}
+
+  void ProcessReport(const ControllerReport &report)
+  {
+    trace_->push_back("sink");
+    reports.push_back(report);
+  }
+
+  std::vector<ControllerReport> reports;
+
+private:
+  std::vector<std::string> *trace_;
+};
+
+std::array<uint8_t, CONTROLLER_REPORT_SIZE> MakeFrame(uint8_t buttons)
+{
+  std::array<uint8_t, CONTROLLER_REPORT_SIZE> frame = {};
+  frame[10] = 0x34;
+  frame[11] = 0x12;
+  frame[16] = 0xCD;
+  frame[17] = 0xAB;
+  frame[18] = 0xFF;
+  frame[19] = 0xFF;
+  frame[22] = 3;
+  frame[23] = buttons;
+  return frame;
+}
+
+// raw -> decode -> decoded -> filter -> sink, with each stage recorded.
+auto MakeRecordingPipeline(std::vector<std::string> *trace, RecordingMapper *mapper)
+{
+  return MakeInputPipeline(
+      RecordingStage{"raw", trace},
+      ReportDecodeStage{},
+      RecordingStage{"decoded", trace},
+      ButtonFilterStage{trace},
+      PanTiltMapperSink<RecordingMapper>{mapper});
+}
+
+class InputPipelineTest : public testing::Test
+{
+protected:
+  InputPipelineTest() : mapper_{&trace_} {}
+
+  std::vector<std::string> trace_;
+  RecordingMapper mapper_;
+};
+
+TEST_F(InputPipelineTest, ValidFrameReachesTheSinkDecodedAndInOrder)
+{
+  std::array<uint8_t, CONTROLLER_REPORT_SIZE> frame =
+      MakeFrame(static_cast<uint8_t>(ToButtonMask(ControllerButton::A)));
+  MakeRecordingPipeline(&trace_, &mapper_)(frame.data(), frame.size());
+
+  EXPECT_EQ((std::vector<std::string>{"raw", "decoded", "filter", "sink"}), trace_);
+  ASSERT_EQ(1u, mapper_.reports.size());
+  const ControllerReport &report = mapper_.reports[0];
+  EXPECT_EQ(0x1234, report.left_stick_x);
+  EXPECT_EQ(0xABCD, report.right_stick_y);
+  EXPECT_EQ(0x03FF, report.left_trigger);
+  EXPECT_EQ(3, report.dpad);
+  EXPECT_EQ(ToButtonMask(ControllerButton::A), report.buttons);
+}
+
+TEST_F(InputPipelineTest, ShortFrameIsRejectedBeforeLaterStages)
+{
+  int64_t rejected = ReadCounter(Counter::PACKETS_REJECTED);
+  std::array<uint8_t, CONTROLLER_REPORT_SIZE> frame =
+      MakeFrame(static_cast<uint8_t>(ToButtonMask(ControllerButton::A)));
+  MakeRecordingPipeline(&trace_, &mapper_)(frame.data(), frame.size() - 1);
+
+  EXPECT_EQ(std::vector<std::string>{"raw"}, trace_);
+  EXPECT_TRUE(mapper_.reports.empty());
+  EXPECT_EQ(rejected + 1, ReadCounter(Counter::PACKETS_REJECTED));
+}
+
+TEST_F(InputPipelineTest, StageCanStopAReport)
+{
+  std::array<uint8_t, CONTROLLER_REPORT_SIZE> frame = MakeFrame(0);
+  MakeRecordingPipeline(&trace_, &mapper_)(frame.data(), frame.size());
+
+  EXPECT_EQ((std::vector<std::string>{"raw", "decoded", "filter"}), trace_);
+  EXPECT_TRUE(mapper_.reports.empty());
+}
+
+TEST(MakeInputPipelineTest, LoneSinkIsThePipeline)
+{
+  std::vector<std::string> trace;
+  RecordingMapper mapper{&trace};
+  auto pipeline = MakeInputPipeline(PanTiltMapperSink<RecordingMapper>{&mapper});
+  pipeline(ControllerReport{});
+
+  EXPECT_EQ(std::vector<std::string>{"sink"}, trace);
+}
+
+}  // namespace
+}  // namespace xbox
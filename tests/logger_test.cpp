@@ -0,0 +1,248 @@
+#include "src/logger.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace xbox
+{
+namespace
+{
+constexpr int PRODUCER_COUNT = 4;
+constexpr int RECORDS_PER_PRODUCER = LOG_RING_CAPACITY / PRODUCER_COUNT;
+constexpr std::chrono::milliseconds NO_INTERVAL{0};
+
+std::vector<std::string> SplitLines(const std::string &text)
+{
+  std::vector<std::string> lines;
+  std::istringstream stream{text};
+  std::string line;
+  while (std::getline(stream, line))
+  {
+    lines.push_back(line);
+  }
+  return lines;
+}
+
+// Points stderr, where the drain thread writes, at a temporary file while the
+// test runs. The ring is process-wide, so whatever other tests left in it is
+// drained first.
+class LoggerTest : public testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    path_ = testing::TempDir() + "xbone_logger_XXXXXX";
+    int fd = mkstemp(&path_[0]);
+    ASSERT_GE(fd, 0);
+
+    fflush(stderr);
+    saved_stderr_ = dup(STDERR_FILENO);
+    ASSERT_GE(saved_stderr_, 0);
+    ASSERT_GE(dup2(fd, STDERR_FILENO), 0);
+    close(fd);
+
+    ASSERT_TRUE(StartAsyncLogger());
+    StopAsyncLogger();
+    ASSERT_EQ(0, ftruncate(STDERR_FILENO, 0));
+    ASSERT_EQ(0, lseek(STDERR_FILENO, 0, SEEK_SET));
+  }
+
+  void TearDown() override
+  {
+    StopAsyncLogger();
+    dup2(saved_stderr_, STDERR_FILENO);
+    close(saved_stderr_);
+    unlink(path_.c_str());
+  }
+
+  std::string ReadOutput() const
+  {
+    std::ifstream file{path_};
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+  }
+
+  std::string path_;
+  int saved_stderr_;
+};
+
+TEST(LogSiteTest, AdmitsOncePerIntervalAndCountsTheRest)
+{
+  LogSite site{__FILE__, __LINE__, std::chrono::milliseconds{10}};
+  uint32_t suppressed = 99;
+
+  ASSERT_TRUE(site.Admit(1000, &suppressed));
+  EXPECT_EQ(0u, suppressed);
+
+  EXPECT_FALSE(site.Admit(1000, &suppressed));
+  EXPECT_FALSE(site.Admit(1000 + 9999999, &suppressed));
+
+  ASSERT_TRUE(site.Admit(1000 + 10000000, &suppressed));
+  EXPECT_EQ(2u, suppressed);
+}
+
+TEST(LogSiteTest, SitesAreLimitedIndependently)
+{
+  LogSite first{__FILE__, __LINE__, std::chrono::milliseconds{10}};
+  LogSite second{__FILE__, __LINE__, std::chrono::milliseconds{10}};
+  uint32_t suppressed;
+
+  ASSERT_TRUE(first.Admit(0, &suppressed));
+  EXPECT_FALSE(first.Admit(1, &suppressed));
+  EXPECT_TRUE(second.Admit(1, &suppressed));
+  EXPECT_EQ(0u, suppressed);
+}
+
+TEST_F(LoggerTest, ConcurrentProducersLoseAndTearNothing)
+{
+  // One site per producer, each without a rate limit, and no more records
+  // than the ring holds, so none may be dropped even if the drain thread
+  // never gets to run.
+  std::vector<std::unique_ptr<LogSite>> sites;
+  for (int producer = 0; producer < PRODUCER_COUNT; ++producer)
+  {
+    sites.emplace_back(new LogSite{__FILE__, __LINE__, NO_INTERVAL});
+  }
+
+  ASSERT_TRUE(StartAsyncLogger());
+  std::vector<std::thread> producers;
+  for (int producer = 0; producer < PRODUCER_COUNT; ++producer)
+  {
+    producers.emplace_back([&, producer] {
+      for (int i = 0; i < RECORDS_PER_PRODUCER; ++i)
+      {
+        LogToRing(
+            LogLevel::WARNING,
+            sites[producer].get(),
+            "producer %d record %d check %d",
+            producer,
+            i,
+            producer * 100000 + i);
+      }
+    });
+  }
+  for (std::thread &producer : producers)
+  {
+    producer.join();
+  }
+  StopAsyncLogger();
+
+  EXPECT_EQ(0u, GetDroppedLogRecordCount());
+
+  std::vector<int> next_record(PRODUCER_COUNT, 0);
+  for (const std::string &line : SplitLines(ReadOutput()))
+  {
+    size_t message = line.find("] ");
+    ASSERT_NE(std::string::npos, message) << line;
+
+    int producer;
+    int record;
+    int check;
+    ASSERT_EQ(
+        3,
+        sscanf(
+            line.c_str() + message + 2,
+            "producer %d record %d check %d",
+            &producer,
+            &record,
+            &check)) << line;
+    ASSERT_GE(producer, 0);
+    ASSERT_LT(producer, PRODUCER_COUNT);
+    EXPECT_EQ(producer * 100000 + record, check) << line;
+    // Each producer's records come out whole and in the order it pushed them.
+    EXPECT_EQ(next_record[producer], record) << line;
+    next_record[producer] = record + 1;
+  }
+
+  for (int producer = 0; producer < PRODUCER_COUNT; ++producer)
+  {
+    EXPECT_EQ(RECORDS_PER_PRODUCER, next_record[producer]);
+  }
+}
+
+TEST_F(LoggerTest, FullRingDropsAndCountsTheOverflow)
+{
+  constexpr int OVERFLOW_RECORDS = 10;
+  LogSite site{__FILE__, __LINE__, NO_INTERVAL};
+
+  // Nothing drains the ring until the logger starts.
+  for (size_t i = 0; i < LOG_RING_CAPACITY + OVERFLOW_RECORDS; ++i)
+  {
+    LogToRing(LogLevel::WARNING, &site, "record %zu", i);
+  }
+  EXPECT_EQ(static_cast<uint64_t>(OVERFLOW_RECORDS), GetDroppedLogRecordCount());
+
+  ASSERT_TRUE(StartAsyncLogger());
+  StopAsyncLogger();
+
+  std::vector<std::string> lines = SplitLines(ReadOutput());
+  ASSERT_EQ(LOG_RING_CAPACITY + 1, lines.size());
+  EXPECT_NE(std::string::npos, lines[0].find("dropped 10 log records")) << lines[0];
+  EXPECT_NE(std::string::npos, lines[1].find("] record 0"));
+  EXPECT_NE(
+      std::string::npos,
+      lines.back().find("] record " + std::to_string(LOG_RING_CAPACITY - 1)));
+  // The drain reports the drops once and starts counting afresh.
+  EXPECT_EQ(0u, GetDroppedLogRecordCount());
+}
+
+TEST_F(LoggerTest, NextEmittedRecordCarriesTheSuppressedCount)
+{
+  auto log = [] (int i) {
+    XBOX_LOG_EVERY(LogLevel::WARNING, 200, "tick %d", i);
+  };
+
+  ASSERT_TRUE(StartAsyncLogger());
+  for (int i = 0; i < 4; ++i)
+  {
+    log(i);
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds{250});
+  log(4);
+  StopAsyncLogger();
+
+  std::vector<std::string> lines = SplitLines(ReadOutput());
+  ASSERT_EQ(2u, lines.size());
+  EXPECT_NE(std::string::npos, lines[0].find("] tick 0")) << lines[0];
+  EXPECT_EQ(std::string::npos, lines[0].find("suppressed")) << lines[0];
+  EXPECT_NE(std::string::npos, lines[1].find("] tick 4 (suppressed 3 similar)")) << lines[1];
+}
+
+TEST_F(LoggerTest, ScopedLoggerDrainsOnShutdown)
+{
+  LogSite site{__FILE__, __LINE__, NO_INTERVAL};
+  {
+    ASSERT_TRUE(StartAsyncLogger());
+    ScopedAsyncLogger async_logger;
+    LogToRing(LogLevel::ERROR, &site, "last words");
+  }
+
+  std::string output = ReadOutput();
+  EXPECT_NE(std::string::npos, output.find("[E ")) << output;
+  EXPECT_NE(std::string::npos, output.find("] last words\n")) << output;
+}
+
+TEST_F(LoggerTest, RecordsBelowTheMinimumLevelAreNotQueued)
+{
+  ASSERT_TRUE(StartAsyncLogger());
+  XBOX_LOG(LogLevel::DEBUG, "hidden");
+  StopAsyncLogger();
+
+  EXPECT_EQ("", ReadOutput());
+}
+
+}  // namespace
+}  // namespace xbox
@@ -0,0 +1,121 @@
+#include "src/metrics.h"
+#include "src/metrics_server.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace xbox
+{
+namespace
+{
+// More threads than per-thread shards, so some share the overflow shard.
+constexpr size_t INCREMENTING_THREAD_COUNT = MAX_METRIC_SHARDS + 4;
+constexpr int64_t INCREMENTS_PER_THREAD = 100000;
+
+TEST(MetricsTest, ConcurrentIncrementsSumAcrossShards)
+{
+  int64_t before = ReadCounter(Counter::JOYSTICK_OVERRIDES);
+
+  std::atomic<bool> go{false};
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < INCREMENTING_THREAD_COUNT; ++i)
+  {
+    threads.emplace_back([&] {
+      while (!go.load(std::memory_order_acquire))
+      {
+        std::this_thread::yield();
+      }
+      for (int64_t j = 0; j < INCREMENTS_PER_THREAD; ++j)
+      {
+        IncrementCounter(Counter::JOYSTICK_OVERRIDES);
+      }
+    });
+  }
+  go.store(true, std::memory_order_release);
+  for (std::thread &thread : threads)
+  {
+    thread.join();
+  }
+
+  EXPECT_EQ(
+      before + static_cast<int64_t>(INCREMENTING_THREAD_COUNT) * INCREMENTS_PER_THREAD,
+      ReadCounter(Counter::JOYSTICK_OVERRIDES));
+  // Every per-thread shard is taken by now.
+  EXPECT_TRUE(AcquireMetricShard()->shared);
+}
+
+TEST(MetricsTest, IncrementAddsItsDelta)
+{
+  int64_t before = ReadCounter(Counter::SERVO_WRITES_RESENT);
+  IncrementCounter(Counter::SERVO_WRITES_RESENT, 5);
+  IncrementCounter(Counter::SERVO_WRITES_RESENT);
+
+  EXPECT_EQ(before + 6, ReadCounter(Counter::SERVO_WRITES_RESENT));
+}
+
+TEST(MetricsServerTest, ServesOneSnapshotPerClient)
+{
+  // The server creates the socket's directory itself.
+  std::string directory = testing::TempDir() + "xbone_metrics_" + std::to_string(getpid());
+  std::string socket_path = directory + "/metrics.sock";
+  MetricsServer server;
+  ASSERT_TRUE(MetricsServer::Create(socket_path, &server));
+
+  IncrementCounter(Counter::SERVO_COMMANDS_EXPIRED, 3);
+  SetGauge(Gauge::TELEOP_LATENCY_NS, 1234);
+
+  int client_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  ASSERT_GE(client_fd, 0);
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+  ASSERT_EQ(0, connect(client_fd, (struct sockaddr *)&address, sizeof(address)));
+
+  // The connection waits in the backlog until the event loop would call in.
+  server.HandlePacket();
+
+  std::string snapshot;
+  char buffer[1024];
+  ssize_t received;
+  while ((received = read(client_fd, buffer, sizeof(buffer))) > 0)
+  {
+    snapshot.append(buffer, received);
+  }
+  EXPECT_EQ(0, received);
+  close(client_fd);
+
+  std::map<std::string, long long> values;
+  std::istringstream lines{snapshot};
+  std::string name;
+  long long value;
+  while (lines >> name >> value)
+  {
+    EXPECT_EQ(0u, values.count(name)) << name;
+    values[name] = value;
+  }
+  EXPECT_TRUE(lines.eof()) << snapshot;
+
+  EXPECT_EQ(1u + COUNTER_COUNT + GAUGE_COUNT, values.size());
+  EXPECT_EQ(1u, values.count("uptime_ms"));
+  EXPECT_EQ(ReadCounter(Counter::SERVO_COMMANDS_EXPIRED), values["servo_commands_expired"]);
+  EXPECT_EQ(1234, values["teleop_latency_ns"]);
+
+  server = MetricsServer{};
+  EXPECT_NE(0, access(socket_path.c_str(), F_OK));
+  rmdir(directory.c_str());
+}
+
+}  // namespace
+}  // namespace xbox
@@ -0,0 +1,173 @@
+#include "src/motion_planner.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+namespace xbox
+{
+namespace
+{
+constexpr double MAX_ACCELERATION = 2000.0;
+constexpr double LIMIT_LOW = 400.0;
+constexpr double LIMIT_HIGH = 650.0;
+constexpr double FULL_SPEED = 255.0;
+constexpr double CONTROL_PERIOD = 0.01;
+constexpr double EPSILON = 1e-9;
+
+AxisPlannerConfig MakeConfig(double initial_position)
+{
+  return AxisPlannerConfig{MAX_ACCELERATION, LIMIT_LOW, LIMIT_HIGH, initial_position};
+}
+
+TEST(VelocityRampSegmentTest, RampsLinearlyThenCruises)
+{
+  VelocityRampSegment segment{1.0, 0, 500, 100, 1000};
+  double ramp_end = 1.1;
+
+  AxisSetpoint halfway = segment.Sample(1.05);
+  EXPECT_NEAR(50.0, halfway.velocity, EPSILON);
+  EXPECT_NEAR(
+      500 + POSITION_UNITS_PER_SPEED_UNIT_SECOND * 0.5 * 1000 * 0.05 * 0.05,
+      halfway.position,
+      EPSILON);
+  EXPECT_FALSE(segment.IsComplete(1.05));
+
+  AxisSetpoint cruising = segment.Sample(ramp_end + 1.0);
+  EXPECT_NEAR(100.0, cruising.velocity, EPSILON);
+  // The ramp covers the average of its end velocities, then 1 s at target.
+  EXPECT_NEAR(
+      500 + POSITION_UNITS_PER_SPEED_UNIT_SECOND * (50 * 0.1 + 100 * 1.0),
+      cruising.position,
+      EPSILON);
+  EXPECT_TRUE(segment.IsComplete(ramp_end));
+}
+
+TEST(VelocityRampSegmentTest, DeceleratesTowardsALowerTarget)
+{
+  VelocityRampSegment segment{0, 100, 500, -100, 1000};
+
+  EXPECT_NEAR(0.0, segment.Sample(0.1).velocity, EPSILON);
+  EXPECT_NEAR(-100.0, segment.Sample(0.2).velocity, EPSILON);
+  // Symmetric ramp: back where it started once it reaches -100.
+  EXPECT_NEAR(500.0, segment.Sample(0.2).position, EPSILON);
+}
+
+TEST(VelocityRampSegmentTest, SamplesBeforeTheStartHoldTheStart)
+{
+  VelocityRampSegment segment{1.0, 20, 500, 100, 1000};
+
+  AxisSetpoint setpoint = segment.Sample(0.5);
+  EXPECT_EQ(20.0, setpoint.velocity);
+  EXPECT_EQ(500.0, setpoint.position);
+}
+
+TEST(TrapezoidalAxisPlannerTest, AcceleratesAtTheLimit)
+{
+  TrapezoidalAxisPlanner planner{MakeConfig(500)};
+  planner.SetTargetVelocity(FULL_SPEED, 0);
+
+  EXPECT_NEAR(MAX_ACCELERATION * 0.05, planner.Update(0.05).velocity, EPSILON);
+  EXPECT_NEAR(FULL_SPEED, planner.Update(1.0).velocity, EPSILON);
+}
+
+TEST(TrapezoidalAxisPlannerTest, BrakesToRestAtEachLimit)
+{
+  for (double target : {FULL_SPEED, -FULL_SPEED})
+  {
+    TrapezoidalAxisPlanner planner{MakeConfig(500)};
+    planner.SetTargetVelocity(target, 0);
+
+    AxisSetpoint previous = planner.Update(0);
+    for (double now = CONTROL_PERIOD; now < 5.0; now += CONTROL_PERIOD)
+    {
+      AxisSetpoint setpoint = planner.Update(now);
+      EXPECT_LE(
+          std::abs(setpoint.velocity - previous.velocity),
+          MAX_ACCELERATION * CONTROL_PERIOD + EPSILON);
+      EXPECT_GE(setpoint.position, LIMIT_LOW);
+      EXPECT_LE(setpoint.position, LIMIT_HIGH);
+      previous = setpoint;
+    }
+
+    EXPECT_EQ(0.0, previous.velocity);
+    // Braking starts on a control tick, so at most a tick's travel short.
+    double limit = target > 0 ? LIMIT_HIGH : LIMIT_LOW;
+    EXPECT_NEAR(
+        limit,
+        previous.position,
+        POSITION_UNITS_PER_SPEED_UNIT_SECOND * FULL_SPEED * CONTROL_PERIOD);
+  }
+}
+
+TEST(TrapezoidalAxisPlannerTest, PushingIntoALimitAtRestDoesNothing)
+{
+  TrapezoidalAxisPlanner planner{MakeConfig(LIMIT_HIGH)};
+  planner.SetTargetVelocity(FULL_SPEED, 0);
+
+  AxisSetpoint setpoint = planner.Update(0.5);
+  EXPECT_EQ(0.0, setpoint.velocity);
+  EXPECT_EQ(LIMIT_HIGH, setpoint.position);
+
+  planner.SetTargetVelocity(-FULL_SPEED, 0.5);
+  EXPECT_LT(planner.Update(0.6).velocity, 0.0);
+}
+
+TEST(TrapezoidalAxisPlannerTest, ReversalRampsThroughZero)
+{
+  TrapezoidalAxisPlanner planner{MakeConfig(525)};
+  planner.SetTargetVelocity(50, 0);
+  ASSERT_NEAR(50.0, planner.Update(0.1).velocity, EPSILON);
+
+  planner.SetTargetVelocity(-50, 0.1);
+  EXPECT_NEAR(50.0 - MAX_ACCELERATION * 0.01, planner.Update(0.11).velocity, EPSILON);
+  EXPECT_NEAR(-50.0, planner.Update(0.2).velocity, EPSILON);
+}
+
+TEST(TrapezoidalAxisPlannerTest, RepeatingTheTargetKeepsTheRamp)
+{
+  TrapezoidalAxisPlanner planner{MakeConfig(500)};
+  planner.SetTargetVelocity(FULL_SPEED, 0);
+  planner.SetTargetVelocity(FULL_SPEED, 0.05);
+
+  EXPECT_NEAR(MAX_ACCELERATION * 0.1, planner.Update(0.1).velocity, EPSILON);
+}
+
+TEST(TrapezoidalAxisPlannerTest, ResetAtRestMovesOnlyThePosition)
+{
+  TrapezoidalAxisPlanner planner{MakeConfig(500)};
+  planner.SetTargetVelocity(FULL_SPEED, 0);
+  planner.SetTargetVelocity(0, 0.05);
+  ASSERT_EQ(0.0, planner.Update(0.5).velocity);
+
+  planner.ResetPosition(520, 0.5);
+  AxisSetpoint setpoint = planner.Update(0.6);
+  EXPECT_EQ(0.0, setpoint.velocity);
+  EXPECT_NEAR(520.0, setpoint.position, EPSILON);
+}
+
+TEST(TrapezoidalAxisPlannerTest, ResetWhileMovingKeepsTheRamp)
+{
+  TrapezoidalAxisPlanner planner{MakeConfig(500)};
+  planner.SetTargetVelocity(FULL_SPEED, 0);
+  planner.ResetPosition(450, 0.05);
+
+  AxisSetpoint setpoint = planner.Update(0.1);
+  EXPECT_NEAR(MAX_ACCELERATION * 0.1, setpoint.velocity, EPSILON);
+  // From 450 at 100 units/s, ramping to 200 over the 0.05 s since the reset.
+  EXPECT_NEAR(
+      450.0 + POSITION_UNITS_PER_SPEED_UNIT_SECOND * (100.0 + 200.0) / 2 * 0.05,
+      setpoint.position,
+      EPSILON);
+}
+
+TEST(TrapezoidalAxisPlannerTest, ResetIsClampedToTheLimits)
+{
+  TrapezoidalAxisPlanner planner{MakeConfig(500)};
+  planner.ResetPosition(LIMIT_HIGH + 20, 0);
+
+  EXPECT_EQ(LIMIT_HIGH, planner.Update(0.1).position);
+}
+
+}  // namespace
+}  // namespace xbox
@@ -0,0 +1,202 @@
+#include "src/motion_setpoint_streamer.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+namespace xbox
+{
+namespace
+{
+using namespace joystick_mapper_internal;
+
+constexpr std::chrono::milliseconds CONTROL_PERIOD{1};
+// Fast enough that every ramp completes within a control period.
+constexpr double MAX_ACCELERATION = 1e6;
+constexpr uint16_t STICK_NEUTRAL = 0x8000;
+constexpr uint16_t STICK_FULL_POSITIVE = 0xFFFF;
+// Long enough at full speed for the estimate to leave the neutral goal.
+constexpr std::chrono::milliseconds TILT_DURATION{40};
+
+// Synchronous servo that holds its registers in memory.
+struct FakeServo
+{
+  bool SetGoalPosition(uint16_t position)
+  {
+    goal_position = position;
+    return true;
+  }
+
+  bool SetMovingSpeed(uint16_t speed)
+  {
+    moving_speed = speed;
+    return true;
+  }
+
+  bool SetTorqueEnabled(bool enabled)
+  {
+    torque_enabled = enabled;
+    return true;
+  }
+
+  bool SetTorqueLimit(uint16_t limit)
+  {
+    torque_limit = limit;
+    return true;
+  }
+
+  bool SetClockWiseAngleLimit(uint16_t limit)
+  {
+    cw_angle_limit = limit;
+    return true;
+  }
+
+  bool SetCounterClockWiseAngleLimit(uint16_t limit)
+  {
+    ccw_angle_limit = limit;
+    return true;
+  }
+
+  bool GetPresentPosition(uint16_t *out_position)
+  {
+    ++position_reads;
+    *out_position = present_position;
+    return !fail_position_reads;
+  }
+
+  uint16_t goal_position = 0;
+  uint16_t moving_speed = 0;
+  bool torque_enabled = false;
+  uint16_t torque_limit = 0;
+  uint16_t cw_angle_limit = 0;
+  uint16_t ccw_angle_limit = 0;
+  uint16_t present_position = GOAL_POSITION_NEUTRAL;
+  bool fail_position_reads = false;
+  int position_reads = 0;
+};
+
+using FakeScheduler = BasicServoBusScheduler<FakeServo>;
+using FakeScheduledServo = ScheduledServo<FakeServo>;
+using FakeMotionSetpointStreamer = BasicMotionSetpointStreamer<FakeScheduledServo, FakeScheduler>;
+
+class MotionSetpointStreamerTest : public ::testing::Test
+{
+protected:
+  MotionSetpointStreamerTest() : scheduler_{nullptr} {}
+
+  void SetUp() override
+  {
+    FakeScheduledServo *scheduled_tilt;
+    FakeScheduledServo *scheduled_pan;
+    ASSERT_TRUE(scheduler_.GetScheduledServo(&tilt_, &scheduled_tilt));
+    ASSERT_TRUE(scheduler_.GetScheduledServo(&pan_, &scheduled_pan));
+    ASSERT_TRUE(FakeMotionSetpointStreamer::Create(
+        scheduled_tilt,
+        scheduled_pan,
+        &scheduler_,
+        CONTROL_PERIOD,
+        MAX_ACCELERATION,
+        &streamer_));
+    ASSERT_TRUE(scheduler_.FlushConfiguration());
+    ASSERT_EQ(GOAL_POSITION_NEUTRAL, tilt_.goal_position);
+  }
+
+  // Deflects only the tilt stick.
+  void ProcessTiltStick(uint16_t stick)
+  {
+    ControllerReport report = {};
+    report.left_stick_x = STICK_NEUTRAL;
+    report.left_stick_y = stick;
+    streamer_.ProcessReport(report);
+  }
+
+  // Waits for the control timer and runs one control period.
+  void RunControlPeriod()
+  {
+    std::this_thread::sleep_for(2 * CONTROL_PERIOD);
+    streamer_.HandlePacket();
+  }
+
+  // Tilts up for a while, then releases the stick and runs the period that
+  // brings the axis to rest.
+  void TiltThenRelease()
+  {
+    ProcessTiltStick(STICK_FULL_POSITIVE);
+    RunControlPeriod();
+    std::this_thread::sleep_for(TILT_DURATION);
+    RunControlPeriod();
+    ASSERT_EQ(GOAL_POSITION_LIMIT_HIGH, tilt_.goal_position);
+
+    ProcessTiltStick(STICK_NEUTRAL);
+    RunControlPeriod();
+  }
+
+  FakeServo tilt_;
+  FakeServo pan_;
+  FakeScheduler scheduler_;
+  FakeMotionSetpointStreamer streamer_;
+};
+
+TEST_F(MotionSetpointStreamerTest, ParksAtThePresentPositionOnceAtRest)
+{
+  // The horn lags the commanded speed, so it is well short of the estimate.
+  tilt_.present_position = GOAL_POSITION_NEUTRAL + 3;
+  TiltThenRelease();
+
+  // Reaching rest only asks where the horn is.
+  EXPECT_EQ(1, tilt_.position_reads);
+  EXPECT_EQ(GOAL_POSITION_LIMIT_HIGH, tilt_.goal_position);
+
+  RunControlPeriod();
+  EXPECT_EQ(GOAL_POSITION_NEUTRAL + 3, tilt_.goal_position);
+  EXPECT_EQ(GOAL_POSITION_NEUTRAL + 3, streamer_.GetTiltCommandState().goal_position);
+  EXPECT_EQ(0, streamer_.GetTiltCommandState().moving_speed);
+
+  // Parked axes are neither read nor written again.
+  tilt_.goal_position = 0;
+  RunControlPeriod();
+  EXPECT_EQ(1, tilt_.position_reads);
+  EXPECT_EQ(0, tilt_.goal_position);
+}
+
+TEST_F(MotionSetpointStreamerTest, ParksAtTheEstimateWhenTheReadFails)
+{
+  tilt_.fail_position_reads = true;
+  TiltThenRelease();
+
+  for (uint32_t i = 1; i < MAX_REST_POSITION_WAIT_PERIODS; ++i)
+  {
+    RunControlPeriod();
+    EXPECT_EQ(GOAL_POSITION_LIMIT_HIGH, tilt_.goal_position);
+  }
+
+  RunControlPeriod();
+  EXPECT_GT(tilt_.goal_position, GOAL_POSITION_NEUTRAL);
+  EXPECT_LT(tilt_.goal_position, GOAL_POSITION_LIMIT_HIGH);
+}
+
+TEST_F(MotionSetpointStreamerTest, MovingAgainCancelsThePark)
+{
+  tilt_.present_position = GOAL_POSITION_NEUTRAL + 3;
+  TiltThenRelease();
+
+  ProcessTiltStick(STICK_FULL_POSITIVE);
+  RunControlPeriod();
+  EXPECT_EQ(GOAL_POSITION_LIMIT_HIGH, tilt_.goal_position);
+  EXPECT_EQ(MAX_MOVEMENT_SPEED, tilt_.moving_speed);
+
+  // The stale read is not parked at later.
+  ProcessTiltStick(STICK_NEUTRAL);
+  tilt_.fail_position_reads = true;
+  for (uint32_t i = 0; i <= MAX_REST_POSITION_WAIT_PERIODS; ++i)
+  {
+    RunControlPeriod();
+  }
+  EXPECT_NE(GOAL_POSITION_NEUTRAL + 3, tilt_.goal_position);
+  EXPECT_NE(GOAL_POSITION_LIMIT_HIGH, tilt_.goal_position);
+}
+
+}  // namespace
+}  // namespace xbox
@@ -0,0 +1,148 @@
+#include "src/persisted_control_state.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <string>
+
+namespace xbox
+{
+namespace
+{
+constexpr const char* BOOT_A = "boot-a";
+constexpr const char* BOOT_B = "boot-b";
+
+// A store file in the test's temporary directory. Each Map() is a separate
+// shared mapping, like a separate process opening the file, and is handed to
+// a ControlStateStore, which unmaps it.
+class ControlStateStoreTest : public testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    path_ = testing::TempDir() + "xbone_control_state_XXXXXX";
+    int fd = mkstemp(&path_[0]);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(0, ftruncate(fd, sizeof(PersistedControlStateFile)));
+    close(fd);
+
+    PersistedControlStateFile *file = Map();
+    file->magic = PERSISTED_CONTROL_STATE_MAGIC;
+    file->version = PERSISTED_CONTROL_STATE_VERSION;
+    raw_file_ = file;
+  }
+
+  void TearDown() override
+  {
+    munmap(raw_file_, sizeof(PersistedControlStateFile));
+    unlink(path_.c_str());
+  }
+
+  PersistedControlStateFile* Map()
+  {
+    int fd = open(path_.c_str(), O_RDWR | O_CLOEXEC);
+    EXPECT_GE(fd, 0);
+    void *mapping = mmap(
+        nullptr,
+        sizeof(PersistedControlStateFile),
+        PROT_READ | PROT_WRITE,
+        MAP_SHARED,
+        fd,
+        0);
+    close(fd);
+    EXPECT_NE(MAP_FAILED, mapping);
+    return static_cast<PersistedControlStateFile *>(mapping);
+  }
+
+  void SaveControllerCount(ControlStateStore *store, uint8_t count)
+  {
+    store->GetState().controller_count = count;
+    store->Save();
+  }
+
+  std::string path_;
+  // Left mapped for the test to inspect and corrupt the slots.
+  PersistedControlStateFile *raw_file_ = nullptr;
+};
+
+TEST_F(ControlStateStoreTest, SavedStateIsResumedDuringTheSameBoot)
+{
+  {
+    ControlStateStore store{Map(), BOOT_A};
+    PersistedControlState state;
+    EXPECT_FALSE(store.LoadWarmState(&state));
+    SaveControllerCount(&store, 3);
+  }
+
+  ControlStateStore store{Map(), BOOT_A};
+  PersistedControlState state;
+  ASSERT_TRUE(store.LoadWarmState(&state));
+  EXPECT_EQ(3, state.controller_count);
+  EXPECT_STREQ(BOOT_A, state.boot_id);
+  EXPECT_EQ(3, store.GetState().controller_count);
+}
+
+TEST_F(ControlStateStoreTest, StateFromAnotherBootIsNotResumed)
+{
+  {
+    ControlStateStore store{Map(), BOOT_A};
+    SaveControllerCount(&store, 3);
+  }
+
+  ControlStateStore store{Map(), BOOT_B};
+  PersistedControlState state;
+  EXPECT_FALSE(store.LoadWarmState(&state));
+  EXPECT_EQ(0, store.GetState().controller_count);
+}
+
+TEST_F(ControlStateStoreTest, SavesAlternateSlotsAndSkipUnchangedState)
+{
+  ControlStateStore store{Map(), BOOT_A};
+  SaveControllerCount(&store, 1);
+  EXPECT_EQ(1u, raw_file_->slots[1].generation);
+
+  SaveControllerCount(&store, 2);
+  EXPECT_EQ(2u, raw_file_->slots[0].generation);
+  EXPECT_EQ(1u, raw_file_->slots[1].generation);
+
+  store.Save();
+  EXPECT_EQ(2u, raw_file_->slots[0].generation);
+  EXPECT_EQ(1u, raw_file_->slots[1].generation);
+}
+
+TEST_F(ControlStateStoreTest, TornNewestSlotFallsBackToTheOlderOne)
+{
+  {
+    ControlStateStore store{Map(), BOOT_A};
+    SaveControllerCount(&store, 1);
+    SaveControllerCount(&store, 2);
+  }
+
+  // As if the process died halfway through copying into slot 0.
+  raw_file_->slots[0].state.controller_count = 7;
+  {
+    ControlStateStore store{Map(), BOOT_A};
+    PersistedControlState state;
+    ASSERT_TRUE(store.LoadWarmState(&state));
+    EXPECT_EQ(1, state.controller_count);
+
+    // The next save overwrites the torn slot, not the intact one.
+    SaveControllerCount(&store, 4);
+    EXPECT_EQ(2u, raw_file_->slots[0].generation);
+    EXPECT_EQ(1u, raw_file_->slots[1].generation);
+  }
+
+  raw_file_->slots[0].checksum ^= 1;
+  raw_file_->slots[1].checksum ^= 1;
+  ControlStateStore store{Map(), BOOT_A};
+  PersistedControlState state;
+  EXPECT_FALSE(store.LoadWarmState(&state));
+}
+
+}  // namespace
+}  // namespace xbox
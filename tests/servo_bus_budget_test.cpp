@@ -0,0 +1,124 @@
+#include "src/servo_bus_budget.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstddef>
+
+namespace xbox
+{
+namespace
+{
+// The burst a full limiter allows: one move command's three writes.
+constexpr size_t BURST_WRITES = 3;
+
+// How long |budget| takes to refill |writes| tokens for one servo.
+std::chrono::nanoseconds GetRefillTime(const ServoBusBudget &budget, double writes)
+{
+  return std::chrono::nanoseconds{
+      static_cast<int64_t>(writes * 1e9 / budget.GetPerServoWriteRate()) + 1};
+}
+
+TEST(ServoBusBudgetTest, RateSharesTheBusBetweenServos)
+{
+  ServoBusBudget budget;
+  double single_servo_rate = budget.GetPerServoWriteRate();
+
+  // 80% of a bus doing a 1 ms transaction at a time.
+  EXPECT_DOUBLE_EQ(800.0, single_servo_rate);
+
+  budget.RegisterServo();
+  budget.RegisterServo();
+  EXPECT_EQ(2u, budget.GetServoCount());
+  EXPECT_DOUBLE_EQ(single_servo_rate / 2, budget.GetPerServoWriteRate());
+}
+
+TEST(ServoBusBudgetTest, TransactionTimeIsAMovingAverage)
+{
+  ServoBusBudget budget;
+  EXPECT_EQ(std::chrono::milliseconds{1}, budget.GetAverageTransactionTime());
+
+  budget.RecordTransaction(std::chrono::nanoseconds{0});
+  EXPECT_EQ(std::chrono::microseconds{875}, budget.GetAverageTransactionTime());
+
+  for (int i = 0; i < 200; ++i)
+  {
+    budget.RecordTransaction(std::chrono::microseconds{500});
+  }
+  EXPECT_NEAR(500000, budget.GetAverageTransactionTime().count(), 1000);
+  EXPECT_NEAR(1600.0, budget.GetPerServoWriteRate(), 5.0);
+}
+
+TEST(ServoRateLimiterTest, AllowsABurstThenRefillsAtTheBudgetRate)
+{
+  ServoBusBudget budget;
+  ServoRateLimiter limiter{&budget};
+  auto now = std::chrono::steady_clock::now();
+
+  EXPECT_TRUE(limiter.TryAcquire(now, BURST_WRITES));
+  EXPECT_FALSE(limiter.TryAcquire(now, 1));
+
+  now += GetRefillTime(budget, 1);
+  EXPECT_TRUE(limiter.TryAcquire(now, 1));
+  EXPECT_FALSE(limiter.TryAcquire(now, 1));
+}
+
+TEST(ServoRateLimiterTest, RefillStopsAtTheBurst)
+{
+  ServoBusBudget budget;
+  ServoRateLimiter limiter{&budget};
+  auto now = std::chrono::steady_clock::now() + std::chrono::seconds{10};
+
+  EXPECT_FALSE(limiter.TryAcquire(now, BURST_WRITES + 1));
+  EXPECT_TRUE(limiter.TryAcquire(now, BURST_WRITES));
+}
+
+TEST(ServoRateLimiterTest, ForcedWritesRunIntoBoundedDebt)
+{
+  ServoBusBudget budget;
+  ServoRateLimiter limiter{&budget};
+  auto now = std::chrono::steady_clock::now();
+
+  // Stops always go out; far more than the burst only costs a burst of debt.
+  for (int i = 0; i < 10; ++i)
+  {
+    limiter.ForceAcquire(now, BURST_WRITES);
+  }
+
+  // Back from -BURST_WRITES to one token.
+  now += GetRefillTime(budget, BURST_WRITES + 1) - std::chrono::microseconds{10};
+  EXPECT_FALSE(limiter.TryAcquire(now, 1));
+  now += std::chrono::microseconds{10};
+  EXPECT_TRUE(limiter.TryAcquire(now, 1));
+}
+
+TEST(ServoRateLimiterTest, TimeGoingBackwardsRefillsNothing)
+{
+  ServoBusBudget budget;
+  ServoRateLimiter limiter{&budget};
+  auto now = std::chrono::steady_clock::now();
+
+  EXPECT_TRUE(limiter.TryAcquire(now, BURST_WRITES));
+  now -= std::chrono::seconds{1};
+  EXPECT_FALSE(limiter.TryAcquire(now, 1));
+}
+
+TEST(ServoRateLimiterTest, EachLimiterTakesItsShareOfTheBus)
+{
+  ServoBusBudget budget;
+  ServoRateLimiter tilt{&budget};
+  ServoRateLimiter pan{&budget};
+  auto now = std::chrono::steady_clock::now();
+
+  ASSERT_TRUE(tilt.TryAcquire(now, BURST_WRITES));
+  ASSERT_TRUE(pan.TryAcquire(now, BURST_WRITES));
+
+  // One token at the shared rate takes twice as long as on a bus of its own.
+  EXPECT_DOUBLE_EQ(400.0, budget.GetPerServoWriteRate());
+  now += GetRefillTime(budget, 1);
+  EXPECT_TRUE(tilt.TryAcquire(now, 1));
+  EXPECT_TRUE(pan.TryAcquire(now, 1));
+}
+
+}  // namespace
+}  // namespace xbox
@@ -0,0 +1,224 @@
+#include "src/servo_bus_discovery.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace xbox
+{
+namespace
+{
+// A bus of servos that each listen at one baud rate and follow broadcast
+// BAUD_RATE writes, like AX-12s do. Pings at |unreliable_rate| go unanswered
+// one time in ten.
+class FakeServoBus
+{
+public:
+  bool SetBaudRate(uint32_t baud_rate)
+  {
+    baud_rate_ = baud_rate;
+    return true;
+  }
+
+  uint32_t GetBaudRate() const
+  {
+    return baud_rate_;
+  }
+
+  bool PingBlocking(uint8_t id)
+  {
+    ++pings;
+    auto servo = servo_rates.find(id);
+    if (servo == servo_rates.end() || servo->second != baud_rate_)
+    {
+      return false;
+    }
+
+    return baud_rate_ != unreliable_rate || ++unreliable_pings_ % 10 != 0;
+  }
+
+  bool Write(uint8_t id, AxA12Address address, uint16_t value, uint8_t width)
+  {
+    EXPECT_EQ(DYNAMIXEL_BROADCAST_ID, id);
+    EXPECT_EQ(AxA12Address::BAUD_RATE, address);
+    EXPECT_EQ(1, width);
+
+    uint32_t new_rate = 0;
+    for (uint32_t rate : STANDARD_SERVO_BAUD_RATES)
+    {
+      if (GetAxA12BaudRateValue(rate) == value)
+      {
+        new_rate = rate;
+      }
+    }
+    EXPECT_NE(0u, new_rate);
+
+    for (auto &servo : servo_rates)
+    {
+      if (servo.second == baud_rate_)
+      {
+        servo.second = new_rate;
+      }
+    }
+    return true;
+  }
+
+  bool FlushBlocking()
+  {
+    return true;
+  }
+
+  std::map<uint8_t, uint32_t> servo_rates;
+  uint32_t unreliable_rate = 0;
+  size_t pings = 0;
+
+private:
+  uint32_t baud_rate_ = 0;
+  size_t unreliable_pings_ = 0;
+};
+
+class ServoBusDiscoveryTest : public testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    directory_ = testing::TempDir() + "xbone_servo_bus_XXXXXX";
+    ASSERT_NE(nullptr, mkdtemp(&directory_[0]));
+    cache_path_ = directory_ + "/servo-bus.cache";
+  }
+
+  void TearDown() override
+  {
+    unlink(cache_path_.c_str());
+    rmdir(directory_.c_str());
+  }
+
+  void WriteCache(const char *contents)
+  {
+    FILE *file = fopen(cache_path_.c_str(), "w");
+    ASSERT_NE(nullptr, file);
+    fputs(contents, file);
+    fclose(file);
+  }
+
+  std::string directory_;
+  std::string cache_path_;
+};
+
+TEST(AxA12BaudRateTest, StandardRatesMapToTheirRegisterValues)
+{
+  std::vector<uint8_t> values;
+  for (uint32_t baud_rate : STANDARD_SERVO_BAUD_RATES)
+  {
+    values.push_back(GetAxA12BaudRateValue(baud_rate));
+  }
+
+  EXPECT_EQ((std::vector<uint8_t>{1, 3, 16, 34, 103, 207}), values);
+}
+
+TEST_F(ServoBusDiscoveryTest, CacheRoundTrips)
+{
+  ServoBusConfiguration saved{57600, {1, 2, 253}};
+  ASSERT_TRUE(SaveServoBusConfiguration(cache_path_, saved));
+
+  ServoBusConfiguration loaded;
+  ASSERT_TRUE(LoadServoBusConfiguration(cache_path_, &loaded));
+  EXPECT_EQ(saved.baud_rate, loaded.baud_rate);
+  EXPECT_EQ(saved.ids, loaded.ids);
+  EXPECT_NE(0, access((cache_path_ + ".tmp").c_str(), F_OK));
+}
+
+TEST_F(ServoBusDiscoveryTest, BadCachesAreRejected)
+{
+  ServoBusConfiguration loaded;
+  EXPECT_FALSE(LoadServoBusConfiguration(cache_path_, &loaded));
+
+  for (const char *contents : {
+           "baud_rate 117647\nids 1 2\n",
+           "baud_rate 1000000\nids 1 254\n",
+           "baud_rate 1000000\nids\n",
+           "ids 1 2\n",
+       })
+  {
+    WriteCache(contents);
+    EXPECT_FALSE(LoadServoBusConfiguration(cache_path_, &loaded)) << contents;
+  }
+}
+
+TEST_F(ServoBusDiscoveryTest, ScanFindsServosAtOneRateAndMovesThemToTheFastest)
+{
+  FakeServoBus bus;
+  bus.servo_rates = {{1, 57600}, {2, 57600}};
+
+  ServoBusConfiguration configuration;
+  ASSERT_TRUE(DiscoverServoBus(&bus, cache_path_, {1, 2}, &configuration));
+
+  EXPECT_EQ(1000000u, configuration.baud_rate);
+  EXPECT_EQ((std::vector<uint8_t>{1, 2}), configuration.ids);
+  EXPECT_EQ((std::map<uint8_t, uint32_t>{{1, 1000000}, {2, 1000000}}), bus.servo_rates);
+
+  ServoBusConfiguration cached;
+  ASSERT_TRUE(LoadServoBusConfiguration(cache_path_, &cached));
+  EXPECT_EQ(configuration.baud_rate, cached.baud_rate);
+  EXPECT_EQ(configuration.ids, cached.ids);
+}
+
+TEST_F(ServoBusDiscoveryTest, ValidCacheSkipsTheScan)
+{
+  WriteCache("baud_rate 500000\nids 1 2\n");
+  FakeServoBus bus;
+  bus.servo_rates = {{1, 500000}, {2, 500000}};
+
+  ServoBusConfiguration configuration;
+  ASSERT_TRUE(DiscoverServoBus(&bus, cache_path_, {1, 2}, &configuration));
+
+  EXPECT_EQ(500000u, configuration.baud_rate);
+  EXPECT_EQ(2u, bus.pings);
+}
+
+TEST_F(ServoBusDiscoveryTest, StaleCacheFallsBackToTheScan)
+{
+  WriteCache("baud_rate 500000\nids 1 2\n");
+  FakeServoBus bus;
+  bus.servo_rates = {{1, 9600}, {2, 9600}};
+
+  ServoBusConfiguration configuration;
+  ASSERT_TRUE(DiscoverServoBus(&bus, cache_path_, {1, 2}, &configuration));
+
+  EXPECT_EQ(1000000u, configuration.baud_rate);
+  EXPECT_EQ(1000000u, bus.servo_rates[1]);
+}
+
+TEST_F(ServoBusDiscoveryTest, UnreliableRateIsPassedOver)
+{
+  FakeServoBus bus;
+  bus.servo_rates = {{1, 19200}, {2, 19200}};
+  bus.unreliable_rate = 1000000;
+
+  ServoBusConfiguration configuration;
+  ASSERT_TRUE(DiscoverServoBus(&bus, "", {1, 2}, &configuration));
+
+  EXPECT_EQ(500000u, configuration.baud_rate);
+  EXPECT_EQ((std::map<uint8_t, uint32_t>{{1, 500000}, {2, 500000}}), bus.servo_rates);
+  EXPECT_NE(0, access(cache_path_.c_str(), F_OK));
+}
+
+TEST_F(ServoBusDiscoveryTest, MissingRequiredServoFails)
+{
+  FakeServoBus bus;
+  bus.servo_rates = {{1, 57600}};
+
+  ServoBusConfiguration configuration;
+  EXPECT_FALSE(DiscoverServoBus(&bus, cache_path_, {1, 2}, &configuration));
+  EXPECT_EQ(57600u, bus.servo_rates[1]);
+}
+
+}  // namespace
+}  // namespace xbox
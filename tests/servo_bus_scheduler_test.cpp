@@ -0,0 +1,304 @@
+#include "src/servo_bus_scheduler.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+namespace xbox
+{
+namespace
+{
+struct Write
+{
+  int servo;
+  ServoRegister reg;
+  uint16_t value;
+
+  bool operator==(const Write &other) const
+  {
+    return servo == other.servo && reg == other.reg && value == other.value;
+  }
+};
+
+std::ostream& operator<<(std::ostream &stream, const Write &write)
+{
+  return stream << "{servo " << write.servo << ", register "
+                << static_cast<int>(write.reg) << ", value " << write.value << "}";
+}
+
+// Synchronous servo that logs its writes to a log shared by every servo on
+// the bus. Each write takes |write_time| on the wire.
+struct FakeServo
+{
+  FakeServo(int id, std::vector<Write> *log) : id{id}, log{log} {}
+
+  bool SetGoalPosition(uint16_t position)
+  {
+    return Record(ServoRegister::GOAL_POSITION, position);
+  }
+
+  bool SetMovingSpeed(uint16_t speed)
+  {
+    return Record(ServoRegister::MOVING_SPEED, speed);
+  }
+
+  bool SetTorqueEnabled(bool enabled)
+  {
+    return Record(ServoRegister::TORQUE_ENABLE, enabled);
+  }
+
+  bool SetTorqueLimit(uint16_t limit)
+  {
+    return Record(ServoRegister::TORQUE_LIMIT, limit);
+  }
+
+  bool SetClockWiseAngleLimit(uint16_t limit)
+  {
+    cw_angle_limit = limit;
+    return Record(ServoRegister::CW_ANGLE_LIMIT, limit);
+  }
+
+  bool SetCounterClockWiseAngleLimit(uint16_t limit)
+  {
+    ccw_angle_limit = limit;
+    return Record(ServoRegister::CCW_ANGLE_LIMIT, limit);
+  }
+
+  bool GetPresentPosition(uint16_t *out_position) const
+  {
+    *out_position = present_position;
+    return true;
+  }
+
+  bool GetClockWiseAngleLimit(uint16_t *out_limit) const
+  {
+    *out_limit = cw_angle_limit;
+    return true;
+  }
+
+  bool GetCounterClockWiseAngleLimit(uint16_t *out_limit) const
+  {
+    *out_limit = ccw_angle_limit;
+    return true;
+  }
+
+  bool Record(ServoRegister reg, uint16_t value)
+  {
+    std::this_thread::sleep_for(write_time);
+    if (fail_writes)
+    {
+      return false;
+    }
+    log->push_back(Write{id, reg, value});
+    return true;
+  }
+
+  int id;
+  std::vector<Write> *log;
+  std::chrono::microseconds write_time{0};
+  bool fail_writes = false;
+  uint16_t cw_angle_limit = 0;
+  uint16_t ccw_angle_limit = 0;
+  uint16_t present_position = 0;
+};
+
+using FakeScheduler = BasicServoBusScheduler<FakeServo>;
+
+class ServoBusSchedulerTest : public ::testing::Test
+{
+protected:
+  ServoBusSchedulerTest()
+    : tilt_{0, &log_},
+      pan_{1, &log_},
+      scheduler_{nullptr} {}
+
+  void SetUp() override
+  {
+    ASSERT_TRUE(scheduler_.GetScheduledServo(&tilt_, &scheduled_tilt_));
+    ASSERT_TRUE(scheduler_.GetScheduledServo(&pan_, &scheduled_pan_));
+  }
+
+  std::vector<Write> log_;
+  FakeServo tilt_;
+  FakeServo pan_;
+  FakeScheduler scheduler_;
+  ScheduledServo<FakeServo> *scheduled_tilt_;
+  ScheduledServo<FakeServo> *scheduled_pan_;
+};
+
+TEST_F(ServoBusSchedulerTest, StopsGoFirstThenServosByUrgency)
+{
+  scheduled_tilt_->SetTorqueLimit(0x3FF);
+  scheduled_tilt_->SetMovingSpeed(0x20);
+  scheduled_pan_->SetGoalPosition(600);
+  scheduled_pan_->SetMovingSpeed(0x10);
+  scheduled_tilt_->SetTorqueEnabled(false);
+
+  EXPECT_TRUE(scheduler_.Flush());
+
+  // Pan's goal position is a direction change and tilt's speed only a speed
+  // change. Inside each servo the queueing order holds.
+  std::vector<Write> expected = {
+      {0, ServoRegister::TORQUE_ENABLE, 0},
+      {1, ServoRegister::GOAL_POSITION, 600},
+      {1, ServoRegister::MOVING_SPEED, 0x10},
+      {0, ServoRegister::TORQUE_LIMIT, 0x3FF},
+      {0, ServoRegister::MOVING_SPEED, 0x20},
+  };
+  EXPECT_EQ(expected, log_);
+  EXPECT_EQ(0u, scheduler_.GetPendingCount());
+  EXPECT_FALSE(scheduler_.TakeLostWrites());
+}
+
+TEST_F(ServoBusSchedulerTest, NewerWriteReplacesQueuedOne)
+{
+  scheduled_tilt_->SetMovingSpeed(0x20);
+  scheduled_tilt_->SetMovingSpeed(0x40);
+
+  EXPECT_EQ(1u, scheduler_.GetPendingCount());
+  EXPECT_TRUE(scheduler_.Flush());
+
+  std::vector<Write> expected = {{0, ServoRegister::MOVING_SPEED, 0x40}};
+  EXPECT_EQ(expected, log_);
+}
+
+TEST_F(ServoBusSchedulerTest, ExpiredCommandsAreDroppedAndReported)
+{
+  using namespace servo_scheduler_internal;
+
+  scheduled_tilt_->SetMovingSpeed(0x20);
+  scheduled_pan_->SetGoalPosition(600);
+  scheduled_pan_->SetTorqueEnabled(false);
+  std::this_thread::sleep_for(SPEED_CHANGE_DEADLINE + std::chrono::milliseconds{10});
+
+  EXPECT_TRUE(scheduler_.Flush());
+
+  // Stops never expire.
+  std::vector<Write> expected = {{1, ServoRegister::TORQUE_ENABLE, 0}};
+  EXPECT_EQ(expected, log_);
+  EXPECT_EQ(0u, scheduler_.GetPendingCount());
+  EXPECT_TRUE(scheduler_.TakeLostWrites());
+  EXPECT_FALSE(scheduler_.TakeLostWrites());
+}
+
+TEST_F(ServoBusSchedulerTest, ExpiredReadLosesNoWrite)
+{
+  using namespace servo_scheduler_internal;
+
+  scheduled_tilt_->RequestPresentPosition();
+  std::this_thread::sleep_for(TELEMETRY_DEADLINE + std::chrono::milliseconds{10});
+
+  EXPECT_TRUE(scheduler_.Flush());
+
+  uint16_t position;
+  std::chrono::steady_clock::time_point read_time;
+  EXPECT_FALSE(scheduled_tilt_->TakePresentPosition(&position, &read_time));
+  EXPECT_FALSE(scheduler_.TakeLostWrites());
+}
+
+TEST_F(ServoBusSchedulerTest, TimeBudgetDefersTheRest)
+{
+  using namespace servo_scheduler_internal;
+
+  // The stop and one more write overrun the budget.
+  tilt_.write_time = FLUSH_TIME_BUDGET * 3 / 5;
+  pan_.write_time = FLUSH_TIME_BUDGET * 3 / 5;
+  for (ScheduledServo<FakeServo> *servo : {scheduled_tilt_, scheduled_pan_})
+  {
+    servo->SetGoalPosition(600);
+    servo->SetMovingSpeed(0x20);
+    servo->SetTorqueLimit(0x3FF);
+  }
+  scheduled_pan_->SetTorqueEnabled(false);
+
+  EXPECT_TRUE(scheduler_.Flush());
+
+  // The stop goes out whatever the budget; then writes until it is spent.
+  std::vector<Write> expected = {
+      {1, ServoRegister::TORQUE_ENABLE, 0},
+      {0, ServoRegister::GOAL_POSITION, 600},
+  };
+  EXPECT_EQ(expected, log_);
+  EXPECT_EQ(5u, scheduler_.GetPendingCount());
+  EXPECT_FALSE(scheduler_.TakeLostWrites());
+
+  tilt_.write_time = std::chrono::microseconds{0};
+  pan_.write_time = std::chrono::microseconds{0};
+  EXPECT_TRUE(scheduler_.Flush());
+
+  // What is left is grouped afresh: pan still has a direction change, tilt
+  // only a speed change.
+  expected.insert(
+      expected.end(),
+      {
+          {1, ServoRegister::GOAL_POSITION, 600},
+          {1, ServoRegister::MOVING_SPEED, 0x20},
+          {1, ServoRegister::TORQUE_LIMIT, 0x3FF},
+          {0, ServoRegister::MOVING_SPEED, 0x20},
+          {0, ServoRegister::TORQUE_LIMIT, 0x3FF},
+      });
+  EXPECT_EQ(expected, log_);
+  EXPECT_EQ(0u, scheduler_.GetPendingCount());
+}
+
+TEST_F(ServoBusSchedulerTest, FlushConfigurationIgnoresBudgetAndDeadlines)
+{
+  using namespace servo_scheduler_internal;
+
+  tilt_.write_time = FLUSH_TIME_BUDGET;
+  scheduled_tilt_->SetGoalPosition(600);
+  scheduled_tilt_->SetMovingSpeed(0x20);
+  scheduled_tilt_->SetTorqueLimit(0x3FF);
+  std::this_thread::sleep_for(SPEED_CHANGE_DEADLINE + std::chrono::milliseconds{10});
+
+  EXPECT_TRUE(scheduler_.FlushConfiguration());
+
+  EXPECT_EQ(3u, log_.size());
+  EXPECT_EQ(0u, scheduler_.GetPendingCount());
+  EXPECT_FALSE(scheduler_.TakeLostWrites());
+}
+
+TEST_F(ServoBusSchedulerTest, FailedWriteIsReportedAndForgotten)
+{
+  tilt_.fail_writes = true;
+  scheduled_tilt_->SetMovingSpeed(0x20);
+
+  EXPECT_FALSE(scheduler_.Flush());
+
+  uint16_t value;
+  EXPECT_FALSE(scheduler_.GetKnownValue(0, ServoRegister::MOVING_SPEED, &value));
+  EXPECT_TRUE(scheduler_.TakeLostWrites());
+}
+
+TEST_F(ServoBusSchedulerTest, PersistentRegistersAreReadCompareWrite)
+{
+  tilt_.cw_angle_limit = 400;
+  tilt_.ccw_angle_limit = 650;
+  scheduler_.ReadPersistentRegisters();
+
+  scheduled_tilt_->SetClockWiseAngleLimit(400);
+  scheduled_tilt_->SetCounterClockWiseAngleLimit(0);
+  scheduled_tilt_->SetMovingSpeed(0x20);
+  EXPECT_TRUE(scheduler_.Flush());
+
+  std::vector<Write> expected = {
+      {0, ServoRegister::CCW_ANGLE_LIMIT, 0},
+      {0, ServoRegister::MOVING_SPEED, 0x20},
+  };
+  EXPECT_EQ(expected, log_);
+
+  // RAM registers are confirmed but always written.
+  uint16_t value;
+  ASSERT_TRUE(scheduler_.GetKnownValue(0, ServoRegister::MOVING_SPEED, &value));
+  EXPECT_EQ(0x20, value);
+  scheduled_tilt_->SetMovingSpeed(0x20);
+  EXPECT_TRUE(scheduler_.Flush());
+  EXPECT_EQ(3u, log_.size());
+}
+
+}  // namespace
+}  // namespace xbox
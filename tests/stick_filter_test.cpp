@@ -0,0 +1,116 @@
+#include "src/stick_filter.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdint>
+
+namespace xbox
+{
+namespace
+{
+constexpr double REPORT_PERIOD = 0.005;
+
+TEST(OneEuroFilterTest, FirstSamplePassesThrough)
+{
+  OneEuroFilter filter;
+  EXPECT_EQ(0.75, filter.Filter(0.75, 10.0));
+}
+
+TEST(OneEuroFilterTest, SampleWithoutElapsedTimeChangesNothing)
+{
+  OneEuroFilter filter;
+  filter.Filter(0.0, 1.0);
+  double smoothed = filter.Filter(1.0, 1.0 + REPORT_PERIOD);
+
+  EXPECT_EQ(smoothed, filter.Filter(-1.0, 1.0 + REPORT_PERIOD));
+  EXPECT_EQ(smoothed, filter.Filter(-1.0, 1.0));
+}
+
+TEST(OneEuroFilterTest, WithoutBetaItIsAFixedLowPass)
+{
+  constexpr double CUTOFF_HZ = 2.0;
+  OneEuroFilter filter{OneEuroFilterConfig{CUTOFF_HZ, 0.0, 1.0}};
+  filter.Filter(0.0, 0.0);
+
+  double time_constant = 1.0 / (2.0 * M_PI * CUTOFF_HZ);
+  double alpha = 1.0 / (1.0 + time_constant / REPORT_PERIOD);
+  double expected = 0.0;
+  for (int i = 1; i <= 100; ++i)
+  {
+    expected += alpha * (1.0 - expected);
+    EXPECT_NEAR(expected, filter.Filter(1.0, i * REPORT_PERIOD), 1e-12);
+  }
+}
+
+TEST(OneEuroFilterTest, SuppressesJitterAroundAHold)
+{
+  OneEuroFilter filter;
+  double max_output = 0;
+  for (int i = 0; i < 400; ++i)
+  {
+    double jitter = (i % 2 == 0) ? 0.01 : -0.01;
+    double output = filter.Filter(jitter, i * REPORT_PERIOD);
+    if (i > 100)
+    {
+      max_output = std::max(max_output, std::abs(output));
+    }
+  }
+
+  EXPECT_LT(max_output, 0.002);
+}
+
+TEST(OneEuroFilterTest, BetaCutsLagOnFastMotion)
+{
+  // A full-range flick in 100 ms.
+  OneEuroFilter fixed{OneEuroFilterConfig{1.0, 0.0, 1.0}};
+  OneEuroFilter adaptive{OneEuroFilterConfig{1.0, 0.5, 1.0}};
+  double fixed_output = 0;
+  double adaptive_output = 0;
+  for (int i = 0; i <= 20; ++i)
+  {
+    double input = -1.0 + 2.0 * i / 20;
+    fixed_output = fixed.Filter(input, i * REPORT_PERIOD);
+    adaptive_output = adaptive.Filter(input, i * REPORT_PERIOD);
+  }
+
+  EXPECT_LT(1.0 - adaptive_output, 1.0 - fixed_output);
+  EXPECT_GT(adaptive_output, fixed_output + 0.1);
+}
+
+TEST(OneEuroFilterTest, ResetRestartsFromTheNextSample)
+{
+  OneEuroFilter filter;
+  filter.Filter(-1.0, 0.0);
+  filter.Filter(-1.0, REPORT_PERIOD);
+  filter.Reset();
+
+  EXPECT_EQ(1.0, filter.Filter(1.0, 2 * REPORT_PERIOD));
+}
+
+TEST(StickSmoothingStageTest, SmoothsOnlyTheSticksAndKeepsTheirRange)
+{
+  StickSmoothingStage stage;
+  ControllerReport report = {};
+  report.left_stick_x = 0x0000;
+  report.left_stick_y = 0xFFFF;
+  report.right_stick_x = 0x8000;
+  report.right_stick_y = 0x1234;
+  report.left_trigger = 0x3FF;
+  report.buttons = 0x5A;
+
+  ControllerReport smoothed = {};
+  auto next = [&] (const ControllerReport &out) { smoothed = out; };
+  stage(next, report);
+
+  // The first report passes through the filters unchanged.
+  EXPECT_EQ(report.left_stick_x, smoothed.left_stick_x);
+  EXPECT_EQ(report.left_stick_y, smoothed.left_stick_y);
+  EXPECT_EQ(report.right_stick_x, smoothed.right_stick_x);
+  EXPECT_EQ(report.right_stick_y, smoothed.right_stick_y);
+  EXPECT_EQ(report.left_trigger, smoothed.left_trigger);
+  EXPECT_EQ(report.buttons, smoothed.buttons);
+}
+
+}  // namespace
+}  // namespace xbox
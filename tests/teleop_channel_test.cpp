@@ -0,0 +1,186 @@
+#include "src/teleop_channel.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "src/teleop_protocol.h"
+
+namespace xbox
+{
+namespace
+{
+constexpr std::chrono::milliseconds MAX_DELAY{50};
+constexpr std::chrono::milliseconds SESSION_TIMEOUT{100};
+// Our clock and the station's need not agree; the checks must not care.
+constexpr int64_t STATION_CLOCK_OFFSET_NS = 3600LL * 1000 * 1000 * 1000;
+
+// Records the first payload byte of every frame it is handed.
+struct RecordingCallback
+{
+  std::vector<uint8_t> *markers;
+
+  void operator()(const uint8_t *buffer, size_t length) const
+  {
+    ASSERT_EQ(CONTROLLER_REPORT_SIZE, length);
+    markers->push_back(buffer[0]);
+  }
+};
+
+using RecordingTeleopChannel = BasicTeleopChannel<RecordingCallback>;
+
+// A receiving socket on an ephemeral loopback port and a station socket
+// connected to it.
+class TeleopLoopbackTest : public testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    int receive_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    ASSERT_GE(receive_fd, 0);
+
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ASSERT_EQ(0, bind(receive_fd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)));
+    socklen_t address_size = sizeof(address);
+    ASSERT_EQ(
+        0,
+        getsockname(receive_fd, reinterpret_cast<struct sockaddr *>(&address), &address_size));
+
+    station_fd_ = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    ASSERT_GE(station_fd_, 0);
+    ASSERT_EQ(
+        0,
+        connect(station_fd_, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)));
+
+    channel_ = RecordingTeleopChannel{
+        receive_fd,
+        RecordingCallback{&markers_},
+        MAX_DELAY,
+        SESSION_TIMEOUT};
+  }
+
+  void TearDown() override
+  {
+    if (station_fd_ >= 0)
+    {
+      close(station_fd_);
+    }
+  }
+
+  // Sends a datagram whose payload starts with |marker|, |delay| after it
+  // claims to have been sent.
+  void Send(
+      uint32_t session,
+      uint32_t sequence,
+      uint8_t marker,
+      std::chrono::nanoseconds delay = std::chrono::nanoseconds{0})
+  {
+    TeleopDatagram datagram = {};
+    datagram.session = session;
+    datagram.sequence = sequence;
+    datagram.send_timestamp_ns =
+        GetTeleopClockNanoseconds() + STATION_CLOCK_OFFSET_NS - delay.count();
+    datagram.payload[0] = marker;
+
+    uint8_t buffer[TELEOP_DATAGRAM_SIZE];
+    EncodeTeleopDatagram(datagram, buffer);
+    ASSERT_EQ(static_cast<ssize_t>(sizeof(buffer)), send(station_fd_, buffer, sizeof(buffer), 0));
+  }
+
+  // Waits for the datagrams sent so far and hands them to the channel.
+  void Receive()
+  {
+    struct pollfd fd = {channel_.GetFd(), POLLIN, 0};
+    ASSERT_EQ(1, poll(&fd, 1, 1000));
+    channel_.HandlePacket();
+  }
+
+  int station_fd_ = -1;
+  std::vector<uint8_t> markers_;
+  RecordingTeleopChannel channel_;
+};
+
+TEST_F(TeleopLoopbackTest, DeliversNewerSequencesAndDropsOlderOnes)
+{
+  Send(7, 0, 1);
+  Send(7, 1, 2);
+  Send(7, 1, 3);
+  Send(7, 0, 4);
+  Send(7, 5, 5);
+  Receive();
+
+  EXPECT_EQ((std::vector<uint8_t>{1, 2, 5}), markers_);
+}
+
+TEST_F(TeleopLoopbackTest, NewerSessionWaitsForTheCurrentOneToGoQuiet)
+{
+  Send(7, 10, 1);
+  Receive();
+  Send(8, 0, 2);
+  Receive();
+  EXPECT_EQ((std::vector<uint8_t>{1}), markers_);
+
+  std::this_thread::sleep_for(SESSION_TIMEOUT + std::chrono::milliseconds{20});
+  Send(8, 1, 3);
+  Receive();
+  EXPECT_EQ((std::vector<uint8_t>{1, 3}), markers_);
+}
+
+TEST_F(TeleopLoopbackTest, OlderSessionNeverSwitchesBack)
+{
+  Send(8, 0, 1);
+  Receive();
+
+  std::this_thread::sleep_for(SESSION_TIMEOUT + std::chrono::milliseconds{20});
+  Send(7, 100, 2);
+  Receive();
+  Send(8, 1, 3);
+  Receive();
+
+  EXPECT_EQ((std::vector<uint8_t>{1, 3}), markers_);
+}
+
+TEST_F(TeleopLoopbackTest, DropsDatagramsDelayedBeyondTheSessionsBest)
+{
+  Send(7, 0, 1);
+  Send(7, 1, 2, MAX_DELAY / 2);
+  Send(7, 2, 3, MAX_DELAY * 4);
+  Send(7, 3, 4);
+  Receive();
+
+  EXPECT_EQ((std::vector<uint8_t>{1, 2, 4}), markers_);
+}
+
+TEST(TeleopInputArbiterTest, RemoteStationWinsWhileItsSessionIsFresh)
+{
+  std::vector<uint8_t> markers;
+  TeleopInputArbiter<RecordingCallback> arbiter{RecordingCallback{&markers}, SESSION_TIMEOUT};
+  uint8_t frame[CONTROLLER_REPORT_SIZE] = {};
+
+  frame[0] = 1;
+  arbiter(frame, sizeof(frame));
+  frame[0] = 2;
+  arbiter.HandleRemoteFrame(frame, sizeof(frame));
+  frame[0] = 3;
+  arbiter(frame, sizeof(frame));
+  EXPECT_EQ((std::vector<uint8_t>{1, 2}), markers);
+
+  std::this_thread::sleep_for(SESSION_TIMEOUT + std::chrono::milliseconds{20});
+  frame[0] = 4;
+  arbiter(frame, sizeof(frame));
+  EXPECT_EQ((std::vector<uint8_t>{1, 2, 4}), markers);
+}
+
+}  // namespace
+}  // namespace xbox
@@ -0,0 +1,223 @@
+#include "src/wheel_mode_mapper.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+namespace xbox
+{
+namespace
+{
+using namespace joystick_mapper_internal;
+
+constexpr std::chrono::milliseconds CONTROL_PERIOD{1};
+// Half deflection, the slow speed bucket, so the model barely moves by
+// itself while a test runs.
+constexpr uint16_t STICK_NEUTRAL = 0x8000;
+constexpr uint16_t STICK_HALF_POSITIVE = 0xC000;
+constexpr uint16_t STICK_HALF_NEGATIVE = 0x4000;
+
+// Synchronous servo that holds its registers in memory.
+struct FakeServo
+{
+  bool SetGoalPosition(uint16_t position)
+  {
+    goal_position = position;
+    return true;
+  }
+
+  bool SetMovingSpeed(uint16_t speed)
+  {
+    if (fail_speed_writes)
+    {
+      return false;
+    }
+    moving_speed = speed;
+    ++speed_writes;
+    return true;
+  }
+
+  bool SetTorqueEnabled(bool enabled)
+  {
+    torque_enabled = enabled;
+    return true;
+  }
+
+  bool SetTorqueLimit(uint16_t limit)
+  {
+    torque_limit = limit;
+    return true;
+  }
+
+  bool SetClockWiseAngleLimit(uint16_t limit)
+  {
+    cw_angle_limit = limit;
+    return true;
+  }
+
+  bool SetCounterClockWiseAngleLimit(uint16_t limit)
+  {
+    ccw_angle_limit = limit;
+    return true;
+  }
+
+  bool GetPresentPosition(uint16_t *out_position) const
+  {
+    *out_position = present_position;
+    return true;
+  }
+
+  bool GetClockWiseAngleLimit(uint16_t *out_limit) const
+  {
+    *out_limit = cw_angle_limit;
+    return true;
+  }
+
+  bool GetCounterClockWiseAngleLimit(uint16_t *out_limit) const
+  {
+    *out_limit = ccw_angle_limit;
+    return true;
+  }
+
+  uint16_t goal_position = 0;
+  uint16_t moving_speed = 0;
+  bool torque_enabled = false;
+  uint16_t torque_limit = 0;
+  uint16_t cw_angle_limit = GOAL_POSITION_LIMIT_LOW;
+  uint16_t ccw_angle_limit = GOAL_POSITION_LIMIT_HIGH;
+  uint16_t present_position = GOAL_POSITION_NEUTRAL;
+  bool fail_speed_writes = false;
+  int speed_writes = 0;
+};
+
+using FakeScheduler = BasicServoBusScheduler<FakeServo>;
+using FakeScheduledServo = ScheduledServo<FakeServo>;
+using FakeWheelModeMapper = BasicWheelModeMapper<FakeScheduledServo, FakeScheduler>;
+
+class WheelModeMapperTest : public ::testing::Test
+{
+protected:
+  WheelModeMapperTest() : scheduler_{nullptr} {}
+
+  void CreateMapper(uint16_t tilt_position)
+  {
+    FakeScheduledServo *scheduled_tilt;
+    FakeScheduledServo *scheduled_pan;
+    ASSERT_TRUE(scheduler_.GetScheduledServo(&tilt_, &scheduled_tilt));
+    ASSERT_TRUE(scheduler_.GetScheduledServo(&pan_, &scheduled_pan));
+    ASSERT_TRUE(FakeWheelModeMapper::Create(
+        scheduled_tilt,
+        scheduled_pan,
+        &scheduler_,
+        CONTROL_PERIOD,
+        tilt_position,
+        GOAL_POSITION_NEUTRAL,
+        &mapper_));
+    ASSERT_TRUE(scheduler_.FlushConfiguration());
+    ASSERT_EQ(0, tilt_.cw_angle_limit);
+    ASSERT_EQ(0, tilt_.ccw_angle_limit);
+  }
+
+  // Maps a report that deflects only the tilt stick and flushes it.
+  void ProcessTiltStick(uint16_t stick)
+  {
+    ControllerReport report = {};
+    report.left_stick_x = STICK_NEUTRAL;
+    report.left_stick_y = stick;
+    mapper_.ProcessReport(report);
+    scheduler_.Flush();
+  }
+
+  // Waits for the control timer and runs one control period.
+  void RunControlPeriod()
+  {
+    std::this_thread::sleep_for(2 * CONTROL_PERIOD);
+    mapper_.HandlePacket();
+  }
+
+  FakeServo tilt_;
+  FakeServo pan_;
+  FakeScheduler scheduler_;
+  FakeWheelModeMapper mapper_;
+};
+
+TEST(WheelSpeedTest, DecodeInvertsEncode)
+{
+  for (int32_t velocity : {0, 1, -1, 0x0F, -0x0F, 0x3FF, -0x3FF})
+  {
+    EXPECT_EQ(velocity, DecodeWheelSpeed(EncodeWheelSpeed(velocity)));
+  }
+}
+
+TEST_F(WheelModeMapperTest, DoesNotDriveIntoTheHighLimit)
+{
+  CreateMapper(GOAL_POSITION_LIMIT_HIGH);
+  int speed_writes = tilt_.speed_writes;
+
+  ProcessTiltStick(STICK_HALF_POSITIVE);
+
+  EXPECT_EQ(0, tilt_.moving_speed);
+  EXPECT_EQ(speed_writes, tilt_.speed_writes);
+}
+
+TEST_F(WheelModeMapperTest, DoesNotDriveIntoTheLowLimit)
+{
+  CreateMapper(GOAL_POSITION_LIMIT_LOW);
+  int speed_writes = tilt_.speed_writes;
+
+  ProcessTiltStick(STICK_HALF_NEGATIVE);
+
+  EXPECT_EQ(0, tilt_.moving_speed);
+  EXPECT_EQ(speed_writes, tilt_.speed_writes);
+}
+
+TEST_F(WheelModeMapperTest, DrivesAwayFromALimit)
+{
+  CreateMapper(GOAL_POSITION_LIMIT_HIGH);
+
+  ProcessTiltStick(STICK_HALF_NEGATIVE);
+
+  EXPECT_EQ(EncodeWheelSpeed(-LOW_MOVEMENT_SPEED), tilt_.moving_speed);
+  EXPECT_FALSE(mapper_.GetTiltCommandState().positive_direction);
+}
+
+TEST_F(WheelModeMapperTest, PresentPositionReadStopsAtTheLimit)
+{
+  using namespace wheel_mode_internal;
+
+  CreateMapper(GOAL_POSITION_LIMIT_LOW + 10);
+  ProcessTiltStick(STICK_HALF_POSITIVE);
+  ASSERT_EQ(LOW_MOVEMENT_SPEED, tilt_.moving_speed);
+
+  // The horn got there faster than the model thinks.
+  tilt_.present_position = GOAL_POSITION_LIMIT_HIGH;
+  int64_t soft_limit_stops = ReadCounter(Counter::WHEEL_SOFT_LIMIT_STOPS);
+  for (uint32_t i = 0; i <= POSITION_CORRECTION_PERIODS; ++i)
+  {
+    RunControlPeriod();
+  }
+
+  EXPECT_EQ(0, tilt_.moving_speed);
+  EXPECT_EQ(soft_limit_stops + 1, ReadCounter(Counter::WHEEL_SOFT_LIMIT_STOPS));
+  EXPECT_GE(mapper_.GetTiltCommandState().goal_position, GOAL_POSITION_LIMIT_HIGH);
+}
+
+TEST_F(WheelModeMapperTest, UnconfirmedSpeedDoesNotMoveTheModel)
+{
+  constexpr uint16_t START_POSITION = 500;
+
+  CreateMapper(START_POSITION);
+  tilt_.fail_speed_writes = true;
+
+  ProcessTiltStick(STICK_HALF_POSITIVE);
+  std::this_thread::sleep_for(std::chrono::milliseconds{50});
+  ProcessTiltStick(STICK_HALF_POSITIVE);
+
+  EXPECT_EQ(0, tilt_.moving_speed);
+  EXPECT_EQ(START_POSITION, mapper_.GetTiltCommandState().goal_position);
+}
+
+}  // namespace
+}  // namespace xbox
@@ -0,0 +1,509 @@
+// Offline decoder for xbone controller captures.
+//
+// Memory-maps a capture written by ControllerCaptureWriter, decodes every
+// record into columnar arrays with the best available SIMD kernel, splitting
+// the file across threads, and prints summary statistics and per-axis
+// histograms.
+//
+//   xbone_capture_decode [--threads=N] [--isa=auto|avx2|sse2|scalar] capture.xcap
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gflags/gflags.h"
+
+#include "src/capture_decoder.h"
+#include "src/controller_capture.h"
+#include "src/controller_report.h"
+
+DEFINE_int32(threads, 0, "Decoder threads. 0 uses every hardware thread.");
+DEFINE_string(isa, "auto", "Decode kernel: auto, avx2, sse2 or scalar.");
+DEFINE_int32(histogram_bins, 32, "Buckets per axis histogram.");
+DEFINE_int32(histogram_width, 50, "Characters in the longest histogram bar.");
+DEFINE_bool(verify, false, "Also decode with the scalar kernel and compare.");
+
+namespace
+{
+using xbox::CaptureDecodeIsa;
+using xbox::ControllerButton;
+using xbox::ControllerCaptureHeader;
+using xbox::ControllerCaptureRecord;
+using xbox::ControllerReportColumns;
+
+// Chunk boundaries stay on AVX2 block multiples so only the file's last chunk
+// has a scalar tail.
+constexpr size_t CHUNK_ALIGNMENT = 16;
+
+enum Axis
+{
+  LEFT_STICK_X,
+  LEFT_STICK_Y,
+  RIGHT_STICK_X,
+  RIGHT_STICK_Y,
+  LEFT_TRIGGER,
+  RIGHT_TRIGGER,
+  AXIS_COUNT,
+};
+
+constexpr std::array<const char *, AXIS_COUNT> AXIS_NAMES =
+{{
+  "left_stick_x",
+  "left_stick_y",
+  "right_stick_x",
+  "right_stick_y",
+  "left_trigger",
+  "right_trigger",
+}};
+
+// Bits of raw value per axis: sticks span 16 bits, triggers 10.
+constexpr std::array<uint32_t, AXIS_COUNT> AXIS_VALUE_BITS = {{16, 16, 16, 16, 10, 10}};
+
+constexpr std::array<const char *, xbox::CONTROLLER_BUTTON_COUNT> BUTTON_NAMES =
+{{
+  "A", "B", "X", "Y", "LB", "RB", "L3", "R3",
+  "DPAD_UP", "DPAD_RIGHT", "DPAD_DOWN", "DPAD_LEFT",
+}};
+
+struct AxisSummary
+{
+  uint16_t min;
+  uint16_t max;
+  double sum;
+  double sum_of_squares;
+  std::vector<uint64_t> histogram;
+};
+
+struct CaptureSummary
+{
+  std::array<AxisSummary, AXIS_COUNT> axes;
+  std::array<uint64_t, xbox::CONTROLLER_BUTTON_COUNT> button_presses;
+  int64_t max_timestamp_gap_ns;
+  uint64_t timestamp_regressions;
+};
+
+void InitializeSummary(size_t histogram_bins, CaptureSummary *summary)
+{
+  for (AxisSummary &axis : summary->axes)
+  {
+    axis.min = UINT16_MAX;
+    axis.max = 0;
+    axis.sum = 0;
+    axis.sum_of_squares = 0;
+    axis.histogram.assign(histogram_bins, 0);
+  }
+  summary->button_presses.fill(0);
+  summary->max_timestamp_gap_ns = 0;
+  summary->timestamp_regressions = 0;
+}
+
+void SummarizeAxis(
+    const uint16_t *values,
+    size_t count,
+    uint32_t value_bits,
+    AxisSummary *axis)
+{
+  uint16_t min = axis->min;
+  uint16_t max = axis->max;
+  double sum = 0;
+  double sum_of_squares = 0;
+  uint64_t bins = axis->histogram.size();
+  uint64_t *histogram = axis->histogram.data();
+
+  for (size_t i = 0; i < count; ++i)
+  {
+    uint16_t value = values[i];
+    min = std::min(min, value);
+    max = std::max(max, value);
+    sum += value;
+    sum_of_squares += static_cast<double>(value) * value;
+    ++histogram[(value * bins) >> value_bits];
+  }
+
+  axis->min = min;
+  axis->max = max;
+  axis->sum += sum;
+  axis->sum_of_squares += sum_of_squares;
+}
+
+uint16_t GetButtonMask(const ControllerReportColumns &columns, size_t row)
+{
+  xbox::ControllerReport report = {};
+  report.dpad = columns.dpad[row];
+  report.buttons = columns.buttons[row];
+  return xbox::GetButtonMask(report);
+}
+
+// Summarizes rows [begin, end). Edges and gaps at |begin| are measured against
+// row |begin| - 1, which another thread decoded, so this runs after all
+// decoding has finished.
+void SummarizeRows(
+    const ControllerReportColumns &columns,
+    size_t begin,
+    size_t end,
+    CaptureSummary *summary)
+{
+  const std::array<const std::vector<uint16_t> *, AXIS_COUNT> axis_columns =
+  {{
+    &columns.left_stick_x,
+    &columns.left_stick_y,
+    &columns.right_stick_x,
+    &columns.right_stick_y,
+    &columns.left_trigger,
+    &columns.right_trigger,
+  }};
+
+  for (size_t axis = 0; axis < AXIS_COUNT; ++axis)
+  {
+    SummarizeAxis(
+        axis_columns[axis]->data() + begin,
+        end - begin,
+        AXIS_VALUE_BITS[axis],
+        &summary->axes[axis]);
+  }
+
+  uint16_t previous_buttons = (begin > 0) ? GetButtonMask(columns, begin - 1) : 0;
+  for (size_t row = begin; row < end; ++row)
+  {
+    uint16_t buttons = GetButtonMask(columns, row);
+    uint16_t pressed = buttons & ~previous_buttons;
+    previous_buttons = buttons;
+
+    while (pressed != 0)
+    {
+      ++summary->button_presses[__builtin_ctz(pressed)];
+      pressed &= pressed - 1;
+    }
+
+    if (row > 0)
+    {
+      int64_t gap = columns.timestamp_ns[row] - columns.timestamp_ns[row - 1];
+      if (gap < 0)
+      {
+        ++summary->timestamp_regressions;
+      }
+      summary->max_timestamp_gap_ns = std::max(summary->max_timestamp_gap_ns, gap);
+    }
+  }
+}
+
+void MergeSummary(const CaptureSummary &from, CaptureSummary *into)
+{
+  for (size_t axis = 0; axis < AXIS_COUNT; ++axis)
+  {
+    AxisSummary &target = into->axes[axis];
+    const AxisSummary &source = from.axes[axis];
+    target.min = std::min(target.min, source.min);
+    target.max = std::max(target.max, source.max);
+    target.sum += source.sum;
+    target.sum_of_squares += source.sum_of_squares;
+    for (size_t bin = 0; bin < target.histogram.size(); ++bin)
+    {
+      target.histogram[bin] += source.histogram[bin];
+    }
+  }
+
+  for (size_t button = 0; button < into->button_presses.size(); ++button)
+  {
+    into->button_presses[button] += from.button_presses[button];
+  }
+
+  into->max_timestamp_gap_ns = std::max(into->max_timestamp_gap_ns, from.max_timestamp_gap_ns);
+  into->timestamp_regressions += from.timestamp_regressions;
+}
+
+bool ParseIsa(const std::string &name, CaptureDecodeIsa *out_isa)
+{
+  if (name == "auto")
+  {
+    *out_isa = xbox::GetBestCaptureDecodeIsa();
+  }
+  else if (name == "avx2")
+  {
+    *out_isa = CaptureDecodeIsa::AVX2;
+  }
+  else if (name == "sse2")
+  {
+    *out_isa = CaptureDecodeIsa::SSE2;
+  }
+  else if (name == "scalar")
+  {
+    *out_isa = CaptureDecodeIsa::SCALAR;
+  }
+  else
+  {
+    return false;
+  }
+
+  return xbox::IsCaptureDecodeIsaSupported(*out_isa);
+}
+
+// Splits [0, record_count) into at most |thread_count| aligned ranges and runs
+// |work(begin, end, index)| for each on its own thread.
+template <typename Work>
+size_t RunChunked(size_t record_count, size_t thread_count, Work work)
+{
+  size_t chunk_size = (record_count + thread_count - 1) / thread_count;
+  chunk_size = (chunk_size + CHUNK_ALIGNMENT - 1) / CHUNK_ALIGNMENT * CHUNK_ALIGNMENT;
+  chunk_size = std::max(chunk_size, CHUNK_ALIGNMENT);
+
+  std::vector<std::thread> threads;
+  for (size_t begin = 0; begin < record_count; begin += chunk_size)
+  {
+    size_t end = std::min(begin + chunk_size, record_count);
+    size_t index = threads.size();
+    threads.emplace_back([=] { work(begin, end, index); });
+  }
+
+  for (std::thread &thread : threads)
+  {
+    thread.join();
+  }
+  return threads.size();
+}
+
+bool ColumnsEqual(const ControllerReportColumns &lhs, const ControllerReportColumns &rhs)
+{
+  return lhs.timestamp_ns == rhs.timestamp_ns &&
+      lhs.left_stick_x == rhs.left_stick_x &&
+      lhs.left_stick_y == rhs.left_stick_y &&
+      lhs.right_stick_x == rhs.right_stick_x &&
+      lhs.right_stick_y == rhs.right_stick_y &&
+      lhs.left_trigger == rhs.left_trigger &&
+      lhs.right_trigger == rhs.right_trigger &&
+      lhs.dpad == rhs.dpad &&
+      lhs.buttons == rhs.buttons;
+}
+
+void PrintSummary(
+    const ControllerReportColumns &columns,
+    const CaptureSummary &summary)
+{
+  size_t record_count = columns.GetSize();
+  double duration_seconds = (record_count > 1)
+      ? (columns.timestamp_ns.back() - columns.timestamp_ns.front()) / 1e9
+      : 0;
+
+  printf("records: %zu\n", record_count);
+  printf("duration_s: %.3f\n", duration_seconds);
+  printf("mean_rate_hz: %.1f\n", duration_seconds > 0 ? (record_count - 1) / duration_seconds : 0);
+  printf("max_gap_ms: %.3f\n", summary.max_timestamp_gap_ns / 1e6);
+  printf("timestamp_regressions: %" PRIu64 "\n", summary.timestamp_regressions);
+
+  printf("\n%-14s %8s %8s %10s %10s\n", "axis", "min", "max", "mean", "stddev");
+  for (size_t axis = 0; axis < AXIS_COUNT; ++axis)
+  {
+    const AxisSummary &stats = summary.axes[axis];
+    double mean = stats.sum / record_count;
+    double variance = std::max(stats.sum_of_squares / record_count - mean * mean, 0.0);
+    printf(
+        "%-14s %8u %8u %10.1f %10.1f\n",
+        AXIS_NAMES[axis],
+        stats.min,
+        stats.max,
+        mean,
+        std::sqrt(variance));
+  }
+
+  printf("\nbutton presses:\n");
+  for (size_t button = 0; button < summary.button_presses.size(); ++button)
+  {
+    printf("  %-10s %" PRIu64 "\n", BUTTON_NAMES[button], summary.button_presses[button]);
+  }
+
+  for (size_t axis = 0; axis < AXIS_COUNT; ++axis)
+  {
+    const std::vector<uint64_t> &histogram = summary.axes[axis].histogram;
+    uint64_t tallest = *std::max_element(histogram.begin(), histogram.end());
+    uint32_t range = 1u << AXIS_VALUE_BITS[axis];
+
+    printf("\nhistogram %s:\n", AXIS_NAMES[axis]);
+    for (size_t bin = 0; bin < histogram.size(); ++bin)
+    {
+      int bar = tallest ? static_cast<int>(histogram[bin] * FLAGS_histogram_width / tallest) : 0;
+      printf(
+          "  [%5u, %5u) %12" PRIu64 " %.*s\n",
+          static_cast<uint32_t>(bin * range / histogram.size()),
+          static_cast<uint32_t>((bin + 1) * range / histogram.size()),
+          histogram[bin],
+          bar,
+          "##################################################"
+          "##################################################");
+    }
+  }
+}
+
+}  // namespace
+
+int main(int argc, char **argv)
+{
+  gflags::SetUsageMessage("xbone_capture_decode [flags] <capture>");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (argc != 2)
+  {
+    fprintf(stderr, "Usage: %s [flags] <capture>\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  CaptureDecodeIsa isa;
+  if (!ParseIsa(FLAGS_isa, &isa))
+  {
+    fprintf(stderr, "Unsupported --isa: %s\n", FLAGS_isa.c_str());
+    return EXIT_FAILURE;
+  }
+
+  if (FLAGS_histogram_bins <= 0 || FLAGS_histogram_width < 0 || FLAGS_histogram_width > 100)
+  {
+    fprintf(stderr, "Invalid histogram parameters\n");
+    return EXIT_FAILURE;
+  }
+
+  size_t thread_count = (FLAGS_threads > 0)
+      ? FLAGS_threads
+      : std::max(1u, std::thread::hardware_concurrency());
+
+  int fd = open(argv[1], O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+  {
+    fprintf(stderr, "Failed to open %s: %s\n", argv[1], strerror(errno));
+    return EXIT_FAILURE;
+  }
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) < 0)
+  {
+    fprintf(stderr, "Failed to stat %s: %s\n", argv[1], strerror(errno));
+    close(fd);
+    return EXIT_FAILURE;
+  }
+
+  size_t file_size = file_stat.st_size;
+  if (file_size < sizeof(ControllerCaptureHeader))
+  {
+    fprintf(stderr, "%s is too small to be a capture\n", argv[1]);
+    close(fd);
+    return EXIT_FAILURE;
+  }
+
+  void *mapping = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED)
+  {
+    fprintf(stderr, "Failed to map %s: %s\n", argv[1], strerror(errno));
+    return EXIT_FAILURE;
+  }
+  madvise(mapping, file_size, MADV_SEQUENTIAL);
+
+  const uint8_t *data = static_cast<const uint8_t *>(mapping);
+  ControllerCaptureHeader header;
+  memcpy(&header, data, sizeof(header));
+  if (header.magic != xbox::CONTROLLER_CAPTURE_MAGIC ||
+      header.version != xbox::CONTROLLER_CAPTURE_VERSION ||
+      header.record_size != sizeof(ControllerCaptureRecord))
+  {
+    fprintf(
+        stderr,
+        "%s is not a version %u capture (magic=0x%x version=%u record_size=%u)\n",
+        argv[1],
+        xbox::CONTROLLER_CAPTURE_VERSION,
+        header.magic,
+        header.version,
+        header.record_size);
+    munmap(mapping, file_size);
+    return EXIT_FAILURE;
+  }
+
+  size_t payload_size = file_size - sizeof(header);
+  size_t record_count = payload_size / sizeof(ControllerCaptureRecord);
+  if (payload_size % sizeof(ControllerCaptureRecord) != 0)
+  {
+    fprintf(stderr, "Ignoring truncated final record\n");
+  }
+
+  if (record_count == 0)
+  {
+    fprintf(stderr, "%s holds no records\n", argv[1]);
+    munmap(mapping, file_size);
+    return EXIT_FAILURE;
+  }
+
+  // The header keeps records 8-byte aligned in the mapping.
+  const ControllerCaptureRecord *records =
+      reinterpret_cast<const ControllerCaptureRecord *>(data + sizeof(header));
+
+  ControllerReportColumns columns;
+  columns.Resize(record_count);
+
+  auto decode_start = std::chrono::steady_clock::now();
+  size_t chunk_count = RunChunked(
+      record_count,
+      thread_count,
+      [&] (size_t begin, size_t end, size_t) {
+        xbox::DecodeCaptureRecords(isa, records + begin, end - begin, begin, &columns);
+      });
+  double decode_seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - decode_start).count();
+
+  fprintf(
+      stderr,
+      "decoded %zu records in %.3f ms with %s on %zu threads (%.1f M records/s, %.1f MB/s)\n",
+      record_count,
+      decode_seconds * 1e3,
+      xbox::GetCaptureDecodeIsaName(isa),
+      chunk_count,
+      record_count / decode_seconds / 1e6,
+      payload_size / decode_seconds / 1e6);
+
+  if (FLAGS_verify)
+  {
+    ControllerReportColumns reference;
+    reference.Resize(record_count);
+    xbox::DecodeCaptureRecords(CaptureDecodeIsa::SCALAR, records, record_count, 0, &reference);
+    if (!ColumnsEqual(columns, reference))
+    {
+      fprintf(stderr, "%s decode differs from scalar decode\n", xbox::GetCaptureDecodeIsaName(isa));
+      munmap(mapping, file_size);
+      return EXIT_FAILURE;
+    }
+    fprintf(stderr, "verified against scalar decode\n");
+  }
+
+  munmap(mapping, file_size);
+
+  std::vector<CaptureSummary> chunk_summaries(chunk_count);
+  for (CaptureSummary &chunk_summary : chunk_summaries)
+  {
+    InitializeSummary(FLAGS_histogram_bins, &chunk_summary);
+  }
+
+  RunChunked(
+      record_count,
+      thread_count,
+      [&] (size_t begin, size_t end, size_t index) {
+        SummarizeRows(columns, begin, end, &chunk_summaries[index]);
+      });
+
+  CaptureSummary summary;
+  InitializeSummary(FLAGS_histogram_bins, &summary);
+  for (const CaptureSummary &chunk_summary : chunk_summaries)
+  {
+    MergeSummary(chunk_summary, &summary);
+  }
+
+  PrintSummary(columns, summary);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,459 @@
+// Bluetooth traffic generator for reproducing xbone under heavy HCI load.
+//
+// Creates a virtual HCI controller through /dev/vhci and injects, as if the
+// controller had received them, a mix of:
+//   - HCI events (completed-packet counts and inquiry results, the bulk of
+//     what a busy adapter reports),
+//   - ACL data on another connection, standing in for other Bluetooth
+//     devices, and
+//   - Xbox HID reports replayed from the doc/packet-traces dumps.
+// Every frame reaches xbone's HCI monitor socket like real traffic, so the
+// BluetoothChannel filter, drain and coalescing paths can be measured locally
+// against the frames_received, frames_filtered and reports_processed metrics.
+// Without --bluetooth_adapters xbone takes reports from this controller too;
+// with it, everything sent here should show up as filtered.
+//
+// The controller is raw (unconfigured) and opened as an HCI user channel, so
+// it comes up without an init sequence and neither bluetoothd nor the kernel
+// stack tries to use it. Needs root (or CAP_NET_ADMIN and access to
+// /dev/vhci).
+//
+//   xbone_hci_stress [--event_rate_hz=N] [--acl_rate_hz=N] [--report_rate_hz=N]
+//                    [--acl_payload_size=N] [--tick_us=N] [--duration_s=N]
+//                    [--trace_dir=doc/packet-traces]
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/hci.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gflags/gflags.h"
+
+#include "src/controller_report.h"
+
+DEFINE_double(event_rate_hz, 2000, "HCI events per second. 0 disables.");
+DEFINE_double(acl_rate_hz, 1000, "ACL frames per second on the noise connection. 0 disables.");
+DEFINE_double(report_rate_hz, 125, "Xbox HID reports per second. 0 disables.");
+DEFINE_int32(acl_payload_size, 300, "L2CAP payload bytes per noise ACL frame.");
+DEFINE_int32(
+    tick_us,
+    1000,
+    "Microseconds between wakeups. Frames due in a tick are sent back to "
+    "back, so longer ticks mean larger bursts.");
+DEFINE_int32(duration_s, 10, "Seconds to run. 0 runs until interrupted.");
+DEFINE_string(trace_dir, "doc/packet-traces", "Packet dumps to take the HID reports from.");
+DEFINE_string(vhci_device, "/dev/vhci", "Virtual HCI driver device.");
+
+namespace
+{
+
+// /dev/vhci creation request: HCI_VENDOR_PKT then this opcode. Bits 0-1 are
+// the device type (primary), bit 7 makes it a raw device.
+constexpr uint8_t VHCI_CREATE_RAW_PRIMARY = 0x80;
+constexpr std::chrono::milliseconds VHCI_CREATE_TIMEOUT{1000};
+// The kernel opens a new controller once during registration; the user
+// channel can only be bound after it has been closed again.
+constexpr int USER_CHANNEL_BIND_ATTEMPTS = 50;
+constexpr std::chrono::milliseconds USER_CHANNEL_BIND_RETRY{20};
+
+constexpr uint8_t EVENT_NUM_COMPLETED_PACKETS = 0x13;
+constexpr uint8_t EVENT_INQUIRY_RESULT_WITH_RSSI = 0x22;
+constexpr uint8_t EVENT_EXTENDED_INQUIRY_RESULT = 0x2F;
+constexpr size_t EXTENDED_INQUIRY_RESPONSE_SIZE = 240;
+
+// Reports in the traces arrive on handle 0x00b, CID 0x0041; the noise
+// connection uses neighbours of both.
+constexpr uint16_t NOISE_ACL_HANDLE = 0x00c;
+constexpr uint16_t NOISE_L2CAP_CID = 0x0040;
+constexpr uint16_t ACL_PACKET_BOUNDARY_START = 0x2000;
+// Leaves room for the ACL and L2CAP headers in xbone's monitor frame buffer.
+constexpr int MAX_ACL_PAYLOAD_SIZE = 1400;
+constexpr size_t NOISE_ACL_VARIANTS = 16;
+
+enum StreamIndex
+{
+  EVENT_STREAM,
+  NOISE_ACL_STREAM,
+  REPORT_STREAM,
+  STREAM_COUNT,
+};
+
+// Monitor opcode of received ACL data in the trace dumps.
+constexpr unsigned int TRACE_ACL_RX_OPCODE = 0x5;
+
+using Packet = std::vector<uint8_t>;
+
+volatile sig_atomic_t g_interrupted = 0;
+
+void HandleInterrupt(int)
+{
+  g_interrupted = 1;
+}
+
+void AppendLittleEndian16(uint16_t value, Packet *packet)
+{
+  packet->push_back(value & 0xFF);
+  packet->push_back(value >> 8);
+}
+
+// Reads every "Packet dump" frame in |path|, as printed by the debug build
+// the traces were taken with, and keeps the received ACL frames that carry a
+// whole controller report.
+void ReadTraceFile(const std::string &path, std::vector<Packet> *out_reports)
+{
+  std::ifstream file{path};
+  std::string line;
+  unsigned int opcode = 0;
+  Packet frame;
+
+  auto finish_frame = [&] {
+    if (opcode == TRACE_ACL_RX_OPCODE && frame.size() >= xbox::CONTROLLER_REPORT_SIZE)
+    {
+      out_reports->push_back(frame);
+    }
+    frame.clear();
+  };
+
+  while (std::getline(file, line))
+  {
+    unsigned int index;
+    unsigned int value;
+    if (sscanf(line.c_str(), "Packet dump: header.opcode=0x%x", &value) == 1)
+    {
+      finish_frame();
+      opcode = value;
+    }
+    else if (sscanf(line.c_str(), "Packet dump: buffer[%u]=0x%x", &index, &value) == 2 &&
+             index == frame.size())
+    {
+      frame.push_back(static_cast<uint8_t>(value));
+    }
+  }
+
+  finish_frame();
+}
+
+void ReadTraceDirectory(const std::string &path, std::vector<Packet> *out_reports)
+{
+  DIR *directory = opendir(path.c_str());
+  if (!directory)
+  {
+    return;
+  }
+
+  std::vector<std::string> entries;
+  while (struct dirent *entry = readdir(directory))
+  {
+    if (entry->d_name[0] != '.')
+    {
+      entries.push_back(path + "/" + entry->d_name);
+    }
+  }
+  closedir(directory);
+
+  // Deterministic replay order across runs.
+  std::sort(entries.begin(), entries.end());
+  for (const std::string &entry : entries)
+  {
+    struct stat entry_stat;
+    if (stat(entry.c_str(), &entry_stat) < 0)
+    {
+      continue;
+    }
+
+    if (S_ISDIR(entry_stat.st_mode))
+    {
+      ReadTraceDirectory(entry, out_reports);
+    }
+    else if (S_ISREG(entry_stat.st_mode))
+    {
+      ReadTraceFile(entry, out_reports);
+    }
+  }
+}
+
+std::vector<Packet> MakeEvents(std::mt19937 *random)
+{
+  std::vector<Packet> events;
+
+  // One completed packet on the noise connection.
+  Packet completed = {EVENT_NUM_COMPLETED_PACKETS, 5, 1};
+  AppendLittleEndian16(NOISE_ACL_HANDLE, &completed);
+  AppendLittleEndian16(1, &completed);
+  events.push_back(completed);
+
+  // A discoverable device nearby: address, page scan mode, reserved, class
+  // of device, clock offset and RSSI.
+  Packet inquiry = {EVENT_INQUIRY_RESULT_WITH_RSSI, 15, 1};
+  for (int i = 0; i < 6; ++i)
+  {
+    inquiry.push_back(static_cast<uint8_t>((*random)()));
+  }
+  inquiry.insert(inquiry.end(), {0x01, 0x00, 0x0C, 0x02, 0x5A, 0x00, 0x00, 0xC4});
+  events.push_back(inquiry);
+
+  // The same with a full extended inquiry response, the largest event an
+  // adapter sends while something around it is scanning.
+  Packet extended = {EVENT_EXTENDED_INQUIRY_RESULT, 255, 1};
+  extended.insert(extended.end(), inquiry.begin() + 3, inquiry.end());
+  for (size_t i = 0; i < EXTENDED_INQUIRY_RESPONSE_SIZE; ++i)
+  {
+    extended.push_back(static_cast<uint8_t>((*random)()));
+  }
+  events.push_back(extended);
+
+  return events;
+}
+
+std::vector<Packet> MakeNoiseAcl(size_t payload_size, std::mt19937 *random)
+{
+  std::vector<Packet> frames;
+  for (size_t variant = 0; variant < NOISE_ACL_VARIANTS; ++variant)
+  {
+    Packet frame;
+    AppendLittleEndian16(NOISE_ACL_HANDLE | ACL_PACKET_BOUNDARY_START, &frame);
+    AppendLittleEndian16(static_cast<uint16_t>(payload_size + 4), &frame);
+    AppendLittleEndian16(static_cast<uint16_t>(payload_size), &frame);
+    AppendLittleEndian16(NOISE_L2CAP_CID, &frame);
+    for (size_t i = 0; i < payload_size; ++i)
+    {
+      frame.push_back(static_cast<uint8_t>((*random)()));
+    }
+    frames.push_back(frame);
+  }
+  return frames;
+}
+
+bool CreateVirtualController(int *out_fd, uint16_t *out_index)
+{
+  int fd = open(FLAGS_vhci_device.c_str(), O_RDWR | O_CLOEXEC);
+  if (fd < 0)
+  {
+    fprintf(stderr, "Failed to open %s: %s\n", FLAGS_vhci_device.c_str(), strerror(errno));
+    return false;
+  }
+
+  uint8_t request[] = {HCI_VENDOR_PKT, VHCI_CREATE_RAW_PRIMARY};
+  if (write(fd, request, sizeof(request)) != static_cast<ssize_t>(sizeof(request)))
+  {
+    fprintf(stderr, "Failed to create virtual controller: %s\n", strerror(errno));
+    close(fd);
+    return false;
+  }
+
+  // The reply is HCI_VENDOR_PKT, the opcode and the new index.
+  struct pollfd readable = {fd, POLLIN, 0};
+  uint8_t reply[4];
+  if (poll(&readable, 1, VHCI_CREATE_TIMEOUT.count()) != 1 ||
+      read(fd, reply, sizeof(reply)) != static_cast<ssize_t>(sizeof(reply)) ||
+      reply[0] != HCI_VENDOR_PKT)
+  {
+    fprintf(stderr, "No reply from %s to the create request\n", FLAGS_vhci_device.c_str());
+    close(fd);
+    return false;
+  }
+
+  *out_fd = fd;
+  *out_index = reply[2] | (reply[3] << 8);
+  return true;
+}
+
+bool OpenUserChannel(uint16_t index, int *out_fd)
+{
+  int fd = socket(AF_BLUETOOTH, SOCK_RAW | SOCK_CLOEXEC, BTPROTO_HCI);
+  if (fd < 0)
+  {
+    fprintf(stderr, "Failed to open HCI socket: %s\n", strerror(errno));
+    return false;
+  }
+
+  struct sockaddr_hci address;
+  memset(&address, 0, sizeof(address));
+  address.hci_family = AF_BLUETOOTH;
+  address.hci_dev = index;
+  address.hci_channel = HCI_CHANNEL_USER;
+
+  for (int attempt = 0; attempt < USER_CHANNEL_BIND_ATTEMPTS; ++attempt)
+  {
+    if (bind(fd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) == 0)
+    {
+      *out_fd = fd;
+      return true;
+    }
+
+    if (errno != EBUSY && errno != EALREADY)
+    {
+      break;
+    }
+    std::this_thread::sleep_for(USER_CHANNEL_BIND_RETRY);
+  }
+
+  fprintf(stderr, "Failed to open hci%u as a user channel: %s\n", index, strerror(errno));
+  close(fd);
+  return false;
+}
+
+// One kind of injected traffic, cycling through |packets|.
+struct TrafficStream
+{
+  const char *name;
+  uint8_t packet_type;
+  double rate_hz;
+  std::vector<Packet> packets;
+  uint64_t sent;
+  uint64_t failed;
+
+  uint64_t GetDue(double elapsed_s) const
+  {
+    if (rate_hz <= 0 || packets.empty())
+    {
+      return 0;
+    }
+
+    uint64_t total = static_cast<uint64_t>(std::floor(elapsed_s * rate_hz));
+    return total > sent + failed ? total - sent - failed : 0;
+  }
+
+  void SendNext(int vhci_fd)
+  {
+    Packet &packet = packets[(sent + failed) % packets.size()];
+    struct iovec iov[2];
+    iov[0].iov_base = &packet_type;
+    iov[0].iov_len = sizeof(packet_type);
+    iov[1].iov_base = packet.data();
+    iov[1].iov_len = packet.size();
+
+    if (writev(vhci_fd, iov, 2) == static_cast<ssize_t>(1 + packet.size()))
+    {
+      ++sent;
+    }
+    else
+    {
+      ++failed;
+    }
+  }
+};
+
+}  // namespace
+
+int main(int argc, char **argv)
+{
+  gflags::SetUsageMessage("xbone_hci_stress [flags]");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (FLAGS_event_rate_hz < 0 || FLAGS_acl_rate_hz < 0 || FLAGS_report_rate_hz < 0 ||
+      FLAGS_tick_us <= 0 || FLAGS_duration_s < 0 ||
+      FLAGS_acl_payload_size < 0 || FLAGS_acl_payload_size > MAX_ACL_PAYLOAD_SIZE)
+  {
+    fprintf(stderr, "Invalid rates, tick, duration or ACL payload size\n");
+    return EXIT_FAILURE;
+  }
+
+  std::vector<Packet> reports;
+  if (FLAGS_report_rate_hz > 0)
+  {
+    ReadTraceDirectory(FLAGS_trace_dir, &reports);
+    if (reports.empty())
+    {
+      fprintf(stderr, "No controller reports found under %s\n", FLAGS_trace_dir.c_str());
+      return EXIT_FAILURE;
+    }
+  }
+
+  std::mt19937 random{std::random_device{}()};
+  TrafficStream streams[STREAM_COUNT] = {
+    {"events", HCI_EVENT_PKT, FLAGS_event_rate_hz, MakeEvents(&random), 0, 0},
+    {"noise_acl", HCI_ACLDATA_PKT, FLAGS_acl_rate_hz,
+     MakeNoiseAcl(static_cast<size_t>(FLAGS_acl_payload_size), &random), 0, 0},
+    {"reports", HCI_ACLDATA_PKT, FLAGS_report_rate_hz, std::move(reports), 0, 0},
+  };
+
+  int vhci_fd;
+  uint16_t index;
+  if (!CreateVirtualController(&vhci_fd, &index))
+  {
+    return EXIT_FAILURE;
+  }
+
+  int user_channel_fd;
+  if (!OpenUserChannel(index, &user_channel_fd))
+  {
+    close(vhci_fd);
+    return EXIT_FAILURE;
+  }
+
+  signal(SIGINT, HandleInterrupt);
+  signal(SIGTERM, HandleInterrupt);
+
+  printf("Injecting into hci%u: %.0f events/s, %.0f ACL frames/s of %d bytes, "
+         "%.0f reports/s (%zu from traces)\n",
+         index, FLAGS_event_rate_hz, FLAGS_acl_rate_hz, FLAGS_acl_payload_size,
+         FLAGS_report_rate_hz, streams[REPORT_STREAM].packets.size());
+
+  auto tick = std::chrono::microseconds{FLAGS_tick_us};
+  auto start = std::chrono::steady_clock::now();
+  auto end = start + std::chrono::seconds{FLAGS_duration_s};
+  auto next = start + tick;
+  while (!g_interrupted && (FLAGS_duration_s == 0 || next <= end))
+  {
+    std::this_thread::sleep_until(next);
+    double elapsed_s = std::chrono::duration<double>(next - start).count();
+
+    // Interleave the streams within a burst, as an adapter would.
+    uint64_t due[STREAM_COUNT];
+    bool any_due = false;
+    for (size_t i = 0; i < STREAM_COUNT; ++i)
+    {
+      due[i] = streams[i].GetDue(elapsed_s);
+      any_due = any_due || due[i] > 0;
+    }
+
+    while (any_due)
+    {
+      any_due = false;
+      for (size_t i = 0; i < STREAM_COUNT; ++i)
+      {
+        if (due[i] > 0)
+        {
+          streams[i].SendNext(vhci_fd);
+          any_due = any_due || --due[i] > 0;
+        }
+      }
+    }
+
+    next += tick;
+  }
+
+  double elapsed_s = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+  for (const TrafficStream &stream : streams)
+  {
+    printf("%-10s sent=%" PRIu64 " failed=%" PRIu64 " rate=%.0f/s\n",
+           stream.name, stream.sent, stream.failed, stream.sent / elapsed_s);
+  }
+
+  close(user_channel_fd);
+  close(vhci_fd);
+  return EXIT_SUCCESS;
+}
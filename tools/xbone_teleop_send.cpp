@@ -0,0 +1,189 @@
+// Operator-station side of xbone --teleop_listen.
+//
+// Sends controller reports as teleop datagrams, either replayed from a
+// capture written with xbone --capture_path at its original pace, or a
+// synthetic left-stick sweep. Pointed at 127.0.0.1 it exercises the whole
+// teleop path on one host; xbone exports the one-way latency as the
+// teleop_latency_ns gauge and the teleop_datagram probe.
+//
+//   xbone_teleop_send [--target=host:port] [--capture=file.xcap]
+//                     [--rate_hz=N] [--duration_s=N]
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <thread>
+
+#include "gflags/gflags.h"
+
+#include "src/controller_capture.h"
+#include "src/controller_report.h"
+#include "src/teleop_channel.h"
+#include "src/teleop_protocol.h"
+
+DEFINE_string(target, "127.0.0.1:47047", "xbone --teleop_listen address.");
+DEFINE_string(capture, "", "Replay this capture instead of sending a sweep.");
+DEFINE_double(rate_hz, 125, "Reports per second for the synthetic sweep.");
+DEFINE_int32(duration_s, 10, "Seconds of synthetic sweep to send.");
+DEFINE_double(sweep_period_s, 4, "Seconds per full left-stick sweep.");
+
+namespace
+{
+using xbox::ControllerCaptureHeader;
+using xbox::ControllerCaptureRecord;
+using xbox::TeleopDatagram;
+
+// Byte offsets from doc/packet-traces/packet-structure.txt.
+constexpr size_t LEFT_STICK_X_OFFSET = 10;
+constexpr size_t RIGHT_STICK_Y_OFFSET = 16;
+
+class TeleopSender
+{
+public:
+  TeleopSender(int fd, uint32_t session) : fd_{fd}, session_{session}, sequence_{0}, failed_{0} {}
+
+  void Send(const uint8_t *payload)
+  {
+    TeleopDatagram datagram;
+    datagram.session = session_;
+    datagram.sequence = sequence_++;
+    datagram.send_timestamp_ns = xbox::GetTeleopClockNanoseconds();
+    memcpy(datagram.payload, payload, sizeof(datagram.payload));
+
+    uint8_t buffer[xbox::TELEOP_DATAGRAM_SIZE];
+    xbox::EncodeTeleopDatagram(datagram, buffer);
+    if (send(fd_, buffer, sizeof(buffer), 0) != static_cast<ssize_t>(sizeof(buffer)))
+    {
+      ++failed_;
+    }
+  }
+
+  uint32_t GetSent() const { return sequence_; }
+  uint32_t GetFailed() const { return failed_; }
+
+private:
+  int fd_;
+  uint32_t session_;
+  uint32_t sequence_;
+  uint32_t failed_;
+};
+
+bool ReplayCapture(const std::string &path, TeleopSender *sender)
+{
+  FILE *file = fopen(path.c_str(), "rb");
+  if (!file)
+  {
+    fprintf(stderr, "Failed to open %s: %s\n", path.c_str(), strerror(errno));
+    return false;
+  }
+
+  ControllerCaptureHeader header;
+  if (fread(&header, sizeof(header), 1, file) != 1 ||
+      header.magic != xbox::CONTROLLER_CAPTURE_MAGIC ||
+      header.version != xbox::CONTROLLER_CAPTURE_VERSION ||
+      header.record_size != sizeof(ControllerCaptureRecord))
+  {
+    fprintf(stderr, "%s is not a version %u capture\n", path.c_str(), xbox::CONTROLLER_CAPTURE_VERSION);
+    fclose(file);
+    return false;
+  }
+
+  ControllerCaptureRecord record;
+  int64_t first_record_ns = 0;
+  auto start = std::chrono::steady_clock::now();
+  while (fread(&record, sizeof(record), 1, file) == 1)
+  {
+    if (first_record_ns == 0)
+    {
+      first_record_ns = record.timestamp_ns;
+    }
+
+    std::this_thread::sleep_until(
+        start + std::chrono::nanoseconds{record.timestamp_ns - first_record_ns});
+    sender->Send(record.payload);
+  }
+
+  fclose(file);
+  return true;
+}
+
+void SendSweep(TeleopSender *sender)
+{
+  uint8_t payload[xbox::CONTROLLER_REPORT_SIZE] = {};
+  // Centered sticks; the sweep only moves the left stick.
+  for (size_t offset = LEFT_STICK_X_OFFSET; offset <= RIGHT_STICK_Y_OFFSET; offset += 2)
+  {
+    payload[offset + 1] = 0x80;
+  }
+
+  auto period = std::chrono::duration<double>(1.0 / FLAGS_rate_hz);
+  auto start = std::chrono::steady_clock::now();
+  auto end = start + std::chrono::seconds{FLAGS_duration_s};
+  auto next = start;
+  while (next < end)
+  {
+    double elapsed = std::chrono::duration<double>(next - start).count();
+    double value = std::sin(2 * M_PI * elapsed / FLAGS_sweep_period_s);
+    uint16_t raw = static_cast<uint16_t>(std::lround(value * 0x7FFF + 0x8000));
+    payload[LEFT_STICK_X_OFFSET] = raw & 0xFF;
+    payload[LEFT_STICK_X_OFFSET + 1] = raw >> 8;
+
+    std::this_thread::sleep_until(next);
+    sender->Send(payload);
+    next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(period);
+  }
+}
+
+}  // namespace
+
+int main(int argc, char **argv)
+{
+  gflags::SetUsageMessage("xbone_teleop_send [flags]");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (FLAGS_rate_hz <= 0 || FLAGS_sweep_period_s <= 0)
+  {
+    fprintf(stderr, "--rate_hz and --sweep_period_s must be positive\n");
+    return EXIT_FAILURE;
+  }
+
+  struct sockaddr_in target;
+  if (!xbox::ParseTeleopAddress(FLAGS_target, &target))
+  {
+    return EXIT_FAILURE;
+  }
+
+  int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if (fd < 0 ||
+      connect(fd, reinterpret_cast<struct sockaddr *>(&target), sizeof(target)) < 0)
+  {
+    fprintf(stderr, "Failed to open socket to %s: %s\n", FLAGS_target.c_str(), strerror(errno));
+    return EXIT_FAILURE;
+  }
+
+  // Sessions must increase from run to run; the start time in seconds does
+  // unless the clock is set back.
+  TeleopSender sender{fd, static_cast<uint32_t>(time(nullptr))};
+  bool succeeded = true;
+  if (!FLAGS_capture.empty())
+  {
+    succeeded = ReplayCapture(FLAGS_capture, &sender);
+  }
+  else
+  {
+    SendSweep(&sender);
+  }
+
+  printf("Sent %u datagrams to %s, %u failed\n",
+         sender.GetSent(), FLAGS_target.c_str(), sender.GetFailed());
+  close(fd);
+  return succeeded ? EXIT_SUCCESS : EXIT_FAILURE;
+}